@@ -8,10 +8,23 @@ import cv2
 import tritonclient.grpc as grpcclient
 from tritonclient.utils import InferenceServerException
 
-from processing import preprocess, postprocess
+from processing import preprocess, postprocess, postprocess_nms
 from render import render_box, render_filled_box, get_text_size, render_text, RAND_COLORS
 from labels import COCOLabels
 
+ENGINE_NMS_OUTPUTS = ['num_detections', 'boxes', 'scores', 'classes']
+
+def requested_outputs(engine_nms):
+    names = ENGINE_NMS_OUTPUTS if engine_nms else ['detections']
+    return [grpcclient.InferRequestedOutput(name) for name in names]
+
+def detect(results, img_w, img_h, flags):
+    input_shape = [flags.width, flags.height]
+    if flags.engine_nms:
+        outputs = [results.as_numpy(name) for name in ENGINE_NMS_OUTPUTS]
+        return postprocess_nms(*outputs, img_w, img_h, input_shape, flags.confidence)
+    return postprocess(results.as_numpy('detections'), img_w, img_h, input_shape, flags.confidence, flags.nms)
+
 if __name__ == '__main__':
     parser = argparse.ArgumentParser()
     parser.add_argument('mode',
@@ -62,6 +75,12 @@ if __name__ == '__main__':
                         required=False,
                         default=0.5,
                         help='Non-maximum suppression threshold for filtering raw boxes, default 0.5')
+    parser.add_argument('-e',
+                        '--engine-nms',
+                        action="store_true",
+                        required=False,
+                        default=False,
+                        help='The engine suppresses the detections itself (built with --nms), read its boxes, scores and classes')
     parser.add_argument('-f',
                         '--fps',
                         type=float,
@@ -170,10 +189,9 @@ if __name__ == '__main__':
         print("Running in 'dummy' mode")
         print("Creating emtpy buffer filled with ones...")
         inputs = []
-        outputs = []
+        outputs = requested_outputs(FLAGS.engine_nms)
         inputs.append(grpcclient.InferInput('input', [1, 3, FLAGS.width, FLAGS.height], "FP32"))
         inputs[0].set_data_from_numpy(np.ones(shape=(1, 3, FLAGS.width, FLAGS.height), dtype=np.float32))
-        outputs.append(grpcclient.InferRequestedOutput('detections'))
 
         print("Invoking inference...")
         results = triton_client.infer(model_name=FLAGS.model,
@@ -188,7 +206,7 @@ if __name__ == '__main__':
             print(statistics)
         print("Done")
 
-        result = results.as_numpy('detections')
+        result = results.as_numpy('boxes' if FLAGS.engine_nms else 'detections')
         print(f"Received result buffer of size {result.shape}")
         print(f"Naive buffer sum: {np.sum(result)}")
 
@@ -200,9 +218,8 @@ if __name__ == '__main__':
             sys.exit(1)
         
         inputs = []
-        outputs = []
+        outputs = requested_outputs(FLAGS.engine_nms)
         inputs.append(grpcclient.InferInput('input', [1, 3, FLAGS.width, FLAGS.height], "FP32"))
-        outputs.append(grpcclient.InferRequestedOutput('detections'))
 
         print("Creating buffer from image file...")
         input_image = cv2.imread(str(FLAGS.input))
@@ -226,11 +243,11 @@ if __name__ == '__main__':
             print(statistics)
         print("Done")
 
-        result = results.as_numpy('detections')
+        result = results.as_numpy('boxes' if FLAGS.engine_nms else 'detections')
         print(f"Received result buffer of size {result.shape}")
         print(f"Naive buffer sum: {np.sum(result)}")
 
-        detected_objects = postprocess(result, input_image.shape[1], input_image.shape[0], [FLAGS.width, FLAGS.height], FLAGS.confidence, FLAGS.nms)
+        detected_objects = detect(results, input_image.shape[1], input_image.shape[0], FLAGS)
         print(f"Detected objects: {len(detected_objects)}")
 
         for box in detected_objects:
@@ -256,9 +273,8 @@ if __name__ == '__main__':
             sys.exit(1)
 
         inputs = []
-        outputs = []
+        outputs = requested_outputs(FLAGS.engine_nms)
         inputs.append(grpcclient.InferInput('input', [1, 3, FLAGS.width, FLAGS.height], "FP32"))
-        outputs.append(grpcclient.InferRequestedOutput('detections'))
 
         print("Opening input video stream...")
         cap = cv2.VideoCapture(FLAGS.input)
@@ -289,9 +305,7 @@ if __name__ == '__main__':
                                     outputs=outputs,
                                     client_timeout=FLAGS.client_timeout)
 
-            result = results.as_numpy('detections')
-
-            detected_objects = postprocess(result, frame.shape[1], frame.shape[0], [FLAGS.width, FLAGS.height], FLAGS.confidence, FLAGS.nms)
+            detected_objects = detect(results, frame.shape[1], frame.shape[0], FLAGS)
             print(f"Frame {counter}: {len(detected_objects)} objects")
             counter += 1
 
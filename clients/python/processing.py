@@ -73,6 +73,19 @@ def _nms_boxes(detections, nms_threshold):
     keep = np.array(keep)
     return keep
 
+def _image_scale(img_w, img_h, input_shape, letter_box):
+    """Width and height of the image the [0, 1] boxes refer to and the offset of the image in it."""
+    old_h, old_w = img_h, img_w
+    offset_h, offset_w = 0, 0
+    if letter_box:
+        if (img_w / input_shape[1]) >= (img_h / input_shape[0]):
+            old_h = int(input_shape[0] * img_w / input_shape[1])
+            offset_h = (old_h - img_h) // 2
+        else:
+            old_w = int(input_shape[1] * img_h / input_shape[0])
+            offset_w = (old_w - img_w) // 2
+    return old_w, old_h, offset_w, offset_h
+
 def postprocess(output, img_w, img_h, input_shape, conf_th=0.8, nms_threshold=0.5, letter_box=False):
     """Postprocess TensorRT outputs.
     # Args
@@ -94,15 +107,7 @@ def postprocess(output, img_w, img_h, input_shape, conf_th=0.8, nms_threshold=0.
         box_scores = detections[:, 4] * detections[:, 6]
 
         # scale x, y, w, h from [0, 1] to pixel values
-        old_h, old_w = img_h, img_w
-        offset_h, offset_w = 0, 0
-        if letter_box:
-            if (img_w / input_shape[1]) >= (img_h / input_shape[0]):
-                old_h = int(input_shape[0] * img_w / input_shape[1])
-                offset_h = (old_h - img_h) // 2
-            else:
-                old_w = int(input_shape[1] * img_h / input_shape[0])
-                offset_w = (old_w - img_w) // 2
+        old_w, old_h, offset_w, offset_h = _image_scale(img_w, img_h, input_shape, letter_box)
         detections[:, 0:4] *= np.array(
             [old_w, old_h, old_w, old_h], dtype=np.float32)
 
@@ -129,4 +134,33 @@ def postprocess(output, img_w, img_h, input_shape, conf_th=0.8, nms_threshold=0.
     detected_objects = []
     for box, score, label in zip(boxes, scores, classes):
         detected_objects.append(BoundingBox(label, score, box[0], box[2], box[1], box[3], img_h, img_w))
-    return detected_objects
\ No newline at end of file
+    return detected_objects
+
+def postprocess_nms(num_detections, boxes, scores, classes, img_w, img_h, input_shape, conf_th=0.8, letter_box=False):
+    """Postprocess the outputs of an engine built with --nms, the detections are already suppressed.
+    # Args
+        num_detections: number of detections kept
+        boxes, scores, classes: the kept detections first, boxes [x, y, w, h], then empty slots
+        conf_th: confidence threshold
+        letter_box: boolean, referring to _preprocess_yolo()
+    # Returns
+        list of bounding boxes with all detections above threshold, see class BoundingBox
+    """
+    count = int(num_detections.reshape(-1)[0])
+    boxes = boxes.reshape((-1, 4))[:count]
+    scores = scores.reshape(-1)[:count]
+    classes = classes.reshape(-1)[:count]
+    keep = scores >= conf_th
+    boxes, scores, classes = boxes[keep], scores[keep], classes[keep].astype(np.int)
+
+    # scale x, y, w, h from [0, 1] to pixel values
+    old_w, old_h, offset_w, offset_h = _image_scale(img_w, img_h, input_shape, letter_box)
+    boxes = boxes * np.array([old_w, old_h, old_w, old_h], dtype=np.float32)
+    xx = boxes[:, 0:1] - offset_w
+    yy = boxes[:, 1:2] - offset_h
+    boxes = np.concatenate([xx, yy, xx+boxes[:, 2:3], yy+boxes[:, 3:4]], axis=1) + 0.5
+    boxes = boxes.astype(np.int)
+    detected_objects = []
+    for box, score, label in zip(boxes, scores, classes):
+        detected_objects.append(BoundingBox(label, score, box[0], box[2], box[1], box[3], img_h, img_w))
+    return detected_objects
@@ -0,0 +1,47 @@
+#ifndef _MAXPOOL_H
+#define _MAXPOOL_H
+
+#include <algorithm>
+#include <cstddef>
+
+// Host references of the two forms of the SPP block of yolov4, see
+// BuildOptions::sppf. The block max-pools one CHW tensor with stride 1 and
+// windows of 5, 9 and 13, padded to keep the size. Padding never wins a max,
+// so every output is the max over the window clipped to the image. Two
+// clipped 5x5 windows in a row cover exactly the clipped 9x9 window and three
+// the 13x13 one, the cascade takes the max of the same values and gives
+// bit identical outputs. The one exception are windows with both +0 and -0,
+// which compare equal, and either of them may come out.
+
+// Stride 1 max-pool with a window x window window (odd) and padding window / 2
+template <typename T>
+static inline void maxPoolReference(const T* input, T* output, int channels, int height, int width, int window)
+{
+    int radius = window / 2;
+    for (int c = 0; c < channels; ++c) {
+        const T* plane = input + static_cast<size_t>(c) * height * width;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                T value = plane[static_cast<size_t>(y) * width + x];
+                for (int wy = std::max(y - radius, 0); wy <= std::min(y + radius, height - 1); ++wy) {
+                    for (int wx = std::max(x - radius, 0); wx <= std::min(x + radius, width - 1); ++wx) {
+                        value = std::max(value, plane[static_cast<size_t>(wy) * width + wx]);
+                    }
+                }
+                output[(static_cast<size_t>(c) * height + y) * width + x] = value;
+            }
+        }
+    }
+}
+
+// The 5, 9 and 13 pools of the SPP block as three cascaded 5x5 pools, each
+// output is channels * height * width values
+template <typename T>
+static inline void sppfReference(const T* input, T* pool5, T* pool9, T* pool13, int channels, int height, int width)
+{
+    maxPoolReference(input, pool5, channels, height, width, 5);
+    maxPoolReference(pool5, pool9, channels, height, width, 5);
+    maxPoolReference(pool9, pool13, channels, height, width, 5);
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef _MISH_H
+#define _MISH_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __CUDACC__
+#define MISH_HOST_DEVICE __host__ __device__
+#else
+#define MISH_HOST_DEVICE
+#endif
+
+// Mish activation, x * tanh(softplus(x)), shared by the Mish_TRT kernels and
+// the host reference. With n = e^x * (e^x + 2) it is x * n / (n + 2), so only
+// an exponential is needed. The exponential below uses nothing but fmaf, one
+// rounding multiply and exact bit operations, which are correctly rounded on
+// host and device alike, so host and GPU results are bit identical (the
+// CUDA math library expf/tanhf/log1pf are not).
+namespace Mish
+{
+    // Largest input for which the result is not just x
+    static constexpr float LINEAR_THRESHOLD = 20.0f;
+
+    MISH_HOST_DEVICE inline float fromBits(uint32_t bits)
+    {
+#ifdef __CUDA_ARCH__
+        return __int_as_float(static_cast<int>(bits));
+#else
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+#endif
+    }
+
+    // e^x = m * scale for x in [-150, 88] with m and scale normal floats,
+    // m * scale is within a few ulp of e^x
+    MISH_HOST_DEVICE inline float exp(float x, float& scale)
+    {
+        // x = k * ln2 + r with |r| <= ln2 / 2, ln2 split in a high part with
+        // trailing zero bits and a low part so that k * ln2hi is exact
+        float k = rintf(x * 1.44269504f);
+        float r = fmaf(k, -0.693145752f, x);
+        r = fmaf(k, -1.42860677e-06f, r);
+
+        // Taylor polynomial of e^r up to r^7 / 7!
+        float p = 1.98412698e-04f;
+        p = fmaf(p, r, 1.38888889e-03f);
+        p = fmaf(p, r, 8.33333333e-03f);
+        p = fmaf(p, r, 4.16666667e-02f);
+        p = fmaf(p, r, 1.66666667e-01f);
+        p = fmaf(p, r, 0.5f);
+        p = fmaf(p, r, 1.0f);
+        p = fmaf(p, r, 1.0f);
+
+        // 2^k in two factors, so that very small results round only once
+        int k1 = static_cast<int>(k) / 2;
+        int k2 = static_cast<int>(k) - k1;
+        scale = fromBits(static_cast<uint32_t>(k2 + 127) << 23);
+        return p * fromBits(static_cast<uint32_t>(k1 + 127) << 23);
+    }
+
+    MISH_HOST_DEVICE inline float mish(float x)
+    {
+        if (!(x <= LINEAR_THRESHOLD)) {
+            return x;  // also passes nan through
+        }
+        if (x < -150.0f) {
+            return -0.0f;
+        }
+
+        float scale;
+        float m = Mish::exp(x, scale);
+        if (x < -LINEAR_THRESHOLD) {
+            // n / (n + 2) rounds to e^x, multiply x first so that a
+            // subnormal result is rounded once
+            return x * m * scale;
+        }
+        float e = m * scale;
+        float n = fmaf(e, e, 2.0f * e);
+        return x * n / (n + 2.0f);
+    }
+}
+
+#ifndef __CUDACC__
+#include "../utils/half.h"
+
+// Host reference of the Mish_TRT plugin for FP32 tensors
+static inline void mishReference(const float* input, float* output, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        output[i] = Mish::mish(input[i]);
+    }
+}
+
+// Host reference of the Mish_TRT plugin for FP16 tensors, computed in float
+// and rounded to nearest even like __float2half_rn()
+static inline void mishReference(const uint16_t* input, uint16_t* output, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        output[i] = floatToHalf(Mish::mish(halfToFloat(input[i])));
+    }
+}
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+#include "mishlayer.h"
+
+#include <algorithm>
+#include <cuda_fp16.h>
+
+namespace
+{
+// Write values into buffer
+template <typename T>
+void write(char*& buffer, const T& val)
+{
+    *reinterpret_cast<T*>(buffer) = val;
+    buffer += sizeof(T);
+}
+
+// Read values from buffer
+template <typename T>
+void read(const char*& buffer, T& val)
+{
+    val = *reinterpret_cast<const T*>(buffer);
+    buffer += sizeof(T);
+}
+} // namespace
+
+namespace nvinfer1
+{
+    MishPlugin::MishPlugin(const void* data, size_t length)
+    {
+        const char *d = reinterpret_cast<const char *>(data);
+        read(d, mThreadCount);
+        read(d, mCount);
+        read(d, mDataType);
+
+        assert(d == reinterpret_cast<const char *>(data) + length);
+    }
+
+    void MishPlugin::serialize(void* buffer) const
+    {
+        char* d = static_cast<char*>(buffer);
+        write(d, mThreadCount);
+        write(d, mCount);
+        write(d, mDataType);
+
+        assert(d == static_cast<char*>(buffer) + getSerializationSize());
+    }
+
+    size_t MishPlugin::getSerializationSize() const
+    {
+        return sizeof(mThreadCount) + sizeof(mCount) + sizeof(mDataType);
+    }
+
+    int MishPlugin::initialize()
+    {
+        return 0;
+    }
+
+    void MishPlugin::terminate()
+    {
+    }
+
+    Dims MishPlugin::getOutputDimensions(int index, const Dims* inputs, int nbInputDims)
+    {
+        assert(index == 0);
+        assert(nbInputDims == 1);
+        return inputs[0];
+    }
+
+    void MishPlugin::setPluginNamespace(const char* pluginNamespace)
+    {
+        mPluginNamespace = pluginNamespace;
+    }
+
+    const char* MishPlugin::getPluginNamespace() const
+    {
+        return mPluginNamespace;
+    }
+
+    // Same type as the input, FP32 or FP16
+    DataType MishPlugin::getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const
+    {
+        return inputTypes[0];
+    }
+
+    // Return true if output tensor is broadcast across a batch.
+    bool MishPlugin::isOutputBroadcastAcrossBatch(int outputIndex, const bool* inputIsBroadcasted, int nbInputs) const
+    {
+        return false;
+    }
+
+    // Return true if plugin can use input that is broadcast across batch without replication.
+    bool MishPlugin::canBroadcastInputAcrossBatch(int inputIndex) const
+    {
+        return false;
+    }
+
+    void MishPlugin::configurePlugin(const PluginTensorDesc* in, int nbInput, const PluginTensorDesc* out, int nbOutput)
+    {
+        mDataType = in[0].type;
+        mCount = 1;
+        for (int i = 0; i < in[0].dims.nbDims; ++i) {
+            mCount *= in[0].dims.d[i];
+        }
+    }
+
+    // Attach the plugin object to an execution context and grant the plugin the access to some context resource.
+    void MishPlugin::attachToContext(cudnnContext* cudnnContext, cublasContext* cublasContext, IGpuAllocator* gpuAllocator)
+    {
+    }
+
+    // Detach the plugin object from its execution context.
+    void MishPlugin::detachFromContext()
+    {
+    }
+
+    const char* MishPlugin::getPluginType() const
+    {
+        return "Mish_TRT";
+    }
+
+    const char* MishPlugin::getPluginVersion() const
+    {
+        return "1";
+    }
+
+    void MishPlugin::destroy()
+    {
+        delete this;
+    }
+
+    // Clone the plugin
+    IPluginV2IOExt* MishPlugin::clone() const
+    {
+        MishPlugin *p = new MishPlugin(*this);
+        p->setPluginNamespace(mPluginNamespace);
+        return p;
+    }
+
+    // One element per thread, grid-stride so any tensor size works
+    __global__ void MishKernel(const float *input, float *output, int num_elements)
+    {
+        for (int idx = threadIdx.x + blockDim.x * blockIdx.x; idx < num_elements; idx += blockDim.x * gridDim.x) {
+            output[idx] = Mish::mish(input[idx]);
+        }
+    }
+
+    // FP16 tensors are computed in float, exactly like mishReference()
+    __global__ void MishKernelHalf(const __half *input, __half *output, int num_elements)
+    {
+        for (int idx = threadIdx.x + blockDim.x * blockIdx.x; idx < num_elements; idx += blockDim.x * gridDim.x) {
+            output[idx] = __float2half_rn(Mish::mish(__half2float(input[idx])));
+        }
+    }
+
+    int MishPlugin::enqueue(int batchSize, const void* const* inputs, void** outputs, void* workspace, cudaStream_t stream)
+    {
+        int num_elements = batchSize * mCount;
+        int blocks = std::min((num_elements + mThreadCount - 1) / mThreadCount, 65535);
+
+        if (mDataType == DataType::kHALF) {
+            MishKernelHalf<<<blocks, mThreadCount, 0, stream>>>((const __half*)inputs[0], (__half*)outputs[0], num_elements);
+        } else {
+            MishKernel<<<blocks, mThreadCount, 0, stream>>>((const float*)inputs[0], (float*)outputs[0], num_elements);
+        }
+        return cudaGetLastError() == cudaSuccess ? 0 : -1;
+    }
+
+    MishPluginCreator::MishPluginCreator()
+    {
+        mPluginAttributes.clear();
+
+        mFC.nbFields = mPluginAttributes.size();
+        mFC.fields = mPluginAttributes.data();
+    }
+
+    const char* MishPluginCreator::getPluginName() const
+    {
+        return "Mish_TRT";
+    }
+
+    const char* MishPluginCreator::getPluginVersion() const
+    {
+        return "1";
+    }
+
+    const PluginFieldCollection* MishPluginCreator::getFieldNames()
+    {
+        return &mFC;
+    }
+
+    IPluginV2IOExt* MishPluginCreator::createPlugin(const char* name, const PluginFieldCollection* fc)
+    {
+        assert(!strcmp(name, getPluginName()));
+        MishPlugin* obj = new MishPlugin();
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    IPluginV2IOExt* MishPluginCreator::deserializePlugin(const char* name, const void* serialData, size_t serialLength)
+    {
+        MishPlugin* obj = new MishPlugin(serialData, serialLength);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    PluginFieldCollection MishPluginCreator::mFC{};
+    std::vector<PluginField> MishPluginCreator::mPluginAttributes;
+} // namespace nvinfer1
@@ -0,0 +1,120 @@
+#ifndef _MISH_LAYER_H
+#define _MISH_LAYER_H
+
+#include <cassert>
+#include <vector>
+#include <string>
+#include <iostream>
+#include "NvInfer.h"
+
+#include "mish.h"
+
+namespace nvinfer1
+{
+    // Mish activation in a single pass, replaces the softplus, tanh and
+    // product layers. Works on FP32 and FP16 tensors of any shape, the math is
+    // shared with the host reference mishReference() in mish.h.
+    class MishPlugin: public IPluginV2IOExt
+    {
+        public:
+            MishPlugin() = default;
+            MishPlugin(const void* data, size_t length);
+
+            ~MishPlugin() override = default;
+
+            int getNbOutputs() const override
+            {
+                return 1;
+            }
+
+            Dims getOutputDimensions(int index, const Dims* inputs, int nbInputDims) override;
+
+            int initialize() override;
+
+            void terminate() override;
+
+            virtual size_t getWorkspaceSize(int maxBatchSize) const override { return 0;}
+
+            virtual int enqueue(int batchSize, const void*const * inputs, void** outputs, void* workspace, cudaStream_t stream) override;
+
+            virtual size_t getSerializationSize() const override;
+
+            virtual void serialize(void* buffer) const override;
+
+            bool supportsFormatCombination(int pos, const PluginTensorDesc* inOut, int nbInputs, int nbOutputs) const override {
+                return inOut[pos].format == TensorFormat::kLINEAR && (inOut[pos].type == DataType::kFLOAT || inOut[pos].type == DataType::kHALF)
+                    && inOut[pos].type == inOut[0].type;
+            }
+
+            const char* getPluginType() const override;
+
+            const char* getPluginVersion() const override;
+
+            void destroy() override;
+
+            IPluginV2IOExt* clone() const override;
+
+            void setPluginNamespace(const char* pluginNamespace) override;
+
+            const char* getPluginNamespace() const override;
+
+            DataType getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const override;
+
+            bool isOutputBroadcastAcrossBatch(int outputIndex, const bool* inputIsBroadcasted, int nbInputs) const override;
+
+            bool canBroadcastInputAcrossBatch(int inputIndex) const override;
+
+            void attachToContext(cudnnContext* cudnnContext, cublasContext* cublasContext, IGpuAllocator* gpuAllocator) override;
+
+            void configurePlugin(const PluginTensorDesc* in, int nbInput, const PluginTensorDesc* out, int nbOutput) override TRTNOEXCEPT;
+
+            void detachFromContext() override;
+
+        private:
+            int mThreadCount = 256;
+            int mCount = 0;  // elements per batch item
+            DataType mDataType = DataType::kFLOAT;
+
+            const char* mPluginNamespace = "";
+
+        protected:
+            using IPluginV2IOExt::configurePlugin;
+    };
+
+    class MishPluginCreator : public IPluginCreator
+    {
+        public:
+            MishPluginCreator();
+
+            ~MishPluginCreator() override = default;
+
+            const char* getPluginName() const override;
+
+            const char* getPluginVersion() const override;
+
+            const PluginFieldCollection* getFieldNames() override;
+
+            IPluginV2IOExt* createPlugin(const char* name, const PluginFieldCollection* fc) override;
+
+            IPluginV2IOExt* deserializePlugin(const char* name, const void* serialData, size_t serialLength) override;
+
+            void setPluginNamespace(const char* libNamespace) override
+            {
+                mNamespace = libNamespace;
+            }
+
+            const char* getPluginNamespace() const override
+            {
+                return mNamespace.c_str();
+            }
+
+        private:
+            static PluginFieldCollection mFC;
+            static std::vector<PluginField> mPluginAttributes;
+            std::string mNamespace;
+    };
+
+    REGISTER_TENSORRT_PLUGIN(MishPluginCreator);
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef _NMS_H
+#define _NMS_H
+
+#include <algorithm>
+#include <vector>
+
+#include "yolodecode.h"
+
+#ifdef __CUDACC__
+#define NMS_HOST_DEVICE __host__ __device__
+#else
+#define NMS_HOST_DEVICE
+#endif
+
+// Products rounded on their own on the device, so that nvcc cannot contract
+// them with a following addition into an FMA. The host code has to be built
+// with -ffp-contract=off for the same reason (see CMakeLists.txt), GCC
+// contracts by default as soon as FMA instructions are enabled. Then every
+// value below is computed with the same IEEE operations on host and device,
+// and the YoloNms_TRT kernels and nmsReference() give bit identical outputs.
+#ifdef __CUDA_ARCH__
+#define NMS_MUL(a, b) __fmul_rn(a, b)
+#else
+#define NMS_MUL(a, b) ((a) * (b))
+#endif
+
+// Batched per class non-maximum suppression of yolo detections, shared by the
+// YoloNms_TRT kernels and the host reference. Per image, the detections with
+// a score (det_confidence * class_confidence) of at least the score threshold
+// are ranked, the best topK of them are visited in rank order and each one
+// not suppressed is kept and suppresses the later ones of its class that
+// overlap it with an IoU above the IoU threshold, until maxOutputs are kept.
+namespace Nms
+{
+    // Largest topK, the suppression flags of the candidates live in shared memory
+    static constexpr int MAX_TOP_K = 4096;
+
+    NMS_HOST_DEVICE inline float score(const Yolo::Detection& det)
+    {
+        return NMS_MUL(det.det_confidence, det.class_confidence);
+    }
+
+    // Rank order of two detections, a before b: higher score first, ties by
+    // class and box and only then by index. The order depends on the contents
+    // alone, so detections compacted in any order (see the filter mode of
+    // YoloLayer_TRT) give the same output.
+    NMS_HOST_DEVICE inline bool before(const Yolo::Detection* detections, int a, int b)
+    {
+        const Yolo::Detection& da = detections[a];
+        const Yolo::Detection& db = detections[b];
+        float sa = score(da);
+        float sb = score(db);
+        if (sa != sb) {
+            return sa > sb;
+        }
+        if (da.class_id != db.class_id) {
+            return da.class_id < db.class_id;
+        }
+        for (int i = 0; i < 4; ++i) {
+            if (da.bbox[i] != db.bbox[i]) {
+                return da.bbox[i] < db.bbox[i];
+            }
+        }
+        return a < b;
+    }
+
+    // IoU of the two x, y, w, h boxes above threshold, as inter > threshold *
+    // union to do without a division. Boxes are relative to the image, unlike
+    // the pixel boxes of the python client there is no + 1 in the extents.
+    NMS_HOST_DEVICE inline bool overlaps(const Yolo::Detection& a, const Yolo::Detection& b, float threshold)
+    {
+        float x1 = fmaxf(a.bbox[0], b.bbox[0]);
+        float y1 = fmaxf(a.bbox[1], b.bbox[1]);
+        float x2 = fminf(a.bbox[0] + a.bbox[2], b.bbox[0] + b.bbox[2]);
+        float y2 = fminf(a.bbox[1] + a.bbox[3], b.bbox[1] + b.bbox[3]);
+        float intersection = NMS_MUL(fmaxf(x2 - x1, 0.0f), fmaxf(y2 - y1, 0.0f));
+        float areas = NMS_MUL(a.bbox[2], a.bbox[3]) + NMS_MUL(b.bbox[2], b.bbox[3]);
+        return intersection > NMS_MUL(threshold, areas - intersection);
+    }
+
+    // Writes kept detection i of an image to the outputs
+    NMS_HOST_DEVICE inline void writeOutput(const Yolo::Detection& det, int i, float* boxes, float* scores, float* classes)
+    {
+        for (int j = 0; j < 4; ++j) {
+            boxes[4 * i + j] = det.bbox[j];
+        }
+        scores[i] = score(det);
+        classes[i] = det.class_id;
+    }
+
+    // Empty output slot i, classes -1 to tell it from class 0
+    NMS_HOST_DEVICE inline void clearOutput(int i, float* boxes, float* scores, float* classes)
+    {
+        for (int j = 0; j < 4; ++j) {
+            boxes[4 * i + j] = 0.0f;
+        }
+        scores[i] = 0.0f;
+        classes[i] = -1.0f;
+    }
+
+    // Host reference for the count detections of one image, fills maxOutputs
+    // boxes (x, y, w, h), scores and classes and returns the number kept
+    static inline int nmsReference(const Yolo::Detection* detections, int count,
+                                   float scoreThreshold, float iouThreshold, int topK, int maxOutputs,
+                                   float* boxes, float* scores, float* classes)
+    {
+        std::vector<int> candidates;
+        for (int i = 0; i < count; ++i) {
+            if (score(detections[i]) >= scoreThreshold) {
+                candidates.push_back(i);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [detections](int a, int b) { return before(detections, a, b); });
+        candidates.resize(std::min(static_cast<int>(candidates.size()), topK));
+
+        std::vector<bool> suppressed(candidates.size(), false);
+        int kept = 0;
+        for (size_t i = 0; i < candidates.size() && kept < maxOutputs; ++i) {
+            if (suppressed[i]) {
+                continue;
+            }
+            const Yolo::Detection& det = detections[candidates[i]];
+            writeOutput(det, kept++, boxes, scores, classes);
+            for (size_t j = i + 1; j < candidates.size(); ++j) {
+                const Yolo::Detection& other = detections[candidates[j]];
+                if (!suppressed[j] && other.class_id == det.class_id && overlaps(det, other, iouThreshold)) {
+                    suppressed[j] = true;
+                }
+            }
+        }
+        for (int i = kept; i < maxOutputs; ++i) {
+            clearOutput(i, boxes, scores, classes);
+        }
+        return kept;
+    }
+}
+
+#endif
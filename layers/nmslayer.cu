@@ -0,0 +1,571 @@
+#include "nmslayer.h"
+
+#include <cstring>
+
+using namespace Yolo;
+
+namespace
+{
+// Write values into buffer
+template <typename T>
+void write(char*& buffer, const T& val)
+{
+    *reinterpret_cast<T*>(buffer) = val;
+    buffer += sizeof(T);
+}
+
+// Read values from buffer
+template <typename T>
+void read(const char*& buffer, T& val)
+{
+    val = *reinterpret_cast<const T*>(buffer);
+    buffer += sizeof(T);
+}
+} // namespace
+
+namespace nvinfer1
+{
+    // Detections per image rounded up to a power of two, the length of the
+    // bitonic sort of the candidates of an image in the workspace
+    static int sortSize(int rows)
+    {
+        int size = 1;
+        while (size < rows) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    static size_t nmsWorkspaceSize(int batchSize, int rows)
+    {
+        return static_cast<size_t>(batchSize) * sortSize(rows) * sizeof(int);
+    }
+
+    // Rank order with the padding (-1) of the sort last
+    inline __device__ bool ranksBefore(const Detection* detections, int a, int b)
+    {
+        return a >= 0 && (b < 0 || Nms::before(detections, a, b));
+    }
+
+    // BatchedNms(): This kernel suppresses the detections of the image
+    // blockIdx.x. The candidates are compacted in index order chunk by chunk
+    // (block prefix sum of warp ballots), brought into rank order by a
+    // bitonic sort in the workspace, and visited in that order by the whole
+    // block: thread 0 writes a kept detection, all threads mark the later
+    // candidates it suppresses. Everything runs in a fixed order, so the
+    // result is that of nmsReference() bit for bit.
+    __global__ void BatchedNms(const float *input, const int *counts, int rows,
+                               int *order_buffer, int sort_size,
+                               float score_thresh, float iou_thresh, int top_k, int max_outputs,
+                               int *num_detections, float *boxes, float *scores, float *classes)
+    {
+        __shared__ int warp_offsets[32];
+        __shared__ int chunk_total;
+        __shared__ unsigned char suppressed[Nms::MAX_TOP_K];
+
+        int image = blockIdx.x;
+        const Detection* detections = ((const Detection*) input) + image * rows;
+        int count = counts ? min(counts[image], rows) : rows;
+        int* order = order_buffer + image * sort_size;
+        boxes += image * max_outputs * 4;
+        scores += image * max_outputs;
+        classes += image * max_outputs;
+
+        int lane = threadIdx.x % 32;
+        int warp = threadIdx.x / 32;
+        int warps = (blockDim.x + 31) / 32;
+        int candidates = 0;
+        for (int start = 0; start < count; start += blockDim.x) {
+            int i = start + threadIdx.x;
+            bool candidate = i < count && Nms::score(detections[i]) >= score_thresh;
+            unsigned int ballot = __ballot_sync(0xffffffff, candidate);
+            if (lane == 0) {
+                warp_offsets[warp] = __popc(ballot);
+            }
+            __syncthreads();
+            if (threadIdx.x == 0) {
+                int total = 0;
+                for (int w = 0; w < warps; ++w) {
+                    int warp_total = warp_offsets[w];
+                    warp_offsets[w] = total;
+                    total += warp_total;
+                }
+                chunk_total = total;
+            }
+            __syncthreads();
+            if (candidate) {
+                order[candidates + warp_offsets[warp] + __popc(ballot & ((1u << lane) - 1))] = i;
+            }
+            candidates += chunk_total;
+            __syncthreads();
+        }
+
+        int size = 1;
+        while (size < candidates) {
+            size <<= 1;
+        }
+        for (int i = candidates + threadIdx.x; i < size; i += blockDim.x) {
+            order[i] = -1;
+        }
+        __syncthreads();
+        for (int run = 2; run <= size; run <<= 1) {
+            for (int stride = run / 2; stride > 0; stride >>= 1) {
+                for (int i = threadIdx.x; i < size; i += blockDim.x) {
+                    int j = i ^ stride;
+                    if (j > i) {
+                        int a = order[i];
+                        int b = order[j];
+                        // Runs with (i & run) == 0 go in rank order, the others reversed
+                        bool swap = (i & run) == 0 ? ranksBefore(detections, b, a) : ranksBefore(detections, a, b);
+                        if (swap) {
+                            order[i] = b;
+                            order[j] = a;
+                        }
+                    }
+                }
+                __syncthreads();
+            }
+        }
+
+        int ranked = min(candidates, top_k);
+        for (int i = threadIdx.x; i < ranked; i += blockDim.x) {
+            suppressed[i] = 0;
+        }
+        __syncthreads();
+        int kept = 0;
+        for (int i = 0; i < ranked && kept < max_outputs; ++i) {
+            if (suppressed[i]) {
+                continue;
+            }
+            const Detection& det = detections[order[i]];
+            if (threadIdx.x == 0) {
+                Nms::writeOutput(det, kept, boxes, scores, classes);
+            }
+            for (int j = i + 1 + threadIdx.x; j < ranked; j += blockDim.x) {
+                const Detection& other = detections[order[j]];
+                if (!suppressed[j] && other.class_id == det.class_id && Nms::overlaps(det, other, iou_thresh)) {
+                    suppressed[j] = 1;
+                }
+            }
+            kept++;
+            __syncthreads();
+        }
+        for (int i = kept + threadIdx.x; i < max_outputs; i += blockDim.x) {
+            Nms::clearOutput(i, boxes, scores, classes);
+        }
+        if (threadIdx.x == 0) {
+            num_detections[image] = kept;
+        }
+    }
+
+    // Suppresses the detections of batchSize images of rows detections each,
+    // of which the first counts[image] are valid if counts is given
+    static int launchNms(const float* input, const int* counts, int rows, void* const* outputs, void* workspace, cudaStream_t stream,
+                         int batchSize, int threadCount, float scoreThresh, float iouThresh, int topK, int maxOutputs)
+    {
+        BatchedNms<<<batchSize, threadCount, 0, stream>>>
+            (input, counts, rows, (int*) workspace, sortSize(rows), scoreThresh, iouThresh, topK, maxOutputs,
+             (int*) outputs[0], (float*) outputs[1], (float*) outputs[2], (float*) outputs[3]);
+        return cudaGetLastError() == cudaSuccess ? 0 : -1;
+    }
+
+    YoloNmsPlugin::YoloNmsPlugin(float score_thresh, float iou_thresh, int top_k, int max_outputs)
+    {
+        mScoreThresh = score_thresh;
+        mIouThresh   = iou_thresh;
+        mTopK        = top_k;
+        mMaxOutputs  = max_outputs;
+    }
+
+    YoloNmsPlugin::YoloNmsPlugin(const void* data, size_t length)
+    {
+        const char *d = reinterpret_cast<const char *>(data);
+        read(d, mThreadCount);
+        read(d, mScoreThresh);
+        read(d, mIouThresh);
+        read(d, mTopK);
+        read(d, mMaxOutputs);
+        read(d, mRows);
+        read(d, mCounted);
+
+        assert(d == reinterpret_cast<const char *>(data) + length);
+    }
+
+    void YoloNmsPlugin::serialize(void* buffer) const
+    {
+        char* d = static_cast<char*>(buffer);
+        write(d, mThreadCount);
+        write(d, mScoreThresh);
+        write(d, mIouThresh);
+        write(d, mTopK);
+        write(d, mMaxOutputs);
+        write(d, mRows);
+        write(d, mCounted);
+
+        assert(d == static_cast<char*>(buffer) + getSerializationSize());
+    }
+
+    size_t YoloNmsPlugin::getSerializationSize() const
+    {
+        return sizeof(mThreadCount) + \
+               sizeof(mScoreThresh) + sizeof(mIouThresh) + \
+               sizeof(mTopK) + sizeof(mMaxOutputs) + \
+               sizeof(mRows) + sizeof(mCounted);
+    }
+
+    int YoloNmsPlugin::initialize()
+    {
+        return 0;
+    }
+
+    void YoloNmsPlugin::terminate()
+    {
+    }
+
+    size_t YoloNmsPlugin::getWorkspaceSize(int maxBatchSize) const
+    {
+        return nmsWorkspaceSize(maxBatchSize, mRows);
+    }
+
+    Dims YoloNmsPlugin::getOutputDimensions(int index, const Dims* inputs, int nbInputDims)
+    {
+        assert(index < 4);
+        assert(nbInputDims == 1 || nbInputDims == 2);
+        assert(inputs[0].d[0] % static_cast<int>(sizeof(Detection) / sizeof(float)) == 0);
+        // num_detections {1}, boxes {max_outputs, 4}, scores and classes {max_outputs}
+        Dims output;
+        output.nbDims = index == 1 ? 2 : 1;
+        output.d[0] = index == 0 ? 1 : mMaxOutputs;
+        output.d[1] = 4;
+        return output;
+    }
+
+    void YoloNmsPlugin::setPluginNamespace(const char* pluginNamespace)
+    {
+        mPluginNamespace = pluginNamespace;
+    }
+
+    const char* YoloNmsPlugin::getPluginNamespace() const
+    {
+        return mPluginNamespace;
+    }
+
+    DataType YoloNmsPlugin::getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const
+    {
+        return index == 0 ? DataType::kINT32 : DataType::kFLOAT;
+    }
+
+    bool YoloNmsPlugin::isOutputBroadcastAcrossBatch(int outputIndex, const bool* inputIsBroadcasted, int nbInputs) const
+    {
+        return false;
+    }
+
+    bool YoloNmsPlugin::canBroadcastInputAcrossBatch(int inputIndex) const
+    {
+        return false;
+    }
+
+    void YoloNmsPlugin::configurePlugin(const PluginTensorDesc* in, int nbInput, const PluginTensorDesc* out, int nbOutput)
+    {
+        mRows = in[0].dims.d[0] / static_cast<int>(sizeof(Detection) / sizeof(float));
+        mCounted = nbInput == 2;
+    }
+
+    void YoloNmsPlugin::attachToContext(cudnnContext* cudnnContext, cublasContext* cublasContext, IGpuAllocator* gpuAllocator)
+    {
+    }
+
+    void YoloNmsPlugin::detachFromContext()
+    {
+    }
+
+    const char* YoloNmsPlugin::getPluginType() const
+    {
+        return "YoloNms_TRT";
+    }
+
+    const char* YoloNmsPlugin::getPluginVersion() const
+    {
+        return "1";
+    }
+
+    void YoloNmsPlugin::destroy()
+    {
+        delete this;
+    }
+
+    IPluginV2IOExt* YoloNmsPlugin::clone() const
+    {
+        YoloNmsPlugin *p = new YoloNmsPlugin(mScoreThresh, mIouThresh, mTopK, mMaxOutputs);
+        p->mRows = mRows;
+        p->mCounted = mCounted;
+        p->setPluginNamespace(mPluginNamespace);
+        return p;
+    }
+
+    int YoloNmsPlugin::enqueue(int batchSize, const void* const* inputs, void** outputs, void* workspace, cudaStream_t stream)
+    {
+        return launchNms((const float*) inputs[0], mCounted ? (const int*) inputs[1] : nullptr, mRows, outputs, workspace, stream,
+                         batchSize, mThreadCount, mScoreThresh, mIouThresh, mTopK, mMaxOutputs);
+    }
+
+    YoloNmsDynamicPlugin::YoloNmsDynamicPlugin(float score_thresh, float iou_thresh, int top_k, int max_outputs)
+    {
+        mScoreThresh = score_thresh;
+        mIouThresh   = iou_thresh;
+        mTopK        = top_k;
+        mMaxOutputs  = max_outputs;
+    }
+
+    YoloNmsDynamicPlugin::YoloNmsDynamicPlugin(const void* data, size_t length)
+    {
+        const char *d = reinterpret_cast<const char *>(data);
+        read(d, mThreadCount);
+        read(d, mScoreThresh);
+        read(d, mIouThresh);
+        read(d, mTopK);
+        read(d, mMaxOutputs);
+        read(d, mCounted);
+
+        assert(d == reinterpret_cast<const char *>(data) + length);
+    }
+
+    void YoloNmsDynamicPlugin::serialize(void* buffer) const
+    {
+        char* d = static_cast<char*>(buffer);
+        write(d, mThreadCount);
+        write(d, mScoreThresh);
+        write(d, mIouThresh);
+        write(d, mTopK);
+        write(d, mMaxOutputs);
+        write(d, mCounted);
+
+        assert(d == static_cast<char*>(buffer) + getSerializationSize());
+    }
+
+    size_t YoloNmsDynamicPlugin::getSerializationSize() const
+    {
+        return sizeof(mThreadCount) + \
+               sizeof(mScoreThresh) + sizeof(mIouThresh) + \
+               sizeof(mTopK) + sizeof(mMaxOutputs) + \
+               sizeof(mCounted);
+    }
+
+    int YoloNmsDynamicPlugin::initialize()
+    {
+        return 0;
+    }
+
+    void YoloNmsDynamicPlugin::terminate()
+    {
+    }
+
+    size_t YoloNmsDynamicPlugin::getWorkspaceSize(const PluginTensorDesc* inputs, int nbInputs, const PluginTensorDesc* outputs, int nbOutputs) const
+    {
+        return nmsWorkspaceSize(inputs[0].dims.d[0], inputs[0].dims.d[1] / static_cast<int>(sizeof(Detection) / sizeof(float)));
+    }
+
+    DimsExprs YoloNmsDynamicPlugin::getOutputDimensions(int outputIndex, const DimsExprs* inputs, int nbInputs, IExprBuilder& exprBuilder)
+    {
+        assert(outputIndex < 4);
+        assert(nbInputs == 1 || nbInputs == 2);
+        assert(inputs[0].nbDims == 4);
+        // num_detections {N, 1}, boxes {N, max_outputs, 4}, scores and classes {N, max_outputs}
+        DimsExprs output;
+        output.nbDims = outputIndex == 1 ? 3 : 2;
+        output.d[0] = inputs[0].d[0];
+        output.d[1] = exprBuilder.constant(outputIndex == 0 ? 1 : mMaxOutputs);
+        output.d[2] = exprBuilder.constant(4);
+        return output;
+    }
+
+    void YoloNmsDynamicPlugin::setPluginNamespace(const char* pluginNamespace)
+    {
+        mPluginNamespace = pluginNamespace;
+    }
+
+    const char* YoloNmsDynamicPlugin::getPluginNamespace() const
+    {
+        return mPluginNamespace;
+    }
+
+    DataType YoloNmsDynamicPlugin::getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const
+    {
+        return index == 0 ? DataType::kINT32 : DataType::kFLOAT;
+    }
+
+    void YoloNmsDynamicPlugin::configurePlugin(const DynamicPluginTensorDesc* in, int nbInputs, const DynamicPluginTensorDesc* out, int nbOutputs)
+    {
+        assert(nbInputs == 1 || nbInputs == 2);
+        mCounted = nbInputs == 2;
+    }
+
+    const char* YoloNmsDynamicPlugin::getPluginType() const
+    {
+        return "YoloNms_TRT";
+    }
+
+    const char* YoloNmsDynamicPlugin::getPluginVersion() const
+    {
+        return "2";
+    }
+
+    void YoloNmsDynamicPlugin::destroy()
+    {
+        delete this;
+    }
+
+    IPluginV2DynamicExt* YoloNmsDynamicPlugin::clone() const
+    {
+        YoloNmsDynamicPlugin *p = new YoloNmsDynamicPlugin(mScoreThresh, mIouThresh, mTopK, mMaxOutputs);
+        p->mCounted = mCounted;
+        p->setPluginNamespace(mPluginNamespace);
+        return p;
+    }
+
+    int YoloNmsDynamicPlugin::enqueue(const PluginTensorDesc* inputDesc, const PluginTensorDesc* outputDesc, const void* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream)
+    {
+        int batchSize = inputDesc[0].dims.d[0];
+        int rows = inputDesc[0].dims.d[1] / static_cast<int>(sizeof(Detection) / sizeof(float));
+        return launchNms((const float*) inputs[0], mCounted ? (const int*) inputs[1] : nullptr, rows, outputs, workspace, stream,
+                         batchSize, mThreadCount, mScoreThresh, mIouThresh, mTopK, mMaxOutputs);
+    }
+
+    // Fields of both versions of YoloNms_TRT
+    static void addNmsFields(std::vector<PluginField>& attributes)
+    {
+        attributes.emplace_back(PluginField("scoreThreshold", nullptr, PluginFieldType::kFLOAT32, 1));
+        attributes.emplace_back(PluginField("iouThreshold", nullptr, PluginFieldType::kFLOAT32, 1));
+        attributes.emplace_back(PluginField("topK", nullptr, PluginFieldType::kINT32, 1));
+        attributes.emplace_back(PluginField("maxOutputs", nullptr, PluginFieldType::kINT32, 1));
+    }
+
+    static void parseNmsFields(const PluginFieldCollection* fc, float& score_thresh, float& iou_thresh, int& top_k, int& max_outputs)
+    {
+        const PluginField* fields = fc->fields;
+        for (int i = 0; i < fc->nbFields; ++i)
+        {
+            const char* attrName = fields[i].name;
+            if (!strcmp(attrName, "scoreThreshold"))
+            {
+                assert(fields[i].type == PluginFieldType::kFLOAT32);
+                score_thresh = *(static_cast<const float*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "iouThreshold"))
+            {
+                assert(fields[i].type == PluginFieldType::kFLOAT32);
+                iou_thresh = *(static_cast<const float*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "topK"))
+            {
+                assert(fields[i].type == PluginFieldType::kINT32);
+                top_k = *(static_cast<const int*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "maxOutputs"))
+            {
+                assert(fields[i].type == PluginFieldType::kINT32);
+                max_outputs = *(static_cast<const int*>(fields[i].data));
+            }
+            else
+            {
+                std::cerr <<  "Unknown attribute: " << attrName << std::endl;
+                assert(0);
+            }
+        }
+        assert(iou_thresh >= 0.0f && iou_thresh <= 1.0f);
+        assert(top_k > 0 && top_k <= Nms::MAX_TOP_K);
+        assert(max_outputs > 0 && max_outputs <= top_k);
+    }
+
+    YoloNmsPluginCreator::YoloNmsPluginCreator()
+    {
+        mPluginAttributes.clear();
+        addNmsFields(mPluginAttributes);
+
+        mFC.nbFields = mPluginAttributes.size();
+        mFC.fields = mPluginAttributes.data();
+    }
+
+    const char* YoloNmsPluginCreator::getPluginName() const
+    {
+        return "YoloNms_TRT";
+    }
+
+    const char* YoloNmsPluginCreator::getPluginVersion() const
+    {
+        return "1";
+    }
+
+    const PluginFieldCollection* YoloNmsPluginCreator::getFieldNames()
+    {
+        return &mFC;
+    }
+
+    IPluginV2IOExt* YoloNmsPluginCreator::createPlugin(const char* name, const PluginFieldCollection* fc)
+    {
+        assert(!strcmp(name, getPluginName()));
+        float score_thresh = 0.0f, iou_thresh = 0.5f;
+        int top_k = 1000, max_outputs = 100;
+        parseNmsFields(fc, score_thresh, iou_thresh, top_k, max_outputs);
+
+        YoloNmsPlugin* obj = new YoloNmsPlugin(score_thresh, iou_thresh, top_k, max_outputs);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    IPluginV2IOExt* YoloNmsPluginCreator::deserializePlugin(const char* name, const void* serialData, size_t serialLength)
+    {
+        YoloNmsPlugin* obj = new YoloNmsPlugin(serialData, serialLength);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    PluginFieldCollection YoloNmsPluginCreator::mFC{};
+    std::vector<PluginField> YoloNmsPluginCreator::mPluginAttributes;
+
+    YoloNmsDynamicPluginCreator::YoloNmsDynamicPluginCreator()
+    {
+        mPluginAttributes.clear();
+        addNmsFields(mPluginAttributes);
+
+        mFC.nbFields = mPluginAttributes.size();
+        mFC.fields = mPluginAttributes.data();
+    }
+
+    const char* YoloNmsDynamicPluginCreator::getPluginName() const
+    {
+        return "YoloNms_TRT";
+    }
+
+    const char* YoloNmsDynamicPluginCreator::getPluginVersion() const
+    {
+        return "2";
+    }
+
+    const PluginFieldCollection* YoloNmsDynamicPluginCreator::getFieldNames()
+    {
+        return &mFC;
+    }
+
+    IPluginV2DynamicExt* YoloNmsDynamicPluginCreator::createPlugin(const char* name, const PluginFieldCollection* fc)
+    {
+        assert(!strcmp(name, getPluginName()));
+        float score_thresh = 0.0f, iou_thresh = 0.5f;
+        int top_k = 1000, max_outputs = 100;
+        parseNmsFields(fc, score_thresh, iou_thresh, top_k, max_outputs);
+
+        YoloNmsDynamicPlugin* obj = new YoloNmsDynamicPlugin(score_thresh, iou_thresh, top_k, max_outputs);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    IPluginV2DynamicExt* YoloNmsDynamicPluginCreator::deserializePlugin(const char* name, const void* serialData, size_t serialLength)
+    {
+        YoloNmsDynamicPlugin* obj = new YoloNmsDynamicPlugin(serialData, serialLength);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    PluginFieldCollection YoloNmsDynamicPluginCreator::mFC{};
+    std::vector<PluginField> YoloNmsDynamicPluginCreator::mPluginAttributes;
+} // namespace nvinfer1
@@ -0,0 +1,235 @@
+#ifndef _NMS_LAYER_H
+#define _NMS_LAYER_H
+
+#include <cassert>
+#include <vector>
+#include <string>
+#include <iostream>
+#include "NvInfer.h"
+
+#include "nms.h"
+
+namespace nvinfer1
+{
+    // Batched per class non-maximum suppression of the detections of the yolo
+    // layers, see nms.h. The input is their concatenation, rows of 7 floats,
+    // or the compacted detections of filtering yolo layers with their number
+    // per image as second input. The outputs are num_detections {1} (INT32),
+    // boxes {max_outputs, 4} (x, y, w, h), scores {max_outputs} and classes
+    // {max_outputs}, the slots after num_detections are zero with class -1.
+    // One block per image ranks and suppresses the candidates, the outputs
+    // are bit identical to those of the host reference nmsReference().
+    class YoloNmsPlugin: public IPluginV2IOExt
+    {
+        public:
+            YoloNmsPlugin(float score_thresh, float iou_thresh, int top_k, int max_outputs);
+            YoloNmsPlugin(const void* data, size_t length);
+
+            ~YoloNmsPlugin() override = default;
+
+            int getNbOutputs() const override
+            {
+                return 4;
+            }
+
+            Dims getOutputDimensions(int index, const Dims* inputs, int nbInputDims) override;
+
+            int initialize() override;
+
+            void terminate() override;
+
+            virtual size_t getWorkspaceSize(int maxBatchSize) const override;
+
+            virtual int enqueue(int batchSize, const void*const * inputs, void** outputs, void* workspace, cudaStream_t stream) override;
+
+            virtual size_t getSerializationSize() const override;
+
+            virtual void serialize(void* buffer) const override;
+
+            bool supportsFormatCombination(int pos, const PluginTensorDesc* inOut, int nbInputs, int nbOutputs) const override {
+                // The numbers of detections in and out are INT32, all else FP32
+                DataType type = pos == nbInputs || (nbInputs == 2 && pos == 1) ? DataType::kINT32 : DataType::kFLOAT;
+                return inOut[pos].format == TensorFormat::kLINEAR && inOut[pos].type == type;
+            }
+
+            const char* getPluginType() const override;
+
+            const char* getPluginVersion() const override;
+
+            void destroy() override;
+
+            IPluginV2IOExt* clone() const override;
+
+            void setPluginNamespace(const char* pluginNamespace) override;
+
+            const char* getPluginNamespace() const override;
+
+            DataType getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const override;
+
+            bool isOutputBroadcastAcrossBatch(int outputIndex, const bool* inputIsBroadcasted, int nbInputs) const override;
+
+            bool canBroadcastInputAcrossBatch(int inputIndex) const override;
+
+            void attachToContext(cudnnContext* cudnnContext, cublasContext* cublasContext, IGpuAllocator* gpuAllocator) override;
+
+            void configurePlugin(const PluginTensorDesc* in, int nbInput, const PluginTensorDesc* out, int nbOutput) override TRTNOEXCEPT;
+
+            void detachFromContext() override;
+
+        private:
+            int mThreadCount = 256;
+            float mScoreThresh;
+            float mIouThresh;
+            int mTopK;
+            int mMaxOutputs;
+            int mRows = 0;      // detections per image
+            int mCounted = 0;   // takes the number of detections per image as second input
+
+            const char* mPluginNamespace = "";
+
+        protected:
+            using IPluginV2IOExt::configurePlugin;
+    };
+
+    class YoloNmsPluginCreator : public IPluginCreator
+    {
+        public:
+            YoloNmsPluginCreator();
+
+            ~YoloNmsPluginCreator() override = default;
+
+            const char* getPluginName() const override;
+
+            const char* getPluginVersion() const override;
+
+            const PluginFieldCollection* getFieldNames() override;
+
+            IPluginV2IOExt* createPlugin(const char* name, const PluginFieldCollection* fc) override;
+
+            IPluginV2IOExt* deserializePlugin(const char* name, const void* serialData, size_t serialLength) override;
+
+            void setPluginNamespace(const char* libNamespace) override
+            {
+                mNamespace = libNamespace;
+            }
+
+            const char* getPluginNamespace() const override
+            {
+                return mNamespace.c_str();
+            }
+
+        private:
+            static PluginFieldCollection mFC;
+            static std::vector<PluginField> mPluginAttributes;
+            std::string mNamespace;
+    };
+
+    // Version 2 of YoloNms_TRT for explicit batch networks, the number of
+    // detections per image is taken from the input at runtime. The outputs
+    // are {N, 1}, {N, max_outputs, 4}, {N, max_outputs} and {N, max_outputs}.
+    class YoloNmsDynamicPlugin: public IPluginV2DynamicExt
+    {
+        public:
+            YoloNmsDynamicPlugin(float score_thresh, float iou_thresh, int top_k, int max_outputs);
+            YoloNmsDynamicPlugin(const void* data, size_t length);
+
+            ~YoloNmsDynamicPlugin() override = default;
+
+            int getNbOutputs() const override
+            {
+                return 4;
+            }
+
+            DimsExprs getOutputDimensions(int outputIndex, const DimsExprs* inputs, int nbInputs, IExprBuilder& exprBuilder) override;
+
+            int initialize() override;
+
+            void terminate() override;
+
+            size_t getWorkspaceSize(const PluginTensorDesc* inputs, int nbInputs, const PluginTensorDesc* outputs, int nbOutputs) const override;
+
+            int enqueue(const PluginTensorDesc* inputDesc, const PluginTensorDesc* outputDesc, const void* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream) override;
+
+            size_t getSerializationSize() const override;
+
+            void serialize(void* buffer) const override;
+
+            bool supportsFormatCombination(int pos, const PluginTensorDesc* inOut, int nbInputs, int nbOutputs) override {
+                DataType type = pos == nbInputs || (nbInputs == 2 && pos == 1) ? DataType::kINT32 : DataType::kFLOAT;
+                return inOut[pos].format == TensorFormat::kLINEAR && inOut[pos].type == type;
+            }
+
+            const char* getPluginType() const override;
+
+            const char* getPluginVersion() const override;
+
+            void destroy() override;
+
+            IPluginV2DynamicExt* clone() const override;
+
+            void setPluginNamespace(const char* pluginNamespace) override;
+
+            const char* getPluginNamespace() const override;
+
+            DataType getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const override;
+
+            void configurePlugin(const DynamicPluginTensorDesc* in, int nbInputs, const DynamicPluginTensorDesc* out, int nbOutputs) override;
+
+        private:
+            int mThreadCount = 256;
+            float mScoreThresh;
+            float mIouThresh;
+            int mTopK;
+            int mMaxOutputs;
+            int mCounted = 0;
+
+            const char* mPluginNamespace = "";
+
+        protected:
+            using IPluginV2DynamicExt::canBroadcastInputAcrossBatch;
+            using IPluginV2DynamicExt::configurePlugin;
+            using IPluginV2DynamicExt::enqueue;
+            using IPluginV2DynamicExt::getOutputDimensions;
+            using IPluginV2DynamicExt::getWorkspaceSize;
+            using IPluginV2DynamicExt::isOutputBroadcastAcrossBatch;
+            using IPluginV2DynamicExt::supportsFormat;
+    };
+
+    class YoloNmsDynamicPluginCreator : public IPluginCreator
+    {
+        public:
+            YoloNmsDynamicPluginCreator();
+
+            ~YoloNmsDynamicPluginCreator() override = default;
+
+            const char* getPluginName() const override;
+
+            const char* getPluginVersion() const override;
+
+            const PluginFieldCollection* getFieldNames() override;
+
+            IPluginV2DynamicExt* createPlugin(const char* name, const PluginFieldCollection* fc) override;
+
+            IPluginV2DynamicExt* deserializePlugin(const char* name, const void* serialData, size_t serialLength) override;
+
+            void setPluginNamespace(const char* libNamespace) override
+            {
+                mNamespace = libNamespace;
+            }
+
+            const char* getPluginNamespace() const override
+            {
+                return mNamespace.c_str();
+            }
+
+        private:
+            static PluginFieldCollection mFC;
+            static std::vector<PluginField> mPluginAttributes;
+            std::string mNamespace;
+    };
+
+    REGISTER_TENSORRT_PLUGIN(YoloNmsPluginCreator);
+    REGISTER_TENSORRT_PLUGIN(YoloNmsDynamicPluginCreator);
+};
+
+#endif
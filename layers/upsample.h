@@ -0,0 +1,48 @@
+#ifndef _UPSAMPLE_H
+#define _UPSAMPLE_H
+
+#include <cstddef>
+
+// Host references of the two ways the necks upsample a CHW tensor by 2, see
+// UpsampleMode. Both give the same output: every output pixel of the 2x2
+// stride 2 grouped deconvolution sees exactly one input pixel times a kernel
+// value of 1, which is what the nearest neighbor resize copies (only -0 comes
+// out of the deconvolution as +0).
+
+// Nearest neighbor resize by 2 like IResizeLayer with ResizeMode::kNEAREST
+template <typename T>
+static inline void upsampleNearestReference(const T* input, T* output, int channels, int height, int width)
+{
+    for (int c = 0; c < channels; ++c) {
+        for (int y = 0; y < 2 * height; ++y) {
+            const T* row = input + (static_cast<size_t>(c) * height + y / 2) * width;
+            T* out = output + (static_cast<size_t>(c) * 2 * height + y) * 2 * width;
+            for (int x = 0; x < 2 * width; ++x) {
+                out[x] = row[x / 2];
+            }
+        }
+    }
+}
+
+// Grouped 2x2 stride 2 deconvolution with one group per channel, kernel is
+// channels * 2 * 2 values as made by deriveUpsampleWeights()
+static inline void upsampleDeconvolutionReference(const float* input, const float* kernel, float* output, int channels, int height, int width)
+{
+    for (size_t i = 0; i < static_cast<size_t>(channels) * 4 * height * width; ++i) {
+        output[i] = 0.0f;
+    }
+    for (int c = 0; c < channels; ++c) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                float value = input[(static_cast<size_t>(c) * height + y) * width + x];
+                for (int ky = 0; ky < 2; ++ky) {
+                    for (int kx = 0; kx < 2; ++kx) {
+                        output[(static_cast<size_t>(c) * 2 * height + 2 * y + ky) * 2 * width + 2 * x + kx] += value * kernel[c * 4 + ky * 2 + kx];
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif
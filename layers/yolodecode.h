@@ -0,0 +1,122 @@
+#ifndef _YOLO_DECODE_H
+#define _YOLO_DECODE_H
+
+#include <cmath>
+#include <vector>
+
+// Decoding of the yolo layer outputs into detections, shared by the kernels
+// of YoloLayer_TRT and the host reference below. The input of a yolo layer is
+// the CHW output of its head convolution, per anchor the x, y, w, h and
+// objectness logits followed by the class logits, one plane of
+// yolo_width * yolo_height cells each. Boxes are relative to the input image.
+
+#ifdef __CUDACC__
+#define YOLO_HOST_DEVICE __host__ __device__
+#else
+#define YOLO_HOST_DEVICE
+#endif
+
+// The kernels use the fast __expf, the host reference expf, so the two agree
+// to a few ulp, not bit for bit
+#ifdef __CUDA_ARCH__
+#define YOLO_EXP(x) __expf(x)
+#else
+#define YOLO_EXP(x) expf(x)
+#endif
+
+namespace Yolo
+{
+    struct alignas(float) Detection {
+        float bbox[4];  // x, y, w, h
+        float det_confidence;
+        float class_id;
+        float class_confidence;
+    };
+
+    YOLO_HOST_DEVICE inline float sigmoid(float x) { return 1.0f / (1.0f + YOLO_EXP(-x)); }
+
+    YOLO_HOST_DEVICE inline float scaleCentered(float x, float s) { return s * x - (s - 1.0f) * 0.5f; }
+
+    // Detection of the cell and anchor idx counted over the planes of all
+    // anchors (and images) of the input. With new_coords (scaled_yolov4) the
+    // logits are already activated and w, h are 4 * x^2 of the anchor.
+    YOLO_HOST_DEVICE inline Detection decodeDetection(const float* input, int idx,
+                                                      int yolo_width, int yolo_height,
+                                                      int num_anchors, const float* anchors,
+                                                      int num_classes, int input_w, int input_h,
+                                                      float scale_x_y, int new_coords)
+    {
+        int total_grids = yolo_width * yolo_height;
+        int info_len = 5 + num_classes;
+        int group_idx = idx / total_grids;
+        int anchor_idx = group_idx % num_anchors;
+        const float* cur_input = input + group_idx * (info_len * total_grids) + (idx % total_grids);
+
+        int class_id = 0;
+        float max_cls_logit = -INFINITY;
+        for (int i = 5; i < info_len; ++i) {
+            float l = cur_input[i * total_grids];
+            if (l > max_cls_logit) {
+                max_cls_logit = l;
+                class_id = i - 5;
+            }
+        }
+
+        int row = (idx % total_grids) / yolo_width;
+        int col = (idx % total_grids) % yolo_width;
+
+        Detection det;
+        if (new_coords) {
+            det.bbox[0] = (col + scaleCentered(cur_input[0 * total_grids], scale_x_y)) / yolo_width;
+            det.bbox[1] = (row + scaleCentered(cur_input[1 * total_grids], scale_x_y)) / yolo_height;
+            det.bbox[2] = cur_input[2 * total_grids] * cur_input[2 * total_grids] * 4 * anchors[2 * anchor_idx + 0] / input_w;
+            det.bbox[3] = cur_input[3 * total_grids] * cur_input[3 * total_grids] * 4 * anchors[2 * anchor_idx + 1] / input_h;
+            det.det_confidence = cur_input[4 * total_grids];
+            det.class_confidence = max_cls_logit;
+        }
+        else {
+            det.bbox[0] = (col + scaleCentered(sigmoid(cur_input[0 * total_grids]), scale_x_y)) / yolo_width;
+            det.bbox[1] = (row + scaleCentered(sigmoid(cur_input[1 * total_grids]), scale_x_y)) / yolo_height;
+            det.bbox[2] = YOLO_EXP(cur_input[2 * total_grids]) * anchors[2 * anchor_idx + 0] / input_w;
+            det.bbox[3] = YOLO_EXP(cur_input[3 * total_grids]) * anchors[2 * anchor_idx + 1] / input_h;
+            det.det_confidence = sigmoid(cur_input[4 * total_grids]);
+            det.class_confidence = sigmoid(max_cls_logit);
+        }
+        det.bbox[0] -= det.bbox[2] / 2;  // shift from center to top-left
+        det.bbox[1] -= det.bbox[3] / 2;
+        det.class_id = class_id;
+        return det;
+    }
+
+    // Whether a detection survives the filter mode of YoloLayer_TRT
+    YOLO_HOST_DEVICE inline bool keepDetection(const Detection& det, float conf_thresh)
+    {
+        return det.det_confidence * det.class_confidence >= conf_thresh;
+    }
+
+    // Host reference of the filter mode for one image: appends the detections
+    // of the yolo layer that pass conf_thresh to detections, in cell order,
+    // until it holds max_detections. Called for the yolo layers in the order
+    // of the network it gives the set of detections the chained plugins
+    // output as long as fewer than max_detections pass; the plugins write
+    // them in no particular order and keep an arbitrary max_detections of
+    // them on overflow.
+    static inline void yoloFilterReference(const float* input, int yolo_width, int yolo_height,
+                                           int num_anchors, const float* anchors,
+                                           int num_classes, int input_w, int input_h,
+                                           float scale_x_y, int new_coords,
+                                           float conf_thresh, int max_detections,
+                                           std::vector<Detection>& detections)
+    {
+        int cells = yolo_width * yolo_height * num_anchors;
+        for (int idx = 0; idx < cells && static_cast<int>(detections.size()) < max_detections; ++idx) {
+            Detection det = decodeDetection(input, idx, yolo_width, yolo_height, num_anchors, anchors,
+                                            num_classes, input_w, input_h, scale_x_y, new_coords);
+            if (keepDetection(det, conf_thresh)) {
+                detections.push_back(det);
+            }
+        }
+    }
+}
+
+#endif
@@ -23,7 +23,8 @@ void read(const char*& buffer, T& val)
 
 namespace nvinfer1
 {
-    YoloLayerPlugin::YoloLayerPlugin(int yolo_width, int yolo_height, int num_anchors, float* anchors, int num_classes, int input_width, int input_height, float scale_x_y, int new_coords)
+    YoloLayerPlugin::YoloLayerPlugin(int yolo_width, int yolo_height, int num_anchors, float* anchors, int num_classes, int input_width, int input_height, float scale_x_y, int new_coords,
+                                     float conf_thresh, int max_detections)
     {
         mYoloWidth   = yolo_width;
         mYoloHeight  = yolo_height;
@@ -34,6 +35,8 @@ namespace nvinfer1
         mInputHeight = input_height;
         mScaleXY     = scale_x_y;
         mNewCoords   = new_coords;
+        mConfThresh  = conf_thresh;
+        mMaxDetections = max_detections;
 
         CHECK(cudaMalloc(&mAnchors, MAX_ANCHORS * 2 * sizeof(float)));
         CHECK(cudaMemcpy(mAnchors, mAnchorsHost, mNumAnchors * 2 * sizeof(float), cudaMemcpyHostToDevice));
@@ -53,6 +56,12 @@ namespace nvinfer1
         read(d, mInputHeight);
         read(d, mScaleXY);
         read(d, mNewCoords);
+        // Engines of plugin library version 1 end here, without filter mode
+        if (d < reinterpret_cast<const char *>(data) + length) {
+            read(d, mConfThresh);
+            read(d, mMaxDetections);
+            read(d, mChained);
+        }
 
         CHECK(cudaMalloc(&mAnchors, MAX_ANCHORS * 2 * sizeof(float)));
         CHECK(cudaMemcpy(mAnchors, mAnchorsHost, mNumAnchors * 2 * sizeof(float), cudaMemcpyHostToDevice));
@@ -74,6 +83,9 @@ namespace nvinfer1
         write(d, mInputHeight);
         write(d, mScaleXY);
         write(d, mNewCoords);
+        write(d, mConfThresh);
+        write(d, mMaxDetections);
+        write(d, mChained);
 
         assert(d == static_cast<char*>(buffer) + getSerializationSize());
     }
@@ -85,7 +97,8 @@ namespace nvinfer1
                sizeof(mNumAnchors) + MAX_ANCHORS * 2 * sizeof(float) + \
                sizeof(mNumClasses) + \
                sizeof(mInputWidth) + sizeof(mInputHeight) + \
-               sizeof(mScaleXY) + sizeof(mNewCoords);
+               sizeof(mScaleXY) + sizeof(mNewCoords) + \
+               sizeof(mConfThresh) + sizeof(mMaxDetections) + sizeof(mChained);
     }
 
     int YoloLayerPlugin::initialize()
@@ -100,11 +113,14 @@ namespace nvinfer1
 
     Dims YoloLayerPlugin::getOutputDimensions(int index, const Dims* inputs, int nbInputDims)
     {
-        assert(index == 0);
-        assert(nbInputDims == 1);
+        assert(index < getNbOutputs());
+        assert(nbInputDims == 1 || (mMaxDetections > 0 && nbInputDims == 3));
         assert(inputs[0].d[0] == (mNumClasses + 5) * mNumAnchors);
         assert(inputs[0].d[1] == mYoloHeight);
         assert(inputs[0].d[2] == mYoloWidth);
+        if (mMaxDetections > 0) {
+            return index == 0 ? Dims3(mMaxDetections * static_cast<int>(sizeof(Detection) / sizeof(float)), 1, 1) : Dims3(1, 1, 1);
+        }
         // output detection results to the channel dimension
         int totalsize = mYoloWidth * mYoloHeight * mNumAnchors * sizeof(Detection) / sizeof(float);
         return Dims3(totalsize, 1, 1);
@@ -123,7 +139,7 @@ namespace nvinfer1
     // Return the DataType of the plugin output at the requested index
     DataType YoloLayerPlugin::getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const
     {
-        return DataType::kFLOAT;
+        return index == 1 ? DataType::kINT32 : DataType::kFLOAT;
     }
 
     // Return true if output tensor is broadcast across a batch.
@@ -140,6 +156,7 @@ namespace nvinfer1
 
     void YoloLayerPlugin::configurePlugin(const PluginTensorDesc* in, int nbInput, const PluginTensorDesc* out, int nbOutput)
     {
+        mChained = nbInput == 3;
     }
 
     // Attach the plugin object to an execution context and grant the plugin the access to some context resource.
@@ -170,18 +187,13 @@ namespace nvinfer1
     // Clone the plugin
     IPluginV2IOExt* YoloLayerPlugin::clone() const
     {
-        YoloLayerPlugin *p = new YoloLayerPlugin(mYoloWidth, mYoloHeight, mNumAnchors, (float*) mAnchorsHost, mNumClasses, mInputWidth, mInputHeight, mScaleXY, mNewCoords);
+        YoloLayerPlugin *p = new YoloLayerPlugin(mYoloWidth, mYoloHeight, mNumAnchors, (float*) mAnchorsHost, mNumClasses, mInputWidth, mInputHeight, mScaleXY, mNewCoords,
+                                                 mConfThresh, mMaxDetections);
+        p->mChained = mChained;
         p->setPluginNamespace(mPluginNamespace);
         return p;
     }
 
-    inline __device__ float sigmoidGPU(float x) { return 1.0f / (1.0f + __expf(-x)); }
-
-    inline __device__ float scale_sigmoidGPU(float x, float s)
-    {
-        return s * sigmoidGPU(x) - (s - 1.0f) * 0.5f;
-    }
-
     // CalDetection(): This kernel processes 1 yolo layer calculation.  It
     // distributes calculations so that 1 GPU thread would be responsible
     // for each grid/anchor combination.
@@ -192,124 +204,290 @@ namespace nvinfer1
                                  int yolo_width, int yolo_height,
                                  int num_anchors, const float *anchors,
                                  int num_classes, int input_w, int input_h,
-                                 float scale_x_y)
+                                 float scale_x_y, int new_coords)
     {
         int idx = threadIdx.x + blockDim.x * blockIdx.x;
-        Detection* det = ((Detection*) output) + idx;
-        int total_grids = yolo_width * yolo_height;
-        if (idx >= batch_size * total_grids * num_anchors) return;
-
-        int info_len = 5 + num_classes;
-        //int batch_idx = idx / (total_grids * num_anchors);
-        int group_idx = idx / total_grids;
-        int anchor_idx = group_idx % num_anchors;
-        const float* cur_input = input + group_idx * (info_len * total_grids) + (idx % total_grids);
-
-        int class_id;
-        float max_cls_logit = -CUDART_INF_F;  // minus infinity
-        for (int i = 5; i < info_len; ++i) {
-            float l = *(cur_input + i * total_grids);
-            if (l > max_cls_logit) {
-                max_cls_logit = l;
-                class_id = i - 5;
+        if (idx >= batch_size * yolo_width * yolo_height * num_anchors) return;
+
+        ((Detection*) output)[idx] = decodeDetection(input, idx, yolo_width, yolo_height, num_anchors, anchors,
+                                                     num_classes, input_w, input_h, scale_x_y, new_coords);
+    }
+
+    // CalDetectionFilter(): The filter mode of CalDetection for the image
+    // blockIdx.y. The detections that pass conf_thresh are compacted into
+    // the max_detections slots of the image: a prefix sum over the block
+    // (ballot within the warps, then over the warp totals) gives each its
+    // offset in the block and one atomicAdd on the count per block reserves
+    // the slots. Detections beyond max_detections are dropped, count keeps
+    // counting them until ClampCount().
+    __global__ void CalDetectionFilter(const float *input, float *output, int *count,
+                                       int yolo_width, int yolo_height,
+                                       int num_anchors, const float *anchors,
+                                       int num_classes, int input_w, int input_h,
+                                       float scale_x_y, int new_coords,
+                                       float conf_thresh, int max_detections)
+    {
+        __shared__ int warp_offsets[32];
+        __shared__ int block_offset;
+
+        int cells = yolo_width * yolo_height * num_anchors;
+        int cell = threadIdx.x + blockDim.x * blockIdx.x;
+        int image = blockIdx.y;
+
+        // Every thread takes part in the prefix sum, also those past the cells
+        Detection det;
+        bool keep = false;
+        if (cell < cells) {
+            det = decodeDetection(input, image * cells + cell, yolo_width, yolo_height, num_anchors, anchors,
+                                  num_classes, input_w, input_h, scale_x_y, new_coords);
+            keep = keepDetection(det, conf_thresh);
+        }
+
+        int lane = threadIdx.x % 32;
+        int warp = threadIdx.x / 32;
+        unsigned int kept = __ballot_sync(0xffffffff, keep);
+        if (lane == 0) {
+            warp_offsets[warp] = __popc(kept);
+        }
+        __syncthreads();
+        if (threadIdx.x == 0) {
+            int total = 0;
+            for (int i = 0; i < (blockDim.x + 31) / 32; ++i) {
+                int warp_total = warp_offsets[i];
+                warp_offsets[i] = total;
+                total += warp_total;
             }
+            block_offset = total > 0 ? atomicAdd(count + image, total) : 0;
         }
-        float max_cls_prob = sigmoidGPU(max_cls_logit);
-        float box_prob = sigmoidGPU(*(cur_input + 4 * total_grids));
-        //if (max_cls_prob < IGNORE_THRESH || box_prob < IGNORE_THRESH)
-        //    return;
+        __syncthreads();
 
-        int row = (idx % total_grids) / yolo_width;
-        int col = (idx % total_grids) % yolo_width;
+        if (keep) {
+            int slot = block_offset + warp_offsets[warp] + __popc(kept & ((1u << lane) - 1));
+            if (slot < max_detections) {
+                ((Detection*) output)[image * max_detections + slot] = det;
+            }
+        }
+    }
 
-        det->bbox[0] = (col + scale_sigmoidGPU(*(cur_input + 0 * total_grids), scale_x_y)) / yolo_width;    // [0, 1]
-        det->bbox[1] = (row + scale_sigmoidGPU(*(cur_input + 1 * total_grids), scale_x_y)) / yolo_height;   // [0, 1]
-        det->bbox[2] = __expf(*(cur_input + 2 * total_grids)) * *(anchors + 2 * anchor_idx + 0) / input_w;  // [0, 1]
-        det->bbox[3] = __expf(*(cur_input + 3 * total_grids)) * *(anchors + 2 * anchor_idx + 1) / input_h;  // [0, 1]
+    __global__ void ClampCount(int *count, int batch_size, int max_detections)
+    {
+        int image = threadIdx.x + blockDim.x * blockIdx.x;
+        if (image < batch_size) {
+            count[image] = min(count[image], max_detections);
+        }
+    }
 
-        det->bbox[0] -= det->bbox[2] / 2;  // shift from center to top-left
-        det->bbox[1] -= det->bbox[3] / 2;
+    // Decodes the boxes of batchSize yolo outputs of yoloWidth x yoloHeight cells
+    static void launchDetection(const float* input, float* output, cudaStream_t stream, int batchSize, int threadCount,
+                                int yoloWidth, int yoloHeight, int numAnchors, const float* anchors,
+                                int numClasses, int inputWidth, int inputHeight, float scaleXY, int newCoords)
+    {
+        int num_elements = batchSize * numAnchors * yoloWidth * yoloHeight;
 
-        det->det_confidence = box_prob;
-        det->class_id = class_id;
-        det->class_confidence = max_cls_prob;
+        CalDetection<<<(num_elements + threadCount - 1) / threadCount, threadCount, 0, stream>>>
+            (input, output, batchSize, yoloWidth, yoloHeight, numAnchors, anchors, numClasses, inputWidth, inputHeight, scaleXY, newCoords);
     }
 
-    inline __device__ float scale(float x, float s)
+    // Filter mode of launchDetection(), appends to the detections and counts
+    // of the previous yolo layer if given, else starts from none
+    static void launchFilteredDetection(const float* input, const float* previous, const int* previousCount, float* output, int* count,
+                                        cudaStream_t stream, int batchSize, int threadCount,
+                                        int yoloWidth, int yoloHeight, int numAnchors, const float* anchors,
+                                        int numClasses, int inputWidth, int inputHeight, float scaleXY, int newCoords,
+                                        float confThresh, int maxDetections)
     {
-        return s * x - (s - 1.0f) * 0.5f;
+        size_t bytes = static_cast<size_t>(batchSize) * maxDetections * sizeof(Detection);
+        if (previous) {
+            CHECK(cudaMemcpyAsync(output, previous, bytes, cudaMemcpyDeviceToDevice, stream));
+            CHECK(cudaMemcpyAsync(count, previousCount, batchSize * sizeof(int), cudaMemcpyDeviceToDevice, stream));
+        } else {
+            CHECK(cudaMemsetAsync(output, 0, bytes, stream));
+            CHECK(cudaMemsetAsync(count, 0, batchSize * sizeof(int), stream));
+        }
+
+        int cells = numAnchors * yoloWidth * yoloHeight;
+        dim3 grid((cells + threadCount - 1) / threadCount, batchSize);
+        CalDetectionFilter<<<grid, threadCount, 0, stream>>>
+            (input, output, count, yoloWidth, yoloHeight, numAnchors, anchors, numClasses, inputWidth, inputHeight, scaleXY, newCoords,
+             confThresh, maxDetections);
+        ClampCount<<<(batchSize + threadCount - 1) / threadCount, threadCount, 0, stream>>>(count, batchSize, maxDetections);
     }
 
-    inline __device__ float square(float x)
+    void YoloLayerPlugin::forwardGpu(const void* const* inputs, void* const* outputs, cudaStream_t stream, int batchSize)
     {
-        return x * x;
+        if (mMaxDetections > 0) {
+            launchFilteredDetection((const float*) inputs[0], mChained ? (const float*) inputs[1] : nullptr, mChained ? (const int*) inputs[2] : nullptr,
+                                    (float*) outputs[0], (int*) outputs[1], stream, batchSize, mThreadCount,
+                                    mYoloWidth, mYoloHeight, mNumAnchors, (const float*) mAnchors,
+                                    mNumClasses, mInputWidth, mInputHeight, mScaleXY, mNewCoords, mConfThresh, mMaxDetections);
+            return;
+        }
+        launchDetection((const float*) inputs[0], (float*) outputs[0], stream, batchSize, mThreadCount, mYoloWidth, mYoloHeight, mNumAnchors, (const float*) mAnchors,
+                        mNumClasses, mInputWidth, mInputHeight, mScaleXY, mNewCoords);
     }
 
-    __global__ void CalDetection_NewCoords(const float *input, float *output,
-                                           int batch_size,
-                                           int yolo_width, int yolo_height,
-                                           int num_anchors, const float *anchors,
-                                           int num_classes, int input_w, int input_h,
-                                           float scale_x_y)
+    int YoloLayerPlugin::enqueue(int batchSize, const void* const* inputs, void** outputs, void* workspace, cudaStream_t stream)
     {
-        int idx = threadIdx.x + blockDim.x * blockIdx.x;
-        Detection* det = ((Detection*) output) + idx;
-        int total_grids = yolo_width * yolo_height;
-        if (idx >= batch_size * total_grids * num_anchors) return;
-
-        int info_len = 5 + num_classes;
-        //int batch_idx = idx / (total_grids * num_anchors);
-        int group_idx = idx / total_grids;
-        int anchor_idx = group_idx % num_anchors;
-        const float* cur_input = input + group_idx * (info_len * total_grids) + (idx % total_grids);
-
-        int class_id;
-        float max_cls_prob = -CUDART_INF_F;  // minus infinity
-        for (int i = 5; i < info_len; ++i) {
-            float l = *(cur_input + i * total_grids);
-            if (l > max_cls_prob) {
-                max_cls_prob = l;
-                class_id = i - 5;
-            }
+        forwardGpu(inputs, outputs, stream, batchSize);
+        return 0;
+    }
+
+    YoloLayerDynamicPlugin::YoloLayerDynamicPlugin(int num_anchors, const float* anchors, int num_classes, int input_multiplier, float scale_x_y, int new_coords,
+                                                   float conf_thresh, int max_detections)
+    {
+        mNumAnchors      = num_anchors;
+        memset(mAnchorsHost, 0, sizeof(mAnchorsHost));
+        memcpy(mAnchorsHost, anchors, num_anchors * 2 * sizeof(float));
+        mNumClasses      = num_classes;
+        mInputMultiplier = input_multiplier;
+        mScaleXY         = scale_x_y;
+        mNewCoords       = new_coords;
+        mConfThresh      = conf_thresh;
+        mMaxDetections   = max_detections;
+
+        CHECK(cudaMalloc(&mAnchors, MAX_ANCHORS * 2 * sizeof(float)));
+        CHECK(cudaMemcpy(mAnchors, mAnchorsHost, mNumAnchors * 2 * sizeof(float), cudaMemcpyHostToDevice));
+    }
+
+    YoloLayerDynamicPlugin::YoloLayerDynamicPlugin(const void* data, size_t length)
+    {
+        const char *d = reinterpret_cast<const char *>(data);
+        read(d, mThreadCount);
+        read(d, mNumAnchors);
+        memcpy(mAnchorsHost, d, MAX_ANCHORS * 2 * sizeof(float));
+        d += MAX_ANCHORS * 2 * sizeof(float);
+        read(d, mNumClasses);
+        read(d, mInputMultiplier);
+        read(d, mScaleXY);
+        read(d, mNewCoords);
+        if (d < reinterpret_cast<const char *>(data) + length) {
+            read(d, mConfThresh);
+            read(d, mMaxDetections);
+            read(d, mChained);
         }
-        float box_prob = *(cur_input + 4 * total_grids);
-        //if (max_cls_prob < IGNORE_THRESH || box_prob < IGNORE_THRESH)
-        //    return;
 
-        int row = (idx % total_grids) / yolo_width;
-        int col = (idx % total_grids) % yolo_width;
+        CHECK(cudaMalloc(&mAnchors, MAX_ANCHORS * 2 * sizeof(float)));
+        CHECK(cudaMemcpy(mAnchors, mAnchorsHost, mNumAnchors * 2 * sizeof(float), cudaMemcpyHostToDevice));
 
-        det->bbox[0] = (col + scale(*(cur_input + 0 * total_grids), scale_x_y)) / yolo_width;                   // [0, 1]
-        det->bbox[1] = (row + scale(*(cur_input + 1 * total_grids), scale_x_y)) / yolo_height;                  // [0, 1]
-        det->bbox[2] = square(*(cur_input + 2 * total_grids)) * 4 * *(anchors + 2 * anchor_idx + 0) / input_w;  // [0, 1]
-        det->bbox[3] = square(*(cur_input + 3 * total_grids)) * 4 * *(anchors + 2 * anchor_idx + 1) / input_h;  // [0, 1]
+        assert(d == reinterpret_cast<const char *>(data) + length);
+    }
 
-        det->bbox[0] -= det->bbox[2] / 2;  // shift from center to top-left
-        det->bbox[1] -= det->bbox[3] / 2;
+    void YoloLayerDynamicPlugin::serialize(void* buffer) const
+    {
+        char* d = static_cast<char*>(buffer);
+        write(d, mThreadCount);
+        write(d, mNumAnchors);
+        memcpy(d, mAnchorsHost, MAX_ANCHORS * 2 * sizeof(float));
+        d += MAX_ANCHORS * 2 * sizeof(float);
+        write(d, mNumClasses);
+        write(d, mInputMultiplier);
+        write(d, mScaleXY);
+        write(d, mNewCoords);
+        write(d, mConfThresh);
+        write(d, mMaxDetections);
+        write(d, mChained);
 
-        det->det_confidence = box_prob;
-        det->class_id = class_id;
-        det->class_confidence = max_cls_prob;
+        assert(d == static_cast<char*>(buffer) + getSerializationSize());
     }
 
-    void YoloLayerPlugin::forwardGpu(const float* const* inputs, float* output, cudaStream_t stream, int batchSize)
+    size_t YoloLayerDynamicPlugin::getSerializationSize() const
     {
-        int num_elements = batchSize * mNumAnchors * mYoloWidth * mYoloHeight;
+        return sizeof(mThreadCount) + \
+               sizeof(mNumAnchors) + MAX_ANCHORS * 2 * sizeof(float) + \
+               sizeof(mNumClasses) + sizeof(mInputMultiplier) + \
+               sizeof(mScaleXY) + sizeof(mNewCoords) + \
+               sizeof(mConfThresh) + sizeof(mMaxDetections) + sizeof(mChained);
+    }
 
-        //CHECK(cudaMemset(output, 0, num_elements * sizeof(Detection)));
+    int YoloLayerDynamicPlugin::initialize()
+    {
+        return 0;
+    }
 
-        if (mNewCoords) {
-            CalDetection_NewCoords<<<(num_elements + mThreadCount - 1) / mThreadCount, mThreadCount, 0, stream>>>
-                (inputs[0], output, batchSize, mYoloWidth, mYoloHeight, mNumAnchors, (const float*) mAnchors, mNumClasses, mInputWidth, mInputHeight, mScaleXY);
-        } else {
-            CalDetection<<<(num_elements + mThreadCount - 1) / mThreadCount, mThreadCount, 0, stream>>>
-                (inputs[0], output, batchSize, mYoloWidth, mYoloHeight, mNumAnchors, (const float*) mAnchors, mNumClasses, mInputWidth, mInputHeight, mScaleXY);
+    void YoloLayerDynamicPlugin::terminate()
+    {
+        CHECK(cudaFree(mAnchors));
+    }
+
+    DimsExprs YoloLayerDynamicPlugin::getOutputDimensions(int outputIndex, const DimsExprs* inputs, int nbInputs, IExprBuilder& exprBuilder)
+    {
+        assert(outputIndex < getNbOutputs());
+        assert(nbInputs == 1 || (mMaxDetections > 0 && nbInputs == 3));
+        assert(inputs[0].nbDims == 4);
+        DimsExprs output;
+        output.nbDims = 4;
+        output.d[0] = inputs[0].d[0];
+        output.d[2] = exprBuilder.constant(1);
+        output.d[3] = exprBuilder.constant(1);
+        if (mMaxDetections > 0) {
+            output.d[1] = exprBuilder.constant(outputIndex == 0 ? mMaxDetections * static_cast<int>(sizeof(Detection) / sizeof(float)) : 1);
+            return output;
         }
+        // output detection results to the channel dimension
+        const IDimensionExpr* cells = exprBuilder.operation(DimensionOperation::kPROD, *inputs[0].d[2], *inputs[0].d[3]);
+        output.d[1] = exprBuilder.operation(DimensionOperation::kPROD, *cells, *exprBuilder.constant(mNumAnchors * sizeof(Detection) / sizeof(float)));
+        return output;
     }
 
-    int YoloLayerPlugin::enqueue(int batchSize, const void* const* inputs, void** outputs, void* workspace, cudaStream_t stream)
+    void YoloLayerDynamicPlugin::setPluginNamespace(const char* pluginNamespace)
+    {
+        mPluginNamespace = pluginNamespace;
+    }
+
+    const char* YoloLayerDynamicPlugin::getPluginNamespace() const
+    {
+        return mPluginNamespace;
+    }
+
+    DataType YoloLayerDynamicPlugin::getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const
+    {
+        return index == 1 ? DataType::kINT32 : DataType::kFLOAT;
+    }
+
+    void YoloLayerDynamicPlugin::configurePlugin(const DynamicPluginTensorDesc* in, int nbInputs, const DynamicPluginTensorDesc* out, int nbOutputs)
+    {
+        assert(nbInputs == 1 || (mMaxDetections > 0 && nbInputs == 3));
+        assert(in[0].desc.dims.d[1] == -1 || in[0].desc.dims.d[1] == (mNumClasses + 5) * mNumAnchors);
+        mChained = nbInputs == 3;
+    }
+
+    const char* YoloLayerDynamicPlugin::getPluginType() const
+    {
+        return "YoloLayer_TRT";
+    }
+
+    const char* YoloLayerDynamicPlugin::getPluginVersion() const
+    {
+        return "2";
+    }
+
+    void YoloLayerDynamicPlugin::destroy()
+    {
+        delete this;
+    }
+
+    IPluginV2DynamicExt* YoloLayerDynamicPlugin::clone() const
+    {
+        YoloLayerDynamicPlugin *p = new YoloLayerDynamicPlugin(mNumAnchors, mAnchorsHost, mNumClasses, mInputMultiplier, mScaleXY, mNewCoords,
+                                                               mConfThresh, mMaxDetections);
+        p->mChained = mChained;
+        p->setPluginNamespace(mPluginNamespace);
+        return p;
+    }
+
+    int YoloLayerDynamicPlugin::enqueue(const PluginTensorDesc* inputDesc, const PluginTensorDesc* outputDesc, const void* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream)
     {
-        forwardGpu((const float* const*)inputs, (float*)outputs[0], stream, batchSize);
+        int batchSize = inputDesc[0].dims.d[0];
+        int yoloHeight = inputDesc[0].dims.d[2];
+        int yoloWidth = inputDesc[0].dims.d[3];
+        if (mMaxDetections > 0) {
+            launchFilteredDetection((const float*)inputs[0], mChained ? (const float*)inputs[1] : nullptr, mChained ? (const int*)inputs[2] : nullptr,
+                                    (float*)outputs[0], (int*)outputs[1], stream, batchSize, mThreadCount, yoloWidth, yoloHeight, mNumAnchors, (const float*) mAnchors,
+                                    mNumClasses, yoloWidth * mInputMultiplier, yoloHeight * mInputMultiplier, mScaleXY, mNewCoords, mConfThresh, mMaxDetections);
+            return 0;
+        }
+        launchDetection((const float*)inputs[0], (float*)outputs[0], stream, batchSize, mThreadCount, yoloWidth, yoloHeight, mNumAnchors, (const float*) mAnchors,
+                        mNumClasses, yoloWidth * mInputMultiplier, yoloHeight * mInputMultiplier, mScaleXY, mNewCoords);
         return 0;
     }
 
@@ -325,6 +503,8 @@ namespace nvinfer1
         mPluginAttributes.emplace_back(PluginField("anchors", nullptr, PluginFieldType::kFLOAT32, 1));
         mPluginAttributes.emplace_back(PluginField("scaleXY", nullptr, PluginFieldType::kFLOAT32, 1));
         mPluginAttributes.emplace_back(PluginField("newCoords", nullptr, PluginFieldType::kINT32, 1));
+        mPluginAttributes.emplace_back(PluginField("confThresh", nullptr, PluginFieldType::kFLOAT32, 1));
+        mPluginAttributes.emplace_back(PluginField("maxDetections", nullptr, PluginFieldType::kINT32, 1));
 
         mFC.nbFields = mPluginAttributes.size();
         mFC.fields = mPluginAttributes.data();
@@ -353,6 +533,8 @@ namespace nvinfer1
         float anchors[MAX_ANCHORS * 2];
         int num_classes, input_multiplier, new_coords = 0;
         float scale_x_y = 1.0;
+        float conf_thresh = 0.0f;
+        int max_detections = 0;
 
         for (int i = 0; i < fc->nbFields; ++i)
         {
@@ -397,6 +579,16 @@ namespace nvinfer1
                 assert(fields[i].type == PluginFieldType::kINT32);
                 new_coords = *(static_cast<const int*>(fields[i].data));
             }
+            else if (!strcmp(attrName, "confThresh"))
+            {
+                assert(fields[i].type == PluginFieldType::kFLOAT32);
+                conf_thresh = *(static_cast<const float*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "maxDetections"))
+            {
+                assert(fields[i].type == PluginFieldType::kINT32);
+                max_detections = *(static_cast<const int*>(fields[i].data));
+            }
             else
             {
                 std::cerr <<  "Unknown attribute: " << attrName << std::endl;
@@ -408,8 +600,10 @@ namespace nvinfer1
         assert(num_classes > 0);
         assert(input_multiplier == 8 || input_multiplier == 16 || input_multiplier == 32);
         assert(scale_x_y >= 1.0);
+        assert(max_detections >= 0);
 
-        YoloLayerPlugin* obj = new YoloLayerPlugin(yolo_width, yolo_height, num_anchors, anchors, num_classes, yolo_width * input_multiplier, yolo_height * input_multiplier, scale_x_y, new_coords);
+        YoloLayerPlugin* obj = new YoloLayerPlugin(yolo_width, yolo_height, num_anchors, anchors, num_classes, yolo_width * input_multiplier, yolo_height * input_multiplier, scale_x_y, new_coords,
+                                                    conf_thresh, max_detections);
         obj->setPluginNamespace(mNamespace.c_str());
         return obj;
     }
@@ -423,4 +617,118 @@ namespace nvinfer1
 
     PluginFieldCollection YoloPluginCreator::mFC{};
     std::vector<PluginField> YoloPluginCreator::mPluginAttributes;
+
+    YoloDynamicPluginCreator::YoloDynamicPluginCreator()
+    {
+        mPluginAttributes.clear();
+
+        mPluginAttributes.emplace_back(PluginField("numClasses", nullptr, PluginFieldType::kINT32, 1));
+        mPluginAttributes.emplace_back(PluginField("inputMultiplier", nullptr, PluginFieldType::kINT32, 1));
+        mPluginAttributes.emplace_back(PluginField("numAnchors", nullptr, PluginFieldType::kINT32, 1));
+        mPluginAttributes.emplace_back(PluginField("anchors", nullptr, PluginFieldType::kFLOAT32, 1));
+        mPluginAttributes.emplace_back(PluginField("scaleXY", nullptr, PluginFieldType::kFLOAT32, 1));
+        mPluginAttributes.emplace_back(PluginField("newCoords", nullptr, PluginFieldType::kINT32, 1));
+        mPluginAttributes.emplace_back(PluginField("confThresh", nullptr, PluginFieldType::kFLOAT32, 1));
+        mPluginAttributes.emplace_back(PluginField("maxDetections", nullptr, PluginFieldType::kINT32, 1));
+
+        mFC.nbFields = mPluginAttributes.size();
+        mFC.fields = mPluginAttributes.data();
+    }
+
+    const char* YoloDynamicPluginCreator::getPluginName() const
+    {
+        return "YoloLayer_TRT";
+    }
+
+    const char* YoloDynamicPluginCreator::getPluginVersion() const
+    {
+        return "2";
+    }
+
+    const PluginFieldCollection* YoloDynamicPluginCreator::getFieldNames()
+    {
+        return &mFC;
+    }
+
+    IPluginV2DynamicExt* YoloDynamicPluginCreator::createPlugin(const char* name, const PluginFieldCollection* fc)
+    {
+        assert(!strcmp(name, getPluginName()));
+        const PluginField* fields = fc->fields;
+        int num_anchors = 0;
+        float anchors[MAX_ANCHORS * 2];
+        int num_classes, input_multiplier, new_coords = 0;
+        float scale_x_y = 1.0;
+        float conf_thresh = 0.0f;
+        int max_detections = 0;
+
+        for (int i = 0; i < fc->nbFields; ++i)
+        {
+            const char* attrName = fields[i].name;
+            if (!strcmp(attrName, "numAnchors"))
+            {
+                assert(fields[i].type == PluginFieldType::kINT32);
+                num_anchors = *(static_cast<const int*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "numClasses"))
+            {
+                assert(fields[i].type == PluginFieldType::kINT32);
+                num_classes = *(static_cast<const int*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "inputMultiplier"))
+            {
+                assert(fields[i].type == PluginFieldType::kINT32);
+                input_multiplier = *(static_cast<const int*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "anchors")){
+                assert(num_anchors > 0 && num_anchors <= MAX_ANCHORS);
+                assert(fields[i].type == PluginFieldType::kFLOAT32);
+                memcpy(anchors, static_cast<const float*>(fields[i].data), num_anchors * 2 * sizeof(float));
+            }
+            else if (!strcmp(attrName, "scaleXY"))
+            {
+                assert(fields[i].type == PluginFieldType::kFLOAT32);
+                scale_x_y = *(static_cast<const float*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "newCoords"))
+            {
+                assert(fields[i].type == PluginFieldType::kINT32);
+                new_coords = *(static_cast<const int*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "confThresh"))
+            {
+                assert(fields[i].type == PluginFieldType::kFLOAT32);
+                conf_thresh = *(static_cast<const float*>(fields[i].data));
+            }
+            else if (!strcmp(attrName, "maxDetections"))
+            {
+                assert(fields[i].type == PluginFieldType::kINT32);
+                max_detections = *(static_cast<const int*>(fields[i].data));
+            }
+            else
+            {
+                std::cerr <<  "Unknown attribute: " << attrName << std::endl;
+                assert(0);
+            }
+        }
+        assert(anchors[0] > 0.0f && anchors[1] > 0.0f);
+        assert(num_classes > 0);
+        assert(input_multiplier == 8 || input_multiplier == 16 || input_multiplier == 32);
+        assert(scale_x_y >= 1.0);
+        assert(max_detections >= 0);
+
+        YoloLayerDynamicPlugin* obj = new YoloLayerDynamicPlugin(num_anchors, anchors, num_classes, input_multiplier, scale_x_y, new_coords,
+                                                                 conf_thresh, max_detections);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    IPluginV2DynamicExt* YoloDynamicPluginCreator::deserializePlugin(const char* name, const void* serialData, size_t serialLength)
+    {
+        YoloLayerDynamicPlugin* obj = new YoloLayerDynamicPlugin(serialData, serialLength);
+        obj->setPluginNamespace(mNamespace.c_str());
+        return obj;
+    }
+
+    PluginFieldCollection YoloDynamicPluginCreator::mFC{};
+    std::vector<PluginField> YoloDynamicPluginCreator::mPluginAttributes;
 } // namespace nvinfer1
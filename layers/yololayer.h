@@ -7,6 +7,7 @@
 #include <iostream>
 #include "math_constants.h"
 #include "NvInfer.h"
+#include "yolodecode.h"
 
 #define MAX_ANCHORS 6
 
@@ -21,31 +22,28 @@
         }                                                       \
     } while (0)
 
-namespace Yolo
-{
-    static constexpr float IGNORE_THRESH = 0.01f;
-
-    struct alignas(float) Detection {
-        float bbox[4];  // x, y, w, h
-        float det_confidence;
-        float class_id;
-        float class_confidence;
-    };
-}
-
 namespace nvinfer1
 {
+    // Decodes the output of a yolo head into one Detection per cell and
+    // anchor, {yolo_w * yolo_h * num_anchors * 7, 1, 1}. In filter mode
+    // (max_detections > 0) only the detections with det_confidence *
+    // class_confidence of at least conf_thresh are kept, compacted to the
+    // front of {max_detections * 7, 1, 1}, and their number is the second
+    // output, INT32 {1, 1, 1}; unused slots are zero. A chained plugin takes
+    // both outputs of the previous yolo layer as second and third input and
+    // appends to them, so the last yolo layer outputs those of all layers.
     class YoloLayerPlugin: public IPluginV2IOExt
     {
         public:
-            YoloLayerPlugin(int yolo_width, int yolo_height, int num_anchors, float* anchors, int num_classes, int input_width, int input_height, float scale_x_y, int new_coords);
+            YoloLayerPlugin(int yolo_width, int yolo_height, int num_anchors, float* anchors, int num_classes, int input_width, int input_height, float scale_x_y, int new_coords,
+                            float conf_thresh = 0.0f, int max_detections = 0);
             YoloLayerPlugin(const void* data, size_t length);
 
             ~YoloLayerPlugin() override = default;
 
             int getNbOutputs() const override // 如果派生类在虚函数声明时使用了override描述符，那么该函数必须重载其基类中的同名函数，否则代码将无法通过编译
             {
-                return 1;
+                return mMaxDetections > 0 ? 2 : 1;
             }
 
             Dims getOutputDimensions(int index, const Dims* inputs, int nbInputDims) override;
@@ -63,7 +61,9 @@ namespace nvinfer1
             virtual void serialize(void* buffer) const override;
 
             bool supportsFormatCombination(int pos, const PluginTensorDesc* inOut, int nbInputs, int nbOutputs) const override {
-                return inOut[pos].format == TensorFormat::kLINEAR && inOut[pos].type == DataType::kFLOAT;
+                // The numbers of detections of the filter mode are INT32, all else FP32
+                DataType type = mMaxDetections > 0 && (pos == 2 || pos == nbInputs + 1) ? DataType::kINT32 : DataType::kFLOAT;
+                return inOut[pos].format == TensorFormat::kLINEAR && inOut[pos].type == type;
             }
 
             const char* getPluginType() const override;
@@ -91,7 +91,7 @@ namespace nvinfer1
             void detachFromContext() override;
 
         private:
-            void forwardGpu(const float* const* inputs, float* output, cudaStream_t stream, int batchSize = 1);
+            void forwardGpu(const void* const* inputs, void* const* outputs, cudaStream_t stream, int batchSize = 1);
 
             int mThreadCount = 64;
             int mYoloWidth, mYoloHeight, mNumAnchors;
@@ -101,6 +101,9 @@ namespace nvinfer1
             int mInputWidth, mInputHeight;
             float mScaleXY;
             int mNewCoords = 0;
+            float mConfThresh = 0.0f;
+            int mMaxDetections = 0;
+            int mChained = 0;   // takes the detections and their number of the previous yolo layer as inputs
 
             const char* mPluginNamespace;
 
@@ -141,7 +144,121 @@ namespace nvinfer1
             std::string mNamespace;
     };
 
+    // Version 2 of YoloLayer_TRT for explicit batch networks with dynamic
+    // shapes. The grid and the input resolution are taken from the input
+    // tensor at runtime, so one plugin serves every shape of an optimization
+    // profile. The output is {N, yolo_w * yolo_h * num_anchors * 7, 1, 1},
+    // in filter mode {N, max_detections * 7, 1, 1} and {N, 1, 1, 1}.
+    class YoloLayerDynamicPlugin: public IPluginV2DynamicExt
+    {
+        public:
+            YoloLayerDynamicPlugin(int num_anchors, const float* anchors, int num_classes, int input_multiplier, float scale_x_y, int new_coords,
+                                   float conf_thresh = 0.0f, int max_detections = 0);
+            YoloLayerDynamicPlugin(const void* data, size_t length);
+
+            ~YoloLayerDynamicPlugin() override = default;
+
+            int getNbOutputs() const override
+            {
+                return mMaxDetections > 0 ? 2 : 1;
+            }
+
+            DimsExprs getOutputDimensions(int outputIndex, const DimsExprs* inputs, int nbInputs, IExprBuilder& exprBuilder) override;
+
+            int initialize() override;
+
+            void terminate() override;
+
+            size_t getWorkspaceSize(const PluginTensorDesc* inputs, int nbInputs, const PluginTensorDesc* outputs, int nbOutputs) const override { return 0; }
+
+            int enqueue(const PluginTensorDesc* inputDesc, const PluginTensorDesc* outputDesc, const void* const* inputs, void* const* outputs, void* workspace, cudaStream_t stream) override;
+
+            size_t getSerializationSize() const override;
+
+            void serialize(void* buffer) const override;
+
+            bool supportsFormatCombination(int pos, const PluginTensorDesc* inOut, int nbInputs, int nbOutputs) override {
+                // The numbers of detections of the filter mode are INT32, all else FP32
+                DataType type = mMaxDetections > 0 && (pos == 2 || pos == nbInputs + 1) ? DataType::kINT32 : DataType::kFLOAT;
+                return inOut[pos].format == TensorFormat::kLINEAR && inOut[pos].type == type;
+            }
+
+            const char* getPluginType() const override;
+
+            const char* getPluginVersion() const override;
+
+            void destroy() override;
+
+            IPluginV2DynamicExt* clone() const override;
+
+            void setPluginNamespace(const char* pluginNamespace) override;
+
+            const char* getPluginNamespace() const override;
+
+            DataType getOutputDataType(int index, const DataType* inputTypes, int nbInputs) const override;
+
+            void configurePlugin(const DynamicPluginTensorDesc* in, int nbInputs, const DynamicPluginTensorDesc* out, int nbOutputs) override;
+
+        private:
+            int mThreadCount = 64;
+            int mNumAnchors;
+            float mAnchorsHost[MAX_ANCHORS * 2];
+            float *mAnchors;  // allocated on GPU
+            int mNumClasses;
+            int mInputMultiplier;
+            float mScaleXY;
+            int mNewCoords = 0;
+            float mConfThresh = 0.0f;
+            int mMaxDetections = 0;
+            int mChained = 0;
+
+            const char* mPluginNamespace = "";
+
+        protected:
+            using IPluginV2DynamicExt::canBroadcastInputAcrossBatch;
+            using IPluginV2DynamicExt::configurePlugin;
+            using IPluginV2DynamicExt::enqueue;
+            using IPluginV2DynamicExt::getOutputDimensions;
+            using IPluginV2DynamicExt::getWorkspaceSize;
+            using IPluginV2DynamicExt::isOutputBroadcastAcrossBatch;
+            using IPluginV2DynamicExt::supportsFormat;
+    };
+
+    class YoloDynamicPluginCreator : public IPluginCreator
+    {
+        public:
+            YoloDynamicPluginCreator();
+
+            ~YoloDynamicPluginCreator() override = default;
+
+            const char* getPluginName() const override;
+
+            const char* getPluginVersion() const override;
+
+            const PluginFieldCollection* getFieldNames() override;
+
+            IPluginV2DynamicExt* createPlugin(const char* name, const PluginFieldCollection* fc) override;
+
+            IPluginV2DynamicExt* deserializePlugin(const char* name, const void* serialData, size_t serialLength) override;
+
+            void setPluginNamespace(const char* libNamespace) override
+            {
+                mNamespace = libNamespace;
+            }
+
+            const char* getPluginNamespace() const override
+            {
+                return mNamespace.c_str();
+            }
+
+        private:
+            static PluginFieldCollection mFC;
+            static std::vector<PluginField> mPluginAttributes;
+            std::string mNamespace;
+    };
+
     REGISTER_TENSORRT_PLUGIN(YoloPluginCreator);
+    REGISTER_TENSORRT_PLUGIN(YoloDynamicPluginCreator);
 };
 
 #endif
@@ -6,45 +6,188 @@
 #include "networks/yolov4.h"
 #include "networks/yolov4tiny.h"
 #include "networks/yolov4tiny3l.h"
+#include "networks/darknet.h"
 
-// Don't remove unused include, necessary to correctly load and register tensorrt yolo plugin
+// Don't remove unused includes, necessary to correctly load and register tensorrt yolo, mish and nms plugins
 #include "layers/yololayer.h"
+#include "layers/mishlayer.h"
+#include "layers/nmslayer.h"
 
+#include "utils/analysis.h"
+#include "utils/enginebuild.h"
+#include "utils/enginecache.h"
+#include "utils/inspect.h"
 #include "utils/logging.h"
+#include "utils/manifest.h"
 static Logger gLogger;
 
+#include <chrono>
 #include <iostream>
+#include <sstream>
 
 #define DEVICE 0
 #define BATCH_SIZE 1
 
 using namespace nvinfer1;
 
+// "min,opt,max" or a single value of an optimization profile dimension
+static bool parseShapeRange(const std::string& text, ShapeRange& range) {
+    int values[3];
+    int count = 0;
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (count == 3 || item.empty() || item.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        values[count++] = std::stoi(item);
+    }
+    if (count == 1) {
+        values[1] = values[2] = values[0];
+    }
+    else if (count != 3) {
+        return false;
+    }
+    range.min = values[0];
+    range.opt = values[1];
+    range.max = values[2];
+    return range.min > 0 && range.min <= range.opt && range.opt <= range.max;
+}
+
 enum NETWORKS {
     YOLOV4,
     YOLOV4TINY,
-    YOLOV4TINY3L
+    YOLOV4TINY3L,
+    DARKNET
 };
 
-int main(int argc, char** argv) {
-    cxxopts::Options options(argv[0], "--- YOLOV4 TRITON TENSORRT ---");
+// Everything one command line asks for, the command line of main or a line of a manifest
+struct Command {
+    NETWORKS network = NETWORKS::YOLOV4;
+    std::string network_string;
+    std::vector<std::pair<int, int>> resolutions;  // width, height
+    BuildOptions buildOptions;
+    std::string output;
+    int device = DEVICE;
+    bool verifyWeightsOnly = false;
+    bool analyzeOnly = false;
+    std::string manifest;
+    int jobs = 0;
+    bool help = false;
+    std::string engineCache;
+    int engineCacheMB = 0;
+    std::string inspect;
+};
+
+// Output file name without extension, --output or <network>, with -<W>x<H> for a resolution of the ladder
+static std::string engineBaseName(const Command& command, const std::pair<int, int>& resolution) {
+    std::string base = command.output.empty() ? command.network_string
+                     : hasExtension(command.output, ".engine") ? command.output.substr(0, command.output.size() - 7) : command.output;
+    if (resolution.first <= 0 || (!command.output.empty() && command.resolutions.size() < 2)) {
+        return base;
+    }
+    return base + "-" + std::to_string(resolution.first) + "x" + std::to_string(resolution.second);
+}
+
+// What besides its inputs decides the engine of a build, for the engine
+// cache. The plugins are given by the hash of the liblayerplugin.so loaded,
+// so any rebuild of the kernels makes new keys.
+static std::string engineEnvironment(int device) {
+    std::string plugins = loadedLibrary("liblayerplugin.so");
+    if (plugins.empty()) {
+        throw std::runtime_error("liblayerplugin.so is not loaded, the engine cache cannot key the plugins");
+    }
+    std::ostringstream text;
+    text << "tensorrt=" << getInferLibVersion() << "\n";
+    text << "plugins=" << hexKey(hashFile(plugins));
+    int count = 0;
+    IPluginCreator* const* creators = getPluginRegistry()->getPluginCreatorList(&count);
+    for (int i = 0; i < count; ++i) {
+        text << " " << creators[i]->getPluginName() << "/" << creators[i]->getPluginVersion();
+    }
+    text << "\n";
+    cudaDeviceProp properties;
+    if (cudaGetDeviceProperties(&properties, device) == cudaSuccess) {
+        text << "device=" << properties.name << " sm_" << properties.major << properties.minor << "\n";
+    }
+    else {
+        text << "device=" << device << "\n";
+    }
+    return text.str();
+}
 
+// Build settings of the network for the options of a build
+static NetworkInfo networkInfo(NETWORKS network, const BuildOptions& options) {
+    switch (network) {
+        case NETWORKS::YOLOV4TINY:
+            return yolov4tiny::networkInfo(options);
+        case NETWORKS::YOLOV4TINY3L:
+            return yolov4tiny3l::networkInfo(options);
+        case NETWORKS::DARKNET:
+            return darknet::networkInfo(options);
+        default:
+            return yolov4::networkInfo(options);
+    }
+}
+
+static void addOptions(cxxopts::Options& options) {
     options.add_options()
-        ("n,network", "Network to optimize, either \"yolov4\", \"yolov4tiny\" or \"yolov4tiny3l\"", cxxopts::value<std::string>()->default_value("yolov4"))
+        ("n,network", "Network to optimize, either \"yolov4\", \"yolov4tiny\", \"yolov4tiny3l\" or \"darknet\" for the network of a Darknet .cfg", cxxopts::value<std::string>()->default_value("yolov4"))
+        ("w,weights", "Weight file, either text (.wts), binary (.wtsb) or darknet (.weights, read with the .cfg of the same name), defaults to <network>.wts", cxxopts::value<std::string>())
+        ("cfg", "Darknet .cfg of the \"darknet\" network and of Darknet --weights, defaults to the .cfg of the same name as the weights; \"darknet\" engines are named after it", cxxopts::value<std::string>())
+        ("mish-plugin", "Compute Mish with the single pass Mish_TRT plugin instead of softplus, tanh and product layers (yolov4)")
+        ("resolution", "Input resolutions \"WxH\" (or \"S\" for SxS), multiples of 32, comma separated for a ladder of engines named <network>-<W>x<H>.engine, defaults to the resolution of the network", cxxopts::value<std::string>())
+        ("classes", "Number of classes, has to match the weights, defaults to the classes of the network", cxxopts::value<int>())
+        ("anchors", "Anchors \"w,h,w,h,...\" of each yolo layer in the order of the network separated by \";\", defaults to the anchors of the network", cxxopts::value<std::string>())
+        ("upsample", "Upsampling in the necks, either \"resize\" (nearest neighbor) or \"deconv\" (all ones deconvolution), defaults to the choice of the network", cxxopts::value<std::string>())
+        ("batch", "Build an explicit batch engine for batch sizes \"min,opt,max\" (or a single size)", cxxopts::value<std::string>())
+        ("height", "Build an explicit batch engine for input heights \"min,opt,max\", multiples of 32", cxxopts::value<std::string>())
+        ("width", "Build an explicit batch engine for input widths \"min,opt,max\", multiples of 32", cxxopts::value<std::string>())
+        ("precision", "Precision of the engine, either \"fp32\", \"fp16\" or \"int8\", defaults to the choice of the network", cxxopts::value<std::string>())
+        ("fp32-layers", "Name patterns (* and ? wildcards) of the layers kept in FP32 in FP16 and INT8 engines, \"none\" for no layer, defaults to the yolo head convolutions of the network", cxxopts::value<std::vector<std::string>>())
+        ("calibration-images", "Directory of INT8 calibration images (.ppm, with OpenCV also .jpg, .png and .bmp)", cxxopts::value<std::string>())
+        ("calibration-cache", "INT8 calibration cache, read if it exists and written after calibrating, defaults to <network>.calib", cxxopts::value<std::string>())
+        ("calibration-batch", "Images per INT8 calibration batch", cxxopts::value<int>()->default_value("8"))
+        ("calibration-batches", "Number of INT8 calibration batches, 0 for all images", cxxopts::value<int>()->default_value("0"))
+        ("sppf", "Build the SPP block of yolov4 as three cascaded 5x5 max-pools instead of 5x5, 9x9 and 13x13 pools, same output for less work")
+        ("fold-bn", "Fold every batch norm into its convolution instead of adding scale layers")
+        ("nms", "Suppress the detections in the engine, per class NMS with this IoU threshold; the outputs are \"num_detections\", \"boxes\", \"scores\" and \"classes\"", cxxopts::value<float>())
+        ("nms-score-threshold", "Detections with objectness x class probability below it are dropped before --nms", cxxopts::value<float>()->default_value("0.001"))
+        ("nms-top-k", "Best detections per image considered by --nms, at most 4096", cxxopts::value<int>()->default_value("1000"))
+        ("nms-max-outputs", "Detections per image kept by --nms", cxxopts::value<int>()->default_value("100"))
+        ("verify-weights", "Check the weight file for truncation and corrupt blobs, then exit without building")
+        ("analyze", "Estimate FLOPs, parameters, activation memory and minimum workspace per layer on the CPU, written to <network>[-<W>x<H>].analysis.json, then exit without building")
+        ("o,output", "Engine file, defaults to <network>.engine, with a ladder of resolutions -<W>x<H> is added to the name", cxxopts::value<std::string>())
+        ("device", "GPU to build on", cxxopts::value<int>()->default_value(std::to_string(DEVICE)))
+        ("manifest", "Build the engines of every line of the file, each line holds the options of a build like the command line", cxxopts::value<std::string>())
+        ("jobs", "Networks of a manifest defined in parallel ahead of the builds per device, 0 for one per CPU", cxxopts::value<int>()->default_value("0"))
+        ("inspect", "Report bindings, memory and the layers after fusion of an engine file as <engine>.inspect.json, then exit without building", cxxopts::value<std::string>())
+        ("engine-cache", "Directory of built engines, a build of the same weights, options, TensorRT, plugins and GPU copies its engine from there instead of building it", cxxopts::value<std::string>())
+        ("engine-cache-size", "Size of the engine cache in MB, the least recently used engines are evicted beyond it", cxxopts::value<int>()->default_value("8192"))
         ("h,help", "Print help screen");
+}
 
-    NETWORKS network;
+// Parses and checks a command line, prints the problem and returns false if it is invalid
+static bool parseCommand(cxxopts::Options& options, int argc, char** argv, Command& command) {
+    NETWORKS& network = command.network;
+    std::string& network_string = command.network_string;
+    std::vector<std::pair<int, int>>& resolutions = command.resolutions;
+    BuildOptions& buildOptions = command.buildOptions;
 
     // Parse and check options
     try {
         auto result = options.parse(argc, argv);
+        if (argc > 1) {
+            std::cout << "[Error] Unexpected argument " << argv[1] << std::endl;
+            return false;
+        }
 
         if (result.count("help")) {
-            std::cout << options.help() << std::endl;
-            exit(0);
+            command.help = true;
+            return true;
         }
 
-        auto network_string = result["network"].as<std::string>();
+        network_string = result["network"].as<std::string>();
         if (network_string.compare("yolov4") == 0) {
             network = NETWORKS::YOLOV4;
         }
@@ -54,59 +197,489 @@ int main(int argc, char** argv) {
         else if (network_string.compare("yolov4tiny3l") == 0) {
             network = NETWORKS::YOLOV4TINY3L;
         }
+        else if (network_string.compare("darknet") == 0) {
+            network = NETWORKS::DARKNET;
+        }
         else {
-            std::cout << "[Error] Network to optimize must be either \"yolov4\" or \"yolov4tiny\"" << std::endl;
+            std::cout << "[Error] Network to optimize must be either \"yolov4\", \"yolov4tiny\", \"yolov4tiny3l\" or \"darknet\"" << std::endl;
             std::cout << options.help({""}) << std::endl;
-            exit(0);
+            return false;
+        }
+
+        if (network == NETWORKS::DARKNET) {
+            // Named after the cfg, the weights default to the .weights next to it
+            if (!result.count("cfg") && !result.count("weights")) {
+                std::cout << "[Error] Network \"darknet\" needs --cfg or Darknet --weights" << std::endl;
+                return false;
+            }
+            buildOptions.cfg = result.count("cfg") ? result["cfg"].as<std::string>() : darknetCfgFor(result["weights"].as<std::string>());
+            network_string = buildOptions.cfg.substr(buildOptions.cfg.find_last_of('/') + 1);
+            network_string = network_string.substr(0, network_string.rfind(".cfg"));
+            buildOptions.weights = result.count("weights") ? result["weights"].as<std::string>()
+                                                           : buildOptions.cfg.substr(0, buildOptions.cfg.rfind(".cfg")) + ".weights";
+        }
+        else {
+            buildOptions.weights = result.count("weights") ? result["weights"].as<std::string>() : network_string + ".wts";
+            if (result.count("cfg")) {
+                buildOptions.cfg = result["cfg"].as<std::string>();
+            }
+        }
+        buildOptions.foldBatchNorm = result.count("fold-bn") > 0;
+        buildOptions.mishPlugin = result.count("mish-plugin") > 0;
+        buildOptions.sppf = result.count("sppf") > 0;
+        if (result.count("upsample")) {
+            auto upsample = result["upsample"].as<std::string>();
+            if (upsample.compare("resize") == 0) {
+                buildOptions.upsample = UpsampleMode::kRESIZE;
+            }
+            else if (upsample.compare("deconv") == 0) {
+                buildOptions.upsample = UpsampleMode::kDECONVOLUTION;
+            }
+            else {
+                std::cout << "[Error] Upsampling must be either \"resize\" or \"deconv\"" << std::endl;
+                std::cout << options.help({""}) << std::endl;
+                return false;
+            }
+        }
+        if (result.count("resolution")) {
+            std::istringstream list(result["resolution"].as<std::string>());
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                int width = 0;
+                int height = 0;
+                char separator = 'x';
+                std::istringstream resolution(item);
+                resolution >> width;
+                if (resolution >> separator) {
+                    resolution >> height;
+                }
+                else {
+                    height = width;
+                }
+                if (separator != 'x' || width <= 0 || height <= 0 || width % 32 != 0 || height % 32 != 0) {
+                    std::cout << "[Error] Resolution " << item << " must be \"WxH\" or \"S\" in multiples of 32" << std::endl;
+                    return false;
+                }
+                resolutions.emplace_back(width, height);
+            }
+        }
+        if (result.count("classes")) {
+            buildOptions.classes = result["classes"].as<int>();
+            if (buildOptions.classes <= 0) {
+                std::cout << "[Error] Number of classes must be positive" << std::endl;
+                return false;
+            }
+        }
+        if (result.count("anchors")) {
+            std::istringstream layers(result["anchors"].as<std::string>());
+            std::string layer;
+            while (std::getline(layers, layer, ';')) {
+                std::vector<float> anchors;
+                std::istringstream values(layer);
+                std::string value;
+                while (std::getline(values, value, ',')) {
+                    anchors.push_back(std::atof(value.c_str()));
+                }
+                if (anchors.size() % 2 != 0 || anchors.size() > 2 * MAX_ANCHORS) {
+                    std::cout << "[Error] Anchors of a yolo layer must be up to " << MAX_ANCHORS << " w,h pairs" << std::endl;
+                    return false;
+                }
+                buildOptions.anchors.push_back(anchors);
+            }
+        }
+        if (result.count("precision")) {
+            auto precision = result["precision"].as<std::string>();
+            if (precision.compare("fp32") == 0) {
+                buildOptions.precision = Precision::kFP32;
+            }
+            else if (precision.compare("fp16") == 0) {
+                buildOptions.precision = Precision::kFP16;
+            }
+            else if (precision.compare("int8") == 0) {
+                buildOptions.precision = Precision::kINT8;
+            }
+            else {
+                std::cout << "[Error] Precision must be either \"fp32\", \"fp16\" or \"int8\"" << std::endl;
+                std::cout << options.help({""}) << std::endl;
+                return false;
+            }
+        }
+        if (result.count("fp32-layers")) {
+            buildOptions.fp32Layers = result["fp32-layers"].as<std::vector<std::string>>();
+        }
+        if (result.count("calibration-images")) {
+            buildOptions.calibrationImages = result["calibration-images"].as<std::string>();
+        }
+        buildOptions.calibrationCache = result.count("calibration-cache") ? result["calibration-cache"].as<std::string>() : network_string + ".calib";
+        buildOptions.calibrationBatchSize = result["calibration-batch"].as<int>();
+        buildOptions.calibrationBatches = result["calibration-batches"].as<int>();
+        if (buildOptions.calibrationBatchSize < 1 || buildOptions.calibrationBatches < 0) {
+            std::cout << "[Error] Calibration batch size must be positive and the number of batches not negative" << std::endl;
+            return false;
+        }
+
+        std::pair<std::string, ShapeRange*> profileOptions[] = {{"batch", &buildOptions.batch}, {"height", &buildOptions.height}, {"width", &buildOptions.width}};
+        for (auto& profileOption : profileOptions) {
+            if (!result.count(profileOption.first)) {
+                continue;
+            }
+            ShapeRange& range = *profileOption.second;
+            if (!parseShapeRange(result[profileOption.first].as<std::string>(), range)) {
+                std::cout << "[Error] --" << profileOption.first << " must be a positive \"min,opt,max\" with min <= opt <= max" << std::endl;
+                return false;
+            }
+            if (profileOption.first != "batch" && (range.min % 32 != 0 || range.opt % 32 != 0 || range.max % 32 != 0)) {
+                std::cout << "[Error] --" << profileOption.first << " must be a multiple of 32" << std::endl;
+                return false;
+            }
+            buildOptions.explicitBatch = true;
+        }
+        if (result.count("nms")) {
+            buildOptions.nms = true;
+            buildOptions.nmsIouThreshold = result["nms"].as<float>();
+            buildOptions.nmsScoreThreshold = result["nms-score-threshold"].as<float>();
+            buildOptions.nmsTopK = result["nms-top-k"].as<int>();
+            buildOptions.nmsMaxOutputs = result["nms-max-outputs"].as<int>();
+            if (buildOptions.nmsIouThreshold < 0.0f || buildOptions.nmsIouThreshold > 1.0f) {
+                std::cout << "[Error] --nms must be in [0, 1]" << std::endl;
+                return false;
+            }
+            if (buildOptions.nmsTopK <= 0 || buildOptions.nmsTopK > Nms::MAX_TOP_K || buildOptions.nmsMaxOutputs <= 0 || buildOptions.nmsMaxOutputs > buildOptions.nmsTopK) {
+                std::cout << "[Error] --nms-top-k must be in [1, " << Nms::MAX_TOP_K << "] and --nms-max-outputs in [1, --nms-top-k]" << std::endl;
+                return false;
+            }
+        }
+        else if (result.count("nms-score-threshold") || result.count("nms-top-k") || result.count("nms-max-outputs")) {
+            std::cout << "[Error] --nms-score-threshold, --nms-top-k and --nms-max-outputs need --nms" << std::endl;
+            return false;
+        }
+        if (buildOptions.explicitBatch && buildOptions.mishPlugin) {
+            std::cout << "[Error] --mish-plugin is only supported for implicit batch engines, without --batch, --height and --width" << std::endl;
+            return false;
+        }
+        if (result.count("output")) {
+            command.output = result["output"].as<std::string>();
+        }
+        command.device = result["device"].as<int>();
+        command.verifyWeightsOnly = result.count("verify-weights") > 0;
+        command.analyzeOnly = result.count("analyze") > 0;
+        if (result.count("manifest")) {
+            command.manifest = result["manifest"].as<std::string>();
+        }
+        command.jobs = result["jobs"].as<int>();
+        if (command.jobs < 0) {
+            std::cout << "[Error] Number of jobs must not be negative" << std::endl;
+            return false;
+        }
+        if (result.count("engine-cache")) {
+            command.engineCache = result["engine-cache"].as<std::string>();
+        }
+        if (result.count("inspect")) {
+            command.inspect = result["inspect"].as<std::string>();
+        }
+        command.engineCacheMB = result["engine-cache-size"].as<int>();
+        if (command.engineCacheMB <= 0) {
+            std::cout << "[Error] Engine cache size must be positive" << std::endl;
+            return false;
         }
     }
     catch(cxxopts::OptionException exception) {
         std::cout << "[Error] " << exception.what() << std::endl;
         std::cout << options.help() << std::endl;
-        exit(0);
+        return false;
     }
+    return true;
+}
 
-    cudaSetDevice(DEVICE);
+// Builds the engines of every line of the manifest, see utils/manifest.h
+static int buildFromManifest(cxxopts::Options& options, char* program, const Command& command) {
+    std::vector<ManifestBuild> builds;
+    std::vector<std::string> descriptions;  // of the builds for the engine cache
+    std::map<std::string, int> engines;  // engine file, manifest line
+    std::unique_ptr<EngineCache> engineCache;
+    std::map<int, std::string> environments;  // device, environment
+    if (!command.engineCache.empty()) {
+        engineCache.reset(new EngineCache(command.engineCache, static_cast<size_t>(command.engineCacheMB) << 20));
+    }
+    try {
+        for (auto& line : readManifest(command.manifest)) {
+            std::vector<char*> arguments{program};
+            for (auto& argument : line.second) {
+                arguments.push_back(const_cast<char*>(argument.c_str()));
+            }
+            Command build;
+            if (!parseCommand(options, arguments.size(), arguments.data(), build)
+                || build.help || build.verifyWeightsOnly || build.analyzeOnly || !build.manifest.empty() || !build.engineCache.empty() || !build.inspect.empty()) {
+                std::cout << "[Error] Line " << line.first << " of manifest " << command.manifest << " is not a valid build" << std::endl;
+                return -1;
+            }
 
-    std::cout << "[Info] Creating builder" << std::endl;
-    // Create builder
-    IBuilder* builder = createInferBuilder(gLogger);
-    IBuilderConfig* config = builder->createBuilderConfig();
+            if (build.resolutions.empty()) {
+                build.resolutions.emplace_back(0, 0);
+            }
+            for (auto& resolution : build.resolutions) {
+                ManifestBuild engine;
+                engine.options = build.buildOptions;
+                engine.options.inputW = resolution.first;
+                engine.options.inputH = resolution.second;
+                engine.info = networkInfo(build.network, engine.options);
+                engine.engine = engineBaseName(build, resolution) + ".engine";
+                engine.device = build.device;
+                if (engines.count(engine.engine)) {
+                    std::cout << "[Error] Lines " << engines[engine.engine] << " and " << line.first << " of manifest " << command.manifest
+                              << " both build " << engine.engine << ", set --output" << std::endl;
+                    return -1;
+                }
+                engines[engine.engine] = line.first;
+                if (engineCache) {
+                    if (!environments.count(engine.device)) {
+                        environments[engine.device] = engineEnvironment(engine.device);
+                    }
+                    // A build whose inputs cannot be read is not cached, it fails when built
+                    std::string description;
+                    try {
+                        description = describeEngineBuild(build.network_string, engine.options, engine.info, BATCH_SIZE, environments[engine.device]);
+                    }
+                    catch(const std::runtime_error&) {
+                    }
+                    engine.cached = !description.empty() && engineCache->fetch(description, engine.engine);
+                    engine.bytes = engine.cached ? fileSize(engine.engine) : 0;
+                    descriptions.push_back(description);
+                }
+                builds.push_back(engine);
+            }
+        }
+    }
+    catch(const std::runtime_error& exception) {
+        std::cerr << "[Error] " << exception.what() << std::endl;
+        return -1;
+    }
 
-    // Create model to populate the network, then set the outputs and create an engine
-    ICudaEngine* engine;
-    if(network == NETWORKS::YOLOV4) {
-        std::cout << "[Info] Creating model yolov4" << std::endl;
-        engine = yolov4::createEngine(BATCH_SIZE, builder, config, DataType::kFLOAT, "yolov4.wts");
+    std::cout << "[Info] Building " << builds.size() << " engines of " << command.manifest << std::endl;
+    auto start = std::chrono::high_resolution_clock::now();
+    buildManifest(builds, BATCH_SIZE, gLogger, command.jobs);
+    auto end = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; engineCache && i < builds.size(); ++i) {
+        if (!builds[i].cached && builds[i].error.empty() && !descriptions[i].empty() && !engineCache->store(descriptions[i], builds[i].engine)) {
+            std::cout << "[Warning] Could not add " << builds[i].engine << " to the engine cache " << command.engineCache << std::endl;
+        }
+    }
+    return printManifestSummary(builds, std::chrono::duration<double, std::milli>(end - start).count()) == 0 ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    cxxopts::Options options(argv[0], "--- YOLOV4 TRITON TENSORRT ---");
+    addOptions(options);
+
+    Command command;
+    if (!parseCommand(options, argc, argv, command)) {
+        return -1;
     }
-    else if(network == NETWORKS::YOLOV4TINY) {
-        std::cout << "[Info] Creating model yolov4tiny" << std::endl;
-        engine = yolov4tiny::createEngine(BATCH_SIZE, builder, config, DataType::kFLOAT, "yolov4tiny.wts");
+    if (command.help) {
+        std::cout << options.help() << std::endl;
+        return 0;
     }
-    else if(network == NETWORKS::YOLOV4TINY3L) {
-        std::cout << "[Info] Creating model yolov4tiny3l" << std::endl;
-        engine = yolov4tiny3l::createEngine(BATCH_SIZE, builder, config, DataType::kFLOAT, "yolov4tiny3l.wts");
+    if (!command.manifest.empty()) {
+        return buildFromManifest(options, argv[0], command);
     }
-    assert(engine != nullptr);
 
-    std::cout << "[Info] Serializing model to engine file" << std::endl;
-    // Serialize the engine
-    IHostMemory* modelStream{nullptr};
-    modelStream = engine->serialize();
+    if (!command.inspect.empty()) {
+        cudaSetDevice(command.device);
+        EngineReport report;
+        try {
+            report = inspectEngine(command.inspect, gLogger);
+        }
+        catch(const std::runtime_error& exception) {
+            std::cerr << "[Error] " << exception.what() << std::endl;
+            return -1;
+        }
+        printEngineReport(std::cout, report);
 
-    // Close everything down
-    engine->destroy();
-    builder->destroy();
-
-    assert(modelStream != nullptr);
-    std::string engine_name = network == NETWORKS::YOLOV4TINY3L ? "yolov4tiny3l.engine" : ( network == NETWORKS::YOLOV4TINY ? "yolov4tiny.engine" : "yolov4.engine" );
-    std::ofstream p(engine_name.c_str(), std::ios::binary);
-    if (!p) {
-        std::cerr << "[Error] Could not open engine output file " << engine_name << std::endl;
+        std::string report_name = (hasExtension(command.inspect, ".engine") ? command.inspect.substr(0, command.inspect.size() - 7) : command.inspect) + ".inspect.json";
+        std::ofstream p(report_name.c_str());
+        if (!p) {
+            std::cerr << "[Error] Could not open inspection output file " << report_name << std::endl;
+            return -1;
+        }
+        writeEngineReportJson(p, report);
+        std::cout << "[Info] Wrote " << report_name << std::endl;
+        return 0;
+    }
+    NETWORKS network = command.network;
+    const std::string& network_string = command.network_string;
+    std::vector<std::pair<int, int>>& resolutions = command.resolutions;
+    const BuildOptions& buildOptions = command.buildOptions;
+
+    if (command.verifyWeightsOnly) {
+        std::cout << "[Info] Verifying " << buildOptions.weights << std::endl;
+        auto start = std::chrono::high_resolution_clock::now();
+        ThreadPool pool;
+        std::vector<std::string> problems = verifyWeights(buildOptions.weights, buildOptions.cfg, pool);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        for (auto& problem : problems) {
+            std::cerr << "[Error] " << problem << std::endl;
+        }
+        if (!problems.empty()) {
+            return -1;
+        }
+        std::cout << "[Info] Weight file is valid, checked in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+        return 0;
+    }
+
+    // One engine per resolution of the ladder, or one of the network's resolution
+    if (resolutions.empty()) {
+        resolutions.emplace_back(0, 0);
+    }
+
+    if (command.analyzeOnly) {
+        for (auto& resolution : resolutions) {
+            BuildOptions engineOptions = buildOptions;
+            engineOptions.inputW = resolution.first;
+            engineOptions.inputH = resolution.second;
+
+            // The layers of createEngine() recorded on the CPU
+            NetworkCost cost;
+            try {
+                if(network == NETWORKS::YOLOV4) {
+                    cost = analyzeNetwork("yolov4", yolov4::defineNetwork<RecordingNetwork>, yolov4::PRECISION, yolov4::FP32_LAYERS, engineOptions, BATCH_SIZE);
+                }
+                else if(network == NETWORKS::YOLOV4TINY) {
+                    cost = analyzeNetwork("yolov4tiny", yolov4tiny::defineNetwork<RecordingNetwork>, yolov4tiny::PRECISION, yolov4tiny::FP32_LAYERS, engineOptions, BATCH_SIZE);
+                }
+                else if(network == NETWORKS::YOLOV4TINY3L) {
+                    cost = analyzeNetwork("yolov4tiny3l", yolov4tiny3l::defineNetwork<RecordingNetwork>, yolov4tiny3l::PRECISION, yolov4tiny3l::FP32_LAYERS, engineOptions, BATCH_SIZE);
+                }
+                else if(network == NETWORKS::DARKNET) {
+                    cost = analyzeNetwork(network_string, darknet::defineNetwork<RecordingNetwork>, darknet::PRECISION, darknet::fp32Layers(engineOptions), engineOptions, BATCH_SIZE);
+                }
+            }
+            catch(const std::runtime_error& exception) {
+                std::cerr << "[Error] " << exception.what() << std::endl;
+                return -1;
+            }
+            printCostTable(std::cout, cost);
+
+            std::string analysis_name = engineBaseName(command, resolution) + ".analysis.json";
+            std::ofstream p(analysis_name.c_str());
+            if (!p) {
+                std::cerr << "[Error] Could not open analysis output file " << analysis_name << std::endl;
+                return -1;
+            }
+            writeCostJson(p, cost);
+            std::cout << "[Info] Wrote " << analysis_name << std::endl;
+        }
+        return 0;
+    }
+
+    cudaSetDevice(command.device);
+
+    std::unique_ptr<EngineCache> engineCache;
+    std::string environment;
+    if (!command.engineCache.empty()) {
+        engineCache.reset(new EngineCache(command.engineCache, static_cast<size_t>(command.engineCacheMB) << 20));
+        try {
+            environment = engineEnvironment(command.device);
+        }
+        catch(const std::runtime_error& exception) {
+            std::cerr << "[Error] " << exception.what() << std::endl;
+            return -1;
+        }
+    }
+
+    IBuilder* builder = nullptr;
+    // Releases the builder before main returns with an error
+    auto fail = [&builder]() {
+        if (builder) {
+            builder->destroy();
+        }
         return -1;
+    };
+    for (auto& resolution : resolutions) {
+        BuildOptions engineOptions = buildOptions;
+        engineOptions.inputW = resolution.first;
+        engineOptions.inputH = resolution.second;
+        std::string engine_name = engineBaseName(command, resolution) + ".engine";
+
+        // An engine of the same build in the cache is copied, not built
+        std::string description;
+        if (engineCache) {
+            try {
+                description = describeEngineBuild(network_string, engineOptions, networkInfo(network, engineOptions), BATCH_SIZE, environment);
+            }
+            catch(const std::runtime_error& exception) {
+                std::cerr << "[Error] " << exception.what() << std::endl;
+                return fail();
+            }
+            if (engineCache->fetch(description, engine_name)) {
+                std::cout << "[Info] Wrote " << engine_name << " from the engine cache (" << EngineCache::key(description) << ")" << std::endl;
+                continue;
+            }
+        }
+
+        if (!builder) {
+            std::cout << "[Info] Creating builder" << std::endl;
+            // Create builder
+            builder = createInferBuilder(gLogger);
+            if (!builder) {
+                std::cerr << "[Error] Could not create the TensorRT builder" << std::endl;
+                return -1;
+            }
+        }
+        IBuilderConfig* config = builder->createBuilderConfig();
+
+        // Create model to populate the network, then set the outputs and create an engine
+        ICudaEngine* engine = nullptr;
+        try {
+            if(network == NETWORKS::YOLOV4) {
+                std::cout << "[Info] Creating model yolov4" << std::endl;
+                engine = yolov4::createEngine(BATCH_SIZE, builder, config, DataType::kFLOAT, engineOptions);
+            }
+            else if(network == NETWORKS::YOLOV4TINY) {
+                std::cout << "[Info] Creating model yolov4tiny" << std::endl;
+                engine = yolov4tiny::createEngine(BATCH_SIZE, builder, config, DataType::kFLOAT, engineOptions);
+            }
+            else if(network == NETWORKS::YOLOV4TINY3L) {
+                std::cout << "[Info] Creating model yolov4tiny3l" << std::endl;
+                engine = yolov4tiny3l::createEngine(BATCH_SIZE, builder, config, DataType::kFLOAT, engineOptions);
+            }
+            else if(network == NETWORKS::DARKNET) {
+                std::cout << "[Info] Creating model " << network_string << " from " << engineOptions.cfg << std::endl;
+                engine = darknet::createEngine(BATCH_SIZE, builder, config, DataType::kFLOAT, engineOptions);
+            }
+        }
+        catch(const std::runtime_error& exception) {
+            std::cerr << "[Error] " << exception.what() << std::endl;
+            config->destroy();
+            return fail();
+        }
+        config->destroy();
+        if (!engine) {
+            std::cerr << "[Error] Could not build engine " << engine_name << std::endl;
+            return fail();
+        }
+
+        std::cout << "[Info] Serializing model to engine file" << std::endl;
+        // Serialize the engine
+        try {
+            saveEngine(engine, engine_name);
+        }
+        catch(const std::runtime_error& exception) {
+            std::cerr << "[Error] " << exception.what() << std::endl;
+            engine->destroy();
+            return fail();
+        }
+        engine->destroy();
+        std::cout << "[Info] Wrote " << engine_name << std::endl;
+        if (engineCache && !engineCache->store(description, engine_name)) {
+            std::cout << "[Warning] Could not add " << engine_name << " to the engine cache " << command.engineCache << std::endl;
+        }
+    }
+
+    // Close everything down
+    if (builder) {
+        builder->destroy();
     }
-    p.write(reinterpret_cast<const char*>(modelStream->data()), modelStream->size());
-    modelStream->destroy();
 
     std::cout << "[Info] Done" << std::endl;
 
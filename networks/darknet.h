@@ -0,0 +1,241 @@
+#include "NvInfer.h"
+#include "NvInferPlugin.h"
+#include <cmath>
+
+#include "layers.h"
+
+#include "../utils/buildoptions.h"
+#include "../utils/calibrator.h"
+#include "../utils/darknet.h"
+#include "../utils/enginebuild.h"
+#include "../utils/precisionpolicy.h"
+#include "../utils/derived.h"
+#include "../utils/shapes.h"
+#include "../utils/weights.h"
+
+using namespace nvinfer1;
+
+// Any network given by a Darknet .cfg. Instead of a hand-written list of
+// layers the sections of the config are interpreted one by one with the same
+// layer helpers, so a cfg of the yolov4 family gives the graph of its
+// hand-written header. Supported are [convolutional] (leaky, mish or linear,
+// no groups), [route] (with groups), [shortcut], [maxpool], [upsample] and
+// [yolo]; the detections of all yolo layers are output in cfg order (see markDetections()).
+namespace darknet {
+
+    // stuff we know about the network and the input/output blobs, the rest is in the cfg
+    static const UpsampleMode UPSAMPLE_MODE = UpsampleMode::kRESIZE;
+    static const Precision PRECISION = Precision::kFP16;
+
+    const char* INPUT_BLOB_NAME = "input";
+    const char* OUTPUT_BLOB_NAME = "detections";
+
+    static std::string cfgFile(const BuildOptions& options) {
+        return darknetCfgFor(options.weights, options.cfg);
+    }
+
+    // Resolution of the [net] section unless overridden
+    static int inputHeight(const std::vector<DarknetSection>& sections, const BuildOptions& options) {
+        return options.inputH > 0 ? options.inputH : sections.front().getInt("height", 416);
+    }
+
+    static int inputWidth(const std::vector<DarknetSection>& sections, const BuildOptions& options) {
+        return options.inputW > 0 ? options.inputW : sections.front().getInt("width", 416);
+    }
+
+    // The convolutions in front of the yolo layers, kept in FP32 by default like
+    // the FP32_LAYERS of the hand-written networks
+    static std::vector<std::string> fp32Layers(const BuildOptions& options) {
+        std::vector<DarknetSection> sections = parseDarknetCfg(cfgFile(options));
+        std::vector<std::string> heads;
+        for (size_t i = 2; i < sections.size(); ++i) {
+            if (sections[i].type == "yolo" && sections[i - 1].type == "convolutional") {
+                heads.push_back("conv" + std::to_string(i - 2));
+            }
+        }
+        return heads;
+    }
+
+    // Anchors of a [yolo] section, the pairs selected by its mask
+    static std::vector<float> yoloSectionAnchors(const DarknetSection& section, int layer) {
+        std::vector<float> all = section.getFloats("anchors");
+        std::vector<int> mask = section.getInts("mask");
+        if (mask.empty()) {
+            return all;
+        }
+        std::vector<float> anchors;
+        for (int index : mask) {
+            if (index < 0 || 2 * static_cast<size_t>(index) + 1 >= all.size()) {
+                throw std::runtime_error("Yolo in darknet layer " + std::to_string(layer) + " masks anchor " + std::to_string(index)
+                                         + " of " + std::to_string(all.size() / 2));
+            }
+            anchors.push_back(all[2 * index]);
+            anchors.push_back(all[2 * index + 1]);
+        }
+        return anchors;
+    }
+
+    // Adds the layers of the cfg for the resolution, classes and anchors of
+    // the build and marks the output, on an INetworkDefinition or a
+    // RecordingNetwork. Layer "model.<i>" of the weights is section i of the
+    // cfg after [net], as read from a .weights file (see indexDarknetWeights()).
+    template <typename Network>
+    void defineNetwork(Network *network, WeightMap& weightMap, const BuildOptions& options, DataType dt, unsigned int maxBatchSize) {
+        using Tensor = TensorOf<Network>;
+
+        std::vector<DarknetSection> sections = parseDarknetCfg(cfgFile(options));
+        std::vector<int> channels = darknetChannels(sections);
+        if (sections.front().getInt("channels", 3) != 3) {
+            throw std::runtime_error("Darknet config " + cfgFile(options) + " must have 3 input channels");
+        }
+
+        // Resolution and upsampling of this build, classes and anchors are per yolo layer
+        const int inputH = inputHeight(sections, options);
+        const int inputW = inputWidth(sections, options);
+        const UpsampleMode upsampleMode = resolveUpsampleMode(options, UPSAMPLE_MODE);
+
+        // Create input tensor of shape {3, inputH, inputW}, or {N, 3, H, W} for explicit batch, with name INPUT_BLOB_NAME
+        Tensor* data = addImageInput(network, options, INPUT_BLOB_NAME, dt, maxBatchSize, inputH, inputW);
+        assert(data);
+
+        // Output of every layer and its stride, input pixels per output cell
+        std::vector<Tensor*> outputs;
+        std::vector<int> strides;
+        std::vector<LayerOf<Network>*> yolos;
+        Tensor* previous = data;
+        int previousStride = 1;
+
+        for (size_t i = 1; i < sections.size(); ++i) {
+            const DarknetSection& section = sections[i];
+            const int linx = i - 1;
+            const std::string where = "darknet layer " + std::to_string(linx);
+            Tensor* output = nullptr;
+            int stride = previousStride;
+
+            if (section.type == "convolutional") {
+                if (section.getInt("groups", 1) != 1) {
+                    throw std::runtime_error("Grouped convolution in " + where + " is not supported");
+                }
+                int filters = section.getInt("filters", 1);
+                int size = section.getInt("size", 1);
+                int s = section.getInt("stride", 1);
+                int p = section.getInt("pad", 0) ? size / 2 : section.getInt("padding", 0);
+                bool batchNorm = section.getInt("batch_normalize", 0) != 0;
+                std::string activation = section.get("activation", "logistic");
+
+                LayerOf<Network>* conv;
+                if (activation == "leaky") {
+                    conv = convAct<Activation::kLEAKY>(network, weightMap, options, *previous, filters, size, s, p, linx, batchNorm);
+                }
+                else if (activation == "mish") {
+                    conv = convAct<Activation::kMISH>(network, weightMap, options, *previous, filters, size, s, p, linx, batchNorm);
+                }
+                else if (activation == "linear") {
+                    conv = convAct<Activation::kLINEAR>(network, weightMap, options, *previous, filters, size, s, p, linx, batchNorm);
+                }
+                else {
+                    throw std::runtime_error("Activation " + activation + " in " + where + " is not supported");
+                }
+                output = conv->getOutput(0);
+                stride *= s;
+            }
+            else if (section.type == "route") {
+                // One input is passed on, more are concatenated; with groups
+                // each input contributes its slice group_id of groups
+                int groups = section.getInt("groups", 1);
+                int groupId = section.getInt("group_id", 0);
+                std::vector<Tensor*> inputs;
+                for (int reference : section.getInts("layers")) {
+                    int index = darknetLayerIndex(reference, linx);
+                    Tensor* input = outputs[index];
+                    if (groups > 1) {
+                        int groupChannels = channels[index] / groups;
+                        input = addChannelSlice(network, weightMap.arena(), *input, groupId * groupChannels, groupChannels)->getOutput(0);
+                    }
+                    inputs.push_back(input);
+                    stride = strides[index];
+                }
+                if (inputs.empty()) {
+                    throw std::runtime_error("Route in " + where + " has no layers");
+                }
+                output = inputs.size() == 1 ? inputs[0] : network->addConcatenation(inputs.data(), inputs.size())->getOutput(0);
+            }
+            else if (section.type == "shortcut") {
+                int index = darknetLayerIndex(section.getInt("from", -1), linx);
+                if (index < 0 || index >= linx || section.get("activation", "linear") != "linear") {
+                    throw std::runtime_error("Shortcut in " + where + " must add an earlier layer without activation");
+                }
+                output = network->addElementWise(*previous, *outputs[index], ElementWiseOperation::kSUM)->getOutput(0);
+            }
+            else if (section.type == "maxpool") {
+                // Darknet pads size - 1 in total, the same output for the
+                // even sizes of the network as padding half of it on both sides
+                int size = section.getInt("size", section.getInt("stride", 1));
+                int s = section.getInt("stride", 1);
+                int padding = section.getInt("padding", size - 1);
+                if (s == 1 && padding % 2 != 0) {
+                    throw std::runtime_error("Maxpool in " + where + " needs asymmetric padding, which is not supported");
+                }
+                auto pool = maxPool(network, *previous, size, s, padding / 2);
+                pool->setName(("pool" + std::to_string(linx)).c_str());
+                output = pool->getOutput(0);
+                stride *= s;
+            }
+            else if (section.type == "upsample") {
+                if (section.getInt("stride", 2) != 2) {
+                    throw std::runtime_error("Upsample in " + where + " must have stride 2");
+                }
+                output = upSample(network, weightMap, upsampleMode, *previous, channels[linx - 1])->getOutput(0);
+                stride /= 2;
+            }
+            else if (section.type == "yolo") {
+                const std::vector<float> cfgAnchors = yoloSectionAnchors(section, linx);
+                const std::vector<float>& anchors = yoloAnchors(options, yolos.size(), cfgAnchors);
+                const int numClasses = options.classes > 0 ? options.classes : section.getInt("classes", 80);
+                int headChannels = anchors.size() / 2 * (numClasses + 5);
+                if (linx == 0 || channels[linx - 1] != headChannels) {
+                    throw std::runtime_error("Yolo in " + where + " has " + std::to_string(linx ? channels[linx - 1] : 0) + " inputs, "
+                                             + std::to_string(anchors.size() / 2) + " anchors and " + std::to_string(numClasses) + " classes need "
+                                             + std::to_string(headChannels));
+                }
+                auto yolo = yoloLayer(network, *previous, inputW, inputH, previousStride, previousStride, numClasses, anchors,
+                                      section.getFloat("scale_x_y", 1.0f), section.getInt("new_coords", 0), options, yolos.empty() ? nullptr : yolos.back());
+                yolo->setName(("yolo" + std::to_string(linx)).c_str());
+                output = yolo->getOutput(0);
+                yolos.push_back(yolo);
+            }
+            else {
+                throw std::runtime_error("Section [" + section.type + "] of " + where + " is not supported");
+            }
+
+            outputs.push_back(output);
+            strides.push_back(stride);
+            previous = output;
+            previousStride = stride;
+        }
+
+        if (yolos.empty()) {
+            throw std::runtime_error("Darknet config " + cfgFile(options) + " has no yolo layer");
+        }
+        markDetections(network, options, yolos, OUTPUT_BLOB_NAME);
+    }
+
+    // Build settings of the network for the options of a build
+    NetworkInfo networkInfo(const BuildOptions& options) {
+        std::vector<DarknetSection> sections = parseDarknetCfg(cfgFile(options));
+        NetworkInfo info;
+        info.define = defineNetwork<INetworkDefinition>;
+        info.inputBlobName = INPUT_BLOB_NAME;
+        info.inputH = inputHeight(sections, options);
+        info.inputW = inputWidth(sections, options);
+        info.precision = PRECISION;
+        info.fp32Layers = fp32Layers(options);
+        return info;
+    }
+
+    ICudaEngine* createEngine(unsigned int maxBatchSize, IBuilder* builder, IBuilderConfig* config, DataType dt, const BuildOptions& options) {
+        DefinedNetwork defined;
+        defineEngineNetwork(defined, builder->createNetworkV2(networkCreationFlags(options)), networkInfo(options), options, maxBatchSize, dt);
+        return buildDefinedNetwork(defined, builder, config);
+    }
+}
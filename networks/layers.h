@@ -0,0 +1,327 @@
+#ifndef __TRT_NETWORK_LAYERS_H_
+#define __TRT_NETWORK_LAYERS_H_
+
+#include "NvInfer.h"
+
+#include "../utils/buildoptions.h"
+#include "../utils/derived.h"
+#include "../utils/networktraits.h"
+#include "../utils/shapes.h"
+#include "../utils/weights.h"
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace nvinfer1;
+
+// Layer construction shared by all networks. The helpers are templates on the
+// network definition, INetworkDefinition for an engine build or
+// RecordingNetwork (utils/recordingnetwork.h) to capture the graph on the CPU.
+// Activation and fusions are template parameters, each combination a build
+// uses is its own specialization; convAct() picks it once from the options.
+
+enum class Activation {
+    kLINEAR,
+    kLEAKY,
+    kMISH
+};
+
+// Fusions of a build as a bit set, see fusionFlags()
+enum FusionFlags : unsigned {
+    kFUSE_NONE = 0,
+    kFUSE_BATCH_NORM = 1 << 0,  // batch norm folded into the convolution, BuildOptions::foldBatchNorm
+    kFUSE_MISH = 1 << 1         // Mish as the single Mish_TRT plugin layer, BuildOptions::mishPlugin
+};
+
+static inline unsigned fusionFlags(const BuildOptions& options) {
+    return (options.foldBatchNorm ? kFUSE_BATCH_NORM : kFUSE_NONE) | (options.mishPlugin ? kFUSE_MISH : kFUSE_NONE);
+}
+
+template <typename Network>
+LayerOf<Network>* addBatchNorm2d(Network *network, WeightMap& weightMap, TensorOf<Network>& input, const std::string& lname, float eps) {
+    const float *gamma = weightMap.floats(lname + ".weight");
+    const float *beta = weightMap.floats(lname + ".bias");
+    const float *mean = weightMap.floats(lname + ".running_mean");
+    const float *var = weightMap.floats(lname + ".running_var");
+    int len = weightMap[lname + ".running_var"].count;
+
+    BatchNormParams bn = deriveBatchNorm(weightMap.arena(), gamma, beta, mean, var, len, eps);
+
+    auto scale_1 = network->addScaleNd(input, ScaleMode::kCHANNEL, bn.shift, bn.scale, bn.power, channelAxis(network));
+    assert(scale_1);
+    return scale_1;
+}
+
+// Activation of the output of a layer, F are the FusionFlags of the build.
+// The activation layers are named after the layer index linx.
+template <Activation A, unsigned F>
+struct ActivationLayer;
+
+template <unsigned F>
+struct ActivationLayer<Activation::kLINEAR, F> {
+    template <typename Network>
+    static LayerOf<Network>* add(Network*, LayerOf<Network>* input, int) {
+        return input;
+    }
+};
+
+template <unsigned F>
+struct ActivationLayer<Activation::kLEAKY, F> {
+    template <typename Network>
+    static LayerOf<Network>* add(Network *network, LayerOf<Network>* input, int linx) {
+        auto lr = network->addActivation(*input->getOutput(0), ActivationType::kLEAKY_RELU);
+        assert(lr);
+        lr->setAlpha(0.1);
+        lr->setName(("leaky" + std::to_string(linx)).c_str());
+        return lr;
+    }
+};
+
+template <unsigned F>
+struct ActivationLayer<Activation::kMISH, F> {
+    template <typename Network>
+    static LayerOf<Network>* add(Network *network, LayerOf<Network>* input, int linx) {
+        std::string name = "mish" + std::to_string(linx);
+        TensorOf<Network>* x = input->getOutput(0);
+        if (F & kFUSE_MISH) {
+            std::vector<PluginField> pluginFields;
+            auto mish = NetworkTraits<Network>::addPlugin(network, "Mish_TRT", "1", pluginFields, &x, 1);
+            mish->setName(name.c_str());
+            return mish;
+        }
+
+        auto mish_softplus = network->addActivation(*x, ActivationType::kSOFTPLUS);
+        mish_softplus->setName((name + "_softplus").c_str());
+        auto mish_tanh = network->addActivation(*mish_softplus->getOutput(0), ActivationType::kTANH);
+        mish_tanh->setName((name + "_tanh").c_str());
+        auto mish_mul = network->addElementWise(*mish_tanh->getOutput(0), *x, ElementWiseOperation::kPROD);
+        mish_mul->setName(name.c_str());
+        return mish_mul;
+    }
+};
+
+template <typename Network>
+LayerOf<Network>* addConvolution(Network *network, TensorOf<Network>& input, int outch, int ksize, int s, int p, Weights kernel, Weights bias) {
+    auto conv = network->addConvolutionNd(input, outch, DimsHW{ksize, ksize}, kernel, bias);
+    assert(conv);
+    conv->setStrideNd(DimsHW{s, s});
+    conv->setPaddingNd(DimsHW{p, p});
+    return conv;
+}
+
+// Convolution of the layer "model.<linx>" and its activation. With batchNorm
+// the convolution has no bias and is followed by the batch norm ".bn", with
+// kFUSE_BATCH_NORM a single convolution with the batch norm folded into
+// kernel and bias. Without batchNorm the convolution has the bias ".conv.bias".
+// The layers are named conv<linx>, bn<linx> and after their activation, the
+// names precision policies match (see utils/precisionpolicy.h).
+template <Activation A, unsigned F>
+struct ConvBlock {
+    template <typename Network>
+    static LayerOf<Network>* add(Network *network, WeightMap& weightMap, TensorOf<Network>& input, int outch, int ksize, int s, int p, int linx, bool batchNorm) {
+        std::string lname = "model." + std::to_string(linx);
+        std::string bname = lname + ".bn";
+        bool fold = batchNorm && (F & kFUSE_BATCH_NORM);
+        Weights emptywts{DataType::kFLOAT, nullptr, 0};
+
+        LayerOf<Network>* conv1;
+        if (fold) {
+            FoldedConvParams folded = deriveFoldedConv(weightMap.arena(),
+                weightMap.floats(lname + ".conv.weight"), weightMap[lname + ".conv.weight"].count,
+                weightMap.floats(bname + ".weight"), weightMap.floats(bname + ".bias"), weightMap.floats(bname + ".running_mean"), weightMap.floats(bname + ".running_var"),
+                weightMap[bname + ".running_var"].count, 1e-4);
+            conv1 = addConvolution(network, input, outch, ksize, s, p, folded.kernel, folded.bias);
+        }
+        else {
+            conv1 = addConvolution(network, input, outch, ksize, s, p, weightMap[lname + ".conv.weight"], batchNorm ? emptywts : weightMap[lname + ".conv.bias"]);
+        }
+        conv1->setName(("conv" + std::to_string(linx)).c_str());
+
+        if (batchNorm && !fold) {
+            conv1 = addBatchNorm2d(network, weightMap, *conv1->getOutput(0), bname, 1e-4);
+            conv1->setName(("bn" + std::to_string(linx)).c_str());
+        }
+        return ActivationLayer<A, F>::add(network, conv1, linx);
+    }
+};
+
+// ConvBlock specialized for the fusions of the build
+template <Activation A, typename Network>
+LayerOf<Network>* convAct(Network *network, WeightMap& weightMap, const BuildOptions& options, TensorOf<Network>& input, int outch, int ksize, int s, int p, int linx, bool batchNorm) {
+    switch (fusionFlags(options)) {
+        case kFUSE_BATCH_NORM:
+            return ConvBlock<A, kFUSE_BATCH_NORM>::add(network, weightMap, input, outch, ksize, s, p, linx, batchNorm);
+        case kFUSE_MISH:
+            return ConvBlock<A, kFUSE_MISH>::add(network, weightMap, input, outch, ksize, s, p, linx, batchNorm);
+        case kFUSE_BATCH_NORM | kFUSE_MISH:
+            return ConvBlock<A, kFUSE_BATCH_NORM | kFUSE_MISH>::add(network, weightMap, input, outch, ksize, s, p, linx, batchNorm);
+        default:
+            return ConvBlock<A, kFUSE_NONE>::add(network, weightMap, input, outch, ksize, s, p, linx, batchNorm);
+    }
+}
+
+template <typename Network>
+LayerOf<Network>* convBnMish(Network *network, WeightMap& weightMap, const BuildOptions& options, TensorOf<Network>& input, int outch, int ksize, int s, int p, int linx) {
+    return convAct<Activation::kMISH>(network, weightMap, options, input, outch, ksize, s, p, linx, true);
+}
+
+template <typename Network>
+LayerOf<Network>* convBnLeaky(Network *network, WeightMap& weightMap, const BuildOptions& options, TensorOf<Network>& input, int outch, int ksize, int s, int p, int linx) {
+    return convAct<Activation::kLEAKY>(network, weightMap, options, input, outch, ksize, s, p, linx, true);
+}
+
+template <typename Network>
+LayerOf<Network>* upSample(Network *network, WeightMap& weightMap, UpsampleMode mode, TensorOf<Network>& input, int channels) {
+    if (mode == UpsampleMode::kRESIZE) {
+        auto resize = network->addResize(input);
+        assert(resize);
+        resize->setResizeMode(ResizeMode::kNEAREST);
+        setUpsampleScales(resize, input);
+        return resize;
+    }
+
+    Weights deconvwts = deriveUpsampleWeights(weightMap.arena(), channels);
+    Weights emptywts{DataType::kFLOAT, nullptr, 0};
+    auto deconv = network->addDeconvolutionNd(input, channels, DimsHW{2, 2}, deconvwts, emptywts);
+    assert(deconv);
+    deconv->setStrideNd(DimsHW{2, 2});
+    deconv->setNbGroups(channels);
+
+    return deconv;
+}
+
+template <typename Network>
+LayerOf<Network>* maxPool(Network *network, TensorOf<Network>& input, int window, int stride, int padding) {
+    auto pool = network->addPoolingNd(input, PoolingType::kMAX, DimsHW{window, window});
+    assert(pool);
+    pool->setStrideNd(DimsHW{stride, stride});
+    pool->setPaddingNd(DimsHW{padding, padding});
+    return pool;
+}
+
+// Output channels of the convolution in front of a yolo layer, they have to match its weights
+static inline int yoloHeadChannels(WeightMap& weightMap, const std::string& lname, const std::vector<float>& anchors, int numClasses) {
+    int channels = anchors.size() / 2 * (numClasses + 5);
+    int64_t weightChannels = weightMap[lname + ".conv.bias"].count;
+    if (weightChannels != channels) {
+        throw std::runtime_error(lname + " has " + std::to_string(weightChannels) + " outputs, " + std::to_string(anchors.size() / 2) + " anchors and "
+                                 + std::to_string(numClasses) + " classes need " + std::to_string(channels));
+    }
+    return channels;
+}
+
+// Name of the number of detections per image output by filtering yolo layers
+static const char* const NUM_DETECTIONS_BLOB_NAME = "num_detections";
+
+// Yolo layer decoding the output of a yolo head. With BuildOptions::maxDetections
+// it filters the detections and appends them to those of previous, the yolo
+// layer before it in the network, if given.
+template <typename Network>
+LayerOf<Network>* yoloLayer(Network *network, TensorOf<Network>& input, int inputWidth, int inputHeight, int widthFactor, int heightFactor, int numClasses, const std::vector<float>& anchors, float scaleXY, int newCoords,
+                            const BuildOptions& options, LayerOf<Network>* previous = nullptr) {
+    // Explicit batch networks need the dynamic shape version of the plugin,
+    // it takes the grid size from its input at runtime
+    bool dynamic = !network->hasImplicitBatchDimension();
+
+    int yoloWidth = inputWidth / widthFactor;
+    int yoloHeight = inputHeight / heightFactor;
+    int numAnchors = anchors.size() / 2;
+
+    std::vector<PluginField> pluginFields;
+    if (!dynamic) {
+        pluginFields.emplace_back(PluginField("yoloWidth", &yoloWidth, PluginFieldType::kINT32, 1));
+        pluginFields.emplace_back(PluginField("yoloHeight", &yoloHeight, PluginFieldType::kINT32, 1));
+    }
+    pluginFields.emplace_back(PluginField("numAnchors", &numAnchors, PluginFieldType::kINT32, 1));
+    pluginFields.emplace_back(PluginField("numClasses", &numClasses, PluginFieldType::kINT32, 1));
+    pluginFields.emplace_back(PluginField("inputMultiplier", &widthFactor, PluginFieldType::kINT32, 1));
+    pluginFields.emplace_back(PluginField("anchors", anchors.data(), PluginFieldType::kFLOAT32, anchors.size()));
+    pluginFields.emplace_back(PluginField("scaleXY", &scaleXY, PluginFieldType::kFLOAT32, 1));
+    pluginFields.emplace_back(PluginField("newCoords", &newCoords, PluginFieldType::kINT32, 1));
+
+    std::vector<TensorOf<Network>*> inputTensors = { &input };
+    float confThresh = options.filterThreshold;
+    int maxDetections = options.maxDetections;
+    if (maxDetections > 0) {
+        pluginFields.emplace_back(PluginField("confThresh", &confThresh, PluginFieldType::kFLOAT32, 1));
+        pluginFields.emplace_back(PluginField("maxDetections", &maxDetections, PluginFieldType::kINT32, 1));
+        if (previous) {
+            inputTensors.push_back(previous->getOutput(0));
+            inputTensors.push_back(previous->getOutput(1));
+        }
+    }
+    return NetworkTraits<Network>::addPlugin(network, "YoloLayer_TRT", dynamic ? "2" : "1", pluginFields, inputTensors.data(), inputTensors.size());
+}
+
+// Names of the outputs of the YoloNms_TRT plugin after NUM_DETECTIONS_BLOB_NAME
+static const char* const NMS_BOXES_BLOB_NAME = "boxes";
+static const char* const NMS_SCORES_BLOB_NAME = "scores";
+static const char* const NMS_CLASSES_BLOB_NAME = "classes";
+
+// YoloNms_TRT plugin suppressing detections, the concatenated detections of
+// the yolo layers or the filtered ones with their number per image
+template <typename Network>
+LayerOf<Network>* nmsLayer(Network *network, const BuildOptions& options, TensorOf<Network>& detections, TensorOf<Network>* numDetections) {
+    bool dynamic = !network->hasImplicitBatchDimension();
+
+    float scoreThreshold = options.nmsScoreThreshold;
+    float iouThreshold = options.nmsIouThreshold;
+    int topK = options.nmsTopK;
+    int maxOutputs = options.nmsMaxOutputs;
+    std::vector<PluginField> pluginFields;
+    pluginFields.emplace_back(PluginField("scoreThreshold", &scoreThreshold, PluginFieldType::kFLOAT32, 1));
+    pluginFields.emplace_back(PluginField("iouThreshold", &iouThreshold, PluginFieldType::kFLOAT32, 1));
+    pluginFields.emplace_back(PluginField("topK", &topK, PluginFieldType::kINT32, 1));
+    pluginFields.emplace_back(PluginField("maxOutputs", &maxOutputs, PluginFieldType::kINT32, 1));
+
+    std::vector<TensorOf<Network>*> inputTensors = { &detections };
+    if (numDetections) {
+        inputTensors.push_back(numDetections);
+    }
+    return NetworkTraits<Network>::addPlugin(network, "YoloNms_TRT", dynamic ? "2" : "1", pluginFields, inputTensors.data(), inputTensors.size());
+}
+
+// Marks the detections of the yolo layers, given in the order of the network,
+// as the outputs: the concatenation of all of them as outputName or, if they
+// filter, the detections of the last one, which holds those of all, and their
+// number as NUM_DETECTIONS_BLOB_NAME. With BuildOptions::nms the detections
+// are suppressed in the engine instead and the outputs are those of the
+// YoloNms_TRT plugin: NUM_DETECTIONS_BLOB_NAME, NMS_BOXES_BLOB_NAME,
+// NMS_SCORES_BLOB_NAME and NMS_CLASSES_BLOB_NAME.
+template <typename Network>
+void markDetections(Network *network, const BuildOptions& options, const std::vector<LayerOf<Network>*>& yolos, const char* outputName) {
+    TensorOf<Network>* detections;
+    TensorOf<Network>* numDetections = nullptr;
+    if (options.maxDetections > 0) {
+        auto last = yolos.back();
+        detections = last->getOutput(0);
+        numDetections = last->getOutput(1);
+    } else {
+        std::vector<TensorOf<Network>*> outputs;
+        for (auto yolo : yolos) {
+            outputs.push_back(yolo->getOutput(0));
+        }
+        detections = network->addConcatenation(outputs.data(), outputs.size())->getOutput(0);
+    }
+
+    if (options.nms) {
+        auto nms = nmsLayer(network, options, *detections, numDetections);
+        const char* names[] = { NUM_DETECTIONS_BLOB_NAME, NMS_BOXES_BLOB_NAME, NMS_SCORES_BLOB_NAME, NMS_CLASSES_BLOB_NAME };
+        for (int i = 0; i < 4; ++i) {
+            nms->getOutput(i)->setName(names[i]);
+            network->markOutput(*nms->getOutput(i));
+        }
+        return;
+    }
+
+    detections->setName(outputName);
+    network->markOutput(*detections);
+    if (numDetections) {
+        numDetections->setName(NUM_DETECTIONS_BLOB_NAME);
+        network->markOutput(*numDetections);
+    }
+}
+
+#endif
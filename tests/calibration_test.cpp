@@ -0,0 +1,160 @@
+#include "utils/calibration.h"
+
+#include "testing.h"
+
+#include <sys/stat.h>
+
+// CalibrationStream batching, dropping of the last incomplete batch, skipping
+// of unreadable images and restarting with reset(), letterboxing, and the
+// calibration cache file I/O, on PPM images written by the test.
+
+static const int INPUT_H = 8;
+static const int INPUT_W = 8;
+
+static void writePpm(const std::string& file, int width, int height, uint8_t value) {
+    std::ofstream out(file, std::ios::binary);
+    out << "P6\n# calibration_test\n" << width << " " << height << "\n255\n";
+    std::vector<char> pixels(static_cast<size_t>(width) * height * 3, static_cast<char>(value));
+    out.write(pixels.data(), pixels.size());
+}
+
+// Directory of images image00.ppm .. image<count - 1>.ppm, each of one gray
+// value 10 * (index + 1), plus files the stream must ignore or skip
+static std::string writeImages(int count) {
+    std::string directory = "calibration_test_images";
+    mkdir(directory.c_str(), 0755);
+    for (int i = 0; i < count; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "/image%02d.ppm", i);
+        writePpm(directory + name, INPUT_W, INPUT_H, static_cast<uint8_t>(10 * (i + 1)));
+    }
+    std::ofstream(directory + "/notes.txt") << "not an image";
+    std::ofstream(directory + "/.hidden.ppm") << "P6\n";
+    return directory;
+}
+
+static void removeImages(const std::string& directory, int count) {
+    for (int i = 0; i < count; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "/image%02d.ppm", i);
+        std::remove((directory + name).c_str());
+    }
+    std::remove((directory + "/notes.txt").c_str());
+    std::remove((directory + "/.hidden.ppm").c_str());
+    std::remove((directory + "/image03b.ppm").c_str());
+    rmdir(directory.c_str());
+}
+
+// Gray value of every image of a batch, -1 if an image is not uniform
+static std::vector<int> batchValues(const std::vector<float>& batch, int batchSize) {
+    std::vector<int> values;
+    size_t volume = 3 * static_cast<size_t>(INPUT_H) * INPUT_W;
+    for (int b = 0; b < batchSize; ++b) {
+        float first = batch[b * volume];
+        bool uniform = std::all_of(batch.begin() + b * volume, batch.begin() + (b + 1) * volume, [first](float v) { return v == first; });
+        values.push_back(uniform ? static_cast<int>(std::lround(first * 255.0f)) : -1);
+    }
+    return values;
+}
+
+static void testBatching() {
+    const int images = 10;
+    std::string directory = writeImages(images);
+
+    CalibrationStream stream(directory, 4, INPUT_H, INPUT_W);
+    EXPECT_EQ(stream.imageCount(), static_cast<size_t>(images));
+    EXPECT_EQ(stream.batchVolume(), static_cast<size_t>(4 * 3 * INPUT_H * INPUT_W));
+
+    // 10 images in batches of 4 in sorted order, the last 2 are dropped
+    std::vector<float> batch(stream.batchVolume());
+    EXPECT(stream.next(batch.data()));
+    EXPECT(batchValues(batch, 4) == std::vector<int>({10, 20, 30, 40}));
+    EXPECT(stream.next(batch.data()));
+    EXPECT(batchValues(batch, 4) == std::vector<int>({50, 60, 70, 80}));
+    EXPECT(!stream.next(batch.data()));
+    EXPECT(!stream.next(batch.data()));
+    EXPECT_EQ(stream.batchesRead(), 2);
+
+    // reset() starts over with the same batches
+    stream.reset();
+    EXPECT_EQ(stream.batchesRead(), 0);
+    EXPECT(stream.next(batch.data()));
+    EXPECT(batchValues(batch, 4) == std::vector<int>({10, 20, 30, 40}));
+
+    // maxBatches stops early, also after a reset
+    CalibrationStream limited(directory, 3, INPUT_H, INPUT_W, 1);
+    std::vector<float> small(limited.batchVolume());
+    EXPECT(limited.next(small.data()));
+    EXPECT(!limited.next(small.data()));
+    limited.reset();
+    EXPECT(limited.next(small.data()));
+    EXPECT(batchValues(small, 3) == std::vector<int>({10, 20, 30}));
+
+    // An unreadable image is skipped and the batch filled from the next ones
+    std::ofstream(directory + "/image03b.ppm") << "P6\n8 8\n255\n";
+    CalibrationStream skipping(directory, 5, INPUT_H, INPUT_W);
+    EXPECT_EQ(skipping.imageCount(), static_cast<size_t>(images + 1));
+    std::vector<float> five(skipping.batchVolume());
+    EXPECT(skipping.next(five.data()));
+    EXPECT(batchValues(five, 5) == std::vector<int>({10, 20, 30, 40, 50}));
+    EXPECT(skipping.next(five.data()));
+    EXPECT(batchValues(five, 5) == std::vector<int>({60, 70, 80, 90, 100}));
+    EXPECT(!skipping.next(five.data()));
+
+    removeImages(directory, images);
+
+    // A missing directory has no batches
+    CalibrationStream missing("calibration_test_missing", 1, INPUT_H, INPUT_W);
+    EXPECT_EQ(missing.imageCount(), 0u);
+    EXPECT(!missing.next(five.data()));
+}
+
+// A 2:1 image is scaled to the full width and centered between gray bars
+static void testLetterbox() {
+    RgbImage image;
+    image.width = 16;
+    image.height = 8;
+    image.pixels.assign(16 * 8 * 3, 200);
+    std::vector<float> chw(3 * INPUT_H * INPUT_W);
+    letterbox(image, INPUT_H, INPUT_W, chw.data());
+    for (int c = 0; c < 3; ++c) {
+        for (int y = 0; y < INPUT_H; ++y) {
+            float expected = y >= 2 && y < 6 ? 200.0f / 255.0f : 127.0f / 255.0f;
+            for (int x = 0; x < INPUT_W; ++x) {
+                EXPECT_EQ(chw[(c * INPUT_H + y) * INPUT_W + x], expected);
+            }
+        }
+    }
+}
+
+static void testCacheFile() {
+    std::string file = "calibration_test.cache";
+    std::remove(file.c_str());
+    EXPECT(readCalibrationCacheFile(file).empty());
+
+    std::string table = "TRT-7103-EntropyCalibration2\ndata: 3c010a14\n";
+    table.push_back('\0');  // binary safe
+    table += "(Unnamed Layer* 0) [Convolution]_output: 3d8a1b2c\n";
+    EXPECT(writeCalibrationCacheFile(file, table.data(), table.size()));
+    std::vector<char> read = readCalibrationCacheFile(file);
+    EXPECT(std::string(read.begin(), read.end()) == table);
+
+    // A rewrite replaces the whole file and leaves no temporary behind
+    std::string shorter = "TRT-7103-EntropyCalibration2\n";
+    EXPECT(writeCalibrationCacheFile(file, shorter.data(), shorter.size()));
+    read = readCalibrationCacheFile(file);
+    EXPECT(std::string(read.begin(), read.end()) == shorter);
+    struct stat st;
+    EXPECT(stat((file + ".tmp" + std::to_string(getpid())).c_str(), &st) != 0);
+
+    // An unwritable location fails without a file
+    EXPECT(!writeCalibrationCacheFile("calibration_test_missing/table.cache", shorter.data(), shorter.size()));
+    std::remove(file.c_str());
+}
+
+int main() {
+    testBatching();
+    testLetterbox();
+    testCacheFile();
+    return testResult("calibration_test");
+}
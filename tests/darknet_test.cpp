@@ -0,0 +1,109 @@
+#include "networks.h"
+
+#include "testing.h"
+
+// The darknet network built from the .cfg of yolov4, yolov4tiny and
+// yolov4tiny3l records the same graph as the hand-written network, compared
+// with RecordingNetwork::describe() for the build options that change the
+// graph.
+
+struct HandWritten {
+    const char* network;
+    NetworkDefine define;
+    std::vector<std::string> fp32Layers;
+};
+
+// Options of the builds that are compared, by name
+static std::vector<std::pair<std::string, BuildOptions>> buildVariants() {
+    std::vector<std::pair<std::string, BuildOptions>> variants;
+    BuildOptions base;
+    base.classes = 80;
+    base.inputH = 416;
+    base.inputW = 416;
+    variants.emplace_back("default", base);
+
+    BuildOptions fused = base;
+    fused.foldBatchNorm = true;
+    fused.mishPlugin = true;
+    fused.upsample = UpsampleMode::kDECONVOLUTION;
+    variants.emplace_back("fused", fused);
+
+    BuildOptions resized = base;
+    resized.inputH = 256;
+    resized.inputW = 320;
+    resized.upsample = UpsampleMode::kRESIZE;
+    variants.emplace_back("320x256", resized);
+
+    BuildOptions explicitBatch = base;
+    explicitBatch.explicitBatch = true;
+    explicitBatch.batch = {1, 2, 4};
+    explicitBatch.height = {256, 416, 608};
+    explicitBatch.width = {256, 416, 608};
+    variants.emplace_back("explicit batch", explicitBatch);
+
+    BuildOptions filter = base;
+    filter.filterThreshold = 0.25f;
+    filter.maxDetections = 1000;
+    variants.emplace_back("filter", filter);
+
+    BuildOptions explicitFilter = explicitBatch;
+    explicitFilter.filterThreshold = 0.25f;
+    explicitFilter.maxDetections = 1000;
+    variants.emplace_back("explicit batch filter", explicitFilter);
+
+    BuildOptions nms = base;
+    nms.nms = true;
+    nms.nmsIouThreshold = 0.5f;
+    variants.emplace_back("nms", nms);
+
+    BuildOptions filterNms = explicitFilter;
+    filterNms.nms = true;
+    variants.emplace_back("explicit batch filter nms", filterNms);
+    return variants;
+}
+
+static void testSameGraph(const HandWritten& network) {
+    for (auto& variant : buildVariants()) {
+        std::unique_ptr<RecordedBuild> hand = recordNetwork(network.define, network.network, variant.second);
+        std::unique_ptr<RecordedBuild> cfg = recordNetwork(darknet::defineNetwork<RecordingNetwork>, network.network, variant.second);
+        std::string expected = hand->network.describe();
+        std::string actual = cfg->network.describe();
+        if (expected != actual) {
+            std::cout << "[Error] " << network.network << " " << variant.first << ": the cfg build differs from the hand-written network" << std::endl;
+            std::ofstream(std::string(network.network) + "-expected.txt") << expected;
+            std::ofstream(std::string(network.network) + "-actual.txt") << actual;
+        }
+        EXPECT(expected == actual);
+        EXPECT(cfg->weightMap.unused().empty());
+    }
+
+    // The yolo heads are kept in FP32 like the FP32_LAYERS of the network
+    BuildOptions options;
+    options.weights = syntheticWeights(network.network);
+    EXPECT(darknet::fp32Layers(options) == network.fp32Layers);
+}
+
+// A grouped route with groups=2 group_id=1 slices the second half of the channels
+static void testGroupedRoutes() {
+    BuildOptions options;
+    std::unique_ptr<RecordedBuild> build = recordNetwork(darknet::defineNetwork<RecordingNetwork>, "yolov4tiny", options);
+    int slices = 0;
+    for (int i = 0; i < build->network.getNbLayers(); ++i) {
+        const RecordedLayer* layer = build->network.getLayer(i);
+        if (layer->type == LayerType::kSLICE) {
+            int channels = layer->inputs[0]->dims.d[0];
+            EXPECT_EQ(layer->start.d[0], channels / 2);
+            EXPECT_EQ(layer->size.d[0], channels / 2);
+            slices++;
+        }
+    }
+    EXPECT_EQ(slices, 3);
+}
+
+int main() {
+    testSameGraph(HandWritten{"yolov4", yolov4::defineNetwork<RecordingNetwork>, yolov4::FP32_LAYERS});
+    testSameGraph(HandWritten{"yolov4tiny", yolov4tiny::defineNetwork<RecordingNetwork>, yolov4tiny::FP32_LAYERS});
+    testSameGraph(HandWritten{"yolov4tiny3l", yolov4tiny3l::defineNetwork<RecordingNetwork>, yolov4tiny3l::FP32_LAYERS});
+    testGroupedRoutes();
+    return testResult("darknet_test");
+}
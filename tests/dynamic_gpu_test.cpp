@@ -0,0 +1,138 @@
+#include "networks.h"
+
+#include "gpu_testing.h"
+#include "utils/analysis.h"
+#include "utils/logging.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+// An explicit batch engine of yolov4tiny with dynamic batch and resolution,
+// the network of the YoloLayer_TRT version 2 plugin: built, serialized and
+// deserialized again, then run at a batch and resolution other than the
+// optimal ones against the implicit batch engine of that resolution, and
+// each image alone against the batch. Needs a GPU, built with WITH_GPU_TESTS.
+
+using namespace nvinfer1;
+
+static Logger gLogger;
+
+static const int MAX_BATCH = 4;
+
+// Builds the engine, writes it to file and deserializes it from there
+static ICudaEngine* buildAndReload(IRuntime* runtime, const BuildOptions& options, const std::string& file) {
+    IBuilder* builder = createInferBuilder(gLogger);
+    IBuilderConfig* config = builder->createBuilderConfig();
+    ICudaEngine* engine = yolov4tiny::createEngine(MAX_BATCH, builder, config, DataType::kFLOAT, options);
+    config->destroy();
+    builder->destroy();
+    if (!engine) {
+        throw std::runtime_error("Could not build " + file);
+    }
+    saveEngine(engine, file);
+    engine->destroy();
+
+    std::stringstream blob;
+    blob << std::ifstream(file, std::ios::binary).rdbuf();
+    std::string content = blob.str();
+    engine = runtime->deserializeCudaEngine(content.data(), content.size(), nullptr);
+    if (!engine) {
+        throw std::runtime_error("Could not deserialize " + file);
+    }
+    return engine;
+}
+
+// Runs the engine on batch images of height x width, returns the output
+static std::vector<float> run(ICudaEngine* engine, const std::vector<float>& images, int batch, int height, int width) {
+    IExecutionContext* context = engine->createExecutionContext();
+    int outputIndex = engine->bindingIsInput(0) ? 1 : 0;
+    int inputIndex = 1 - outputIndex;
+    size_t outputCount = 0;
+    if (engine->hasImplicitBatchDimension()) {
+        outputCount = batch * dimsVolume(engine->getBindingDimensions(outputIndex));
+    }
+    else {
+        EXPECT(context->setBindingDimensions(inputIndex, Dims4{batch, 3, height, width}));
+        EXPECT(context->allInputDimensionsSpecified());
+        Dims outputDims = context->getBindingDimensions(outputIndex);
+        EXPECT_EQ(outputDims.d[0], batch);
+        outputCount = dimsVolume(outputDims);
+    }
+
+    DeviceBuffer<float> input(images);
+    DeviceBuffer<float> output(outputCount);
+    void* buffers[2];
+    buffers[inputIndex] = input.get();
+    buffers[outputIndex] = output.get();
+    bool executed = engine->hasImplicitBatchDimension() ? context->execute(batch, buffers) : context->executeV2(buffers);
+    EXPECT(executed);
+    std::vector<float> result = output.download();
+    context->destroy();
+    return result;
+}
+
+// Different engines may pick different tactics, their outputs agree within
+// a tolerance. A class id may flip where two class probabilities are almost
+// equal, a few such values are allowed.
+static void expectClose(const std::vector<float>& actual, const float* expected, size_t count, const char* what) {
+    EXPECT_EQ(actual.size(), count);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count && i < actual.size(); ++i) {
+        if (!(std::fabs(actual[i] - expected[i]) <= 1e-3f * (1.0f + std::fabs(expected[i])))) {
+            mismatches++;
+        }
+    }
+    if (mismatches > count / 10000) {
+        std::cout << "[Error] " << what << ": " << mismatches << " of " << count << " values differ" << std::endl;
+        testFailures++;
+    }
+}
+
+int main() {
+    std::mt19937 generator(13);
+    IRuntime* runtime = createInferRuntime(gLogger);
+    EXPECT(getPluginRegistry()->getPluginCreator("YoloLayer_TRT", "2") != nullptr);
+
+    BuildOptions options;
+    options.weights = syntheticWeights("yolov4tiny");
+    options.inputH = 320;
+    options.inputW = 320;
+    ICudaEngine* implicitEngine = buildAndReload(runtime, options, "dynamic_gpu_test_implicit.engine");
+
+    options.inputH = 416;
+    options.inputW = 416;
+    options.explicitBatch = true;
+    options.batch = ShapeRange{1, 2, MAX_BATCH};
+    options.height = ShapeRange{320, 416, 416};
+    options.width = ShapeRange{320, 416, 416};
+    ICudaEngine* dynamicEngine = buildAndReload(runtime, options, "dynamic_gpu_test_dynamic.engine");
+
+    EXPECT(!dynamicEngine->hasImplicitBatchDimension());
+    EXPECT_EQ(dynamicEngine->getNbOptimizationProfiles(), 1);
+    int inputIndex = dynamicEngine->getBindingIndex("input");
+    EXPECT_EQ(dynamicEngine->getBindingDimensions(inputIndex).d[0], -1);
+    EXPECT_EQ(dynamicEngine->getProfileDimensions(inputIndex, 0, OptProfileSelector::kMIN).d[0], 1);
+    EXPECT_EQ(dynamicEngine->getProfileDimensions(inputIndex, 0, OptProfileSelector::kMAX).d[0], MAX_BATCH);
+
+    // Batch 3 at 320x320, neither the optimal nor the largest shape
+    const int batch = 3;
+    const size_t imageSize = 3 * 320 * 320;
+    std::vector<float> images = randomFloats(generator, batch * imageSize, 0.0f, 1.0f);
+    std::vector<float> expected = run(implicitEngine, images, batch, 320, 320);
+    std::vector<float> outputs = run(dynamicEngine, images, batch, 320, 320);
+    expectClose(outputs, expected.data(), expected.size(), "batch of 3 against the implicit batch engine");
+
+    size_t perImage = expected.size() / batch;
+    for (int i = 0; i < batch; ++i) {
+        std::vector<float> image(images.begin() + i * imageSize, images.begin() + (i + 1) * imageSize);
+        expectClose(run(dynamicEngine, image, 1, 320, 320), outputs.data() + i * perImage, perImage, "one image against the batch");
+    }
+
+    dynamicEngine->destroy();
+    implicitEngine->destroy();
+    runtime->destroy();
+    remove("dynamic_gpu_test_implicit.engine");
+    remove("dynamic_gpu_test_dynamic.engine");
+    return testResult("dynamic_gpu_test");
+}
@@ -0,0 +1,327 @@
+#include "utils/enginecache.h"
+
+#include "testing.h"
+
+#include <set>
+#include <thread>
+
+// describeEngineBuild() keys, INT8 calibration included, and the EngineCache
+// directory: hits, a key whose stored description differs, least recently
+// used eviction and concurrent stores, on small files standing in for
+// weights, images and engines.
+
+static const char ENVIRONMENT[] = "tensorrt=7203\nplugins=test\ndevice=test\n";
+static const char CACHE_DIRECTORY[] = "enginecache_test_cache";
+
+static void writeFile(const std::string& file, const std::string& contents) {
+    std::ofstream(file, std::ios::binary) << contents;
+}
+
+static std::string readFile(const std::string& file) {
+    std::ifstream in(file, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static NetworkInfo testNetworkInfo() {
+    NetworkInfo info;
+    info.inputH = 416;
+    info.inputW = 416;
+    info.precision = Precision::kFP16;
+    info.fp32Layers = {"conv138", "conv149", "conv160"};
+    return info;
+}
+
+static std::string describe(const BuildOptions& options) {
+    return describeEngineBuild("yolov4", options, testNetworkInfo(), 1, ENVIRONMENT);
+}
+
+// Files in the cache directory that are neither engines nor descriptions
+static int strayFiles() {
+    int stray = 0;
+    DIR* dir = opendir(CACHE_DIRECTORY);
+    while (dirent* entry = dir ? readdir(dir) : nullptr) {
+        std::string name = entry->d_name;
+        if (name != "." && name != ".." && !hasExtension(name, ".engine") && !hasExtension(name, ".build")) {
+            std::cout << "[Error] Stray file " << name << " in the engine cache" << std::endl;
+            stray++;
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+    return stray;
+}
+
+static void clearCache() {
+    DIR* dir = opendir(CACHE_DIRECTORY);
+    while (dirent* entry = dir ? readdir(dir) : nullptr) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") {
+            std::remove((std::string(CACHE_DIRECTORY) + "/" + name).c_str());
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+}
+
+static void testKeys() {
+    writeFile("enginecache_test_a.wtsb", "weights a");
+    writeFile("enginecache_test_b.wtsb", "weights a");
+    writeFile("enginecache_test_c.wtsb", "weights c");
+
+    BuildOptions options;
+    options.weights = "enginecache_test_a.wtsb";
+    std::string description = describe(options);
+
+    // The same inputs give the same description and key, a 16 digit hex string
+    EXPECT(describe(options) == description);
+    std::string key = EngineCache::key(description);
+    EXPECT_EQ(key.size(), 16u);
+    EXPECT(key.find_first_not_of("0123456789abcdef") == std::string::npos);
+    EXPECT(EngineCache::key(describe(options)) == key);
+
+    // Weights are keyed by contents, not path
+    BuildOptions renamed = options;
+    renamed.weights = "enginecache_test_b.wtsb";
+    EXPECT(describe(renamed) == description);
+    BuildOptions retrained = options;
+    retrained.weights = "enginecache_test_c.wtsb";
+    EXPECT(EngineCache::key(describe(retrained)) != key);
+
+    // The network's precision spelled out is the same build
+    BuildOptions fp16 = options;
+    fp16.precision = Precision::kFP16;
+    EXPECT(describe(fp16) == description);
+
+    // Every option that changes the engine changes the key
+    std::vector<BuildOptions> changed(10, options);
+    changed[0].precision = Precision::kFP32;
+    changed[1].foldBatchNorm = true;
+    changed[2].inputH = 608;
+    changed[3].anchors = {{10, 13, 16, 30, 33, 23}};
+    changed[4].fp32Layers = {"none"};
+    changed[5].sppf = true;
+    changed[6].upsample = UpsampleMode::kDECONVOLUTION;
+    changed[7].explicitBatch = true;
+    changed[8].maxDetections = 100;
+    changed[9].nms = true;
+    std::set<std::string> keys{key};
+    for (auto& change : changed) {
+        NetworkInfo info = testNetworkInfo();
+        if (change.inputH) {
+            info.inputH = change.inputH;
+        }
+        keys.insert(EngineCache::key(describeEngineBuild("yolov4", change, info, 1, ENVIRONMENT)));
+    }
+    EXPECT_EQ(keys.size(), changed.size() + 1);
+    EXPECT(EngineCache::key(describeEngineBuild("yolov4", options, testNetworkInfo(), 1, "tensorrt=8000\n")) != key);
+
+    // Unreadable weights cannot be keyed
+    BuildOptions missing = options;
+    missing.weights = "enginecache_test_missing.wtsb";
+    bool thrown = false;
+    try {
+        describe(missing);
+    }
+    catch(const std::runtime_error&) {
+        thrown = true;
+    }
+    EXPECT(thrown);
+
+    for (const char* file : {"enginecache_test_a.wtsb", "enginecache_test_b.wtsb", "enginecache_test_c.wtsb"}) {
+        std::remove(file);
+    }
+}
+
+// INT8 builds are keyed by the names, sizes and contents of the calibration
+// images and the batch settings, and by the calibration cache if it exists
+static void testCalibrationKeys() {
+    const std::string directory = "enginecache_test_images";
+    mkdir(directory.c_str(), 0755);
+    writeFile(directory + "/a.ppm", "image a");
+    writeFile(directory + "/b.ppm", "image b");
+    writeFile("enginecache_test_a.wtsb", "weights a");
+
+    BuildOptions options;
+    options.weights = "enginecache_test_a.wtsb";
+    options.precision = Precision::kINT8;
+    options.calibrationImages = directory;
+    options.calibrationCache = "enginecache_test_int8.cache";
+    std::remove(options.calibrationCache.c_str());
+
+    std::set<std::string> keys;
+    auto expectNewKey = [&]() {
+        EXPECT(keys.insert(EngineCache::key(describe(options))).second);
+    };
+    auto expectSameKey = [&]() {
+        EXPECT(!keys.insert(EngineCache::key(describe(options))).second);
+    };
+
+    expectNewKey();
+    writeFile(directory + "/notes.txt", "not an image");
+    expectSameKey();
+    writeFile(directory + "/b.ppm", "image c");     // same size, other bytes
+    expectNewKey();
+    writeFile(directory + "/b.ppm", "image bb");
+    expectNewKey();
+    std::rename((directory + "/b.ppm").c_str(), (directory + "/c.ppm").c_str());
+    expectNewKey();
+    writeFile(directory + "/d.ppm", "image d");
+    expectNewKey();
+    options.calibrationBatchSize = 4;
+    expectNewKey();
+    options.calibrationBatches = 2;
+    expectNewKey();
+
+    // With a calibration cache the images still count, and so does the cache
+    writeFile(options.calibrationCache, "scales 1");
+    expectNewKey();
+    writeFile(directory + "/d.ppm", "image e");
+    expectNewKey();
+    writeFile(options.calibrationCache, "scales 2");
+    expectNewKey();
+    options.calibrationBatchSize = 8;
+    expectNewKey();
+
+    for (const char* name : {"a.ppm", "c.ppm", "d.ppm", "notes.txt"}) {
+        std::remove((directory + "/" + name).c_str());
+    }
+    rmdir(directory.c_str());
+    std::remove(options.calibrationCache.c_str());
+    std::remove("enginecache_test_a.wtsb");
+}
+
+// main.cpp keys the plugins by the loaded liblayerplugin.so, found like libc here
+static void testLoadedLibrary() {
+    std::string libc = loadedLibrary("libc.so");
+    EXPECT(!libc.empty());
+    EXPECT(fileExists(libc));
+    EXPECT(loadedLibrary("libenginecache_test_missing.so").empty());
+    EXPECT(loadedLibrary("c.so").empty());
+}
+
+static void testFetch() {
+    clearCache();
+    EngineCache cache(CACHE_DIRECTORY, 1 << 20);
+    std::string description = "network=test\nweights=0123\n";
+    EXPECT(!cache.fetch(description, "enginecache_test.engine"));
+
+    writeFile("enginecache_test.engine", "engine 1");
+    EXPECT(cache.store(description, "enginecache_test.engine"));
+    std::remove("enginecache_test.engine");
+    EXPECT(cache.fetch(description, "enginecache_test.engine"));
+    EXPECT(readFile("enginecache_test.engine") == "engine 1");
+    EXPECT(readFile(std::string(CACHE_DIRECTORY) + "/" + EngineCache::key(description) + ".build") == description);
+
+    // A description stored under the same key but different is a miss
+    std::string base = std::string(CACHE_DIRECTORY) + "/" + EngineCache::key(description);
+    writeFile(base + ".build", "network=other\n");
+    std::remove("enginecache_test.engine");
+    EXPECT(!cache.fetch(description, "enginecache_test.engine"));
+    EXPECT(!fileExists("enginecache_test.engine"));
+
+    // So is a description without its engine
+    writeFile(base + ".build", description);
+    std::remove((base + ".engine").c_str());
+    EXPECT(!cache.fetch(description, "enginecache_test.engine"));
+
+    // A missing engine file is not stored
+    EXPECT(!cache.store("network=missing\n", "enginecache_test_missing.engine"));
+    EXPECT_EQ(strayFiles(), 0);
+}
+
+// Stores an engine of bytes bytes and marks it as used at time used
+static void storeEngine(EngineCache& cache, const std::string& description, size_t bytes, time_t used) {
+    writeFile("enginecache_test.engine", std::string(bytes, 'e'));
+    EXPECT(cache.store(description, "enginecache_test.engine"));
+    struct utimbuf times{used, used};
+    utime((std::string(CACHE_DIRECTORY) + "/" + EngineCache::key(description) + ".engine").c_str(), &times);
+}
+
+static bool cached(const std::string& description) {
+    return fileExists(std::string(CACHE_DIRECTORY) + "/" + EngineCache::key(description) + ".engine") &&
+           fileExists(std::string(CACHE_DIRECTORY) + "/" + EngineCache::key(description) + ".build");
+}
+
+static void testEviction() {
+    clearCache();
+    EngineCache cache(CACHE_DIRECTORY, 3000);
+    time_t now = time(nullptr);
+    storeEngine(cache, "engine=a\n", 1000, now - 400);
+    storeEngine(cache, "engine=b\n", 1000, now - 300);
+    storeEngine(cache, "engine=c\n", 1000, now - 200);
+    EXPECT(cached("engine=a\n") && cached("engine=b\n") && cached("engine=c\n"));
+
+    // A hit makes a the most recently used, the next store evicts b, the least recently used
+    EXPECT(cache.fetch("engine=a\n", "enginecache_test.engine"));
+    storeEngine(cache, "engine=d\n", 1000, now);
+    EXPECT(cached("engine=a\n") && !cached("engine=b\n") && cached("engine=c\n") && cached("engine=d\n"));
+
+    // The engine just stored is kept even if it is older than the others
+    // and alone exceeds the limit, everything else goes
+    writeFile("enginecache_test.engine", std::string(4000, 'e'));
+    EXPECT(cache.store("engine=e\n", "enginecache_test.engine"));
+    EXPECT(cached("engine=e\n") && !cached("engine=a\n") && !cached("engine=c\n") && !cached("engine=d\n"));
+
+    // evict() with keep skips the kept engine however old it is
+    clearCache();
+    storeEngine(cache, "engine=f\n", 1500, now - 500);
+    storeEngine(cache, "engine=g\n", 1500, now - 100);
+    EngineCache smaller(CACHE_DIRECTORY, 2000);
+    smaller.evict(std::string(CACHE_DIRECTORY) + "/" + EngineCache::key("engine=f\n") + ".engine");
+    EXPECT(cached("engine=f\n") && !cached("engine=g\n"));
+    EXPECT_EQ(strayFiles(), 0);
+    std::remove("enginecache_test.engine");
+}
+
+// Threads storing at once, the same build and different builds, leave
+// complete entries and no temporary files
+static void testConcurrentStores() {
+    clearCache();
+    EngineCache cache(CACHE_DIRECTORY, 1 << 20);
+    const int threads = 8;
+    for (int i = 0; i < threads; ++i) {
+        writeFile("enginecache_test_" + std::to_string(i) + ".engine", std::string(10000 + i, 'a' + i));
+    }
+    std::vector<std::thread> workers;
+    std::atomic<int> failures{0};
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&cache, &failures, i]() {
+            std::string engine = "enginecache_test_" + std::to_string(i) + ".engine";
+            for (int round = 0; round < 20; ++round) {
+                bool same = cache.store("engine=same\n", "enginecache_test_0.engine");
+                bool own = cache.store("engine=" + std::to_string(i) + "\n", engine);
+                failures += !same + !own;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_EQ(strayFiles(), 0);
+    EXPECT(cache.fetch("engine=same\n", "enginecache_test.engine"));
+    EXPECT(readFile("enginecache_test.engine") == readFile("enginecache_test_0.engine"));
+    for (int i = 0; i < threads; ++i) {
+        std::string engine = "enginecache_test_" + std::to_string(i) + ".engine";
+        EXPECT(cache.fetch("engine=" + std::to_string(i) + "\n", "enginecache_test.engine"));
+        EXPECT(readFile("enginecache_test.engine") == readFile(engine));
+        std::remove(engine.c_str());
+    }
+    std::remove("enginecache_test.engine");
+    clearCache();
+    rmdir(CACHE_DIRECTORY);
+}
+
+int main() {
+    testKeys();
+    testCalibrationKeys();
+    testLoadedLibrary();
+    testFetch();
+    testEviction();
+    testConcurrentStores();
+    return testResult("enginecache_test");
+}
@@ -0,0 +1,86 @@
+#include "utils/derived.h"
+
+#include "testing.h"
+
+#include <cmath>
+
+// --fold-bn (deriveFoldedConv()) against the unfused convolution followed by
+// the batch norm, on random tensors.
+
+struct ConvShape {
+    int inChannels, outChannels, height, width, kernel, stride, padding;
+};
+
+// Direct convolution of one CHW image, accumulated in double so that the
+// reference does not depend on the summation order
+static std::vector<double> convolve(const ConvShape& shape, const float* input, const float* kernel, const float* bias) {
+    int outHeight = (shape.height + 2 * shape.padding - shape.kernel) / shape.stride + 1;
+    int outWidth = (shape.width + 2 * shape.padding - shape.kernel) / shape.stride + 1;
+    std::vector<double> output(static_cast<size_t>(shape.outChannels) * outHeight * outWidth);
+    for (int o = 0; o < shape.outChannels; ++o) {
+        for (int y = 0; y < outHeight; ++y) {
+            for (int x = 0; x < outWidth; ++x) {
+                double sum = bias ? bias[o] : 0.0;
+                for (int c = 0; c < shape.inChannels; ++c) {
+                    for (int ky = 0; ky < shape.kernel; ++ky) {
+                        for (int kx = 0; kx < shape.kernel; ++kx) {
+                            int iy = y * shape.stride + ky - shape.padding;
+                            int ix = x * shape.stride + kx - shape.padding;
+                            if (iy < 0 || iy >= shape.height || ix < 0 || ix >= shape.width) {
+                                continue;
+                            }
+                            double value = input[(static_cast<size_t>(c) * shape.height + iy) * shape.width + ix];
+                            sum += value * kernel[((static_cast<size_t>(o) * shape.inChannels + c) * shape.kernel + ky) * shape.kernel + kx];
+                        }
+                    }
+                }
+                output[(static_cast<size_t>(o) * outHeight + y) * outWidth + x] = sum;
+            }
+        }
+    }
+    return output;
+}
+
+static void testFoldedConvolution(std::mt19937& generator, const ConvShape& shape) {
+    const float eps = 1e-4f;
+    int64_t kernelCount = static_cast<int64_t>(shape.outChannels) * shape.inChannels * shape.kernel * shape.kernel;
+    std::vector<float> input = randomFloats(generator, static_cast<size_t>(shape.inChannels) * shape.height * shape.width, -1.0f, 1.0f);
+    std::vector<float> kernel = randomFloats(generator, kernelCount, -0.1f, 0.1f);
+    std::vector<float> gamma = randomFloats(generator, shape.outChannels, 0.5f, 1.5f);
+    std::vector<float> beta = randomFloats(generator, shape.outChannels, -0.5f, 0.5f);
+    std::vector<float> mean = randomFloats(generator, shape.outChannels, -0.2f, 0.2f);
+    std::vector<float> var = randomFloats(generator, shape.outChannels, 0.0f, 2.0f);
+    var[0] = 0.0f;  // a dead channel, the scale is then 1 / sqrt(eps)
+
+    WeightArena arena;
+    FoldedConvParams folded = deriveFoldedConv(arena, kernel.data(), kernelCount, gamma.data(), beta.data(), mean.data(), var.data(), shape.outChannels, eps);
+    EXPECT_EQ(folded.kernel.count, kernelCount);
+    EXPECT_EQ(folded.bias.count, shape.outChannels);
+
+    // Unfused: convolution without bias, then gamma * (x - mean) / sqrt(var + eps) + beta
+    std::vector<double> unfused = convolve(shape, input.data(), kernel.data(), nullptr);
+    std::vector<double> fused = convolve(shape, input.data(), static_cast<const float*>(folded.kernel.values), static_cast<const float*>(folded.bias.values));
+    size_t plane = unfused.size() / shape.outChannels;
+    int mismatches = 0;
+    for (size_t i = 0; i < unfused.size(); ++i) {
+        int o = i / plane;
+        double scale = gamma[o] / std::sqrt(static_cast<double>(var[o]) + eps);
+        double expected = (unfused[i] - mean[o]) * scale + beta[o];
+        // Float rounding of the folded kernel and bias, relative to the magnitude of the terms
+        double magnitude = (std::fabs(unfused[i]) + std::fabs(mean[o])) * std::fabs(scale) + std::fabs(beta[o]) + 1.0;
+        mismatches += std::fabs(fused[i] - expected) > 1e-5 * magnitude;
+    }
+    EXPECT_EQ(mismatches, 0);
+
+    // The folded bias is exactly the shift of the unfused batch norm
+    BatchNormParams bn = deriveBatchNorm(arena, gamma.data(), beta.data(), mean.data(), var.data(), shape.outChannels, eps);
+    EXPECT(sameBits(static_cast<const float*>(folded.bias.values), static_cast<const float*>(bn.shift.values), shape.outChannels));
+}
+
+int main() {
+    std::mt19937 generator(10);
+    testFoldedConvolution(generator, ConvShape{3, 8, 13, 11, 3, 1, 1});
+    testFoldedConvolution(generator, ConvShape{16, 32, 9, 9, 3, 2, 1});
+    testFoldedConvolution(generator, ConvShape{64, 24, 5, 7, 1, 1, 0});
+    return testResult("foldbn_test");
+}
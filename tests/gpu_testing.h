@@ -0,0 +1,61 @@
+#ifndef __TRT_GPU_TESTING_H_
+#define __TRT_GPU_TESTING_H_
+
+#include "testing.h"
+
+#include <algorithm>
+#include <cuda_runtime_api.h>
+#include <stdexcept>
+
+// Device buffers of the GPU tests, which run the plugin kernels on the same
+// inputs as their host references. A CUDA error ends the test.
+static inline void checkCuda(cudaError_t status, const char* what) {
+    if (status != cudaSuccess) {
+        throw std::runtime_error(std::string("CUDA error ") + std::to_string(static_cast<int>(status)) + " in " + what);
+    }
+}
+
+template <typename T>
+class DeviceBuffer {
+    public:
+        explicit DeviceBuffer(size_t count) : mCount(count) {
+            checkCuda(cudaMalloc(&mData, std::max<size_t>(count, 1) * sizeof(T)), "cudaMalloc");
+        }
+
+        explicit DeviceBuffer(const std::vector<T>& values) : DeviceBuffer(values.size()) {
+            upload(values);
+        }
+
+        ~DeviceBuffer() {
+            cudaFree(mData);
+        }
+
+        DeviceBuffer(const DeviceBuffer&) = delete;
+        DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+
+        void upload(const std::vector<T>& values) {
+            checkCuda(cudaMemcpy(mData, values.data(), values.size() * sizeof(T), cudaMemcpyHostToDevice), "cudaMemcpy");
+        }
+
+        // Fills the buffer with a byte pattern, to see which elements a kernel writes
+        void fill(int byte) {
+            checkCuda(cudaMemset(mData, byte, mCount * sizeof(T)), "cudaMemset");
+        }
+
+        std::vector<T> download() const {
+            std::vector<T> values(mCount);
+            checkCuda(cudaDeviceSynchronize(), "cudaDeviceSynchronize");
+            checkCuda(cudaMemcpy(values.data(), mData, mCount * sizeof(T), cudaMemcpyDeviceToHost), "cudaMemcpy");
+            return values;
+        }
+
+        T* get() const {
+            return mData;
+        }
+
+    private:
+        T* mData = nullptr;
+        size_t mCount;
+};
+
+#endif
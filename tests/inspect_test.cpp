@@ -0,0 +1,451 @@
+#include "utils/inspect.h"
+
+#include "testing.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <map>
+
+// The JSON report of --inspect: writeEngineReportJson() against the recorded
+// fixtures in tests/fixtures (TEST_FIXTURE_DIR), a check of its schema with a
+// small JSON parser, string escaping and the layer classification.
+// With INSPECT_TEST_RECORD=1 in the environment the fixtures are rewritten.
+
+// Parsed JSON value, numbers as double
+struct Json {
+    enum Type { kNULL, kBOOL, kNUMBER, kSTRING, kARRAY, kOBJECT } type = kNULL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> members;  // in document order
+
+    const Json& operator[](const std::string& key) const {
+        for (auto& member : members) {
+            if (member.first == key) {
+                return member.second;
+            }
+        }
+        throw std::runtime_error("No member " + key);
+    }
+
+    std::vector<std::string> keys() const {
+        std::vector<std::string> names;
+        for (auto& member : members) {
+            names.push_back(member.first);
+        }
+        return names;
+    }
+};
+
+// Strict enough for the report: objects, arrays, strings with escapes,
+// numbers, true, false and null. Throws on anything else.
+class JsonParser {
+    public:
+        explicit JsonParser(const std::string& text) : mText(text) {}
+
+        Json parse() {
+            Json value = parseValue();
+            skipSpace();
+            if (mPos != mText.size()) {
+                fail("trailing characters");
+            }
+            return value;
+        }
+
+    private:
+        Json parseValue() {
+            skipSpace();
+            Json value;
+            char c = peek();
+            if (c == '{') {
+                value.type = Json::kOBJECT;
+                mPos++;
+                if (consume('}')) {
+                    return value;
+                }
+                do {
+                    skipSpace();
+                    std::string key = parseString();
+                    skipSpace();
+                    expect(':');
+                    value.members.emplace_back(key, parseValue());
+                    skipSpace();
+                } while (consume(','));
+                expect('}');
+            }
+            else if (c == '[') {
+                value.type = Json::kARRAY;
+                mPos++;
+                if (consume(']')) {
+                    return value;
+                }
+                do {
+                    value.items.push_back(parseValue());
+                    skipSpace();
+                } while (consume(','));
+                expect(']');
+            }
+            else if (c == '"') {
+                value.type = Json::kSTRING;
+                value.string = parseString();
+            }
+            else if (mText.compare(mPos, 4, "true") == 0 || mText.compare(mPos, 5, "false") == 0) {
+                value.type = Json::kBOOL;
+                value.boolean = c == 't';
+                mPos += value.boolean ? 4 : 5;
+            }
+            else if (mText.compare(mPos, 4, "null") == 0) {
+                mPos += 4;
+            }
+            else {
+                const char* start = mText.c_str() + mPos;
+                char* end = nullptr;
+                value.type = Json::kNUMBER;
+                value.number = strtod(start, &end);
+                if (end == start || !(c == '-' || std::isdigit(static_cast<unsigned char>(c)))) {
+                    fail("value expected");
+                }
+                mPos += end - start;
+            }
+            return value;
+        }
+
+        std::string parseString() {
+            expect('"');
+            std::string text;
+            while (peek() != '"') {
+                char c = mText[mPos++];
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    fail("unescaped control character");
+                }
+                if (c != '\\') {
+                    text += c;
+                    continue;
+                }
+                char escape = mText[mPos++];
+                switch (escape) {
+                    case '"': case '\\': case '/': text += escape; break;
+                    case 'n': text += '\n'; break;
+                    case 't': text += '\t'; break;
+                    case 'r': text += '\r'; break;
+                    case 'b': text += '\b'; break;
+                    case 'f': text += '\f'; break;
+                    case 'u': {
+                        unsigned long code = std::stoul(mText.substr(mPos, 4), nullptr, 16);
+                        if (code > 0x7F) {
+                            fail("non-ASCII escape");
+                        }
+                        text += static_cast<char>(code);
+                        mPos += 4;
+                        break;
+                    }
+                    default: fail("bad escape");
+                }
+            }
+            mPos++;
+            return text;
+        }
+
+        void skipSpace() {
+            while (mPos < mText.size() && std::isspace(static_cast<unsigned char>(mText[mPos]))) {
+                mPos++;
+            }
+        }
+
+        char peek() {
+            if (mPos >= mText.size()) {
+                fail("unexpected end");
+            }
+            return mText[mPos];
+        }
+
+        bool consume(char c) {
+            skipSpace();
+            if (mPos < mText.size() && mText[mPos] == c) {
+                mPos++;
+                return true;
+            }
+            return false;
+        }
+
+        void expect(char c) {
+            if (!consume(c)) {
+                fail(std::string("'") + c + "' expected");
+            }
+        }
+
+        void fail(const std::string& message) {
+            throw std::runtime_error("JSON " + message + " at " + std::to_string(mPos));
+        }
+
+        const std::string& mText;
+        size_t mPos = 0;
+};
+
+static Json parseJson(const std::string& text) {
+    return JsonParser(text).parse();
+}
+
+static Dims dims(std::initializer_list<int> values) {
+    Dims d{};
+    for (int value : values) {
+        d.d[d.nbDims++] = value;
+    }
+    return d;
+}
+
+// Report of an FP16 yolov4tiny engine at 416x416 with implicit batch 1
+static EngineReport tinyReport() {
+    EngineReport report;
+    report.engine = "yolov4tiny.engine";
+    report.engineBytes = 13041764;
+    report.implicitBatch = true;
+    report.maxBatchSize = 1;
+    report.deviceMemoryBytes = 11075584;
+    report.optimizationProfiles = 1;
+    report.nbLayers = 29;
+
+    BindingReport input;
+    input.index = 0;
+    input.name = "input";
+    input.input = true;
+    input.dims = dims({3, 416, 416});
+    input.bytes = 3 * 416 * 416 * 4;
+    BindingReport output;
+    output.index = 1;
+    output.name = "detections";
+    output.dims = dims({17745, 1, 1});
+    output.bytes = 17745 * 4;
+    report.bindings = {input, output};
+
+    report.layers = {
+        {"conv0 + leaky0", 0.0676f}, {"conv1 + leaky1", 0.0532f}, {"conv2 + leaky2", 0.0481f},
+        {"(Unnamed Layer* 9) [Slice]", 0.0114f}, {"conv4 + leaky4", 0.0295f}, {"conv5 + leaky5", 0.0288f},
+        {"conv7 + leaky7 || conv8", 0.0301f}, {"(Unnamed Layer* 29) [Pooling]", 0.0159f},
+        {"conv30", 0.0212f}, {"yolo30", 0.0187f}, {"conv37", 0.0394f}, {"yolo37", 0.0246f},
+        {"(Unnamed Layer* 95) [Concatenation]", 0.0061f}};
+    return report;
+}
+
+// Report of an explicit batch yolov4tiny engine with dynamic batch and resolution
+static EngineReport tinyDynamicReport() {
+    EngineReport report;
+    report.engine = "yolov4tiny-dynamic.engine";
+    report.engineBytes = 13102180;
+    report.implicitBatch = false;
+    report.maxBatchSize = 1;
+    report.deviceMemoryBytes = 94371840;
+    report.optimizationProfiles = 1;
+    report.nbLayers = 30;
+
+    BindingReport input;
+    input.index = 0;
+    input.name = "input";
+    input.input = true;
+    input.dims = dims({-1, 3, -1, -1});
+    input.min = dims({1, 3, 320, 320});
+    input.opt = dims({4, 3, 416, 416});
+    input.max = dims({8, 3, 608, 608});
+    input.bytes = 8ull * 3 * 608 * 608 * 4;
+    // (h/32 * w/32 + h/16 * w/16) cells x 3 anchors x 7 floats
+    BindingReport output;
+    output.index = 1;
+    output.name = "detections";
+    output.dims = dims({-1, -1, 1, 1});
+    output.min = dims({1, 10500, 1, 1});
+    output.opt = dims({4, 17745, 1, 1});
+    output.max = dims({8, 37905, 1, 1});
+    output.bytes = 8ull * 37905 * 4;
+    report.bindings = {input, output};
+
+    report.layers = {
+        {"conv0 + leaky0", 0.2218f}, {"conv1 + leaky1", 0.1643f}, {"(Unnamed Layer* 9) [Slice]", 0.0427f},
+        {"yolo30", 0.0531f}, {"yolo37", 0.0718f}, {"(Unnamed Layer* 95) [Concatenation]", 0.0129f}};
+    return report;
+}
+
+// Report of an explicit batch yolov4tiny engine with the YoloNms_TRT outputs
+static EngineReport tinyNmsReport() {
+    EngineReport report;
+    report.engine = "yolov4tiny-nms.engine";
+    report.engineBytes = 13187560;
+    report.implicitBatch = false;
+    report.maxBatchSize = 1;
+    report.deviceMemoryBytes = 95420416;
+    report.optimizationProfiles = 1;
+    report.nbLayers = 31;
+
+    BindingReport input;
+    input.index = 0;
+    input.name = "input";
+    input.input = true;
+    input.dims = dims({-1, 3, -1, -1});
+    input.min = dims({1, 3, 320, 320});
+    input.opt = dims({4, 3, 416, 416});
+    input.max = dims({8, 3, 608, 608});
+    input.bytes = 8ull * 3 * 608 * 608 * 4;
+    report.bindings.push_back(input);
+
+    const char* names[] = {"num_detections", "boxes", "scores", "classes"};
+    for (int i = 0; i < 4; ++i) {
+        BindingReport output;
+        output.index = i + 1;
+        output.name = names[i];
+        output.type = i == 0 ? DataType::kINT32 : DataType::kFLOAT;
+        output.dims = i == 0 ? dims({-1, 1}) : i == 1 ? dims({-1, 100, 4}) : dims({-1, 100});
+        output.min = output.opt = output.max = output.dims;
+        output.min.d[0] = 1;
+        output.opt.d[0] = 4;
+        output.max.d[0] = 8;
+        output.bytes = dimsVolume(output.max) * 4;
+        report.bindings.push_back(output);
+    }
+
+    report.layers = {
+        {"conv0 + leaky0", 0.2218f}, {"conv1 + leaky1", 0.1643f}, {"(Unnamed Layer* 9) [Slice]", 0.0427f},
+        {"yolo30", 0.0531f}, {"yolo37", 0.0718f}, {"(Unnamed Layer* 95) [Concatenation]", 0.0129f},
+        {"nms", 0.1884f}};
+    return report;
+}
+
+static std::string reportJson(const EngineReport& report) {
+    std::ostringstream out;
+    writeEngineReportJson(out, report);
+    return out.str();
+}
+
+static std::string readFile(const std::string& file) {
+    std::ifstream in(file, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// The writer output is the recorded fixture byte for byte
+static void testFixture(const EngineReport& report, const std::string& fixture) {
+    std::string file = std::string(TEST_FIXTURE_DIR) + "/" + fixture;
+    std::string json = reportJson(report);
+    const char* record = getenv("INSPECT_TEST_RECORD");
+    if (record && std::string(record) == "1") {
+        std::ofstream(file, std::ios::binary) << json;
+        std::cout << "[Info] Recorded " << file << std::endl;
+    }
+    std::string expected = readFile(file);
+    EXPECT(!expected.empty());
+    if (json != expected) {
+        std::cout << "[Error] The report differs from " << file << ":\n" << json << std::endl;
+    }
+    EXPECT(json == expected);
+}
+
+// Keys, types and the totals of a report
+static void testSchema(const EngineReport& report) {
+    Json json;
+    try {
+        json = parseJson(reportJson(report));
+    }
+    catch(const std::runtime_error& exception) {
+        std::cout << "[Error] " << exception.what() << std::endl;
+        EXPECT(false);
+        return;
+    }
+    EXPECT(json.type == Json::kOBJECT);
+    EXPECT(json.keys() == std::vector<std::string>({"engine", "engine_bytes", "implicit_batch", "max_batch_size", "device_memory_bytes",
+                                                    "optimization_profiles", "bindings", "total", "layers"}));
+    EXPECT(json["engine"].string == report.engine);
+    EXPECT_EQ(json["engine_bytes"].number, static_cast<double>(report.engineBytes));
+    EXPECT(json["implicit_batch"].type == Json::kBOOL && json["implicit_batch"].boolean == report.implicitBatch);
+    EXPECT_EQ(json["device_memory_bytes"].number, static_cast<double>(report.deviceMemoryBytes));
+
+    const Json& bindings = json["bindings"];
+    EXPECT(bindings.type == Json::kARRAY);
+    EXPECT_EQ(bindings.items.size(), report.bindings.size());
+    std::vector<std::string> bindingKeys = {"index", "name", "input", "type", "dims"};
+    if (!report.implicitBatch) {
+        bindingKeys.insert(bindingKeys.end(), {"min", "opt", "max"});
+    }
+    bindingKeys.push_back("bytes");
+    for (size_t i = 0; i < bindings.items.size() && i < report.bindings.size(); ++i) {
+        const Json& binding = bindings.items[i];
+        EXPECT(binding.keys() == bindingKeys);
+        EXPECT_EQ(binding["index"].number, static_cast<double>(report.bindings[i].index));
+        EXPECT(binding["name"].string == report.bindings[i].name);
+        EXPECT(binding["type"].string == dataTypeName(report.bindings[i].type));
+        EXPECT(binding["dims"].string == costDims(report.bindings[i].dims));
+        EXPECT_EQ(binding["bytes"].number, static_cast<double>(report.bindings[i].bytes));
+    }
+
+    const Json& total = json["total"];
+    EXPECT(total.keys() == std::vector<std::string>({"layers", "profiled_layers", "fused_layers", "yolo_layers", "ms"}));
+    EXPECT_EQ(total["layers"].number, static_cast<double>(report.nbLayers));
+    EXPECT_EQ(total["profiled_layers"].number, static_cast<double>(report.layers.size()));
+
+    const Json& layers = json["layers"];
+    EXPECT_EQ(layers.items.size(), report.layers.size());
+    double ms = 0.0;
+    int fused = 0;
+    int yolo = 0;
+    for (size_t i = 0; i < layers.items.size(); ++i) {
+        const Json& layer = layers.items[i];
+        EXPECT(layer.keys() == std::vector<std::string>({"index", "name", "ms", "fused"}));
+        EXPECT_EQ(layer["index"].number, static_cast<double>(i));
+        ms += layer["ms"].number;
+        fused += layer["fused"].boolean;
+        yolo += isYoloLayer(layer["name"].string);
+    }
+    EXPECT_EQ(total["fused_layers"].number, static_cast<double>(fused));
+    EXPECT_EQ(total["yolo_layers"].number, static_cast<double>(yolo));
+    EXPECT(std::fabs(total["ms"].number - ms) < 1e-3);
+}
+
+// Names with quotes, backslashes and control characters survive a round trip
+static void testEscaping() {
+    EngineReport report = tinyReport();
+    const std::string names[] = {"conv \"0\"", "C:\\engines\\tiny", "line\nbreak\tand\x01"};
+    report.engine = names[1];
+    for (int i = 0; i < 3; ++i) {
+        report.layers[i].first = names[i];
+    }
+    Json json;
+    try {
+        json = parseJson(reportJson(report));
+    }
+    catch(const std::runtime_error& exception) {
+        std::cout << "[Error] " << exception.what() << std::endl;
+        EXPECT(false);
+        return;
+    }
+    EXPECT(json["engine"].string == names[1]);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT(json["layers"].items[i]["name"].string == names[i]);
+    }
+}
+
+static void testLayerNames() {
+    EXPECT(isYoloLayer("yolo30"));
+    EXPECT(isYoloLayer("yolo161"));
+    EXPECT(!isYoloLayer("yolo"));
+    EXPECT(!isYoloLayer("yolo30 + conv"));
+    EXPECT(!isYoloLayer("conv30"));
+    EXPECT(isFusedLayer("conv0 + leaky0"));
+    EXPECT(isFusedLayer("conv7 + leaky7 || conv8"));
+    EXPECT(!isFusedLayer("(Unnamed Layer* 9) [Slice]"));
+
+    std::ostringstream out;
+    printEngineReport(out, tinyReport());
+    EXPECT(out.str().find("[Info] 29 layers, 2 YoloLayer_TRT") != std::string::npos);
+    EXPECT(out.str().find("[Info] Output detections fp32 17745x1x1") != std::string::npos);
+}
+
+int main() {
+    testFixture(tinyReport(), "yolov4tiny.inspect.json");
+    testFixture(tinyDynamicReport(), "yolov4tiny-dynamic.inspect.json");
+    testFixture(tinyNmsReport(), "yolov4tiny-nms.inspect.json");
+    testSchema(tinyReport());
+    testSchema(tinyDynamicReport());
+    testSchema(tinyNmsReport());
+    testEscaping();
+    testLayerNames();
+    return testResult("inspect_test");
+}
@@ -0,0 +1,86 @@
+#include "layers/mishlayer.h"
+
+#include "gpu_testing.h"
+
+#include <cmath>
+#include <limits>
+
+// The kernels of Mish_TRT against mishReference(), bit for bit: FP32 on
+// random inputs, the thresholds of Mish::mish() and special values over a
+// batch of three, FP16 on every half. Needs a GPU, built with WITH_GPU_TESTS.
+
+using namespace nvinfer1;
+
+// Runs the plugin on batch items of count elements each
+template <typename T>
+static std::vector<T> runPlugin(const std::vector<T>& inputs, int batchSize, DataType type) {
+    int count = static_cast<int>(inputs.size()) / batchSize;
+    PluginTensorDesc desc{};
+    desc.dims.nbDims = 1;
+    desc.dims.d[0] = count;
+    desc.type = type;
+    desc.format = TensorFormat::kLINEAR;
+
+    MishPlugin plugin;
+    plugin.configurePlugin(&desc, 1, &desc, 1);
+    DeviceBuffer<T> input(inputs);
+    DeviceBuffer<T> output(inputs.size());
+    output.fill(0xFF);
+    const void* inputBuffers[] = {input.get()};
+    void* outputBuffers[] = {output.get()};
+    EXPECT_EQ(plugin.enqueue(batchSize, inputBuffers, outputBuffers, nullptr, 0), 0);
+    return output.download();
+}
+
+static void testFloat(std::mt19937& generator) {
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float threshold = Mish::LINEAR_THRESHOLD;
+    // Not a multiple of the threads per block
+    std::vector<float> inputs = randomFloats(generator, 3 * 100003 - 20, -150.0f, threshold);
+    for (float x : {threshold, nextafterf(threshold, infinity), nextafterf(threshold, 0.0f), -threshold, nextafterf(-threshold, -infinity),
+                    -150.0f, nextafterf(-150.0f, -infinity), 0.0f, -0.0f, 1e-30f, -1e-30f, infinity, -infinity,
+                    std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::quiet_NaN(),
+                    std::numeric_limits<float>::denorm_min(), -std::numeric_limits<float>::denorm_min(), -87.5f, 0.5f}) {
+        inputs.push_back(x);
+    }
+
+    std::vector<float> expected(inputs.size());
+    mishReference(inputs.data(), expected.data(), inputs.size());
+    std::vector<float> outputs = runPlugin(inputs, 3, DataType::kFLOAT);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        // NaNs only need to stay NaN, the GPU has its own canonical NaN
+        bool same = std::isnan(expected[i]) ? std::isnan(outputs[i]) : sameBits(&outputs[i], &expected[i], 1);
+        if (!same) {
+            if (mismatches++ < 10) {
+                std::cout << "[Error] mish(" << inputs[i] << ") " << outputs[i] << " vs " << expected[i] << std::endl;
+            }
+        }
+    }
+    EXPECT_EQ(mismatches, 0u);
+}
+
+static void testHalf() {
+    std::vector<uint16_t> inputs(0x10000);
+    for (uint32_t bits = 0; bits < 0x10000; ++bits) {
+        inputs[bits] = static_cast<uint16_t>(bits);
+    }
+    std::vector<uint16_t> expected(inputs.size());
+    mishReference(inputs.data(), expected.data(), inputs.size());
+    std::vector<uint16_t> outputs = runPlugin(inputs, 1, DataType::kHALF);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        bool nan = (inputs[i] & 0x7C00) == 0x7C00 && (inputs[i] & 0x03FF);
+        if (nan ? (outputs[i] & 0x7C00) != 0x7C00 || !(outputs[i] & 0x03FF) : outputs[i] != expected[i]) {
+            mismatches++;
+        }
+    }
+    EXPECT_EQ(mismatches, 0u);
+}
+
+int main() {
+    std::mt19937 generator(11);
+    testFloat(generator);
+    testHalf();
+    return testResult("mish_gpu_test");
+}
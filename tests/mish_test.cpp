@@ -0,0 +1,138 @@
+#include "layers/mish.h"
+
+#include "testing.h"
+
+#include <cmath>
+#include <limits>
+
+// mishReference() (the polynomial Mish::exp()) against x * tanh(log1p(exp(x)))
+// of the C library, in double and in float, on random inputs, at the
+// thresholds of Mish::mish() and on NaN and infinities, FP32 and FP16.
+
+static float mishDouble(float x) {
+    double value = x;
+    return static_cast<float>(value * std::tanh(std::log1p(std::exp(value))));
+}
+
+static float mishFloat(float x) {
+    return x * tanhf(log1pf(expf(x)));
+}
+
+static float mish(float x) {
+    float result;
+    mishReference(&x, &result, 1);
+    return result;
+}
+
+static uint16_t mish(uint16_t x) {
+    uint16_t result;
+    mishReference(&x, &result, 1);
+    return result;
+}
+
+static bool negativeZero(float value) {
+    return value == 0.0f && std::signbit(value);
+}
+
+// Inputs over [-150, 20] and of small magnitude, where the result is
+// dominated by rounding of x * n / (n + 2)
+static std::vector<float> mishInputs(std::mt19937& generator) {
+    std::vector<float> inputs = randomFloats(generator, 1 << 20, -150.0f, Mish::LINEAR_THRESHOLD);
+    for (float exponent : randomFloats(generator, 1 << 18, -40.0f, 4.0f)) {
+        inputs.push_back(std::exp2(exponent));
+        inputs.push_back(-std::exp2(exponent));
+    }
+    return inputs;
+}
+
+static void testUlpBound(std::mt19937& generator) {
+    std::vector<float> inputs = mishInputs(generator);
+    std::vector<float> outputs(inputs.size());
+    mishReference(inputs.data(), outputs.data(), inputs.size());
+    int64_t worstDouble = 0;
+    int64_t worstFloat = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        worstDouble = std::max(worstDouble, ulpDistance(outputs[i], mishDouble(inputs[i])));
+        // Below -87 expf() is subnormal and the float formula loses the
+        // precision itself
+        if (inputs[i] >= -87.0f) {
+            worstFloat = std::max(worstFloat, ulpDistance(outputs[i], mishFloat(inputs[i])));
+        }
+    }
+    std::cout << "[Info] mish ulp distance to double " << worstDouble << ", to float " << worstFloat << std::endl;
+    EXPECT(worstDouble <= 4);
+    EXPECT(worstFloat <= 8);
+}
+
+static void testThresholds() {
+    const float threshold = Mish::LINEAR_THRESHOLD;
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    // Above the linear threshold the result is x, at and below it the formula
+    for (float x : {nextafterf(threshold, infinity), 20.5f, 1e10f, std::numeric_limits<float>::max()}) {
+        EXPECT_EQ(mish(x), x);
+    }
+    for (float x : {threshold, nextafterf(threshold, 0.0f)}) {
+        EXPECT(ulpDistance(mish(x), mishDouble(x)) <= 4);
+    }
+
+    // Both sides of -20, where n / (n + 2) is replaced by e^x
+    for (float x : {-threshold, nextafterf(-threshold, 0.0f), nextafterf(-threshold, -infinity)}) {
+        EXPECT(ulpDistance(mish(x), mishDouble(x)) <= 4);
+    }
+
+    // Both sides of -150, below it the result is -0
+    for (float x : {-150.0f, nextafterf(-150.0f, 0.0f), -103.0f, -104.0f}) {
+        EXPECT(ulpDistance(mish(x), mishDouble(x)) <= 4);
+    }
+    for (float x : {nextafterf(-150.0f, -infinity), -1000.0f, std::numeric_limits<float>::lowest()}) {
+        EXPECT(negativeZero(mish(x)));
+    }
+
+    EXPECT(negativeZero(mish(-0.0f)));
+    EXPECT_EQ(mish(0.0f), 0.0f);
+}
+
+static void testSpecialValues() {
+    const float infinity = std::numeric_limits<float>::infinity();
+    EXPECT(std::isnan(mish(std::numeric_limits<float>::quiet_NaN())));
+    EXPECT(std::isnan(mish(-std::numeric_limits<float>::quiet_NaN())));
+    EXPECT_EQ(mish(infinity), infinity);
+    EXPECT(negativeZero(mish(-infinity)));
+
+    EXPECT_EQ(mish(static_cast<uint16_t>(0x7C00)), 0x7C00);   // +inf
+    EXPECT_EQ(mish(static_cast<uint16_t>(0xFC00)), 0x8000);   // -inf to -0
+    EXPECT_EQ(mish(static_cast<uint16_t>(0x7E00)) & 0x7E00, 0x7E00);  // NaN
+}
+
+// Distance of two halves in units in the last place
+static int halfUlpDistance(uint16_t a, uint16_t b) {
+    auto ordered = [](uint16_t h) { return h & 0x8000 ? -(h & 0x7FFF) : static_cast<int>(h); };
+    return std::abs(ordered(a) - ordered(b));
+}
+
+// Every finite half is at most 1 ulp from the correctly rounded result and
+// exactly the FP32 result rounded to half
+static void testHalf() {
+    int worst = 0;
+    for (uint32_t bits = 0; bits < 0x10000; ++bits) {
+        uint16_t input = static_cast<uint16_t>(bits);
+        float x = halfToFloat(input);
+        if (!std::isfinite(x)) {
+            continue;
+        }
+        uint16_t output = mish(input);
+        EXPECT_EQ(output, floatToHalf(mish(x)));
+        worst = std::max(worst, halfUlpDistance(output, floatToHalf(mishDouble(x))));
+    }
+    EXPECT(worst <= 1);
+}
+
+int main() {
+    std::mt19937 generator(11);
+    testUlpBound(generator);
+    testThresholds();
+    testSpecialValues();
+    testHalf();
+    return testResult("mish_test");
+}
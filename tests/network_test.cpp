@@ -0,0 +1,172 @@
+#include "networks.h"
+
+#include "testing.h"
+
+// Graphs of the hand-written networks recorded with RecordingNetwork on
+// synthetic weights: layer counts, shapes of the convolutions and yolo
+// layers, the detections output, and that every weight blob and every layer
+// output is used.
+
+struct ExpectedGraph {
+    const char* network;
+    NetworkDefine define;
+    int layers;
+    std::vector<int> yoloStrides;  // in the order of the yolo layers
+};
+
+static int yoloLayerCount(const RecordingNetwork& network) {
+    int count = 0;
+    for (int i = 0; i < network.getNbLayers(); ++i) {
+        count += network.getLayer(i)->pluginType == "YoloLayer_TRT";
+    }
+    return count;
+}
+
+static int countLayers(const RecordingNetwork& network, LayerType type) {
+    int count = 0;
+    for (int i = 0; i < network.getNbLayers(); ++i) {
+        count += network.getLayer(i)->type == type;
+    }
+    return count;
+}
+
+// Every tensor a layer outputs feeds another layer or is a network output
+static int unusedOutputs(const RecordingNetwork& network) {
+    std::set<const RecordedTensor*> consumed;
+    for (int i = 0; i < network.getNbLayers(); ++i) {
+        for (auto input : network.getLayer(i)->inputs) {
+            consumed.insert(input);
+        }
+    }
+    int unused = 0;
+    for (int i = 0; i < network.getNbLayers(); ++i) {
+        for (auto output : network.getLayer(i)->outputs) {
+            if (!output->output && !consumed.count(output)) {
+                std::cout << "[Error] Output of layer " << i << " " << layerTypeName(network.getLayer(i)->type) << " is not used" << std::endl;
+                unused++;
+            }
+        }
+    }
+    return unused;
+}
+
+// Kernel and bias counts of the convolutions match their input and output channels
+static int badConvolutions(const RecordingNetwork& network) {
+    int bad = 0;
+    for (int i = 0; i < network.getNbLayers(); ++i) {
+        const RecordedLayer* layer = network.getLayer(i);
+        if (layer->type != LayerType::kCONVOLUTION) {
+            continue;
+        }
+        Dims in = layer->inputs[0]->dims;
+        Dims out = layer->outputs[0]->dims;
+        int64_t kernel = static_cast<int64_t>(layer->outputMaps) * (in.d[in.nbDims - 3] / layer->groups) * layer->window.d[0] * layer->window.d[1];
+        bool ok = out.d[out.nbDims - 3] == layer->outputMaps && layer->weights[0].count == kernel &&
+                  (layer->weights[1].count == 0 || layer->weights[1].count == layer->outputMaps);
+        bad += !ok;
+    }
+    return bad;
+}
+
+static void testGraph(const ExpectedGraph& expected, int inputH, int inputW) {
+    BuildOptions options;
+    options.classes = 80;
+    options.inputH = inputH;
+    options.inputW = inputW;
+    std::unique_ptr<RecordedBuild> build = recordNetwork(expected.define, expected.network, options);
+    const RecordingNetwork& network = build->network;
+
+    EXPECT_EQ(network.getNbLayers(), expected.layers);
+    EXPECT(build->weightMap.unused().empty());
+    EXPECT_EQ(unusedOutputs(network), 0);
+    EXPECT_EQ(badConvolutions(network), 0);
+
+    EXPECT_EQ(network.getNbInputs(), 1);
+    Dims input = network.getInput(0)->dims;
+    EXPECT(input.nbDims == 3 && input.d[0] == 3 && input.d[1] == inputH && input.d[2] == inputW);
+
+    // The yolo layers see 3 anchors x (5 + 80) channels at their stride
+    std::vector<const RecordedLayer*> yolos;
+    for (int i = 0; i < network.getNbLayers(); ++i) {
+        if (network.getLayer(i)->pluginType == "YoloLayer_TRT") {
+            yolos.push_back(network.getLayer(i));
+        }
+    }
+    EXPECT_EQ(yolos.size(), expected.yoloStrides.size());
+    int detections = 0;
+    for (size_t i = 0; i < yolos.size() && i < expected.yoloStrides.size(); ++i) {
+        int stride = expected.yoloStrides[i];
+        Dims in = yolos[i]->inputs[0]->dims;
+        EXPECT(in.nbDims == 3 && in.d[0] == 255 && in.d[1] == inputH / stride && in.d[2] == inputW / stride);
+        EXPECT_EQ(yolos[i]->pluginField("numAnchors"), 3.0);
+        detections += (inputH / stride) * (inputW / stride) * 3;
+    }
+
+    // One output, the concatenation of the detections of every yolo layer
+    EXPECT_EQ(network.getNbOutputs(), 1);
+    const RecordedTensor* output = network.getOutput(0);
+    EXPECT(output->name == "detections");
+    EXPECT(output->dims.nbDims == 3 && output->dims.d[0] == detections * RECORDED_YOLO_DETECTION_SIZE);
+    const RecordedLayer* concat = output->producer;
+    EXPECT(concat->type == LayerType::kCONCATENATION);
+    EXPECT_EQ(concat->inputs.size(), yolos.size());
+    for (size_t i = 0; i < concat->inputs.size() && i < yolos.size(); ++i) {
+        EXPECT(concat->inputs[i]->producer == yolos[i]);
+    }
+}
+
+static void testFusedGraph() {
+    BuildOptions options;
+    options.classes = 80;
+    options.foldBatchNorm = true;
+    options.mishPlugin = true;
+    options.upsample = UpsampleMode::kDECONVOLUTION;
+    std::unique_ptr<RecordedBuild> build = recordNetwork(yolov4::defineNetwork<RecordingNetwork>, "yolov4", options);
+    const RecordingNetwork& network = build->network;
+
+    // Every conv, batch norm, mish triple is one convolution and one plugin
+    EXPECT_EQ(network.getNbLayers(), 259);
+    EXPECT_EQ(countLayers(network, LayerType::kSCALE), 0);
+    EXPECT_EQ(countLayers(network, LayerType::kRESIZE), 0);
+    EXPECT_EQ(countLayers(network, LayerType::kDECONVOLUTION), 2);
+    EXPECT(build->weightMap.unused().empty());
+    EXPECT_EQ(unusedOutputs(network), 0);
+    EXPECT_EQ(badConvolutions(network), 0);
+    EXPECT_EQ(network.getOutput(0)->dims.d[0], 159201);
+}
+
+static void testExplicitBatchGraph() {
+    BuildOptions options;
+    options.classes = 80;
+    options.explicitBatch = true;
+    options.batch = {1, 4, 8};
+    options.height = {320, 416, 608};
+    options.width = {320, 416, 608};
+    std::unique_ptr<RecordedBuild> build = recordNetwork(yolov4tiny::defineNetwork<RecordingNetwork>, "yolov4tiny", options);
+    const RecordingNetwork& network = build->network;
+
+    // The dynamic dimensions stay -1 through the whole graph
+    EXPECT(!network.hasImplicitBatchDimension());
+    Dims input = network.getInput(0)->dims;
+    EXPECT(input.nbDims == 4 && input.d[0] == -1 && input.d[1] == 3 && input.d[2] == -1 && input.d[3] == -1);
+    Dims output = network.getOutput(0)->dims;
+    EXPECT(output.nbDims == 4 && output.d[0] == -1 && output.d[1] == -1);
+    EXPECT_EQ(yoloLayerCount(network), 2);
+    EXPECT(build->weightMap.unused().empty());
+    EXPECT_EQ(unusedOutputs(network), 0);
+}
+
+int main() {
+    const ExpectedGraph yolov4Graph{"yolov4", yolov4::defineNetwork<RecordingNetwork>, 510, {8, 16, 32}};
+    const ExpectedGraph tinyGraph{"yolov4tiny", yolov4tiny::defineNetwork<RecordingNetwork>, 76, {32, 16}};
+    const ExpectedGraph tiny3lGraph{"yolov4tiny3l", yolov4tiny3l::defineNetwork<RecordingNetwork>, 86, {32, 16, 8}};
+
+    testGraph(yolov4Graph, 608, 608);
+    testGraph(yolov4Graph, 320, 256);
+    testGraph(tinyGraph, 416, 416);
+    testGraph(tiny3lGraph, 416, 416);
+    testGraph(tiny3lGraph, 320, 256);
+    testFusedGraph();
+    testExplicitBatchGraph();
+    return testResult("network_test");
+}
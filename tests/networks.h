@@ -0,0 +1,98 @@
+#ifndef __TRT_TESTS_NETWORKS_H_
+#define __TRT_TESTS_NETWORKS_H_
+
+#include "networks/darknet.h"
+#include "networks/yolov4.h"
+#include "networks/yolov4tiny.h"
+#include "networks/yolov4tiny3l.h"
+
+#include "utils/darknet.h"
+#include "utils/recordingnetwork.h"
+
+#include <fstream>
+#include <memory>
+#include <random>
+#include <set>
+
+// Recording the graphs of the networks on synthetic weights, for the tests
+// that need a whole network. NETWORK_CFG_DIR is the networks/ directory with
+// the .cfg of every hand-written network.
+
+// Writes a Darknet .weights file with random values for every convolution of
+// the config, like hostbench. Batch norm variances are kept positive.
+static void writeSyntheticDarknet(const std::vector<DarknetSection>& sections, const std::string& file, unsigned seed) {
+    std::ofstream output(file, std::ios::binary);
+    int32_t version[3] = {0, 2, 5};
+    uint64_t seen = 0;
+    output.write(reinterpret_cast<const char*>(version), sizeof(version));
+    output.write(reinterpret_cast<const char*>(&seen), sizeof(seen));
+
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> normal(0.0f, 0.05f);
+    std::uniform_real_distribution<float> positive(0.5f, 1.5f);
+    auto write = [&](int64_t count, bool variance) {
+        std::vector<float> values(count);
+        for (auto& value : values) {
+            value = variance ? positive(generator) : normal(generator);
+        }
+        output.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+    };
+
+    std::vector<int> channels = darknetChannels(sections);
+    for (size_t i = 1; i < sections.size(); ++i) {
+        const DarknetSection& section = sections[i];
+        if (section.type != "convolutional") {
+            continue;
+        }
+        int layer = i - 1;
+        int inputChannels = layer == 0 ? sections.front().getInt("channels", 3) : channels[layer - 1];
+        int filters = section.getInt("filters", 1);
+        int kernel = section.getInt("size", 1);
+        if (section.getInt("batch_normalize", 0)) {
+            write(filters, false);
+            write(filters, false);
+            write(filters, false);
+            write(filters, true);
+        }
+        else {
+            write(filters, false);
+        }
+        write(static_cast<int64_t>(filters) * (inputChannels / section.getInt("groups", 1)) * kernel * kernel, false);
+    }
+}
+
+// <network>.weights with a copy of networks/<network>.cfg next to it in the
+// working directory, written once per test run
+static std::string syntheticWeights(const std::string& network) {
+    static std::set<std::string> written;
+    std::string weights = network + ".weights";
+    if (written.insert(network).second) {
+        std::string cfg = std::string(NETWORK_CFG_DIR) + "/" + network + ".cfg";
+        std::ofstream(darknetCfgFor(weights)) << std::ifstream(cfg).rdbuf();
+        writeSyntheticDarknet(parseDarknetCfg(cfg), weights, 1);
+    }
+    return weights;
+}
+
+// Graph of one build with the weights it was defined from
+struct RecordedBuild {
+    WeightArena arena;
+    WeightMap weightMap{arena};
+    RecordingNetwork network;
+
+    explicit RecordedBuild(const BuildOptions& options) : network(networkCreationFlags(options)) {}
+};
+
+using NetworkDefine = void (*)(RecordingNetwork*, WeightMap&, const BuildOptions&, DataType, unsigned int);
+
+// Records the network defined by define on the synthetic weights of the cfg
+// network, at a maximum batch size of 1
+static std::unique_ptr<RecordedBuild> recordNetwork(NetworkDefine define, const std::string& network, BuildOptions options) {
+    options.weights = syntheticWeights(network);
+    std::unique_ptr<RecordedBuild> build(new RecordedBuild(options));
+    build->weightMap.load(options.weights, options.cfg);
+    define(&build->network, build->weightMap, options, DataType::kFLOAT, 1);
+    return build;
+}
+
+#endif
@@ -0,0 +1,186 @@
+#include "layers/nmslayer.h"
+#include "layers/yololayer.h"
+
+#include "gpu_testing.h"
+
+// The BatchedNms kernel of YoloNms_TRT against nmsReference(), bit for bit:
+// numbers of detections and candidates that are not powers of two, so that
+// the bitonic sort is padded, ties in score, counts of valid detections per
+// image given as input, among them those of filtering yolo layers, and
+// top_k up to Nms::MAX_TOP_K. Needs a GPU, built with WITH_GPU_TESTS.
+
+using namespace nvinfer1;
+using Yolo::Detection;
+
+struct NmsParams {
+    float scoreThreshold;
+    float iouThreshold;
+    int topK;
+    int maxOutputs;
+};
+
+struct NmsOutput {
+    std::vector<int> kept;
+    std::vector<float> boxes;
+    std::vector<float> scores;
+    std::vector<float> classes;
+};
+
+// Random detections, scores from a few levels with ties if tied is set
+static std::vector<Detection> randomDetections(std::mt19937& generator, size_t count, int classes, bool tied) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::uniform_int_distribution<int> classIds(0, classes - 1);
+    std::vector<Detection> detections(count);
+    for (auto& det : detections) {
+        det.bbox[0] = uniform(generator) * 0.8f;
+        det.bbox[1] = uniform(generator) * 0.8f;
+        det.bbox[2] = 0.05f + uniform(generator) * 0.2f;
+        det.bbox[3] = 0.05f + uniform(generator) * 0.2f;
+        det.det_confidence = tied ? 0.25f * (1 + generator() % 4) : uniform(generator);
+        det.class_confidence = tied ? 0.5f : uniform(generator);
+        det.class_id = classIds(generator);
+    }
+    return detections;
+}
+
+// Runs the plugin on batch images of rows detections each, the first
+// counts[image] of them valid if counts is not empty
+static NmsOutput runPlugin(const float* detections, int batch, int rows, const int* counts, const NmsParams& params) {
+    const int detectionFloats = sizeof(Detection) / sizeof(float);
+    YoloNmsPlugin plugin(params.scoreThreshold, params.iouThreshold, params.topK, params.maxOutputs);
+    PluginTensorDesc desc[2] = {};
+    desc[0].dims.nbDims = 3;
+    desc[0].dims.d[0] = rows * detectionFloats;
+    desc[0].dims.d[1] = 1;
+    desc[0].dims.d[2] = 1;
+    plugin.configurePlugin(desc, counts ? 2 : 1, desc, 4);
+
+    DeviceBuffer<float> input(std::vector<float>(detections, detections + static_cast<size_t>(batch) * rows * detectionFloats));
+    DeviceBuffer<int> inputCounts(counts ? std::vector<int>(counts, counts + batch) : std::vector<int>(1));
+    DeviceBuffer<char> workspace(plugin.getWorkspaceSize(batch));
+    DeviceBuffer<int> kept(batch);
+    DeviceBuffer<float> boxes(static_cast<size_t>(batch) * params.maxOutputs * 4);
+    DeviceBuffer<float> scores(static_cast<size_t>(batch) * params.maxOutputs);
+    DeviceBuffer<float> classes(static_cast<size_t>(batch) * params.maxOutputs);
+    for (DeviceBuffer<float>* output : {&boxes, &scores, &classes}) {
+        output->fill(0xFF);
+    }
+    kept.fill(0xFF);
+    workspace.fill(0xFF);
+
+    const void* inputs[] = {input.get(), inputCounts.get()};
+    void* outputs[] = {kept.get(), boxes.get(), scores.get(), classes.get()};
+    EXPECT_EQ(plugin.enqueue(batch, inputs, outputs, workspace.get(), 0), 0);
+    return NmsOutput{kept.download(), boxes.download(), scores.download(), classes.download()};
+}
+
+// Every image of the plugin output against nmsReference() on its valid detections
+static void expectReference(const std::vector<Detection>& detections, int batch, int rows, const std::vector<int>& counts,
+                            const NmsParams& params, const char* what) {
+    NmsOutput output = runPlugin(reinterpret_cast<const float*>(detections.data()), batch, rows, counts.empty() ? nullptr : counts.data(), params);
+    for (int image = 0; image < batch; ++image) {
+        int count = counts.empty() ? rows : std::min(counts[image], rows);
+        std::vector<float> boxes(params.maxOutputs * 4), scores(params.maxOutputs), classes(params.maxOutputs);
+        int kept = Nms::nmsReference(detections.data() + static_cast<size_t>(image) * rows, count, params.scoreThreshold, params.iouThreshold,
+                                     params.topK, params.maxOutputs, boxes.data(), scores.data(), classes.data());
+        bool same = output.kept[image] == kept &&
+                    sameBits(output.boxes.data() + static_cast<size_t>(image) * params.maxOutputs * 4, boxes.data(), boxes.size()) &&
+                    sameBits(output.scores.data() + static_cast<size_t>(image) * params.maxOutputs, scores.data(), scores.size()) &&
+                    sameBits(output.classes.data() + static_cast<size_t>(image) * params.maxOutputs, classes.data(), classes.size());
+        if (!same) {
+            std::cout << "[Error] " << what << ", image " << image << ": " << output.kept[image] << " kept vs " << kept << std::endl;
+            testFailures++;
+        }
+    }
+}
+
+// Numbers of detections and of candidates around powers of two, the sort
+// pads them to the next one
+static void testPadding(std::mt19937& generator) {
+    for (int rows : {1, 2, 3, 31, 33, 255, 257, 1000, 1024, 1025, 2049}) {
+        std::vector<Detection> detections = randomDetections(generator, 3 * static_cast<size_t>(rows), 5, false);
+        for (float scoreThreshold : {0.0f, 0.3f, 0.9f}) {
+            expectReference(detections, 3, rows, {}, NmsParams{scoreThreshold, 0.45f, 1000, 100}, "padding");
+        }
+    }
+    // No detection at all passes
+    std::vector<Detection> detections = randomDetections(generator, 2 * 100, 5, false);
+    expectReference(detections, 2, 100, {}, NmsParams{1.5f, 0.45f, 1000, 100}, "no candidates");
+}
+
+// Equal scores rank by class and box on the device as well
+static void testTies(std::mt19937& generator) {
+    std::vector<Detection> detections = randomDetections(generator, 2 * 3000, 3, true);
+    expectReference(detections, 2, 3000, {}, NmsParams{0.1f, 0.5f, 2000, 300}, "ties");
+    // Identical detections
+    for (int i = 1; i < 3000; i += 2) {
+        detections[i] = detections[i - 1];
+    }
+    expectReference(detections, 2, 3000, {}, NmsParams{0.1f, 0.5f, 2000, 300}, "identical detections");
+}
+
+// Only the first counts[image] detections count, also counts of zero and
+// counts beyond the rows, which the kernel takes as rows
+static void testCounts(std::mt19937& generator) {
+    const int rows = 1024;
+    std::vector<Detection> detections = randomDetections(generator, 5 * static_cast<size_t>(rows), 4, false);
+    expectReference(detections, 5, rows, {0, 1, 700, rows, 2 * rows}, NmsParams{0.2f, 0.45f, 1000, 100}, "counts");
+}
+
+// top_k near and at Nms::MAX_TOP_K with more candidates than that
+static void testTopK(std::mt19937& generator) {
+    const int rows = 5000;
+    std::vector<Detection> detections = randomDetections(generator, 2 * static_cast<size_t>(rows), 8, false);
+    for (int topK : {Nms::MAX_TOP_K - 1, Nms::MAX_TOP_K}) {
+        expectReference(detections, 2, rows, {}, NmsParams{0.0f, 0.45f, topK, 300}, "top_k");
+        expectReference(detections, 2, rows, {}, NmsParams{0.0f, 0.45f, topK, topK}, "top_k outputs");
+    }
+}
+
+// The detections and counts of two chained filtering yolo layers as input,
+// as in an engine with both
+static void testFilteredInput(std::mt19937& generator) {
+    const int batch = 2;
+    const int maxDetections = 1024;
+    const int classes = 80;
+    static float anchors[] = {10, 14, 23, 27, 37, 58};
+    std::vector<float> first = randomFloats(generator, static_cast<size_t>(batch) * 3 * (5 + classes) * 13 * 13, -3.0f, 2.0f);
+    std::vector<float> second = randomFloats(generator, static_cast<size_t>(batch) * 3 * (5 + classes) * 26 * 26, -3.0f, 2.0f);
+
+    DeviceBuffer<float> firstInput(first);
+    DeviceBuffer<float> secondInput(second);
+    DeviceBuffer<float> firstDetections(static_cast<size_t>(batch) * maxDetections * 7);
+    DeviceBuffer<int> firstCounts(batch);
+    DeviceBuffer<float> detections(static_cast<size_t>(batch) * maxDetections * 7);
+    DeviceBuffer<int> counts(batch);
+    YoloLayerPlugin firstPlugin(13, 13, 3, anchors, classes, 416, 416, 1.05f, 0, 0.25f, maxDetections);
+    YoloLayerPlugin secondPlugin(26, 26, 3, anchors, classes, 416, 416, 1.05f, 0, 0.25f, maxDetections);
+    PluginTensorDesc desc[5] = {};
+    firstPlugin.configurePlugin(desc, 1, desc, 2);
+    secondPlugin.configurePlugin(desc, 3, desc, 2);
+    const void* firstInputs[] = {firstInput.get()};
+    void* firstOutputs[] = {firstDetections.get(), firstCounts.get()};
+    EXPECT_EQ(firstPlugin.enqueue(batch, firstInputs, firstOutputs, nullptr, 0), 0);
+    const void* secondInputs[] = {secondInput.get(), firstDetections.get(), firstCounts.get()};
+    void* secondOutputs[] = {detections.get(), counts.get()};
+    EXPECT_EQ(secondPlugin.enqueue(batch, secondInputs, secondOutputs, nullptr, 0), 0);
+
+    std::vector<float> values = detections.download();
+    std::vector<Detection> filtered(static_cast<size_t>(batch) * maxDetections);
+    memcpy(filtered.data(), values.data(), values.size() * sizeof(float));
+    std::vector<int> filteredCounts = counts.download();
+    EXPECT(filteredCounts[0] > 0 && filteredCounts[1] > 0);
+    expectReference(filtered, batch, maxDetections, filteredCounts, NmsParams{0.25f, 0.45f, 1000, 100}, "filtered yolo output");
+    firstPlugin.terminate();
+    secondPlugin.terminate();
+}
+
+int main() {
+    std::mt19937 generator(25);
+    testPadding(generator);
+    testTies(generator);
+    testCounts(generator);
+    testTopK(generator);
+    testFilteredInput(generator);
+    return testResult("nms_gpu_test");
+}
@@ -0,0 +1,226 @@
+#include "layers/nms.h"
+
+#include "testing.h"
+
+#include <algorithm>
+#include <cmath>
+
+// nmsReference(), the host reference of YoloNms_TRT, on hand-made detections:
+// empty input, the score and IoU threshold boundaries, ties in score, per
+// class suppression and truncation at topK and maxOutputs; then on random
+// detections against a plain greedy NMS and for shuffled input orders.
+
+using Yolo::Detection;
+
+static Detection detection(float x, float y, float w, float h, float confidence, float classConfidence, int classId) {
+    Detection det;
+    det.bbox[0] = x;
+    det.bbox[1] = y;
+    det.bbox[2] = w;
+    det.bbox[3] = h;
+    det.det_confidence = confidence;
+    det.class_confidence = classConfidence;
+    det.class_id = classId;
+    return det;
+}
+
+struct NmsOutput {
+    int kept = 0;
+    std::vector<float> boxes;
+    std::vector<float> scores;
+    std::vector<float> classes;
+
+    bool operator==(const NmsOutput& other) const {
+        return kept == other.kept && sameBits(boxes.data(), other.boxes.data(), boxes.size()) &&
+               sameBits(scores.data(), other.scores.data(), scores.size()) && sameBits(classes.data(), other.classes.data(), classes.size());
+    }
+};
+
+// The outputs are filled with a pattern first to see that every slot is written
+static NmsOutput runNms(const std::vector<Detection>& detections, float scoreThreshold, float iouThreshold, int topK, int maxOutputs) {
+    NmsOutput output;
+    output.boxes.assign(maxOutputs * 4, 12345.0f);
+    output.scores.assign(maxOutputs, 12345.0f);
+    output.classes.assign(maxOutputs, 12345.0f);
+    output.kept = Nms::nmsReference(detections.data(), static_cast<int>(detections.size()), scoreThreshold, iouThreshold, topK, maxOutputs,
+                                    output.boxes.data(), output.scores.data(), output.classes.data());
+    return output;
+}
+
+// Slots past the kept detections are zero with class -1
+static bool cleared(const NmsOutput& output) {
+    for (size_t i = output.kept; i < output.scores.size(); ++i) {
+        if (output.scores[i] != 0.0f || output.classes[i] != -1.0f ||
+            std::any_of(output.boxes.begin() + 4 * i, output.boxes.begin() + 4 * i + 4, [](float value) { return value != 0.0f; })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testEmpty() {
+    NmsOutput none = runNms({}, 0.25f, 0.5f, 100, 10);
+    EXPECT_EQ(none.kept, 0);
+    EXPECT(cleared(none));
+
+    // Nothing at the score threshold is as good as nothing
+    NmsOutput below = runNms({detection(0.1f, 0.1f, 0.2f, 0.2f, 0.5f, 0.4f, 0)}, 0.25f, 0.5f, 100, 10);
+    EXPECT_EQ(below.kept, 0);
+    EXPECT(cleared(below));
+    EXPECT_EQ(runNms({detection(0.1f, 0.1f, 0.2f, 0.2f, 0.5f, 0.5f, 0)}, 0.25f, 0.5f, 0, 10).kept, 0);
+}
+
+// Scores at the threshold are candidates, overlaps at the IoU threshold are not suppressed
+static void testThresholds() {
+    std::vector<Detection> detections = {detection(0.1f, 0.1f, 0.2f, 0.2f, 0.5f, 0.5f, 0),
+                                         detection(0.5f, 0.5f, 0.2f, 0.2f, 0.5f, std::nextafter(0.5f, 0.0f), 0)};
+    NmsOutput output = runNms(detections, 0.25f, 0.5f, 100, 10);
+    EXPECT_EQ(output.kept, 1);
+    EXPECT_EQ(output.scores[0], 0.25f);
+
+    // Intersection 0.5 and union 1, an IoU of exactly 0.5
+    std::vector<Detection> halves = {detection(0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.75f, 2),
+                                     detection(0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 0.5f, 2)};
+    EXPECT_EQ(runNms(halves, 0.1f, 0.5f, 100, 10).kept, 2);
+    EXPECT_EQ(runNms(halves, 0.1f, std::nextafter(0.5f, 0.0f), 100, 10).kept, 1);
+}
+
+// Equal scores rank by class, then box, whatever the input order
+static void testTies() {
+    std::vector<Detection> detections = {detection(0.6f, 0.1f, 0.1f, 0.1f, 0.8f, 0.5f, 1),
+                                         detection(0.3f, 0.1f, 0.1f, 0.1f, 0.8f, 0.5f, 1),
+                                         detection(0.1f, 0.6f, 0.1f, 0.1f, 0.8f, 0.5f, 0),
+                                         detection(0.1f, 0.3f, 0.1f, 0.1f, 0.5f, 0.8f, 1)};
+    NmsOutput output = runNms(detections, 0.1f, 0.5f, 100, 10);
+    EXPECT_EQ(output.kept, 4);
+    EXPECT_EQ(output.classes[0], 0.0f);
+    EXPECT_EQ(output.classes[1], 1.0f);
+    // Class 1 by x, then y of the box
+    EXPECT_EQ(output.boxes[4 * 1], 0.1f);
+    EXPECT_EQ(output.boxes[4 * 2], 0.3f);
+    EXPECT_EQ(output.boxes[4 * 3], 0.6f);
+    EXPECT(cleared(output));
+
+    std::vector<Detection> reversed(detections.rbegin(), detections.rend());
+    EXPECT(runNms(reversed, 0.1f, 0.5f, 100, 10) == output);
+
+    // Of two identical detections one is kept
+    std::vector<Detection> twice = {detections[0], detections[0]};
+    EXPECT_EQ(runNms(twice, 0.1f, 0.5f, 100, 10).kept, 1);
+}
+
+// Only detections of the same class suppress each other, and only kept ones do
+static void testPerClass() {
+    std::vector<Detection> detections = {detection(0.10f, 0.1f, 0.2f, 0.2f, 1.0f, 0.9f, 0),
+                                         detection(0.10f, 0.1f, 0.2f, 0.2f, 1.0f, 0.8f, 1),
+                                         detection(0.14f, 0.1f, 0.2f, 0.2f, 1.0f, 0.7f, 0),
+                                         detection(0.22f, 0.1f, 0.2f, 0.2f, 1.0f, 0.6f, 0)};
+    // The second class 0 box overlaps the first and goes, the third overlaps
+    // only the second enough and stays
+    NmsOutput output = runNms(detections, 0.1f, 0.4f, 100, 10);
+    EXPECT_EQ(output.kept, 3);
+    EXPECT_EQ(output.scores[0], 0.9f);
+    EXPECT_EQ(output.classes[1], 1.0f);
+    EXPECT_EQ(output.boxes[4 * 1], 0.10f);
+    EXPECT_EQ(output.scores[2], 0.6f);
+
+    // As one class the box of class 1 goes as well
+    for (auto& det : detections) {
+        det.class_id = 3;
+    }
+    NmsOutput oneClass = runNms(detections, 0.1f, 0.4f, 100, 10);
+    EXPECT_EQ(oneClass.kept, 2);
+    EXPECT_EQ(oneClass.scores[1], 0.6f);
+}
+
+// topK limits the ranked candidates, suppressed ones included, maxOutputs the kept ones
+static void testTruncation() {
+    std::vector<Detection> detections;
+    for (int i = 0; i < 6; ++i) {
+        detections.push_back(detection(0.15f * i, 0.1f, 0.1f, 0.1f, 1.0f, 0.9f - 0.1f * i, 0));
+    }
+    detections.push_back(detection(0.0f, 0.1f, 0.1f, 0.1f, 1.0f, 0.85f, 0));  // suppressed by the first
+
+    EXPECT_EQ(runNms(detections, 0.1f, 0.5f, 100, 10).kept, 6);
+    NmsOutput top3 = runNms(detections, 0.1f, 0.5f, 3, 10);
+    EXPECT_EQ(top3.kept, 2);
+    EXPECT(cleared(top3));
+    EXPECT_EQ(runNms(detections, 0.1f, 0.5f, 4, 10).kept, 3);
+
+    NmsOutput max2 = runNms(detections, 0.1f, 0.5f, 100, 2);
+    EXPECT_EQ(max2.kept, 2);
+    EXPECT_EQ(max2.scores[0], detections[0].class_confidence);
+    EXPECT_EQ(max2.scores[1], detections[1].class_confidence);
+    EXPECT_EQ(runNms(detections, 0.1f, 0.5f, 100, 6).kept, 6);
+}
+
+// Greedy NMS as written in most clients, IoU with a division
+static std::vector<Detection> greedyNms(std::vector<Detection> detections, float scoreThreshold, float iouThreshold, int topK, int maxOutputs) {
+    auto score = [](const Detection& det) { return det.det_confidence * det.class_confidence; };
+    detections.erase(std::remove_if(detections.begin(), detections.end(), [&](const Detection& det) { return score(det) < scoreThreshold; }),
+                     detections.end());
+    std::stable_sort(detections.begin(), detections.end(), [&](const Detection& a, const Detection& b) { return score(a) > score(b); });
+    detections.resize(std::min(static_cast<int>(detections.size()), topK));
+    std::vector<Detection> kept;
+    std::vector<bool> suppressed(detections.size(), false);
+    for (size_t i = 0; i < detections.size() && static_cast<int>(kept.size()) < maxOutputs; ++i) {
+        if (suppressed[i]) {
+            continue;
+        }
+        const float* a = detections[i].bbox;
+        kept.push_back(detections[i]);
+        for (size_t j = i + 1; j < detections.size(); ++j) {
+            const float* b = detections[j].bbox;
+            float w = std::max(0.0f, std::min(a[0] + a[2], b[0] + b[2]) - std::max(a[0], b[0]));
+            float h = std::max(0.0f, std::min(a[1] + a[3], b[1] + b[3]) - std::max(a[1], b[1]));
+            float intersection = w * h;
+            if (detections[j].class_id == detections[i].class_id && intersection / (a[2] * a[3] + b[2] * b[3] - intersection) > iouThreshold) {
+                suppressed[j] = true;
+            }
+        }
+    }
+    return kept;
+}
+
+// Random detections without ties, where the rank order and the overlaps do
+// not depend on how they are computed
+static void testRandom(std::mt19937& generator) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for (int round = 0; round < 50; ++round) {
+        int count = std::uniform_int_distribution<int>(0, 2000)(generator);
+        int classes = std::uniform_int_distribution<int>(1, 5)(generator);
+        std::vector<Detection> detections;
+        for (int i = 0; i < count; ++i) {
+            detections.push_back(detection(uniform(generator) * 0.8f, uniform(generator) * 0.8f, 0.05f + uniform(generator) * 0.2f,
+                                           0.05f + uniform(generator) * 0.2f, uniform(generator), uniform(generator),
+                                           std::uniform_int_distribution<int>(0, classes - 1)(generator)));
+        }
+        float scoreThreshold = round % 4 ? uniform(generator) * 0.5f : 0.0f;
+        float iouThreshold = uniform(generator);
+        int topK = std::uniform_int_distribution<int>(1, Nms::MAX_TOP_K)(generator);
+        int maxOutputs = std::uniform_int_distribution<int>(1, std::min(topK, 300))(generator);
+
+        NmsOutput output = runNms(detections, scoreThreshold, iouThreshold, topK, maxOutputs);
+        std::vector<Detection> expected = greedyNms(detections, scoreThreshold, iouThreshold, topK, maxOutputs);
+        EXPECT_EQ(output.kept, static_cast<int>(expected.size()));
+        for (int i = 0; i < output.kept && i < static_cast<int>(expected.size()); ++i) {
+            EXPECT(sameBits(output.boxes.data() + 4 * i, expected[i].bbox, 4));
+            EXPECT_EQ(output.classes[i], expected[i].class_id);
+        }
+        EXPECT(cleared(output));
+
+        std::shuffle(detections.begin(), detections.end(), generator);
+        EXPECT(runNms(detections, scoreThreshold, iouThreshold, topK, maxOutputs) == output);
+    }
+}
+
+int main() {
+    std::mt19937 generator(25);
+    testEmpty();
+    testThresholds();
+    testTies();
+    testPerClass();
+    testTruncation();
+    testRandom(generator);
+    return testResult("nms_test");
+}
@@ -0,0 +1,112 @@
+#include "layers/maxpool.h"
+
+#include "testing.h"
+
+#include <cmath>
+#include <limits>
+
+// sppfReference(), the SPP block as cascaded 5x5 pools, against
+// maxPoolReference() with 9x9 and 13x13 windows, and maxPoolReference()
+// against a pool over an explicitly padded tensor like IPoolingLayer, on
+// random tensors smaller and larger than the windows.
+
+// Stride 1 max-pool over the input padded by window / 2 with -inf on every side
+static std::vector<float> paddedMaxPool(const std::vector<float>& input, int channels, int height, int width, int window) {
+    int radius = window / 2;
+    int paddedH = height + 2 * radius;
+    int paddedW = width + 2 * radius;
+    std::vector<float> padded(static_cast<size_t>(channels) * paddedH * paddedW, -std::numeric_limits<float>::infinity());
+    for (int c = 0; c < channels; ++c) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                padded[(static_cast<size_t>(c) * paddedH + y + radius) * paddedW + x + radius] = input[(static_cast<size_t>(c) * height + y) * width + x];
+            }
+        }
+    }
+    std::vector<float> output(input.size());
+    for (int c = 0; c < channels; ++c) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                float value = -std::numeric_limits<float>::infinity();
+                for (int wy = 0; wy < window; ++wy) {
+                    for (int wx = 0; wx < window; ++wx) {
+                        value = std::max(value, padded[(static_cast<size_t>(c) * paddedH + y + wy) * paddedW + x + wx]);
+                    }
+                }
+                output[(static_cast<size_t>(c) * height + y) * width + x] = value;
+            }
+        }
+    }
+    return output;
+}
+
+// Random values, all negative in every other channel so that a zero padding
+// would win at the borders, with repeated values for ties but no zeros
+static std::vector<float> randomTensor(std::mt19937& generator, int channels, int height, int width) {
+    std::vector<float> values = randomFloats(generator, static_cast<size_t>(channels) * height * width, -10.0f, 10.0f);
+    std::uniform_int_distribution<int> tie(0, 7);
+    size_t plane = static_cast<size_t>(height) * width;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if ((i / plane) % 2) {
+            values[i] = -std::fabs(values[i]) - 1.0f;
+        }
+        if (tie(generator) == 0) {
+            float rounded = std::round(values[i]);
+            values[i] = rounded == 0.0f ? 1.0f : rounded;
+        }
+    }
+    values[0] = -std::numeric_limits<float>::infinity();
+    return values;
+}
+
+static void testSppf(std::mt19937& generator, int channels, int height, int width) {
+    std::vector<float> input = randomTensor(generator, channels, height, width);
+    size_t count = input.size();
+
+    std::vector<float> pool5(count), pool9(count), pool13(count);
+    sppfReference(input.data(), pool5.data(), pool9.data(), pool13.data(), channels, height, width);
+
+    std::vector<float> direct(count);
+    int window = 5;
+    for (const std::vector<float>* cascaded : {&pool5, &pool9, &pool13}) {
+        maxPoolReference(input.data(), direct.data(), channels, height, width, window);
+        EXPECT(sameBits(cascaded->data(), direct.data(), count));
+
+        // Clipping the window is padding with -inf
+        std::vector<float> padded = paddedMaxPool(input, channels, height, width, window);
+        EXPECT(sameBits(padded.data(), direct.data(), count));
+        window += 4;
+    }
+}
+
+// +0 and -0 compare equal, which of them a window of both gives depends on
+// the order the values are visited, only the values are the same
+static void testSignedZeros(std::mt19937& generator) {
+    const int height = 15;
+    const int width = 15;
+    std::vector<float> input(height * width);
+    std::uniform_int_distribution<int> pick(0, 2);
+    for (auto& value : input) {
+        int choice = pick(generator);
+        value = choice == 0 ? -0.0f : choice == 1 ? 0.0f : -1.0f;
+    }
+    std::vector<float> pool5(input.size()), pool9(input.size()), pool13(input.size()), direct(input.size());
+    sppfReference(input.data(), pool5.data(), pool9.data(), pool13.data(), 1, height, width);
+    maxPoolReference(input.data(), direct.data(), 1, height, width, 13);
+    EXPECT(std::equal(pool13.begin(), pool13.end(), direct.begin()));
+}
+
+int main() {
+    std::mt19937 generator(18);
+    // Smaller than every window, between the windows and like the SPP input
+    // of yolov4 at 608x608 and 416x416
+    testSppf(generator, 2, 1, 1);
+    testSppf(generator, 2, 3, 4);
+    testSppf(generator, 4, 7, 11);
+    testSppf(generator, 4, 12, 5);
+    testSppf(generator, 16, 19, 19);
+    testSppf(generator, 8, 13, 13);
+    testSppf(generator, 3, 40, 23);
+    testSignedZeros(generator);
+    return testResult("sppf_test");
+}
@@ -0,0 +1,70 @@
+#ifndef __TRT_TESTING_H_
+#define __TRT_TESTING_H_
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks of the CPU tests. A failed check is reported and counted, the test
+// goes on and testResult() makes main() return non-zero at the end.
+static int testFailures = 0;
+
+#define EXPECT(condition)                                                       \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            std::cout << "[Error] " << __FILE__ << ":" << __LINE__              \
+                      << ": " << #condition << std::endl;                       \
+            testFailures++;                                                     \
+        }                                                                       \
+    } while (0)
+
+#define EXPECT_EQ(a, b)                                                         \
+    do {                                                                        \
+        auto valueA = (a);                                                      \
+        auto valueB = (b);                                                      \
+        if (!(valueA == valueB)) {                                              \
+            std::cout << "[Error] " << __FILE__ << ":" << __LINE__              \
+                      << ": " << #a << " == " << #b << " (" << valueA           \
+                      << " vs " << valueB << ")" << std::endl;                  \
+            testFailures++;                                                     \
+        }                                                                       \
+    } while (0)
+
+static inline int testResult(const char* test) {
+    if (testFailures) {
+        std::cout << "[Error] " << test << ": " << testFailures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "[Info] " << test << " passed" << std::endl;
+    return 0;
+}
+
+// Bit equality of float buffers, NaN payloads and signed zeros included
+static inline bool sameBits(const float* a, const float* b, size_t count) {
+    return memcmp(a, b, count * sizeof(float)) == 0;
+}
+
+static inline std::vector<float> randomFloats(std::mt19937& generator, size_t count, float low, float high) {
+    std::uniform_real_distribution<float> uniform(low, high);
+    std::vector<float> values(count);
+    for (auto& value : values) {
+        value = uniform(generator);
+    }
+    return values;
+}
+
+// Distance of two finite floats in units in the last place
+static inline int64_t ulpDistance(float a, float b) {
+    auto ordered = [](float value) {
+        int32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits < 0 ? static_cast<int64_t>(INT32_MIN) - bits : static_cast<int64_t>(bits);
+    };
+    int64_t distance = ordered(a) - ordered(b);
+    return distance < 0 ? -distance : distance;
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include "layers/upsample.h"
+#include "utils/derived.h"
+
+#include "testing.h"
+
+#include <cmath>
+#include <limits>
+
+// upsampleNearestReference() against upsampleDeconvolutionReference() with
+// the kernel of deriveUpsampleWeights(), the two UpsampleModes of the necks.
+
+static void testUpsample(std::mt19937& generator, int channels, int height, int width) {
+    size_t count = static_cast<size_t>(channels) * height * width;
+    std::vector<float> input = randomFloats(generator, count, -100.0f, 100.0f);
+    // Values the multiply by the kernel value 1 must keep
+    const float specials[] = {0.0f, -0.0f, 1e-40f, -1e-40f, std::numeric_limits<float>::max(),
+                              std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+    for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]) && i < count; ++i) {
+        input[(i * 7919) % count] = specials[i];
+    }
+
+    WeightArena arena;
+    Weights kernel = deriveUpsampleWeights(arena, channels);
+    EXPECT_EQ(kernel.count, static_cast<int64_t>(channels) * 4);
+
+    std::vector<float> nearest(count * 4);
+    std::vector<float> deconvolution(count * 4);
+    upsampleNearestReference(input.data(), nearest.data(), channels, height, width);
+    upsampleDeconvolutionReference(input.data(), static_cast<const float*>(kernel.values), deconvolution.data(), channels, height, width);
+
+    // Equal values, the deconvolution accumulates on +0 so -0 comes out as +0
+    int mismatches = 0;
+    for (size_t i = 0; i < nearest.size(); ++i) {
+        mismatches += !(nearest[i] == deconvolution[i]);
+    }
+    EXPECT_EQ(mismatches, 0);
+
+    // Every output pixel is its input pixel
+    for (int c = 0; c < channels; ++c) {
+        for (int y = 0; y < 2 * height; ++y) {
+            for (int x = 0; x < 2 * width; ++x) {
+                float in = input[(static_cast<size_t>(c) * height + y / 2) * width + x / 2];
+                float out = nearest[(static_cast<size_t>(c) * 2 * height + y) * 2 * width + x];
+                mismatches += !sameBits(&in, &out, 1);
+            }
+        }
+    }
+    EXPECT_EQ(mismatches, 0);
+
+    // NaN propagates through both
+    input[0] = std::numeric_limits<float>::quiet_NaN();
+    upsampleNearestReference(input.data(), nearest.data(), channels, height, width);
+    upsampleDeconvolutionReference(input.data(), static_cast<const float*>(kernel.values), deconvolution.data(), channels, height, width);
+    for (int i : {0, 1, 2 * width, 2 * width + 1}) {
+        EXPECT(std::isnan(nearest[i]) && std::isnan(deconvolution[i]));
+    }
+}
+
+// FP16 tensors go through the nearest neighbor resize as bit copies
+static void testHalfUpsample(std::mt19937& generator, int channels, int height, int width) {
+    size_t count = static_cast<size_t>(channels) * height * width;
+    std::vector<uint16_t> input(count);
+    std::uniform_int_distribution<int> bits(0, 0xFFFF);
+    for (auto& value : input) {
+        value = static_cast<uint16_t>(bits(generator));
+    }
+    std::vector<uint16_t> output(count * 4);
+    upsampleNearestReference(input.data(), output.data(), channels, height, width);
+    int mismatches = 0;
+    for (int c = 0; c < channels; ++c) {
+        for (int y = 0; y < 2 * height; ++y) {
+            for (int x = 0; x < 2 * width; ++x) {
+                mismatches += output[(static_cast<size_t>(c) * 2 * height + y) * 2 * width + x] !=
+                              input[(static_cast<size_t>(c) * height + y / 2) * width + x / 2];
+            }
+        }
+    }
+    EXPECT_EQ(mismatches, 0);
+}
+
+int main() {
+    std::mt19937 generator(12);
+    testUpsample(generator, 1, 1, 1);
+    testUpsample(generator, 3, 5, 7);
+    testUpsample(generator, 128, 19, 19);
+    testUpsample(generator, 256, 13, 20);
+    testHalfUpsample(generator, 128, 19, 19);
+    return testResult("upsample_test");
+}
@@ -0,0 +1,163 @@
+#include "utils/weights.h"
+
+#include "testing.h"
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+
+// The text weight loaders: the fixed width fast path of loadWeightsParallel()
+// and WeightMap against the iostream loader, the hex digit check of the fast
+// path, and that values which are not hex digits fail the load. Darknet
+// weights are loaded and verified with the .cfg given for them.
+
+struct TextBlob {
+    std::string name;
+    std::vector<std::string> values;
+};
+
+static void writeText(const std::string& file, const std::vector<TextBlob>& blobs) {
+    std::ofstream out(file);
+    out << blobs.size() << "\n";
+    for (auto& blob : blobs) {
+        out << blob.name << " " << blob.values.size();
+        for (auto& value : blob.values) {
+            out << " " << value;
+        }
+        out << "\n";
+    }
+}
+
+static std::vector<std::string> randomValues(std::mt19937& generator, size_t count) {
+    std::vector<std::string> values(count);
+    char digits[9];
+    for (auto& value : values) {
+        snprintf(digits, sizeof(digits), "%08x", static_cast<unsigned>(generator()));
+        value = digits;
+    }
+    return values;
+}
+
+static bool loadFails(const std::string& file) {
+    WeightArena arena;
+    try {
+        loadWeightsParallel(file, arena);
+    }
+    catch(const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+static bool mapFails(const std::string& file, const std::string& name) {
+    WeightArena arena;
+    WeightMap map(arena);
+    map.load(file);
+    try {
+        map.floats(name);
+    }
+    catch(const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Every byte value at every position of an 8 digit value
+static void testHexDigitErrors() {
+    for (int position = 0; position < 8; ++position) {
+        for (int c = 0; c < 256; ++c) {
+            char digits[8];
+            memcpy(digits, "3f80a0C1", 8);
+            digits[position] = static_cast<char>(c);
+            EXPECT_EQ(hexDigitErrors8(digits) != 0, !isxdigit(c));
+        }
+    }
+}
+
+// Fixed width blobs, one larger than a decode chunk, and irregular ones
+static void testValid(std::mt19937& generator) {
+    std::vector<TextBlob> blobs = {{"conv0.weight", randomValues(generator, (1 << 16) + 3)},
+                                   {"conv0.bias", randomValues(generator, 7)},
+                                   {"bn0.weight", {"3F800000", "0", "0x40000000", "bf80"}}};
+    writeText("weights_test.wts", blobs);
+
+    WeightArena streamArena, parallelArena, mapArena;
+    std::map<std::string, Weights> stream = loadWeights("weights_test.wts", streamArena);
+    std::map<std::string, Weights> parallel = loadWeightsParallel("weights_test.wts", parallelArena);
+    WeightMap map(mapArena);
+    map.load("weights_test.wts");
+    for (auto& blob : blobs) {
+        const Weights& expected = stream[blob.name];
+        EXPECT_EQ(parallel[blob.name].count, expected.count);
+        EXPECT(sameBits(static_cast<const float*>(parallel[blob.name].values), static_cast<const float*>(expected.values), expected.count));
+        EXPECT(sameBits(map.floats(blob.name), static_cast<const float*>(expected.values), expected.count));
+    }
+}
+
+// A value with a character that is not a hex digit fails the load, in fixed
+// width lines at every position of the value and in irregular lines
+static void testInvalid(std::mt19937& generator) {
+    for (char bad : {'g', ':', '@', '`', 'G', '/', '\x80'}) {
+        for (int position = 0; position < 8; ++position) {
+            std::vector<TextBlob> blobs = {{"conv0.weight", randomValues(generator, 300)}, {"conv0.bias", randomValues(generator, 5)}};
+            blobs[0].values[123][position] = bad;
+            writeText("weights_test_invalid.wts", blobs);
+            EXPECT(loadFails("weights_test_invalid.wts"));
+            EXPECT(mapFails("weights_test_invalid.wts", "conv0.weight"));
+            EXPECT(!mapFails("weights_test_invalid.wts", "conv0.bias"));
+        }
+    }
+
+    writeText("weights_test_invalid.wts", {{"bn0.weight", {"3f800000", "0x4z", "1"}}});
+    EXPECT(loadFails("weights_test_invalid.wts"));
+    EXPECT(mapFails("weights_test_invalid.wts", "bn0.weight"));
+
+    // More values than the size in a line of the length of two fixed width values
+    std::ofstream("weights_test_invalid.wts") << "1\nbn0.weight 2 3f800 000 0000000\n";
+    EXPECT(loadFails("weights_test_invalid.wts"));
+    EXPECT(mapFails("weights_test_invalid.wts", "bn0.weight"));
+}
+
+// A Darknet file of one 1x1 convolution from 3 to 2 channels without batch
+// norm: 2 biases and 6 kernel values after the header
+static void testDarknetCfg() {
+    {
+        std::ofstream weights("weights_test.weights", std::ios::binary);
+        int32_t version[3] = {0, 2, 0};
+        uint64_t seen = 0;
+        float values[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+        weights.write(reinterpret_cast<const char*>(version), sizeof(version));
+        weights.write(reinterpret_cast<const char*>(&seen), sizeof(seen));
+        weights.write(reinterpret_cast<const char*>(values), sizeof(values));
+    }
+    std::ofstream("weights_test_given.cfg") << "[net]\nchannels=3\n\n[convolutional]\nfilters=2\nsize=1\nactivation=linear\n";
+    std::ofstream("weights_test_larger.cfg") << "[net]\nchannels=3\n\n[convolutional]\nfilters=4\nsize=1\nactivation=linear\n";
+    remove("weights_test.cfg");
+
+    // There is no weights_test.cfg next to the weights
+    ThreadPool pool(2);
+    EXPECT(!verifyWeights("weights_test.weights", "", pool).empty());
+    EXPECT(verifyWeights("weights_test.weights", "weights_test_given.cfg", pool).empty());
+    EXPECT(!verifyWeights("weights_test.weights", "weights_test_larger.cfg", pool).empty());
+
+    WeightArena arena;
+    WeightMap map(arena);
+    map.load("weights_test.weights", "weights_test_given.cfg");
+    EXPECT_EQ(map.floats("model.0.conv.bias")[1], 2.0f);
+    EXPECT_EQ(map.floats("model.0.conv.weight")[5], 8.0f);
+
+    remove("weights_test.weights");
+    remove("weights_test_given.cfg");
+    remove("weights_test_larger.cfg");
+}
+
+int main() {
+    std::mt19937 generator(7);
+    testHexDigitErrors();
+    testValid(generator);
+    testInvalid(generator);
+    testDarknetCfg();
+    remove("weights_test.wts");
+    remove("weights_test_invalid.wts");
+    return testResult("weights_test");
+}
@@ -0,0 +1,186 @@
+#include "layers/yololayer.h"
+
+#include "gpu_testing.h"
+
+#include <algorithm>
+
+// The filter mode of YoloLayer_TRT (CalDetectionFilter, ClampCount) against
+// yoloFilterReference(): two chained yolo layers over a batch of two images,
+// bit for bit with new_coords, where decoding needs no exponential, and
+// within a few ulp with the __expf of the default decoding. Past
+// max_detections the count is clamped and the slots hold different passing
+// detections. Needs a GPU, built with WITH_GPU_TESTS.
+
+using namespace nvinfer1;
+using Yolo::Detection;
+
+static float ANCHORS[] = {10, 14, 23, 27, 37, 58};
+static const int CLASSES = 80;
+static const int BATCH = 2;
+
+// Output of a yolo head convolution, BATCH images of 3 * (5 + CLASSES) planes
+struct YoloInput {
+    YoloInput(int width, int height) : width(width), height(height), data(static_cast<size_t>(BATCH) * 3 * (5 + CLASSES) * width * height) {}
+
+    int cells() const { return width * height * 3; }
+
+    const float* image(int index) const { return data.data() + static_cast<size_t>(index) * cells() * (5 + CLASSES); }
+
+    int width;
+    int height;
+    std::vector<float> data;
+};
+
+// With new_coords the values are the scores themselves, about half of the
+// cells pass 0.5
+static YoloInput newCoordsInput(std::mt19937& generator, int width, int height) {
+    YoloInput input(width, height);
+    input.data = randomFloats(generator, input.data.size(), 0.0f, 1.0f);
+    return input;
+}
+
+// Logits whose scores are far from 0.25 on either side, so that the few ulp
+// between __expf and expf never change which detections pass
+static YoloInput logitInput(std::mt19937& generator, int width, int height) {
+    YoloInput input(width, height);
+    input.data = randomFloats(generator, input.data.size(), -3.0f, 2.0f);
+    int grids = width * height;
+    std::uniform_int_distribution<int> classes(0, CLASSES - 1);
+    for (int anchor = 0; anchor < BATCH * 3; ++anchor) {
+        float* planes = input.data.data() + static_cast<size_t>(anchor) * (5 + CLASSES) * grids;
+        for (int cell = 0; cell < grids; ++cell) {
+            planes[4 * grids + cell] = generator() % 2 ? 4.0f : -4.0f;
+            planes[(5 + classes(generator)) * grids + cell] = 3.0f;
+        }
+    }
+    return input;
+}
+
+struct FilterOutput {
+    std::vector<Detection> detections;  // BATCH * maxDetections slots
+    std::vector<int> counts;
+};
+
+// Runs the two yolo layers, the second chained to the first, like the engine
+static FilterOutput runPlugins(const YoloInput& first, const YoloInput& second, int newCoords, float threshold, int maxDetections) {
+    const int detectionFloats = sizeof(Detection) / sizeof(float);
+    DeviceBuffer<float> firstInput(first.data);
+    DeviceBuffer<float> secondInput(second.data);
+    DeviceBuffer<float> firstDetections(static_cast<size_t>(BATCH) * maxDetections * detectionFloats);
+    DeviceBuffer<int> firstCounts(BATCH);
+    DeviceBuffer<float> detections(static_cast<size_t>(BATCH) * maxDetections * detectionFloats);
+    DeviceBuffer<int> counts(BATCH);
+    firstDetections.fill(0xFF);
+    detections.fill(0xFF);
+
+    YoloLayerPlugin firstPlugin(first.width, first.height, 3, ANCHORS, CLASSES, 416, 416, 1.05f, newCoords, threshold, maxDetections);
+    YoloLayerPlugin secondPlugin(second.width, second.height, 3, ANCHORS, CLASSES, 416, 416, 1.05f, newCoords, threshold, maxDetections);
+    PluginTensorDesc desc[5] = {};
+    firstPlugin.configurePlugin(desc, 1, desc, 2);
+    secondPlugin.configurePlugin(desc, 3, desc, 2);
+
+    const void* firstInputs[] = {firstInput.get()};
+    void* firstOutputs[] = {firstDetections.get(), firstCounts.get()};
+    EXPECT_EQ(firstPlugin.enqueue(BATCH, firstInputs, firstOutputs, nullptr, 0), 0);
+    const void* secondInputs[] = {secondInput.get(), firstDetections.get(), firstCounts.get()};
+    void* secondOutputs[] = {detections.get(), counts.get()};
+    EXPECT_EQ(secondPlugin.enqueue(BATCH, secondInputs, secondOutputs, nullptr, 0), 0);
+
+    FilterOutput output;
+    std::vector<float> values = detections.download();
+    output.detections.resize(static_cast<size_t>(BATCH) * maxDetections);
+    memcpy(output.detections.data(), values.data(), values.size() * sizeof(float));
+    output.counts = counts.download();
+    firstPlugin.terminate();
+    secondPlugin.terminate();
+    return output;
+}
+
+static std::vector<Detection> reference(const YoloInput& first, const YoloInput& second, int image, int newCoords, float threshold, int maxDetections) {
+    std::vector<Detection> detections;
+    Yolo::yoloFilterReference(first.image(image), first.width, first.height, 3, ANCHORS, CLASSES, 416, 416, 1.05f, newCoords,
+                              threshold, maxDetections, detections);
+    Yolo::yoloFilterReference(second.image(image), second.width, second.height, 3, ANCHORS, CLASSES, 416, 416, 1.05f, newCoords,
+                              threshold, maxDetections, detections);
+    return detections;
+}
+
+static bool lessDetection(const Detection& a, const Detection& b) {
+    return std::lexicographical_compare(a.bbox, a.bbox + 4, b.bbox, b.bbox + 4);
+}
+
+static bool closeDetection(const Detection& a, const Detection& b, int64_t ulps) {
+    const float* x = reinterpret_cast<const float*>(&a);
+    const float* y = reinterpret_cast<const float*>(&b);
+    for (size_t i = 0; i < sizeof(Detection) / sizeof(float); ++i) {
+        if (ulpDistance(x[i], y[i]) > ulps) {
+            return false;
+        }
+    }
+    return a.class_id == b.class_id;
+}
+
+// The kept detections of every image are those of the reference in some
+// order, the slots after them zero
+static void expectDetections(const YoloInput& first, const YoloInput& second, int newCoords, float threshold, int maxDetections, int64_t ulps) {
+    FilterOutput output = runPlugins(first, second, newCoords, threshold, maxDetections);
+    for (int image = 0; image < BATCH; ++image) {
+        std::vector<Detection> expected = reference(first, second, image, newCoords, threshold, maxDetections);
+        EXPECT(expected.size() < static_cast<size_t>(maxDetections));
+        EXPECT_EQ(output.counts[image], static_cast<int>(expected.size()));
+        int count = std::min(std::max(output.counts[image], 0), maxDetections);
+        auto begin = output.detections.begin() + static_cast<size_t>(image) * maxDetections;
+        std::vector<Detection> kept(begin, begin + count);
+        std::sort(kept.begin(), kept.end(), lessDetection);
+        std::sort(expected.begin(), expected.end(), lessDetection);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < kept.size() && i < expected.size(); ++i) {
+            mismatches += closeDetection(kept[i], expected[i], ulps) ? 0 : 1;
+        }
+        EXPECT_EQ(mismatches, 0u);
+        Detection zero;
+        memset(&zero, 0, sizeof(zero));
+        for (int slot = count; slot < maxDetections; ++slot) {
+            EXPECT(memcmp(&*(begin + slot), &zero, sizeof(Detection)) == 0);
+        }
+    }
+}
+
+// More passing detections than slots in the first layer already: the count
+// is clamped, every slot holds a different detection the unlimited
+// reference passes, and the chained layer adds none
+static void testOverflow(std::mt19937& generator) {
+    YoloInput first = newCoordsInput(generator, 13, 13);
+    YoloInput second = newCoordsInput(generator, 26, 26);
+    const int maxDetections = 200;
+    FilterOutput output = runPlugins(first, second, 1, 0.5f, maxDetections);
+    for (int image = 0; image < BATCH; ++image) {
+        std::vector<Detection> firstOnly;
+        Yolo::yoloFilterReference(first.image(image), first.width, first.height, 3, ANCHORS, CLASSES, 416, 416, 1.05f, 1,
+                                  0.5f, first.cells(), firstOnly);
+        EXPECT(firstOnly.size() > static_cast<size_t>(maxDetections));
+        EXPECT_EQ(output.counts[image], maxDetections);
+
+        auto begin = output.detections.begin() + static_cast<size_t>(image) * maxDetections;
+        std::vector<Detection> kept(begin, begin + maxDetections);
+        std::sort(kept.begin(), kept.end(), lessDetection);
+        std::sort(firstOnly.begin(), firstOnly.end(), lessDetection);
+        for (size_t i = 0; i < kept.size(); ++i) {
+            EXPECT(std::binary_search(firstOnly.begin(), firstOnly.end(), kept[i], lessDetection));
+            EXPECT(i == 0 || lessDetection(kept[i - 1], kept[i]));
+        }
+    }
+}
+
+int main() {
+    std::mt19937 generator(24);
+    // Well below max_detections, then with the second layer filling all but a few slots
+    expectDetections(newCoordsInput(generator, 13, 13), newCoordsInput(generator, 26, 26), 1, 0.5f, 4096, 0);
+    YoloInput first = newCoordsInput(generator, 13, 13);
+    YoloInput second = newCoordsInput(generator, 26, 26);
+    size_t most = std::max(reference(first, second, 0, 1, 0.5f, 1 << 20).size(), reference(first, second, 1, 1, 0.5f, 1 << 20).size());
+    expectDetections(first, second, 1, 0.5f, static_cast<int>(most) + 3, 0);
+    expectDetections(logitInput(generator, 13, 13), logitInput(generator, 26, 26), 0, 0.25f, 4096, 8);
+    testOverflow(generator);
+    return testResult("yolofilter_gpu_test");
+}
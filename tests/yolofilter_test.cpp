@@ -0,0 +1,230 @@
+#include "layers/yolodecode.h"
+
+#include "testing.h"
+
+#include <algorithm>
+#include <numeric>
+
+// yoloFilterReference(), the host reference of the filter mode of
+// YoloLayer_TRT: the conf_thresh boundary, truncation at max_detections, and
+// against the compaction of CalDetectionFilter and ClampCount modelled on the
+// host, which gives the same detections whatever order the blocks run in.
+
+using Yolo::Detection;
+
+static const float ANCHORS[] = {10, 14, 23, 27, 37, 58};
+
+// Output of a yolo head convolution, batch images of num_anchors * (5 + classes) planes
+struct YoloInput {
+    YoloInput(int width, int height, int classes, int batch = 1)
+        : width(width), height(height), classes(classes), batch(batch),
+          data(static_cast<size_t>(batch) * 3 * (5 + classes) * width * height, 0.0f) {}
+
+    int cells() const { return width * height * 3; }
+
+    const float* image(int index) const { return data.data() + static_cast<size_t>(index) * 3 * (5 + classes) * width * height; }
+
+    // Sets the objectness and one class score of the cell of an anchor, taken
+    // as they are with new_coords
+    void set(int cell, float objectness, int classId, float score) {
+        int grids = width * height;
+        float* anchor = data.data() + static_cast<size_t>(cell / grids) * (5 + classes) * grids + cell % grids;
+        anchor[4 * grids] = objectness;
+        anchor[(5 + classId) * grids] = score;
+    }
+
+    int width;
+    int height;
+    int classes;
+    int batch;
+    std::vector<float> data;
+};
+
+static std::vector<Detection> filter(const YoloInput& input, int image, int newCoords, float threshold, int maxDetections) {
+    std::vector<Detection> detections;
+    Yolo::yoloFilterReference(input.image(image), input.width, input.height, 3, ANCHORS, input.classes, 416, 416, 1.05f, newCoords,
+                              threshold, maxDetections, detections);
+    return detections;
+}
+
+static bool sameDetection(const Detection& a, const Detection& b) {
+    return memcmp(&a, &b, sizeof(Detection)) == 0;
+}
+
+// Detections in an order independent of the order they were written in
+static std::vector<Detection> sorted(std::vector<Detection> detections) {
+    std::sort(detections.begin(), detections.end(), [](const Detection& a, const Detection& b) {
+        return memcmp(&a, &b, sizeof(Detection)) < 0;
+    });
+    return detections;
+}
+
+static bool sameDetections(const std::vector<Detection>& a, const std::vector<Detection>& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), sameDetection);
+}
+
+// CalDetectionFilter for one image with the blocks run in blockOrder, then
+// ClampCount: the kept detections of a block get consecutive slots from the
+// count, by the ballots of its warps, and only slots below maxDetections are
+// written. slots holds the maxDetections slots of the image and count the
+// count of the previous yolo layer. Returns the clamped count.
+static int compactOnHost(const YoloInput& input, int image, int newCoords, float threshold, int maxDetections,
+                         int threadCount, const std::vector<int>& blockOrder, std::vector<Detection>& slots, int count) {
+    int cells = input.cells();
+    for (int block : blockOrder) {
+        std::vector<Detection> dets(threadCount);
+        std::vector<int> warpOffsets((threadCount + 31) / 32, 0);
+        std::vector<unsigned int> ballots(warpOffsets.size(), 0);
+        for (int thread = 0; thread < threadCount; ++thread) {
+            int cell = thread + block * threadCount;
+            if (cell < cells) {
+                dets[thread] = Yolo::decodeDetection(input.data.data(), image * cells + cell, input.width, input.height, 3, ANCHORS,
+                                                     input.classes, 416, 416, 1.05f, newCoords);
+                if (Yolo::keepDetection(dets[thread], threshold)) {
+                    ballots[thread / 32] |= 1u << (thread % 32);
+                }
+            }
+        }
+        int total = 0;
+        for (size_t warp = 0; warp < ballots.size(); ++warp) {
+            warpOffsets[warp] = total;
+            total += __builtin_popcount(ballots[warp]);
+        }
+        int blockOffset = count;
+        count += total;
+        for (int thread = 0; thread < threadCount; ++thread) {
+            unsigned int ballot = ballots[thread / 32];
+            int lane = thread % 32;
+            if (ballot & (1u << lane)) {
+                int slot = blockOffset + warpOffsets[thread / 32] + __builtin_popcount(ballot & ((1u << lane) - 1));
+                if (slot < maxDetections) {
+                    slots[slot] = dets[thread];
+                }
+            }
+        }
+    }
+    return std::min(count, maxDetections);
+}
+
+static std::vector<int> blocksInOrder(const YoloInput& input, int threadCount) {
+    std::vector<int> order((input.cells() + threadCount - 1) / threadCount);
+    std::iota(order.begin(), order.end(), 0);
+    return order;
+}
+
+// Random logits, about a fifth of the cells pass 0.25
+static YoloInput randomInput(std::mt19937& generator, int width, int height, int classes, int batch) {
+    YoloInput input(width, height, classes, batch);
+    input.data = randomFloats(generator, input.data.size(), -3.0f, 2.0f);
+    return input;
+}
+
+// det_confidence * class_confidence exactly at conf_thresh is kept, one ulp below is not
+static void testThreshold() {
+    YoloInput input(4, 3, 5);
+    input.set(1, 0.5f, 2, 0.5f);
+    input.set(7, 0.5f, 4, std::nextafter(0.5f, 0.0f));
+    input.set(20, 1.0f, 0, 0.25f);
+    input.set(35, 0.5f, 3, 0.75f);
+
+    std::vector<Detection> kept = filter(input, 0, 1, 0.25f, 100);
+    EXPECT_EQ(kept.size(), 3u);
+    if (kept.size() == 3) {
+        // In cell order, with the class of the highest score
+        EXPECT_EQ(kept[0].class_id, 2.0f);
+        EXPECT_EQ(kept[0].det_confidence * kept[0].class_confidence, 0.25f);
+        EXPECT_EQ(kept[1].class_id, 0.0f);
+        EXPECT_EQ(kept[2].class_id, 3.0f);
+    }
+
+    // Just above the product of cell 1 it goes
+    std::vector<Detection> above = filter(input, 0, 1, std::nextafter(0.25f, 1.0f), 100);
+    EXPECT_EQ(above.size(), 1u);
+    EXPECT(!above.empty() && above[0].class_id == 3.0f);
+
+    // A zero threshold keeps every cell, also those with zero scores
+    EXPECT_EQ(filter(input, 0, 1, 0.0f, 100).size(), static_cast<size_t>(input.cells()));
+    EXPECT(filter(input, 0, 1, 0.25f, 0).empty());
+}
+
+// Past max_detections the reference keeps the first in cell order, the
+// kernels an arbitrary max_detections of the passing ones and clamp the count
+static void testOverflow(std::mt19937& generator) {
+    YoloInput input = randomInput(generator, 13, 13, 80, 1);
+    std::vector<Detection> all = filter(input, 0, 0, 0.25f, input.cells());
+    EXPECT(all.size() > 100u);
+    std::vector<Detection> first = filter(input, 0, 0, 0.25f, 100);
+    EXPECT_EQ(first.size(), 100u);
+    EXPECT(sameDetections(first, std::vector<Detection>(all.begin(), all.begin() + std::min<size_t>(100, all.size()))));
+
+    std::vector<Detection> sortedAll = sorted(all);
+    for (int round = 0; round < 4; ++round) {
+        std::vector<int> order = blocksInOrder(input, 64);
+        std::shuffle(order.begin(), order.end(), generator);
+        std::vector<Detection> slots(100);
+        int count = compactOnHost(input, 0, 0, 0.25f, 100, 64, order, slots, 0);
+        EXPECT_EQ(count, 100);
+        // Every slot holds a different passing detection
+        std::vector<Detection> written = sorted(slots);
+        for (size_t i = 0; i < written.size(); ++i) {
+            EXPECT(std::binary_search(sortedAll.begin(), sortedAll.end(), written[i], [](const Detection& a, const Detection& b) {
+                return memcmp(&a, &b, sizeof(Detection)) < 0;
+            }));
+            EXPECT(i == 0 || !sameDetection(written[i - 1], written[i]));
+        }
+    }
+
+    // A chained yolo layer after a full one adds nothing and keeps the count
+    // at max_detections, the reference appends nothing either
+    std::vector<Detection> slots(100);
+    int count = compactOnHost(input, 0, 0, 0.25f, 100, 64, blocksInOrder(input, 64), slots, 0);
+    std::vector<Detection> before = slots;
+    count = compactOnHost(input, 0, 0, 0.25f, 100, 64, blocksInOrder(input, 64), slots, count);
+    EXPECT_EQ(count, 100);
+    EXPECT(sameDetections(slots, before));
+    std::vector<Detection> chained = first;
+    Yolo::yoloFilterReference(input.image(0), 13, 13, 3, ANCHORS, 80, 416, 416, 1.05f, 0, 0.25f, 100, chained);
+    EXPECT(sameDetections(chained, first));
+}
+
+// Below max_detections every block order and block size writes the same
+// detections as the reference, also for the second image of a batch and for
+// a chained second yolo layer
+static void testCompactionOrders(std::mt19937& generator) {
+    YoloInput first = randomInput(generator, 13, 13, 80, 2);
+    YoloInput second = randomInput(generator, 26, 26, 80, 2);
+    const int maxDetections = 4000;
+    for (int image = 0; image < 2; ++image) {
+        std::vector<Detection> expected = filter(first, image, 0, 0.25f, maxDetections);
+        size_t firstCount = expected.size();
+        Yolo::yoloFilterReference(second.image(image), 26, 26, 3, ANCHORS, 80, 416, 416, 1.05f, 0, 0.25f, maxDetections, expected);
+        EXPECT(expected.size() > firstCount && expected.size() < static_cast<size_t>(maxDetections));
+        expected = sorted(expected);
+
+        for (int threadCount : {64, 256, 512}) {
+            for (int round = 0; round < 3; ++round) {
+                std::vector<int> firstOrder = blocksInOrder(first, threadCount);
+                std::vector<int> secondOrder = blocksInOrder(second, threadCount);
+                if (round) {
+                    std::shuffle(firstOrder.begin(), firstOrder.end(), generator);
+                    std::shuffle(secondOrder.begin(), secondOrder.end(), generator);
+                }
+                std::vector<Detection> slots(maxDetections);
+                int count = compactOnHost(first, image, 0, 0.25f, maxDetections, threadCount, firstOrder, slots, 0);
+                EXPECT_EQ(static_cast<size_t>(count), firstCount);
+                count = compactOnHost(second, image, 0, 0.25f, maxDetections, threadCount, secondOrder, slots, count);
+                EXPECT_EQ(static_cast<size_t>(count), expected.size());
+                slots.resize(std::min(count, maxDetections));
+                EXPECT(sameDetections(sorted(slots), expected));
+            }
+        }
+    }
+}
+
+int main() {
+    std::mt19937 generator(24);
+    testThreshold();
+    testOverflow(generator);
+    testCompactionOrders(generator);
+    return testResult("yolofilter_test");
+}
@@ -0,0 +1,361 @@
+#include "NvInfer.h"
+
+#include "parser/cxxopts.hpp"
+
+#include "utils/darknet.h"
+#include "utils/derived.h"
+#include "utils/weights.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace nvinfer1;
+
+// Loader paths that are measured, each reads its own synthetic file
+enum LoaderPath {
+    WTS_STREAM,     // iostream reference loader, everything decoded up front
+    WTS,            // WeightMap over a text file, decoded on first use
+    WTSB,           // WeightMap over a mapped binary file
+    WTSB_FP16,      // same with half precision blobs as for an FP16 build
+    DARKNET,        // WeightMap over a mapped Darknet .weights file
+    NB_LOADER_PATHS
+};
+
+static const char* LOADER_PATH_NAMES[] = {"wts-stream", "wts", "wtsb", "wtsb-fp16", "weights"};
+
+struct Phases {
+    double loadMs;          // open and parse or index the file
+    double materializeMs;   // fetch every blob a layer helper would ask for and read it once like the builder
+    double deriveMs;        // batch norm folding and upsample kernels
+    long peakRssKb;
+    uint64_t derivedBytes;
+    uint32_t blobs;
+    float checksum;
+    uint64_t touched;
+};
+
+// Reads every byte of a blob so that mapped files are paged in as when the builder copies them
+static uint64_t touch(const Weights& wt) {
+    const char* bytes = static_cast<const char*>(wt.values);
+    size_t size = wt.count * weightTypeSize(wt.type);
+    uint64_t sum = 0;
+    for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        sum += word;
+    }
+    return sum;
+}
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Writes a Darknet .weights file with random values for every convolution of
+// the config. Batch norm variances are kept positive like in a trained model.
+static void writeSyntheticDarknet(const std::vector<DarknetSection>& sections, const std::string& file, unsigned seed) {
+    std::ofstream output(file, std::ios::binary);
+    int32_t version[3] = {0, 2, 5};
+    uint64_t seen = 0;
+    output.write(reinterpret_cast<const char*>(version), sizeof(version));
+    output.write(reinterpret_cast<const char*>(&seen), sizeof(seen));
+
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> normal(0.0f, 0.05f);
+    std::uniform_real_distribution<float> positive(0.5f, 1.5f);
+    auto write = [&](int64_t count, bool variance) {
+        std::vector<float> values(count);
+        for (auto& value : values) {
+            value = variance ? positive(generator) : normal(generator);
+        }
+        output.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+    };
+
+    std::vector<int> channels = darknetChannels(sections);
+    for (size_t i = 1; i < sections.size(); ++i) {
+        const DarknetSection& section = sections[i];
+        if (section.type != "convolutional") {
+            continue;
+        }
+        int layer = i - 1;
+        int inputChannels = layer == 0 ? sections.front().getInt("channels", 3) : channels[layer - 1];
+        int filters = section.getInt("filters", 1);
+        int kernel = section.getInt("size", 1);
+        if (section.getInt("batch_normalize", 0)) {
+            write(filters, false);
+            write(filters, false);
+            write(filters, false);
+            write(filters, true);
+        }
+        else {
+            write(filters, false);
+        }
+        write(static_cast<int64_t>(filters) * (inputChannels / section.getInt("groups", 1)) * kernel * kernel, false);
+    }
+}
+
+// Writes the .wts text format the PyTorch converter produces
+static void writeWeightsText(const std::string& file, const std::map<std::string, Weights>& weightMap) {
+    std::ofstream output(file);
+    output << weightMap.size() << "\n";
+    char hex[10];
+    for (auto& wt : weightMap) {
+        output << wt.first << " " << wt.second.count;
+        const uint32_t* values = static_cast<const uint32_t*>(wt.second.values);
+        for (int64_t i = 0; i < wt.second.count; ++i) {
+            snprintf(hex, sizeof(hex), " %08x", values[i]);
+            output << hex;
+        }
+        output << "\n";
+    }
+}
+
+// Generates the synthetic files of all loader paths from one Darknet file,
+// the config is copied next to it for the Darknet loader
+static std::vector<std::string> writeSyntheticFiles(const std::string& cfgFile, const std::vector<DarknetSection>& sections, const std::string& prefix) {
+    std::vector<std::string> files(NB_LOADER_PATHS);
+    files[DARKNET] = prefix + ".weights";
+    std::ofstream(darknetCfgFor(files[DARKNET])) << std::ifstream(cfgFile).rdbuf();
+    files[WTS_STREAM] = files[WTS] = prefix + ".wts";
+    files[WTSB] = prefix + ".wtsb";
+    files[WTSB_FP16] = prefix + "-fp16.wtsb";
+
+    writeSyntheticDarknet(sections, files[DARKNET], 42);
+
+    MappedFile mapping;
+    mapping.open(files[DARKNET]);
+    std::map<std::string, Weights> weightMap = indexDarknetWeights(sections, mapping.data(), mapping.size());
+    writeWeightsText(files[WTS], weightMap);
+    writeWeightsBinary(files[WTSB], weightMap);
+
+    WeightArena arena;
+    for (auto& wt : weightMap) {
+        uint16_t* halfValues = arena.allocate<uint16_t>(wt.second.count);
+        floatToHalf(static_cast<const float*>(wt.second.values), halfValues, wt.second.count);
+        wt.second = Weights{DataType::kHALF, halfValues, wt.second.count};
+    }
+    writeWeightsBinary(files[WTSB_FP16], weightMap);
+
+    return files;
+}
+
+// Does the host side work of createEngine() for every layer of the config:
+// fetches the blobs, folds the batch norms and builds the upsample kernels.
+// Runs in a forked child so that the peak RSS of one path does not hide the next one.
+static bool measure(const std::vector<DarknetSection>& sections, const std::string& file, LoaderPath path, Phases& result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        Phases r{};
+        WeightArena arena;
+        std::map<std::string, Weights> streamed;
+        WeightMap weightMap(arena);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if (path == WTS_STREAM) {
+            streamed = loadWeights(file, arena);
+        }
+        else {
+            weightMap.load(file);
+            weightMap.setHalfWeights(path == WTSB_FP16);
+        }
+        r.loadMs = elapsedMs(start);
+
+        // Blobs of each convolution in the order the network helpers ask for them
+        struct Fetched {
+            const float* values[4];
+            int len;
+        };
+        std::vector<Fetched> batchNorms;
+        std::vector<int> upsamples;
+        std::vector<int> channels = darknetChannels(sections);
+        auto fetch = [&](const std::string& name) -> Weights {
+            if (path == WTS_STREAM) {
+                return streamed.at(name);
+            }
+            return weightMap[name];
+        };
+        auto floats = [&](const std::string& name) {
+            return path == WTS_STREAM ? static_cast<const float*>(streamed.at(name).values) : weightMap.floats(name);
+        };
+
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 1; i < sections.size(); ++i) {
+            std::string prefix = "model." + std::to_string(i - 1);
+            if (sections[i].type == "upsample") {
+                upsamples.push_back(channels[i - 1]);
+            }
+            if (sections[i].type != "convolutional") {
+                continue;
+            }
+
+            Weights kernel = fetch(prefix + ".conv.weight");
+            r.touched += touch(kernel);
+            r.checksum += kernel.type == DataType::kHALF ? halfToFloat(static_cast<const uint16_t*>(kernel.values)[0]) : static_cast<const float*>(kernel.values)[0];
+            r.blobs++;
+            if (!sections[i].getInt("batch_normalize", 0)) {
+                r.touched += touch(fetch(prefix + ".conv.bias"));
+                r.blobs++;
+                continue;
+            }
+            Fetched bn;
+            bn.values[0] = floats(prefix + ".bn.weight");
+            bn.values[1] = floats(prefix + ".bn.bias");
+            bn.values[2] = floats(prefix + ".bn.running_mean");
+            bn.values[3] = floats(prefix + ".bn.running_var");
+            bn.len = sections[i].getInt("filters", 1);
+            batchNorms.push_back(bn);
+            r.blobs += 4;
+        }
+        r.materializeMs = elapsedMs(start);
+
+        size_t before = arena.used();
+        start = std::chrono::high_resolution_clock::now();
+        for (auto& bn : batchNorms) {
+            BatchNormParams params = deriveBatchNorm(arena, bn.values[0], bn.values[1], bn.values[2], bn.values[3], bn.len, 1e-4);
+            r.checksum += static_cast<const float*>(params.scale.values)[0];
+        }
+        for (int upsampleChannels : upsamples) {
+            deriveUpsampleWeights(arena, upsampleChannels);
+        }
+        r.deriveMs = elapsedMs(start);
+        r.derivedBytes = arena.used() - before;
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        r.peakRssKb = usage.ru_maxrss;
+
+        ssize_t written = write(fds[1], &r, sizeof(r));
+        _exit(written == sizeof(r) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t received = pid > 0 ? read(fds[0], &result, sizeof(result)) : -1;
+    close(fds[0]);
+
+    int status = 0;
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+    return received == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static uint64_t fileSize(const std::string& file) {
+    struct stat st;
+    return stat(file.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// Benchmarks the host side of the engine build on synthetic weights with the
+// blob shapes of the real networks. Needs no GPU, results are written as JSON.
+int main(int argc, char** argv) {
+    cxxopts::Options options(argv[0], "--- YOLOV4 HOST BUILD BENCHMARK ---");
+
+    options.add_options()
+        ("n,networks", "Networks to benchmark", cxxopts::value<std::vector<std::string>>()->default_value("yolov4,yolov4tiny,yolov4tiny3l"))
+        ("c,cfg-dir", "Directory with the <network>.cfg files", cxxopts::value<std::string>()->default_value(NETWORK_CFG_DIR))
+        ("d,dir", "Directory for the synthetic weight files", cxxopts::value<std::string>()->default_value("."))
+        ("r,runs", "Number of runs per loader path, the fastest run is reported", cxxopts::value<int>()->default_value("3"))
+        ("o,output", "JSON result file, defaults to stdout", cxxopts::value<std::string>())
+        ("keep", "Keep the synthetic weight files")
+        ("h,help", "Print help screen");
+
+    std::vector<std::string> networks;
+    std::string cfgDir, dir, output;
+    int runs;
+    bool keep;
+
+    // Parse and check options
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help")) {
+            std::cout << options.help() << std::endl;
+            exit(0);
+        }
+
+        networks = result["networks"].as<std::vector<std::string>>();
+        cfgDir = result["cfg-dir"].as<std::string>();
+        dir = result["dir"].as<std::string>();
+        runs = std::max(1, result["runs"].as<int>());
+        output = result.count("output") ? result["output"].as<std::string>() : "";
+        keep = result.count("keep") > 0;
+    }
+    catch(cxxopts::OptionException exception) {
+        std::cout << "[Error] " << exception.what() << std::endl;
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"runs\": " << runs << ",\n  \"results\": [";
+    bool first = true;
+
+    for (auto& network : networks) {
+        std::vector<DarknetSection> sections;
+        std::vector<std::string> files;
+        try {
+            std::string cfgFile = cfgDir + "/" + network + ".cfg";
+            sections = parseDarknetCfg(cfgFile);
+            std::cerr << "[Info] Generating synthetic weights for " << network << std::endl;
+            files = writeSyntheticFiles(cfgFile, sections, dir + "/" + network + "-synthetic");
+        }
+        catch(const std::runtime_error& exception) {
+            std::cerr << "[Error] " << exception.what() << std::endl;
+            return -1;
+        }
+
+        for (int path = 0; path < NB_LOADER_PATHS; ++path) {
+            Phases best{};
+            for (int run = 0; run < runs; ++run) {
+                Phases r;
+                if (!measure(sections, files[path], static_cast<LoaderPath>(path), r)) {
+                    std::cerr << "[Error] Could not load weight file " << files[path] << std::endl;
+                    return -1;
+                }
+                double total = r.loadMs + r.materializeMs + r.deriveMs;
+                if (run == 0 || total < best.loadMs + best.materializeMs + best.deriveMs) {
+                    best = r;
+                }
+            }
+
+            double totalMs = best.loadMs + best.materializeMs + best.deriveMs;
+            uint64_t bytes = fileSize(files[path]);
+            std::cerr << "[Info] " << network << " " << LOADER_PATH_NAMES[path] << ": " << totalMs << " ms" << std::endl;
+
+            json << (first ? "\n" : ",\n") << "    {\"network\": \"" << network << "\", \"loader\": \"" << LOADER_PATH_NAMES[path] << "\""
+                 << ", \"file_bytes\": " << bytes << ", \"blobs\": " << best.blobs
+                 << ", \"load_ms\": " << best.loadMs << ", \"materialize_ms\": " << best.materializeMs << ", \"derive_ms\": " << best.deriveMs
+                 << ", \"total_ms\": " << totalMs << ", \"mb_per_s\": " << bytes / (1024.0 * 1024.0) / (totalMs / 1000.0)
+                 << ", \"derived_bytes\": " << best.derivedBytes << ", \"peak_rss_mb\": " << best.peakRssKb / 1024.0
+                 << ", \"checksum\": " << best.checksum << "}";
+            first = false;
+        }
+
+        if (!keep) {
+            for (int path = 0; path < NB_LOADER_PATHS; ++path) {
+                std::remove(files[path].c_str());
+            }
+            std::remove(darknetCfgFor(files[DARKNET]).c_str());
+        }
+    }
+    json << "\n  ]\n}\n";
+
+    if (output.empty()) {
+        std::cout << json.str();
+    }
+    else {
+        std::ofstream(output) << json.str();
+    }
+
+    return 0;
+}
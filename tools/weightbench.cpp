@@ -0,0 +1,140 @@
+#include "NvInfer.h"
+
+#include "parser/cxxopts.hpp"
+
+#include "utils/weights.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace nvinfer1;
+
+struct LoadResult {
+    double loadMs;
+    double touchMs;
+    long peakRssKb;
+    uint64_t bytes;
+    uint32_t blobs;
+    float checksum;
+};
+
+// Loads the file and reads every value once, as the builder would. Runs in a
+// forked child so that the peak RSS of one loader does not hide the next one.
+// The stream loader is the single threaded iostream reference for text files.
+static bool measure(const std::string& file, bool stream, LoadResult& result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        LoadResult r{};
+
+        auto start = std::chrono::high_resolution_clock::now();
+        WeightArena arena;
+        MappedFile mapping;
+        std::map<std::string, Weights> weightMap = stream ? loadWeights(file, arena) : loadWeights(file, mapping, arena);
+        auto loaded = std::chrono::high_resolution_clock::now();
+
+        for (auto& wt : weightMap) {
+            if (wt.second.type == DataType::kHALF) {
+                const uint16_t* values = static_cast<const uint16_t*>(wt.second.values);
+                for (int64_t i = 0; i < wt.second.count; ++i) {
+                    r.checksum += halfToFloat(values[i]);
+                }
+            }
+            else {
+                const float* values = static_cast<const float*>(wt.second.values);
+                for (int64_t i = 0; i < wt.second.count; ++i) {
+                    r.checksum += values[i];
+                }
+            }
+            r.bytes += wt.second.count * weightTypeSize(wt.second.type);
+        }
+        auto touched = std::chrono::high_resolution_clock::now();
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        r.loadMs = std::chrono::duration<double, std::milli>(loaded - start).count();
+        r.touchMs = std::chrono::duration<double, std::milli>(touched - loaded).count();
+        r.peakRssKb = usage.ru_maxrss;
+        r.blobs = weightMap.size();
+
+        ssize_t written = write(fds[1], &r, sizeof(r));
+        _exit(written == sizeof(r) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t received = pid > 0 ? read(fds[0], &result, sizeof(result)) : -1;
+    close(fds[0]);
+
+    int status = 0;
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+    return received == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Compares load time and peak RSS of the text (.wts) and binary (.wtsb) loaders,
+// text files are loaded both with the stream and the parallel parser
+int main(int argc, char** argv) {
+    cxxopts::Options options(argv[0], "--- YOLOV4 WEIGHT LOADING BENCHMARK ---");
+
+    options.add_options()
+        ("r,runs", "Number of runs per file, the fastest run is reported", cxxopts::value<int>()->default_value("3"))
+        ("files", "Weight files to load", cxxopts::value<std::vector<std::string>>())
+        ("h,help", "Print help screen");
+    options.parse_positional({"files"});
+    options.positional_help("<file.wts> <file.wtsb> ...");
+
+    int runs;
+    std::vector<std::string> files;
+
+    // Parse and check options
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help") || !result.count("files")) {
+            std::cout << options.help() << std::endl;
+            exit(0);
+        }
+
+        runs = std::max(1, result["runs"].as<int>());
+        files = result["files"].as<std::vector<std::string>>();
+    }
+    catch(cxxopts::OptionException exception) {
+        std::cout << "[Error] " << exception.what() << std::endl;
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    printf("%-40s %8s %12s %12s %12s %12s %14s\n", "file", "blobs", "load ms", "touch ms", "MB/s", "peak RSS MB", "checksum");
+    for (auto& file : files) {
+        for (int stream = hasExtension(file, ".wtsb") ? 0 : 1; stream >= 0; --stream) {
+            LoadResult best{};
+            for (int run = 0; run < runs; ++run) {
+                LoadResult r;
+                if (!measure(file, stream, r)) {
+                    std::cerr << "[Error] Could not load weight file " << file << std::endl;
+                    return -1;
+                }
+                if (run == 0 || r.loadMs + r.touchMs < best.loadMs + best.touchMs) {
+                    best = r;
+                }
+            }
+
+            std::string label = file + (stream ? " (stream)" : "");
+            double mb = best.bytes / (1024.0 * 1024.0);
+            printf("%-40.40s %8u %12.2f %12.2f %12.1f %12.1f %14g\n", label.c_str(), best.blobs, best.loadMs, best.touchMs,
+                   mb / ((best.loadMs + best.touchMs) / 1000.0), best.peakRssKb / 1024.0, best.checksum);
+        }
+    }
+
+    return 0;
+}
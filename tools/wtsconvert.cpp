@@ -0,0 +1,89 @@
+#include "NvInfer.h"
+
+#include "parser/cxxopts.hpp"
+
+#include "utils/weights.h"
+
+#include <cmath>
+#include <iostream>
+
+using namespace nvinfer1;
+
+// Converts a text (.wts) or darknet (.weights) weight file into the memory mappable binary format (.wtsb)
+int main(int argc, char** argv) {
+    cxxopts::Options options(argv[0], "--- YOLOV4 WEIGHT CONVERTER ---");
+
+    options.add_options()
+        ("i,input", "Text (.wts) or darknet (.weights, read with the .cfg of the same name) weight file", cxxopts::value<std::string>())
+        ("o,output", "Binary weight file (.wtsb), defaults to the input with a .wtsb extension", cxxopts::value<std::string>())
+        ("fp16", "Store the blobs as half precision, halves the file size for FP16 engines")
+        ("h,help", "Print help screen");
+
+    std::string input, output;
+    bool fp16 = false;
+
+    // Parse and check options
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help") || !result.count("input")) {
+            std::cout << options.help() << std::endl;
+            exit(0);
+        }
+
+        input = result["input"].as<std::string>();
+        if (result.count("output")) {
+            output = result["output"].as<std::string>();
+        }
+        else {
+            output = input.substr(0, input.rfind('.')) + ".wtsb";
+        }
+        fp16 = result.count("fp16") > 0;
+    }
+    catch(cxxopts::OptionException exception) {
+        std::cout << "[Error] " << exception.what() << std::endl;
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    std::cout << "[Info] Loading " << input << std::endl;
+    WeightArena arena;
+    MappedFile inputFile;
+    std::map<std::string, Weights> weightMap;
+    try {
+        weightMap = loadWeights(input, inputFile, arena);
+    }
+    catch(const std::runtime_error& exception) {
+        std::cerr << "[Error] " << exception.what() << std::endl;
+        return -1;
+    }
+
+    if (fp16) {
+        size_t outOfRange = 0;
+        for (auto& wt : weightMap) {
+            if (wt.second.type != DataType::kFLOAT) {
+                continue;
+            }
+            const float* values = static_cast<const float*>(wt.second.values);
+            uint16_t* halfValues = arena.allocate<uint16_t>(wt.second.count);
+            floatToHalf(values, halfValues, wt.second.count);
+            for (int64_t i = 0; i < wt.second.count; ++i) {
+                outOfRange += std::isfinite(values[i]) && std::fabs(values[i]) > 65504.0f;
+            }
+            wt.second = Weights{DataType::kHALF, halfValues, wt.second.count};
+        }
+        if (outOfRange > 0) {
+            std::cout << "[Warning] " << outOfRange << " values are too large for half precision and became infinite" << std::endl;
+        }
+    }
+
+    std::cout << "[Info] Writing " << weightMap.size() << " blobs to " << output << std::endl;
+    if (!writeWeightsBinary(output, weightMap)) {
+        std::cerr << "[Error] Could not write weight file " << output << std::endl;
+        return -1;
+    }
+
+    std::cout << "[Info] Done" << std::endl;
+
+    return 0;
+}
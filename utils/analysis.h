@@ -0,0 +1,290 @@
+#ifndef __TRT_ANALYSIS_H_
+#define __TRT_ANALYSIS_H_
+
+#include "NvInfer.h"
+
+#include "buildoptions.h"
+#include "precisionpolicy.h"
+#include "recordingnetwork.h"
+#include "shapes.h"
+#include "weights.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace nvinfer1;
+
+// Cost estimate of a network without TensorRT runtime or GPU. The network is
+// defined on a RecordingNetwork by the same defineNetwork() as the engine
+// build, so the estimate follows the options (fusions, upsampling, SPPF,
+// precision and FP32 layers) exactly like the build would. The numbers are
+// those of the graph as defined, before the builder fuses layers and picks
+// kernels: FLOPs count a multiply-add as two, parameters and activations are
+// at the precision of the build (FP32 for pinned layers) and the workspace is
+// the largest im2col buffer of a convolution, what a GEMM based tactic needs
+// at least.
+
+// defineNetwork() of a network for the recording backend
+using DefineNetwork = void (*)(RecordingNetwork*, WeightMap&, const BuildOptions&, DataType, unsigned int);
+
+struct LayerCost {
+    int index = 0;
+    std::string name;
+    std::string type;
+    Dims output{};
+    uint64_t flops = 0;
+    uint64_t parameterBytes = 0;
+    uint64_t outputBytes = 0;
+    bool fp32 = false;      // pinned to FP32 in a reduced precision build
+};
+
+struct NetworkCost {
+    std::string network;
+    int inputH = 0;
+    int inputW = 0;
+    int batch = 0;
+    Precision precision = Precision::kFP32;
+    std::vector<LayerCost> layers;
+
+    uint64_t flops = 0;
+    uint64_t parameterBytes = 0;
+    uint64_t activationBytes = 0;       // all layer outputs
+    uint64_t peakActivationBytes = 0;   // outputs live at the same time
+    std::string peakLayer;
+    uint64_t workspaceBytes = 0;        // estimated minimum builder workspace
+    std::string workspaceLayer;
+};
+
+static inline const char* precisionName(Precision precision) {
+    switch (precision) {
+        case Precision::kFP16: return "fp16";
+        case Precision::kINT8: return "int8";
+        default: return "fp32";
+    }
+}
+
+// Elements of the dimensions, dynamic dimensions count as 0
+static inline uint64_t dimsVolume(const Dims& dims) {
+    uint64_t volume = 1;
+    for (int i = 0; i < dims.nbDims; ++i) {
+        volume *= std::max(dims.d[i], 0);
+    }
+    return volume;
+}
+
+// Bytes per activation element of a layer output in a build of the precision
+static inline int activationSize(const RecordedLayer& layer, const RecordedTensor& tensor, Precision precision) {
+    if (tensor.type == DataType::kINT32) {
+        return 4;
+    }
+    for (auto& outputType : layer.outputTypes) {
+        if (outputType.second == DataType::kFLOAT) {
+            return 4;
+        }
+    }
+    return precision == Precision::kINT8 ? 1 : precision == Precision::kFP16 ? 2 : 4;
+}
+
+// FLOPs of one image (implicit batch) or of the whole batch (explicit batch)
+static inline uint64_t layerFlops(const RecordedLayer& layer) {
+    const Dims& in = layer.inputs.empty() || !layer.inputs[0] ? Dims{} : layer.inputs[0]->dims;
+    const Dims& out = layer.outputs[0]->dims;
+    uint64_t outputs = dimsVolume(out);
+    int c = in.nbDims - 3;
+    switch (layer.type) {
+        case LayerType::kCONVOLUTION: {
+            uint64_t macs = static_cast<uint64_t>(in.d[c] / layer.groups) * layer.window.d[0] * layer.window.d[1];
+            return outputs * (2 * macs + (layer.weights[1].count > 0 ? 1 : 0));
+        }
+        case LayerType::kDECONVOLUTION: {
+            uint64_t macs = static_cast<uint64_t>(layer.outputMaps / layer.groups) * layer.window.d[0] * layer.window.d[1];
+            return dimsVolume(in) * 2 * macs;
+        }
+        case LayerType::kSCALE:
+            return outputs * 2;
+        case LayerType::kACTIVATION:
+        case LayerType::kELEMENTWISE:
+            return outputs;
+        case LayerType::kPOOLING:
+            return outputs * layer.window.d[0] * layer.window.d[1];
+        case LayerType::kPLUGIN_V2:
+            return dimsVolume(in);
+        default:
+            return 0;
+    }
+}
+
+// Bytes of the im2col buffer of a convolution, 0 if it needs none
+static inline uint64_t im2colBytes(const RecordedLayer& layer, int elementSize) {
+    if (layer.type != LayerType::kCONVOLUTION || layer.window.d[0] * layer.window.d[1] == 1) {
+        return 0;
+    }
+    const Dims& in = layer.inputs[0]->dims;
+    const Dims& out = layer.outputs[0]->dims;
+    uint64_t rows = static_cast<uint64_t>(in.d[in.nbDims - 3] / layer.groups) * layer.window.d[0] * layer.window.d[1];
+    return rows * dimsVolume(out) / std::max(out.d[out.nbDims - 3], 1) * elementSize;
+}
+
+// Costs of the recorded network, batch is the number of images of an implicit
+// batch network, 1 for explicit batch where it is part of the dimensions
+static NetworkCost costOf(const RecordingNetwork& network, Precision precision, int batch) {
+    NetworkCost cost;
+    cost.precision = precision;
+    cost.batch = batch;
+
+    // Last layer reading each tensor, outputs of the network stay live to the end
+    std::map<const RecordedTensor*, int> lastUse;
+    for (int i = 0; i < network.getNbLayers(); ++i) {
+        for (auto input : network.getLayer(i)->inputs) {
+            if (input) {
+                lastUse[input] = i;
+            }
+        }
+    }
+    for (int i = 0; i < network.getNbOutputs(); ++i) {
+        lastUse[network.getOutput(i)] = network.getNbLayers();
+    }
+
+    // The inputs are bound as FP32 in every precision
+    uint64_t live = 0;
+    const int inputSize = 4;
+    for (int i = 0; i < network.getNbInputs(); ++i) {
+        live += dimsVolume(network.getInput(i)->dims) * batch * inputSize;
+    }
+    std::vector<std::vector<uint64_t>> freed(network.getNbLayers() + 1);
+    for (int i = 0; i < network.getNbInputs(); ++i) {
+        auto input = network.getInput(i);
+        if (lastUse.count(input)) {
+            freed[lastUse[input]].push_back(dimsVolume(input->dims) * batch * inputSize);
+        }
+    }
+
+    for (int i = 0; i < network.getNbLayers(); ++i) {
+        const RecordedLayer& layer = *network.getLayer(i);
+        const RecordedTensor& output = *layer.outputs[0];
+        int elementSize = activationSize(layer, output, precision);
+
+        LayerCost layerCost;
+        layerCost.index = layer.index;
+        layerCost.name = layer.name;
+        layerCost.type = layer.type == LayerType::kPLUGIN_V2 ? layer.pluginType : layerTypeName(layer.type);
+        layerCost.output = output.dims;
+        layerCost.flops = layerFlops(layer) * batch;
+        // Parameters as the engine stores them, at the precision of the layer
+        for (auto& weights : layer.weights) {
+            layerCost.parameterBytes += weights.count * elementSize;
+        }
+        layerCost.outputBytes = dimsVolume(output.dims) * batch * elementSize;
+        layerCost.fp32 = precision != Precision::kFP32 && elementSize == 4 && output.type != DataType::kINT32;
+
+        cost.flops += layerCost.flops;
+        cost.parameterBytes += layerCost.parameterBytes;
+        cost.activationBytes += layerCost.outputBytes;
+
+        // The output is allocated while the inputs are still live
+        live += layerCost.outputBytes;
+        if (live > cost.peakActivationBytes) {
+            cost.peakActivationBytes = live;
+            cost.peakLayer = layer.name;
+        }
+        if (lastUse.count(&output)) {
+            freed[lastUse[&output]].push_back(layerCost.outputBytes);
+        }
+        else {
+            live -= layerCost.outputBytes;
+        }
+        for (auto bytes : freed[i]) {
+            live -= bytes;
+        }
+
+        uint64_t workspace = im2colBytes(layer, elementSize) * batch;
+        if (workspace > cost.workspaceBytes) {
+            cost.workspaceBytes = workspace;
+            cost.workspaceLayer = layer.name;
+        }
+        cost.layers.push_back(layerCost);
+    }
+    return cost;
+}
+
+// Defines the network on a RecordingNetwork with the weights and options of a
+// build and estimates its costs. Dynamic dimensions of an explicit batch build
+// are taken at the largest size of their range. Throws like createEngine() on
+// missing or mismatched weights.
+static NetworkCost analyzeNetwork(const std::string& networkName, DefineNetwork define, Precision networkPrecision, const std::vector<std::string>& fp32Layers,
+                                  const BuildOptions& options, unsigned int maxBatchSize) {
+    BuildOptions analysisOptions = options;
+    for (ShapeRange* range : {&analysisOptions.batch, &analysisOptions.height, &analysisOptions.width}) {
+        range->min = range->opt = range->max;
+    }
+
+    WeightArena arena;
+    WeightMap weightMap(arena);
+    weightMap.load(options.weights, options.cfg);
+    Precision precision = resolvePrecision(options, networkPrecision);
+    weightMap.setHalfWeights(precision == Precision::kFP16);
+
+    RecordingNetwork network(networkCreationFlags(analysisOptions));
+    define(&network, weightMap, analysisOptions, DataType::kFLOAT, maxBatchSize);
+    weightMap.reportUnused();
+    pinLayerPrecision(&network, resolveFp32Layers(options, fp32Layers), precision);
+
+    // The parameters point into the arena, cost them before it goes away
+    NetworkCost cost = costOf(network, precision, network.hasImplicitBatchDimension() ? maxBatchSize : 1);
+    cost.network = networkName;
+    Dims input = network.getInput(0)->dims;
+    cost.inputH = input.d[input.nbDims - 2];
+    cost.inputW = input.d[input.nbDims - 1];
+    if (!network.hasImplicitBatchDimension()) {
+        cost.batch = input.d[0];
+    }
+    return cost;
+}
+
+static std::string costDims(const Dims& dims) {
+    std::string text;
+    for (int i = 0; i < dims.nbDims; ++i) {
+        text += (i ? "x" : "") + std::to_string(dims.d[i]);
+    }
+    return text;
+}
+
+static void writeCostJson(std::ostream& out, const NetworkCost& cost) {
+    out << "{\n  \"network\": \"" << cost.network << "\", \"input_h\": " << cost.inputH << ", \"input_w\": " << cost.inputW
+        << ", \"batch\": " << cost.batch << ", \"precision\": \"" << precisionName(cost.precision) << "\",\n"
+        << "  \"total\": {\"layers\": " << cost.layers.size() << ", \"flops\": " << cost.flops << ", \"parameter_bytes\": " << cost.parameterBytes
+        << ", \"activation_bytes\": " << cost.activationBytes << ", \"peak_activation_bytes\": " << cost.peakActivationBytes
+        << ", \"peak_layer\": \"" << cost.peakLayer << "\", \"workspace_bytes\": " << cost.workspaceBytes
+        << ", \"workspace_layer\": \"" << cost.workspaceLayer << "\"},\n  \"layers\": [";
+    for (size_t i = 0; i < cost.layers.size(); ++i) {
+        const LayerCost& layer = cost.layers[i];
+        out << (i ? ",\n" : "\n") << "    {\"index\": " << layer.index << ", \"name\": \"" << layer.name << "\", \"type\": \"" << layer.type
+            << "\", \"output\": \"" << costDims(layer.output) << "\", \"flops\": " << layer.flops << ", \"parameter_bytes\": " << layer.parameterBytes
+            << ", \"output_bytes\": " << layer.outputBytes << ", \"fp32\": " << (layer.fp32 ? "true" : "false") << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void printCostTable(std::ostream& out, const NetworkCost& cost) {
+    const double mb = 1 << 20;
+    out << std::left << std::setw(6) << "#" << std::setw(28) << "Layer" << std::setw(16) << "Type" << std::setw(18) << "Output"
+        << std::right << std::setw(12) << "MFLOPs" << std::setw(12) << "Params MB" << std::setw(12) << "Output MB" << std::endl;
+    out << std::fixed << std::setprecision(2);
+    for (auto& layer : cost.layers) {
+        out << std::left << std::setw(6) << layer.index << std::setw(28) << layer.name.substr(0, 27) << std::setw(16) << layer.type.substr(0, 15)
+            << std::setw(18) << costDims(layer.output) << std::right << std::setw(12) << layer.flops / 1e6
+            << std::setw(12) << layer.parameterBytes / mb << std::setw(12) << layer.outputBytes / mb << (layer.fp32 ? "  fp32" : "") << std::endl;
+    }
+    out << "[Info] " << cost.network << " " << cost.inputW << "x" << cost.inputH << " batch " << cost.batch << " " << precisionName(cost.precision)
+        << ": " << cost.layers.size() << " layers, " << cost.flops / 1e9 << " GFLOPs, " << cost.parameterBytes / mb << " MB parameters" << std::endl;
+    out << "[Info] Activations " << cost.activationBytes / mb << " MB, peak " << cost.peakActivationBytes / mb << " MB at " << cost.peakLayer << std::endl;
+    out << "[Info] Estimated minimum workspace " << cost.workspaceBytes / mb << " MB (" << cost.workspaceLayer << ")" << std::endl;
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef __TRT_ARENA_H_
+#define __TRT_ARENA_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Bump pointer allocator for all host memory of an engine build: weight blobs
+// and the parameters derived from them. Memory is only given back as a whole,
+// reset() keeps the chunks for the next build, release() frees them.
+// Allocations are not thread safe.
+class WeightArena {
+    public:
+        explicit WeightArena(size_t chunkSize = 64 << 20) : mChunkSize(chunkSize) {}
+
+        WeightArena(const WeightArena&) = delete;
+        WeightArena& operator=(const WeightArena&) = delete;
+
+        ~WeightArena() {
+            release();
+        }
+
+        void* allocate(size_t bytes, size_t alignment = 64) {
+            while (true) {
+                if (mCurrent < mChunks.size()) {
+                    Chunk& chunk = mChunks[mCurrent];
+                    size_t offset = alignUp(mOffset, alignment);
+                    if (offset + bytes <= chunk.size) {
+                        mUsed += offset + bytes - mOffset;
+                        mHighWaterMark = std::max(mHighWaterMark, mUsed);
+                        mOffset = offset + bytes;
+                        return chunk.data + offset;
+                    }
+                    // The tail of this chunk stays unused until the next reset
+                    mUsed += chunk.size - mOffset;
+                    mCurrent++;
+                    mOffset = 0;
+                    continue;
+                }
+
+                Chunk chunk;
+                chunk.size = alignUp(std::max(mChunkSize, bytes), alignment);
+                if (posix_memalign(reinterpret_cast<void**>(&chunk.data), std::max(alignment, sizeof(void*)), chunk.size) != 0) {
+                    throw std::bad_alloc();
+                }
+                mChunks.push_back(chunk);
+            }
+        }
+
+        template <typename T>
+        T* allocate(size_t count) {
+            return static_cast<T*>(allocate(sizeof(T) * std::max<size_t>(count, 1)));
+        }
+
+        // Makes all memory available again, pointers handed out before are invalid
+        void reset() {
+            mCurrent = 0;
+            mOffset = 0;
+            mUsed = 0;
+        }
+
+        void release() {
+            for (auto& chunk : mChunks) {
+                free(chunk.data);
+            }
+            mChunks.clear();
+            reset();
+        }
+
+        // Bytes handed out since the last reset, including alignment padding
+        size_t used() const { return mUsed; }
+
+        // Largest number of bytes in use at any time
+        size_t highWaterMark() const { return mHighWaterMark; }
+
+        size_t reserved() const {
+            size_t total = 0;
+            for (auto& chunk : mChunks) {
+                total += chunk.size;
+            }
+            return total;
+        }
+
+    private:
+        struct Chunk {
+            char* data;
+            size_t size;
+        };
+
+        std::vector<Chunk> mChunks;
+        size_t mChunkSize;
+        size_t mCurrent = 0;
+        size_t mOffset = 0;
+        size_t mUsed = 0;
+        size_t mHighWaterMark = 0;
+};
+
+#endif
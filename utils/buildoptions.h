@@ -0,0 +1,118 @@
+#ifndef __TRT_BUILDOPTIONS_H_
+#define __TRT_BUILDOPTIONS_H_
+
+#include <string>
+#include <vector>
+
+// How the necks upsample feature maps by 2
+enum class UpsampleMode {
+    kDEFAULT,           // the UPSAMPLE_MODE of the network
+    kDECONVOLUTION,     // grouped 2x2 deconvolution with an all ones kernel
+    kRESIZE             // nearest neighbor IResizeLayer
+};
+
+// Precision of the engine layers
+enum class Precision {
+    kDEFAULT,   // the PRECISION of the network
+    kFP32,
+    kFP16,
+    kINT8       // INT8 with FP16 fallback, calibrated on images or a calibration cache
+};
+
+// Smallest, optimal and largest value of an input dimension in the
+// optimization profile of an explicit batch build, all 0 to use the fixed
+// value of the network
+struct ShapeRange {
+    int min = 0;
+    int opt = 0;
+    int max = 0;
+
+    bool empty() const { return max == 0; }
+    bool dynamic() const { return min != max; }
+};
+
+// Options of an engine build that all networks understand
+struct BuildOptions {
+    // Input resolution and number of classes, 0 for the INPUT_H, INPUT_W and
+    // CLASS_NUM of the network
+    int inputH = 0;
+    int inputW = 0;
+    int classes = 0;
+
+    // Anchors (w,h pairs) of each yolo layer in the order of the network,
+    // empty for the YOLO_ANCHORS of the network
+    std::vector<std::vector<float>> anchors;
+
+    // Weight file, text (.wts), binary (.wtsb) or darknet (.weights)
+    std::string weights;
+
+    // Darknet .cfg the "darknet" network is built from, empty for the .cfg
+    // next to the weights (yolov4.cfg for yolov4.weights)
+    std::string cfg;
+
+    // Fold every batch norm into the kernel and bias of its convolution instead of adding a scale layer
+    bool foldBatchNorm = false;
+
+    // Compute Mish with the Mish_TRT plugin instead of softplus, tanh and product layers
+    bool mishPlugin = false;
+
+    // Build the SPP block of yolov4 as three cascaded 5x5 max-pools instead of
+    // 5x5, 9x9 and 13x13 pools of the same input, the outputs are the same
+    bool sppf = false;
+
+    UpsampleMode upsample = UpsampleMode::kDEFAULT;
+
+    // Filter the detections in the yolo layers: only those with objectness
+    // times class probability of at least filterThreshold are output, up to
+    // maxDetections per image, with their number as a second output.
+    // maxDetections 0 outputs every cell and anchor of every yolo layer.
+    float filterThreshold = 0.0f;
+    int maxDetections = 0;
+
+    // Suppress the detections in the engine with the YoloNms_TRT plugin: per
+    // class NMS with nmsIouThreshold over the best nmsTopK detections with a
+    // score of at least nmsScoreThreshold, up to nmsMaxOutputs per image
+    bool nms = false;
+    float nmsIouThreshold = 0.45f;
+    float nmsScoreThreshold = 0.001f;
+    int nmsTopK = 1000;
+    int nmsMaxOutputs = 100;
+
+    Precision precision = Precision::kDEFAULT;
+
+    // Name patterns of the layers kept in FP32 in FP16 and INT8 builds, empty
+    // for the FP32_LAYERS of the network, "none" to pin no layer
+    std::vector<std::string> fp32Layers;
+
+    // INT8 calibration: directory of calibration images, the cache file of
+    // the calibration scales (read if it exists, otherwise written), images
+    // per batch and the number of batches to use, 0 for all images
+    std::string calibrationImages;
+    std::string calibrationCache;
+    int calibrationBatchSize = 8;
+    int calibrationBatches = 0;
+
+    // Build an explicit batch network with one optimization profile over the
+    // ranges below instead of an implicit batch network of fixed resolution
+    bool explicitBatch = false;
+    ShapeRange batch;
+    ShapeRange height;
+    ShapeRange width;
+};
+
+// Precision of the build, the network's unless overridden
+static inline Precision resolvePrecision(const BuildOptions& options, Precision networkPrecision) {
+    return options.precision == Precision::kDEFAULT ? networkPrecision : options.precision;
+}
+
+// Upsample mode of the build, the network's unless overridden
+static inline UpsampleMode resolveUpsampleMode(const BuildOptions& options, UpsampleMode networkMode) {
+    return options.upsample == UpsampleMode::kDEFAULT ? networkMode : options.upsample;
+}
+
+// Anchors of the yolo layer with the given index, the network's unless overridden
+static inline const std::vector<float>& yoloAnchors(const BuildOptions& options, size_t index, const std::vector<float>& networkAnchors) {
+    return index < options.anchors.size() && !options.anchors[index].empty() ? options.anchors[index] : networkAnchors;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef __TRT_CALIBRATION_H_
+#define __TRT_CALIBRATION_H_
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#ifdef USE_OPENCV
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#endif
+
+// Host side of INT8 calibration, independent of TensorRT and CUDA: reading
+// images, letterboxing them like the python client (clients/python/processing.py)
+// and reading and writing the calibration cache. Without OpenCV (USE_OPENCV)
+// only binary PPM (P6) images are read.
+
+// 8 bit RGB image, rows of width * 3 bytes
+struct RgbImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Binary PPM (P6) with a maxval of 255
+static bool readPpm(const std::string& file, RgbImage& image) {
+    std::ifstream in(file, std::ios::binary);
+    std::string magic;
+    int maxval = 0;
+    in >> magic;
+    // Skip comments between the header fields
+    auto field = [&in](int& value) {
+        while (in >> std::ws && in.peek() == '#') {
+            std::string comment;
+            std::getline(in, comment);
+        }
+        return static_cast<bool>(in >> value);
+    };
+    if (magic != "P6" || !field(image.width) || !field(image.height) || !field(maxval) || maxval != 255 ||
+        image.width <= 0 || image.height <= 0) {
+        return false;
+    }
+    in.get();  // the single whitespace before the raster
+
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+    in.read(reinterpret_cast<char*>(image.pixels.data()), image.pixels.size());
+    return static_cast<size_t>(in.gcount()) == image.pixels.size();
+}
+
+static bool readImage(const std::string& file, RgbImage& image) {
+#ifdef USE_OPENCV
+    cv::Mat bgr = cv::imread(file, cv::IMREAD_COLOR);
+    if (bgr.empty()) {
+        return false;
+    }
+    cv::Mat rgb;
+    cv::cvtColor(bgr, rgb, cv::COLOR_BGR2RGB);
+    image.width = rgb.cols;
+    image.height = rgb.rows;
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+    for (int y = 0; y < image.height; ++y) {
+        std::copy(rgb.ptr<uint8_t>(y), rgb.ptr<uint8_t>(y) + image.width * 3, image.pixels.data() + static_cast<size_t>(y) * image.width * 3);
+    }
+    return true;
+#else
+    return readPpm(file, image);
+#endif
+}
+
+static bool isCalibrationImage(const std::string& name) {
+    std::string extension = name.substr(name.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+#ifdef USE_OPENCV
+    for (const char* supported : {"jpg", "jpeg", "png", "bmp", "ppm"}) {
+        if (extension == supported) {
+            return true;
+        }
+    }
+    return false;
+#else
+    return extension == "ppm";
+#endif
+}
+
+// Bilinear resize with pixel centers aligned like cv::resize(INTER_LINEAR)
+static void resizeBilinear(const RgbImage& source, int width, int height, RgbImage& target) {
+    target.width = width;
+    target.height = height;
+    target.pixels.resize(static_cast<size_t>(width) * height * 3);
+
+    float scaleX = static_cast<float>(source.width) / width;
+    float scaleY = static_cast<float>(source.height) / height;
+    for (int y = 0; y < height; ++y) {
+        float sy = std::max((y + 0.5f) * scaleY - 0.5f, 0.0f);
+        int y0 = std::min(static_cast<int>(sy), source.height - 1);
+        int y1 = std::min(y0 + 1, source.height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < width; ++x) {
+            float sx = std::max((x + 0.5f) * scaleX - 0.5f, 0.0f);
+            int x0 = std::min(static_cast<int>(sx), source.width - 1);
+            int x1 = std::min(x0 + 1, source.width - 1);
+            float fx = sx - x0;
+            for (int c = 0; c < 3; ++c) {
+                auto at = [&source, c](int px, int py) {
+                    return static_cast<float>(source.pixels[(static_cast<size_t>(py) * source.width + px) * 3 + c]);
+                };
+                float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+                float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+                float value = top + (bottom - top) * fy;
+                target.pixels[(static_cast<size_t>(y) * width + x) * 3 + c] = static_cast<uint8_t>(std::min(std::max(std::lround(value), 0L), 255L));
+            }
+        }
+    }
+}
+
+// Scales the image to fit inputW x inputH keeping its aspect ratio, centers
+// it on gray (127) and writes it as planar RGB in [0, 1], 3 * inputH * inputW floats
+static void letterbox(const RgbImage& image, int inputH, int inputW, float* chw) {
+    int newW = inputW;
+    int newH = inputH;
+    int offsetX = 0;
+    int offsetY = 0;
+    if (static_cast<float>(inputW) / image.width <= static_cast<float>(inputH) / image.height) {
+        newH = static_cast<int>(static_cast<int64_t>(image.height) * inputW / image.width);
+        offsetY = (inputH - newH) / 2;
+    }
+    else {
+        newW = static_cast<int>(static_cast<int64_t>(image.width) * inputH / image.height);
+        offsetX = (inputW - newW) / 2;
+    }
+
+    RgbImage resized;
+    resizeBilinear(image, newW, newH, resized);
+
+    size_t plane = static_cast<size_t>(inputH) * inputW;
+    std::fill(chw, chw + 3 * plane, 127.0f / 255.0f);
+    for (int y = 0; y < newH; ++y) {
+        for (int x = 0; x < newW; ++x) {
+            const uint8_t* pixel = resized.pixels.data() + (static_cast<size_t>(y) * newW + x) * 3;
+            size_t offset = static_cast<size_t>(y + offsetY) * inputW + x + offsetX;
+            for (int c = 0; c < 3; ++c) {
+                chw[c * plane + offset] = pixel[c] / 255.0f;
+            }
+        }
+    }
+}
+
+// Paths of the calibration images of a directory in sorted order, empty if
+// the directory cannot be read
+static std::vector<std::string> listCalibrationImages(const std::string& directory) {
+    std::vector<std::string> files;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return files;
+    }
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name[0] != '.' && isCalibrationImage(name)) {
+            files.push_back(directory + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Streams the images of a directory in sorted order as batches of
+// letterboxed NCHW floats. Unreadable images are skipped with a warning, a
+// last incomplete batch is dropped.
+class CalibrationStream {
+    public:
+        CalibrationStream(const std::string& directory, int batchSize, int inputH, int inputW, int maxBatches = 0)
+            : mFiles(listCalibrationImages(directory)), mBatchSize(batchSize), mInputH(inputH), mInputW(inputW), mMaxBatches(maxBatches) {}
+
+        int batchSize() const { return mBatchSize; }
+
+        // Floats of one batch
+        size_t batchVolume() const { return static_cast<size_t>(mBatchSize) * 3 * mInputH * mInputW; }
+
+        size_t imageCount() const { return mFiles.size(); }
+
+        int batchesRead() const { return mBatchesRead; }
+
+        // Fills batchVolume() floats, false when there is no complete batch left
+        bool next(float* batch) {
+            if (mMaxBatches > 0 && mBatchesRead >= mMaxBatches) {
+                return false;
+            }
+
+            int filled = 0;
+            RgbImage image;
+            while (filled < mBatchSize && mNextFile < mFiles.size()) {
+                const std::string& file = mFiles[mNextFile++];
+                if (!readImage(file, image)) {
+                    std::cout << "[Warning] Skipping calibration image " << file << ", it could not be read" << std::endl;
+                    continue;
+                }
+                letterbox(image, mInputH, mInputW, batch + filled * 3 * static_cast<size_t>(mInputH) * mInputW);
+                filled++;
+            }
+            if (filled < mBatchSize) {
+                return false;
+            }
+            mBatchesRead++;
+            return true;
+        }
+
+        void reset() {
+            mNextFile = 0;
+            mBatchesRead = 0;
+        }
+
+    private:
+        std::vector<std::string> mFiles;
+        size_t mNextFile = 0;
+        int mBatchSize;
+        int mInputH;
+        int mInputW;
+        int mMaxBatches;
+        int mBatchesRead = 0;
+};
+
+// Contents of a calibration cache file, empty if there is none
+static std::vector<char> readCalibrationCacheFile(const std::string& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        return {};
+    }
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Writes a new file and renames it over the old one, so that concurrent builds
+// never read a partial cache
+static bool writeCalibrationCacheFile(const std::string& file, const void* data, size_t size) {
+    std::string temporary = file + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        out.write(static_cast<const char*>(data), size);
+        if (!out) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), file.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef __TRT_CALIBRATOR_H_
+#define __TRT_CALIBRATOR_H_
+
+#include "NvInfer.h"
+#include "cuda_runtime_api.h"
+
+#include "buildoptions.h"
+#include "calibration.h"
+#include "shapes.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace nvinfer1;
+
+// Entropy calibrator for INT8 builds. Feeds the batches of a
+// CalibrationStream to the builder and keeps the resulting scales in a cache
+// file, so later builds with the same cache skip the calibration.
+class EntropyCalibrator : public IInt8EntropyCalibrator2 {
+    public:
+        // Explicit batch networks calibrate with batches of the calibration
+        // profile, the builder then expects a batch size of 1
+        EntropyCalibrator(std::unique_ptr<CalibrationStream> stream, const std::string& cacheFile, const char* inputName, bool explicitBatch)
+            : mStream(std::move(stream)), mCacheFile(cacheFile), mInputName(inputName), mExplicitBatch(explicitBatch) {
+            if (mStream) {
+                mHostBatch.resize(mStream->batchVolume());
+                if (cudaMalloc(&mDeviceBatch, mHostBatch.size() * sizeof(float)) != cudaSuccess) {
+                    throw std::runtime_error("Could not allocate the calibration batch on the GPU");
+                }
+            }
+        }
+
+        EntropyCalibrator(const EntropyCalibrator&) = delete;
+        EntropyCalibrator& operator=(const EntropyCalibrator&) = delete;
+
+        ~EntropyCalibrator() override {
+            if (mDeviceBatch) {
+                cudaFree(mDeviceBatch);
+            }
+        }
+
+        int getBatchSize() const override {
+            return mExplicitBatch || !mStream ? 1 : mStream->batchSize();
+        }
+
+        bool getBatch(void* bindings[], const char* names[], int nbBindings) override {
+            if (!mStream || !mStream->next(mHostBatch.data())) {
+                return false;
+            }
+            if (cudaMemcpy(mDeviceBatch, mHostBatch.data(), mHostBatch.size() * sizeof(float), cudaMemcpyHostToDevice) != cudaSuccess) {
+                return false;
+            }
+            for (int i = 0; i < nbBindings; ++i) {
+                if (std::string(names[i]) == mInputName) {
+                    bindings[i] = mDeviceBatch;
+                }
+            }
+            std::cout << "[Info] Calibration batch " << mStream->batchesRead() << std::endl;
+            return true;
+        }
+
+        const void* readCalibrationCache(size_t& length) override {
+            mCache = readCalibrationCacheFile(mCacheFile);
+            length = mCache.size();
+            if (!mCache.empty()) {
+                std::cout << "[Info] Using calibration cache " << mCacheFile << std::endl;
+            }
+            return mCache.empty() ? nullptr : mCache.data();
+        }
+
+        void writeCalibrationCache(const void* cache, size_t length) override {
+            if (!writeCalibrationCacheFile(mCacheFile, cache, length)) {
+                std::cout << "[Warning] Could not write calibration cache " << mCacheFile << std::endl;
+            }
+        }
+
+    private:
+        std::unique_ptr<CalibrationStream> mStream;
+        std::string mCacheFile;
+        std::string mInputName;
+        bool mExplicitBatch;
+        std::vector<float> mHostBatch;
+        void* mDeviceBatch = nullptr;
+        std::vector<char> mCache;
+};
+
+// Sets the builder flags of the precision. For INT8 it returns the
+// calibrator, which has to live until the engine is built.
+static std::unique_ptr<EntropyCalibrator> configurePrecision(IBuilder* builder, IBuilderConfig* config, const BuildOptions& options, Precision precision,
+                                                             const char* inputName, unsigned int maxBatchSize, int inputH, int inputW) {
+    if (precision == Precision::kFP16 || precision == Precision::kINT8) {
+        if (!builder->platformHasFastFp16()) {
+            std::cout << "[Warning] The GPU has no fast FP16" << std::endl;
+        }
+        config->setFlag(BuilderFlag::kFP16);
+    }
+    else {
+        config->setFlag(BuilderFlag::kTF32);
+    }
+    if (precision != Precision::kINT8) {
+        return nullptr;
+    }
+
+    if (!builder->platformHasFastInt8()) {
+        std::cout << "[Warning] The GPU has no fast INT8" << std::endl;
+    }
+    config->setFlag(BuilderFlag::kINT8);
+
+    // Explicit batch networks are calibrated at the optimal resolution of the profile
+    int height = options.explicitBatch ? resolveShapeRange(options.height, inputH).opt : inputH;
+    int width = options.explicitBatch ? resolveShapeRange(options.width, inputW).opt : inputW;
+    ShapeRange batch = resolveShapeRange(options.batch, maxBatchSize);
+    if (!options.explicitBatch) {
+        batch.min = 1;
+        batch.max = maxBatchSize;
+    }
+    int batchSize = std::min(std::max(options.calibrationBatchSize, batch.min), batch.max);
+    if (batchSize != options.calibrationBatchSize) {
+        std::cout << "[Info] Calibrating with batches of " << batchSize << ", the engine takes " << batch.min << " to " << batch.max << " images" << std::endl;
+    }
+
+    std::unique_ptr<CalibrationStream> stream;
+    if (!options.calibrationImages.empty()) {
+        stream.reset(new CalibrationStream(options.calibrationImages, batchSize, height, width, options.calibrationBatches));
+        std::cout << "[Info] " << stream->imageCount() << " calibration images in " << options.calibrationImages << std::endl;
+        if (stream->imageCount() < static_cast<size_t>(batchSize)) {
+            stream.reset();
+        }
+    }
+    if (!stream && readCalibrationCacheFile(options.calibrationCache).empty()) {
+        throw std::runtime_error("INT8 needs calibration images or the calibration cache " + options.calibrationCache);
+    }
+
+    if (options.explicitBatch) {
+        IOptimizationProfile* profile = builder->createOptimizationProfile();
+        profile->setDimensions(inputName, OptProfileSelector::kMIN, Dims4{batchSize, 3, height, width});
+        profile->setDimensions(inputName, OptProfileSelector::kOPT, Dims4{batchSize, 3, height, width});
+        profile->setDimensions(inputName, OptProfileSelector::kMAX, Dims4{batchSize, 3, height, width});
+        config->setCalibrationProfile(profile);
+    }
+
+    std::unique_ptr<EntropyCalibrator> calibrator(new EntropyCalibrator(std::move(stream), options.calibrationCache, inputName, options.explicitBatch));
+    config->setInt8Calibrator(calibrator.get());
+    return calibrator;
+}
+
+#endif
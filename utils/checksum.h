@@ -0,0 +1,114 @@
+#ifndef __TRT_CHECKSUM_H_
+#define __TRT_CHECKSUM_H_
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define TRT_CHECKSUM_SSE42 1
+#endif
+
+// CRC32C (Castagnoli) of weight blobs. Uses the SSE 4.2 crc32 instruction when
+// the CPU has it and a slicing by 8 table implementation otherwise, both give
+// the same result.
+
+struct Crc32cTable {
+    uint32_t values[8][256];
+
+    Crc32cTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+            }
+            values[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int slice = 1; slice < 8; ++slice) {
+                values[slice][i] = (values[slice - 1][i] >> 8) ^ values[0][values[slice - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+static inline uint32_t crc32cSoftware(uint32_t crc, const unsigned char* data, size_t size) {
+    static const Crc32cTable table;
+    const uint32_t (*t)[256] = table.values;
+
+    for (; size >= 8; size -= 8, data += 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        word ^= crc;
+        crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^ t[5][(word >> 16) & 0xFF] ^ t[4][(word >> 24) & 0xFF] ^
+              t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^ t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+    }
+    for (; size > 0; --size, ++data) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+    }
+    return crc;
+}
+
+#ifdef TRT_CHECKSUM_SSE42
+__attribute__((target("sse4.2")))
+static inline uint32_t crc32cSse42(uint32_t crc, const unsigned char* data, size_t size) {
+    uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+    for (; size > 0; --size, ++data) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+#endif
+
+static inline uint32_t crc32c(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+#ifdef TRT_CHECKSUM_SSE42
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+    if (sse42) {
+        return ~crc32cSse42(~0u, bytes, size);
+    }
+#endif
+    return ~crc32cSoftware(~0u, bytes, size);
+}
+
+static inline uint64_t rotl64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t fmix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// 64 bit hash for cache keys (MurmurHash3 style mixing, not cryptographic).
+// Chain calls through seed to hash several buffers.
+static inline uint64_t hash64(const void* data, size_t size, uint64_t seed = 0) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ULL);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        word *= 0x87C37B91114253D5ULL;
+        word = rotl64(word, 31);
+        word *= 0x4CF5AD432745937FULL;
+        h ^= word;
+        h = rotl64(h, 27) * 5 + 0x52DCE729;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    h ^= fmix64(tail ^ (size - i));
+    return fmix64(h);
+}
+
+#endif
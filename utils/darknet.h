@@ -0,0 +1,200 @@
+#ifndef __TRT_DARKNET_H_
+#define __TRT_DARKNET_H_
+
+#include "NvInfer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace nvinfer1;
+
+// One [section] of a Darknet .cfg file with its key=value options
+struct DarknetSection {
+    std::string type;
+    std::map<std::string, std::string> options;
+
+    bool has(const std::string& key) const {
+        return options.count(key) > 0;
+    }
+
+    std::string get(const std::string& key, const std::string& defaultValue = "") const {
+        auto option = options.find(key);
+        return option == options.end() ? defaultValue : option->second;
+    }
+
+    int getInt(const std::string& key, int defaultValue) const {
+        return has(key) ? std::atoi(get(key).c_str()) : defaultValue;
+    }
+
+    float getFloat(const std::string& key, float defaultValue) const {
+        return has(key) ? std::atof(get(key).c_str()) : defaultValue;
+    }
+
+    std::vector<float> getFloats(const std::string& key) const {
+        std::vector<float> values;
+        std::stringstream list(get(key));
+        std::string value;
+        while (std::getline(list, value, ',')) {
+            if (value.find_first_not_of(" \t") != std::string::npos) {
+                values.push_back(std::atof(value.c_str()));
+            }
+        }
+        return values;
+    }
+
+    std::vector<int> getInts(const std::string& key) const {
+        std::vector<int> values;
+        for (float value : getFloats(key)) {
+            values.push_back(static_cast<int>(value));
+        }
+        return values;
+    }
+};
+
+static std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return begin == std::string::npos ? "" : text.substr(begin, end - begin + 1);
+}
+
+// Reads all sections of a Darknet .cfg file, the first one is [net]
+static std::vector<DarknetSection> parseDarknetCfg(const std::string& file) {
+    std::ifstream input(file);
+    if (!input.is_open()) {
+        throw std::runtime_error("Unable to load darknet config " + file);
+    }
+
+    std::vector<DarknetSection> sections;
+    std::string line;
+    while (std::getline(input, line)) {
+        line = trim(line.substr(0, line.find_first_of("#;")));
+        if (line.empty()) {
+            continue;
+        }
+
+        if (line.front() == '[') {
+            sections.push_back(DarknetSection{trim(line.substr(1, line.find(']') - 1)), {}});
+            continue;
+        }
+
+        size_t separator = line.find('=');
+        if (sections.empty() || separator == std::string::npos) {
+            throw std::runtime_error("Invalid line in darknet config " + file + ": " + line);
+        }
+        sections.back().options[trim(line.substr(0, separator))] = trim(line.substr(separator + 1));
+    }
+
+    if (sections.empty() || (sections.front().type != "net" && sections.front().type != "network")) {
+        throw std::runtime_error("Darknet config " + file + " does not start with [net]");
+    }
+    return sections;
+}
+
+// Layer index of a route or shortcut reference, relative references are negative
+static int darknetLayerIndex(int reference, int layer) {
+    return reference < 0 ? layer + reference : reference;
+}
+
+// Number of output channels of every layer (sections without [net])
+static std::vector<int> darknetChannels(const std::vector<DarknetSection>& sections) {
+    std::vector<int> channels;
+    int previous = sections.front().getInt("channels", 3);
+    for (size_t i = 1; i < sections.size(); ++i) {
+        const DarknetSection& section = sections[i];
+        int layer = i - 1;
+        int out = previous;
+        if (section.type == "convolutional") {
+            out = section.getInt("filters", 1);
+        }
+        else if (section.type == "route") {
+            out = 0;
+            for (int reference : section.getInts("layers")) {
+                int index = darknetLayerIndex(reference, layer);
+                if (index < 0 || index >= layer) {
+                    throw std::runtime_error("Route in darknet layer " + std::to_string(layer) + " references layer " + std::to_string(index));
+                }
+                out += channels[index];
+            }
+            out /= section.getInt("groups", 1);
+        }
+        channels.push_back(out);
+        previous = out;
+    }
+    return channels;
+}
+
+// Darknet .weights files hold a small header followed by the parameters of
+// every convolutional layer in cfg order as little endian floats:
+// [bias or bn beta] [bn gamma] [bn mean] [bn var] [kernel]
+// The returned weights point straight into the mapped file and use the blob
+// names of the .wts files (model.<layer>.conv.weight, model.<layer>.bn.bias, ...).
+static std::map<std::string, Weights> indexDarknetWeights(const std::vector<DarknetSection>& sections, const char* data, size_t size) {
+    std::map<std::string, Weights> weightMap;
+
+    int32_t version[3];
+    if (size < sizeof(version)) {
+        throw std::runtime_error("Truncated darknet weight file");
+    }
+    memcpy(version, data, sizeof(version));
+    bool wideSeen = version[0] * 10 + version[1] >= 2 && version[0] < 1000 && version[1] < 1000;
+    size_t offset = sizeof(version) + (wideSeen ? sizeof(uint64_t) : sizeof(int32_t));
+
+    auto take = [&](const std::string& name, int64_t count) {
+        if (offset + count * sizeof(float) > size) {
+            throw std::runtime_error("Darknet weight file ends in blob " + name);
+        }
+        weightMap[name] = Weights{DataType::kFLOAT, data + offset, count};
+        offset += count * sizeof(float);
+    };
+
+    std::vector<int> channels = darknetChannels(sections);
+    for (size_t i = 1; i < sections.size(); ++i) {
+        const DarknetSection& section = sections[i];
+        if (section.type != "convolutional") {
+            continue;
+        }
+
+        int layer = i - 1;
+        int inputChannels = layer == 0 ? sections.front().getInt("channels", 3) : channels[layer - 1];
+        int filters = section.getInt("filters", 1);
+        int kernel = section.getInt("size", 1);
+        int groups = section.getInt("groups", 1);
+        std::string prefix = "model." + std::to_string(layer);
+
+        if (section.getInt("batch_normalize", 0)) {
+            take(prefix + ".bn.bias", filters);
+            take(prefix + ".bn.weight", filters);
+            take(prefix + ".bn.running_mean", filters);
+            take(prefix + ".bn.running_var", filters);
+        }
+        else {
+            take(prefix + ".conv.bias", filters);
+        }
+        take(prefix + ".conv.weight", static_cast<int64_t>(filters) * (inputChannels / groups) * kernel * kernel);
+    }
+
+    if (offset != size) {
+        std::cout << "[Warning] Darknet weight file has " << size - offset << " bytes more than the config needs" << std::endl;
+    }
+    return weightMap;
+}
+
+// Darknet keeps the network definition next to the weights, e.g. yolov4.cfg for yolov4.weights
+static std::string darknetCfgFor(const std::string& weightsFile) {
+    size_t extension = weightsFile.rfind(".weights");
+    return (extension == std::string::npos ? weightsFile : weightsFile.substr(0, extension)) + ".cfg";
+}
+
+// The .cfg a Darknet weight file is read with, the given one unless it is empty
+static std::string darknetCfgFor(const std::string& weightsFile, const std::string& cfg) {
+    return cfg.empty() ? darknetCfgFor(weightsFile) : cfg;
+}
+
+#endif
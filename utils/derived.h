@@ -0,0 +1,78 @@
+#ifndef __TRT_DERIVED_H_
+#define __TRT_DERIVED_H_
+
+#include "NvInfer.h"
+
+#include "arena.h"
+
+#include <cmath>
+
+using namespace nvinfer1;
+
+// Parameters the layer helpers compute from the weight blobs on the host,
+// allocated from the arena of the build.
+
+// Per channel scale, shift and power of a batch norm as an IScaleLayer
+struct BatchNormParams {
+    Weights scale;
+    Weights shift;
+    Weights power;
+};
+
+static BatchNormParams deriveBatchNorm(WeightArena& arena, const float* gamma, const float* beta, const float* mean, const float* var, int len, float eps) {
+    float *values = arena.allocate<float>(3 * len);
+    float *scval = values;
+    for (int i = 0; i < len; i++) {
+        scval[i] = gamma[i] / sqrt(var[i] + eps);
+    }
+
+    float *shval = values + len;
+    for (int i = 0; i < len; i++) {
+        shval[i] = beta[i] - mean[i] * gamma[i] / sqrt(var[i] + eps);
+    }
+
+    float *pval = values + 2 * len;
+    for (int i = 0; i < len; i++) {
+        pval[i] = 1.0;
+    }
+
+    return BatchNormParams{Weights{DataType::kFLOAT, scval, len}, Weights{DataType::kFLOAT, shval, len}, Weights{DataType::kFLOAT, pval, len}};
+}
+
+// Convolution kernel and bias with the following batch norm folded in
+struct FoldedConvParams {
+    Weights kernel;
+    Weights bias;
+};
+
+// Folds a batch norm into the bias-less convolution in front of it:
+// kernel' = kernel * gamma / sqrt(var + eps) per output channel and
+// bias' = beta - mean * gamma / sqrt(var + eps), the scale and shift of
+// deriveBatchNorm()
+static FoldedConvParams deriveFoldedConv(WeightArena& arena, const float* kernel, int64_t kernelCount, const float* gamma, const float* beta, const float* mean, const float* var, int len, float eps) {
+    BatchNormParams bn = deriveBatchNorm(arena, gamma, beta, mean, var, len, eps);
+    const float *scale = static_cast<const float*>(bn.scale.values);
+
+    float *kval = arena.allocate<float>(kernelCount);
+    int64_t perChannel = kernelCount / len;
+    for (int i = 0; i < len; i++) {
+        for (int64_t j = i * perChannel; j < (i + 1) * perChannel; j++) {
+            kval[j] = kernel[j] * scale[i];
+        }
+    }
+
+    return FoldedConvParams{Weights{DataType::kFLOAT, kval, kernelCount}, bn.shift};
+}
+
+// Kernel of a 2x2 stride 2 grouped deconvolution that repeats every pixel,
+// i.e. a nearest neighbor upsample by 2
+static Weights deriveUpsampleWeights(WeightArena& arena, int channels) {
+    float *deval = arena.allocate<float>(channels * 2 * 2);
+    for (int i = 0; i < channels * 2 * 2; i++) {
+        deval[i] = 1.0;
+    }
+
+    return Weights{DataType::kFLOAT, deval, channels * 2 * 2};
+}
+
+#endif
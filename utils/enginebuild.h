@@ -0,0 +1,144 @@
+#ifndef __TRT_ENGINE_BUILD_H_
+#define __TRT_ENGINE_BUILD_H_
+
+#include "NvInfer.h"
+
+#include "buildoptions.h"
+#include "calibrator.h"
+#include "precisionpolicy.h"
+#include "shapes.h"
+#include "weights.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace nvinfer1;
+
+// The engine build of every network in two steps. Defining the network is
+// host work on a network of the builder, builds of several engines can do it
+// in parallel. Building the engine from the definition occupies the builder
+// and the device. createEngine() of a network does both in a row.
+
+// defineNetwork() of a network for the builder
+using DefineEngineNetwork = void (*)(INetworkDefinition*, WeightMap&, const BuildOptions&, DataType, unsigned int);
+
+// What the build needs to know about a network besides its layers
+struct NetworkInfo {
+    DefineEngineNetwork define = nullptr;
+    const char* inputBlobName = nullptr;
+    int inputH = 0;                         // resolution of the build, for the optimization profile and the calibration
+    int inputW = 0;
+    Precision precision = Precision::kFP32; // PRECISION of the network
+    std::vector<std::string> fp32Layers;    // FP32_LAYERS of the network
+};
+
+// Network definition of one engine build and the host memory its weights
+// point into, which has to live until the engine is built
+struct DefinedNetwork {
+    INetworkDefinition* network = nullptr;
+    NetworkInfo info;
+    BuildOptions options;
+    unsigned int maxBatchSize = 1;
+    Precision precision = Precision::kFP32;
+    bool strictTypes = false;   // layers are pinned to FP32
+    WeightArena arena;
+    std::unique_ptr<WeightMap> weightMap;
+
+    DefinedNetwork() = default;
+    DefinedNetwork(const DefinedNetwork&) = delete;
+    DefinedNetwork& operator=(const DefinedNetwork&) = delete;
+
+    ~DefinedNetwork() {
+        if (network) {
+            network->destroy();
+        }
+    }
+};
+
+// Adds the layers of the network to the empty network, created by the builder
+// with networkCreationFlags(options), which defined takes over. The weights
+// are loaded from options.weights, or taken from sharedWeights if that is a
+// map already loaded from the file.
+static void defineEngineNetwork(DefinedNetwork& defined, INetworkDefinition* network, const NetworkInfo& info, const BuildOptions& options,
+                                unsigned int maxBatchSize, DataType dt, WeightMap* sharedWeights = nullptr) {
+    defined.network = network;
+    defined.info = info;
+    defined.options = options;
+    defined.maxBatchSize = maxBatchSize;
+
+    if (sharedWeights) {
+        defined.weightMap.reset(new WeightMap(defined.arena, *sharedWeights));
+    }
+    else {
+        defined.weightMap.reset(new WeightMap(defined.arena));
+        defined.weightMap->load(options.weights, options.cfg);
+    }
+    WeightMap& weightMap = *defined.weightMap;
+    defined.precision = resolvePrecision(options, info.precision);
+    weightMap.setHalfWeights(defined.precision == Precision::kFP16);
+
+    info.define(network, weightMap, options, dt, maxBatchSize);
+    weightMap.reportUnused();
+
+    defined.strictTypes = !pinLayerPrecision(network, resolveFp32Layers(options, info.fp32Layers), defined.precision).empty();
+}
+
+// Builds the engine of a defined network on the builder that created the
+// network, then releases the network and its host memory
+static ICudaEngine* buildDefinedNetwork(DefinedNetwork& defined, IBuilder* builder, IBuilderConfig* config) {
+    const NetworkInfo& info = defined.info;
+    const BuildOptions& options = defined.options;
+
+    // Build engine
+    if (options.explicitBatch) {
+        if (!addImageProfile(builder, config, options, info.inputBlobName, defined.maxBatchSize, info.inputH, info.inputW)) {
+            throw std::runtime_error("Invalid optimization profile for " + std::string(info.inputBlobName));
+        }
+    }
+    else {
+        builder->setMaxBatchSize(defined.maxBatchSize);
+    }
+    config->setMaxWorkspaceSize(16 * (1 << 20));  // 16MB
+    auto calibrator = configurePrecision(builder, config, options, defined.precision, info.inputBlobName, defined.maxBatchSize, info.inputH, info.inputW);
+    if (defined.strictTypes) {
+        config->setFlag(BuilderFlag::kSTRICT_TYPES);
+    }
+    ICudaEngine* engine = builder->buildEngineWithConfig(*defined.network, *config);
+
+    // Don't need the network any more
+    defined.network->destroy();
+    defined.network = nullptr;
+
+    // Release host memory
+    std::cout << "[Info] Weight memory high-water mark " << defined.arena.highWaterMark() / (1 << 20) << " MB" << std::endl;
+    defined.weightMap.reset();
+    defined.arena.release();
+
+    return engine;
+}
+
+// Serializes the engine into the file, returns its size
+static size_t saveEngine(ICudaEngine* engine, const std::string& file) {
+    IHostMemory* modelStream = engine->serialize();
+    if (!modelStream) {
+        throw std::runtime_error("Could not serialize the engine of " + file);
+    }
+    std::ofstream p(file.c_str(), std::ios::binary);
+    if (!p) {
+        modelStream->destroy();
+        throw std::runtime_error("Could not open engine output file " + file);
+    }
+    p.write(reinterpret_cast<const char*>(modelStream->data()), modelStream->size());
+    size_t size = modelStream->size();
+    modelStream->destroy();
+    if (!p) {
+        throw std::runtime_error("Could not write engine output file " + file);
+    }
+    return size;
+}
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef __TRT_ENGINE_CACHE_H_
+#define __TRT_ENGINE_CACHE_H_
+
+#include "NvInfer.h"
+
+#include "buildoptions.h"
+#include "calibration.h"
+#include "checksum.h"
+#include "darknet.h"
+#include "enginebuild.h"
+#include "precisionpolicy.h"
+#include "weights.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <link.h>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#include <vector>
+
+using namespace nvinfer1;
+
+// Local store of built engines addressed by the inputs of their build, so an
+// unchanged build copies its engine instead of running the builder again.
+// Needs neither a GPU nor the TensorRT runtime, main.cpp passes in what it
+// knows about them.
+
+// Bump whenever a change of the network definitions or the build settings
+// gives other engines for the same inputs, so older cached engines are not
+// used anymore
+static const char ENGINE_CACHE_VERSION[] = "enginecache/2";
+
+// Hash of the contents of a file, chained to seed
+static uint64_t hashFile(const std::string& file, uint64_t seed = 0) {
+    MappedFile mapping;
+    if (!mapping.open(file)) {
+        throw std::runtime_error("Unable to read " + file + " for the engine cache key");
+    }
+    return hash64(mapping.data(), mapping.size(), seed);
+}
+
+static std::string hexKey(uint64_t key) {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key;
+    return name.str();
+}
+
+static bool fileExists(const std::string& file) {
+    struct stat st;
+    return stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static size_t fileSize(const std::string& file) {
+    struct stat st;
+    return stat(file.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// Path of the shared library of this process named library (or library.<n>),
+// empty if it is not loaded
+static std::string loadedLibrary(const std::string& library) {
+    struct Search {
+        const std::string& library;
+        std::string path;
+    } search{library, ""};
+    dl_iterate_phdr([](dl_phdr_info* info, size_t, void* data) {
+        Search& search = *static_cast<Search*>(data);
+        std::string path = info->dlpi_name ? info->dlpi_name : "";
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        if (name == search.library || name.compare(0, search.library.size() + 1, search.library + ".") == 0) {
+            search.path = path;
+            return 1;
+        }
+        return 0;
+    }, &search);
+    return search.path;
+}
+
+// Hash of the calibration images of a directory, their names, sizes and
+// contents in the order they are calibrated in
+static uint64_t hashCalibrationImages(const std::string& directory) {
+    uint64_t key = 0;
+    for (auto& file : listCalibrationImages(directory)) {
+        std::string name = file.substr(directory.size() + 1);
+        uint64_t size = fileSize(file);
+        key = hash64(name.data(), name.size(), key);
+        key = hash64(&size, sizeof(size), key);
+        if (size > 0) {
+            key = hashFile(file, key);
+        }
+    }
+    return key;
+}
+
+// Everything an engine is built from, one "name=value" per line. Files are
+// given by the hash of their contents, not their path, so a renamed weight
+// file still hits and a retrained one does not. environment holds the
+// TensorRT version, the plugin library and the device (see main.cpp).
+static std::string describeEngineBuild(const std::string& network, const BuildOptions& options, const NetworkInfo& info,
+                                       unsigned int maxBatchSize, const std::string& environment) {
+    Precision precision = resolvePrecision(options, info.precision);
+    std::ostringstream text;
+    text << "version=" << ENGINE_CACHE_VERSION << "\n";
+    text << environment;
+    text << "network=" << network << "\n";
+    text << "weights=" << hexKey(hashFile(options.weights)) << "\n";
+    if (!options.cfg.empty() || hasExtension(options.weights, ".weights")) {
+        text << "cfg=" << hexKey(hashFile(options.cfg.empty() ? darknetCfgFor(options.weights) : options.cfg)) << "\n";
+    }
+    text << "input=" << info.inputW << "x" << info.inputH << "\n";
+    text << "classes=" << options.classes << "\n";
+    text << "anchors=";
+    for (auto& layer : options.anchors) {
+        for (float anchor : layer) {
+            text << anchor << ",";
+        }
+        text << ";";
+    }
+    text << "\n";
+    text << "upsample=" << static_cast<int>(options.upsample) << "\n";
+    text << "foldbn=" << options.foldBatchNorm << " mishplugin=" << options.mishPlugin << " sppf=" << options.sppf << "\n";
+    if (options.maxDetections > 0) {
+        text << "filter=" << options.filterThreshold << " " << options.maxDetections << "\n";
+    }
+    if (options.nms) {
+        text << "nms=" << options.nmsIouThreshold << " " << options.nmsScoreThreshold << " " << options.nmsTopK << " " << options.nmsMaxOutputs << "\n";
+    }
+    text << "precision=" << static_cast<int>(precision) << "\n";
+    if (precision != Precision::kFP32) {
+        text << "fp32layers=";
+        for (auto& pattern : resolveFp32Layers(options, info.fp32Layers)) {
+            text << pattern << ",";
+        }
+        text << "\n";
+    }
+    if (precision == Precision::kINT8) {
+        // The images and batches the scales are calibrated from, and the
+        // scales of an existing calibration cache, which the builder uses
+        // instead of calibrating again
+        text << "calibration=" << hexKey(hashCalibrationImages(options.calibrationImages)) << " "
+             << options.calibrationBatchSize << "x" << options.calibrationBatches << "\n";
+        if (fileExists(options.calibrationCache)) {
+            text << "calibrationcache=" << hexKey(hashFile(options.calibrationCache)) << "\n";
+        }
+    }
+    text << "maxbatch=" << maxBatchSize << "\n";
+    if (options.explicitBatch) {
+        text << "profile=" << options.batch.min << "," << options.batch.opt << "," << options.batch.max << " "
+             << options.height.min << "," << options.height.opt << "," << options.height.max << " "
+             << options.width.min << "," << options.width.opt << "," << options.width.max << "\n";
+    }
+    return text.str();
+}
+
+// Directory of engines <key>.engine, each with the description of its build
+// in <key>.build. A hit marks the engine as used, store() evicts the least
+// recently used engines until the directory holds at most maxBytes.
+class EngineCache {
+    public:
+        EngineCache(const std::string& directory, size_t maxBytes) : mDirectory(directory), mMaxBytes(maxBytes) {
+            mkdir(directory.c_str(), 0755);
+        }
+
+        static std::string key(const std::string& description) {
+            return hexKey(hash64(description.data(), description.size()));
+        }
+
+        // Copies the cached engine of the build into file, false if there is
+        // none. The stored description has to match, not only its hash.
+        bool fetch(const std::string& description, const std::string& file) {
+            std::string base = mDirectory + "/" + key(description);
+            std::ifstream build(base + ".build");
+            std::stringstream stored;
+            stored << build.rdbuf();
+            if (!build || stored.str() != description || !copyFile(base + ".engine", file)) {
+                return false;
+            }
+            utime((base + ".engine").c_str(), nullptr);
+            return true;
+        }
+
+        // Adds the engine file of the build, then evicts, false if it could
+        // not be added. Both files are written under names of their own and
+        // renamed into place, the .build last, so that a concurrent fetch()
+        // never sees a description without its complete engine.
+        bool store(const std::string& description, const std::string& file) {
+            std::string base = mDirectory + "/" + key(description);
+            std::string temporary = temporaryName(base);
+            if (!copyFile(file, temporary) || std::rename(temporary.c_str(), (base + ".engine").c_str()) != 0) {
+                std::remove(temporary.c_str());
+                return false;
+            }
+            temporary = temporaryName(base);
+            std::ofstream build(temporary);
+            build << description;
+            build.close();
+            if (!build || std::rename(temporary.c_str(), (base + ".build").c_str()) != 0) {
+                std::remove(temporary.c_str());
+                std::remove((base + ".engine").c_str());
+                return false;
+            }
+            evict(base + ".engine");
+            return true;
+        }
+
+        // Removes the least recently used engines other than keep until the cache fits
+        void evict(const std::string& keep = "") {
+            struct Entry {
+                std::string file;
+                size_t bytes;
+                struct timespec used;
+            };
+            std::vector<Entry> entries;
+            size_t total = 0;
+            DIR* dir = opendir(mDirectory.c_str());
+            if (!dir) {
+                return;
+            }
+            while (dirent* entry = readdir(dir)) {
+                std::string file = mDirectory + "/" + entry->d_name;
+                struct stat st;
+                if (hasExtension(file, ".engine") && stat(file.c_str(), &st) == 0) {
+                    entries.push_back(Entry{file, static_cast<size_t>(st.st_size), st.st_mtim});
+                    total += st.st_size;
+                }
+            }
+            closedir(dir);
+
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+                return a.used.tv_sec != b.used.tv_sec ? a.used.tv_sec < b.used.tv_sec : a.used.tv_nsec < b.used.tv_nsec;
+            });
+            for (auto& entry : entries) {
+                if (total <= mMaxBytes) {
+                    break;
+                }
+                if (entry.file == keep) {
+                    continue;
+                }
+                std::cout << "[Info] Evicting " << entry.file << " from the engine cache" << std::endl;
+                std::remove(entry.file.c_str());
+                std::remove((entry.file.substr(0, entry.file.size() - 7) + ".build").c_str());
+                total -= entry.bytes;
+            }
+        }
+
+    private:
+        // Unique across the processes and threads storing into the cache
+        static std::string temporaryName(const std::string& base) {
+            static std::atomic<unsigned> counter{0};
+            return base + ".tmp" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+        }
+
+        static bool copyFile(const std::string& from, const std::string& to) {
+            MappedFile mapping;
+            if (!mapping.open(from)) {
+                return false;
+            }
+            std::ofstream output(to, std::ios::binary);
+            output.write(mapping.data(), mapping.size());
+            output.close();
+            return static_cast<bool>(output);
+        }
+
+        std::string mDirectory;
+        size_t mMaxBytes;
+};
+
+#endif
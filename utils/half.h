@@ -0,0 +1,135 @@
+#ifndef __TRT_HALF_H_
+#define __TRT_HALF_H_
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRT_HALF_F16C 1
+#endif
+
+// IEEE 754 half precision conversion on the host. Uses F16C instructions when
+// the CPU has them and falls back to a bit exact software conversion (round to
+// nearest even, like F16C) otherwise.
+
+static inline float halfToFloat(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t bits;
+
+    if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0);  // inf or quiet nan
+    }
+    else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0) {
+        bits = sign;
+    }
+    else {
+        // Subnormal half, normalize it
+        exponent = 113;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline uint16_t floatToHalf(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude >= 0x7F800000) {
+        // inf stays inf, nan stays a quiet nan
+        return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 | ((magnitude >> 13) & 0x3FF) : 0);
+    }
+    if (magnitude >= 0x477FF000) {
+        return sign | 0x7C00;  // rounds to more than the largest half
+    }
+    if (magnitude < 0x38800000) {
+        // Subnormal half or zero: shift the implicit bit in and round to nearest even
+        if (magnitude < 0x33000000) {
+            return sign;
+        }
+        uint32_t exponent = magnitude >> 23;
+        uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        half += rest > halfway || (rest == halfway && (half & 1));
+        return sign | half;
+    }
+
+    uint32_t half = ((magnitude >> 13) - (112 << 10));
+    uint32_t rest = magnitude & 0x1FFF;
+    half += rest > 0x1000 || (rest == 0x1000 && (half & 1));
+    return sign | half;
+}
+
+#ifdef TRT_HALF_F16C
+__attribute__((target("avx,f16c")))
+static inline void halfToFloatF16C(const uint16_t* in, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+    }
+    for (; i < count; ++i) {
+        out[i] = halfToFloat(in[i]);
+    }
+}
+
+__attribute__((target("avx,f16c")))
+static inline void floatToHalfF16C(const float* in, uint16_t* out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+    }
+    for (; i < count; ++i) {
+        out[i] = floatToHalf(in[i]);
+    }
+}
+
+static inline bool hasF16C() {
+    static const bool supported = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    return supported;
+}
+#endif
+
+static inline void halfToFloat(const uint16_t* in, float* out, size_t count) {
+#ifdef TRT_HALF_F16C
+    if (hasF16C()) {
+        halfToFloatF16C(in, out, count);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = halfToFloat(in[i]);
+    }
+}
+
+static inline void floatToHalf(const float* in, uint16_t* out, size_t count) {
+#ifdef TRT_HALF_F16C
+    if (hasF16C()) {
+        floatToHalfF16C(in, out, count);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = floatToHalf(in[i]);
+    }
+}
+
+#endif
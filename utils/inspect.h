@@ -0,0 +1,265 @@
+#ifndef __TRT_INSPECT_H_
+#define __TRT_INSPECT_H_
+
+#include "NvInfer.h"
+#include "cuda_runtime_api.h"
+
+#include "analysis.h"
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace nvinfer1;
+
+// What TensorRT made of a network: the bindings of a serialized engine, its
+// memory requirements and the layers left after fusion with their time in
+// one profiled execution. The report and its JSON writer are plain data,
+// only inspectEngine() needs the GPU and the plugin library.
+
+struct BindingReport {
+    int index = 0;
+    std::string name;
+    bool input = false;
+    DataType type = DataType::kFLOAT;
+    Dims dims{};        // of the engine, -1 for dynamic dimensions
+    Dims min{};         // of the optimization profile, explicit batch engines only
+    Dims opt{};
+    Dims max{};
+    uint64_t bytes = 0; // at the largest batch and shape
+};
+
+struct EngineReport {
+    std::string engine;
+    uint64_t engineBytes = 0;
+    bool implicitBatch = true;
+    int maxBatchSize = 1;
+    uint64_t deviceMemoryBytes = 0;     // activations and workspace of an execution context
+    int optimizationProfiles = 0;
+    int nbLayers = 0;                   // layers of the engine after fusion
+    std::vector<BindingReport> bindings;
+    std::vector<std::pair<std::string, float>> layers;  // name and ms of the profiled execution
+};
+
+static inline const char* dataTypeName(DataType type) {
+    switch (type) {
+        case DataType::kHALF: return "fp16";
+        case DataType::kINT8: return "int8";
+        case DataType::kINT32: return "int32";
+        case DataType::kBOOL: return "bool";
+        default: return "fp32";
+    }
+}
+
+static inline int dataTypeSize(DataType type) {
+    switch (type) {
+        case DataType::kHALF: return 2;
+        case DataType::kINT8:
+        case DataType::kBOOL: return 1;
+        default: return 4;
+    }
+}
+
+// Fused layers are named after their parts joined by " + "
+static inline bool isFusedLayer(const std::string& name) {
+    return name.find(" + ") != std::string::npos;
+}
+
+// YoloLayer_TRT layers are named yolo<N> by the networks
+static inline bool isYoloLayer(const std::string& name) {
+    if (name.compare(0, 4, "yolo") != 0 || name.size() == 4) {
+        return false;
+    }
+    for (size_t i = 4; i < name.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(name[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Quoted and escaped, control characters as \u00XX
+static std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            quoted += escaped;
+            continue;
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+static void writeEngineReportJson(std::ostream& out, const EngineReport& report) {
+    int fused = 0;
+    int yolo = 0;
+    float totalMs = 0.0f;
+    for (auto& layer : report.layers) {
+        fused += isFusedLayer(layer.first) ? 1 : 0;
+        yolo += isYoloLayer(layer.first) ? 1 : 0;
+        totalMs += layer.second;
+    }
+
+    out << "{\n  \"engine\": " << jsonString(report.engine) << ", \"engine_bytes\": " << report.engineBytes
+        << ", \"implicit_batch\": " << (report.implicitBatch ? "true" : "false") << ", \"max_batch_size\": " << report.maxBatchSize
+        << ", \"device_memory_bytes\": " << report.deviceMemoryBytes << ", \"optimization_profiles\": " << report.optimizationProfiles << ",\n"
+        << "  \"bindings\": [";
+    for (size_t i = 0; i < report.bindings.size(); ++i) {
+        const BindingReport& binding = report.bindings[i];
+        out << (i ? ",\n" : "\n") << "    {\"index\": " << binding.index << ", \"name\": " << jsonString(binding.name)
+            << ", \"input\": " << (binding.input ? "true" : "false") << ", \"type\": \"" << dataTypeName(binding.type)
+            << "\", \"dims\": \"" << costDims(binding.dims) << "\"";
+        if (!report.implicitBatch) {
+            out << ", \"min\": \"" << costDims(binding.min) << "\", \"opt\": \"" << costDims(binding.opt) << "\", \"max\": \"" << costDims(binding.max) << "\"";
+        }
+        out << ", \"bytes\": " << binding.bytes << "}";
+    }
+    out << "\n  ],\n  \"total\": {\"layers\": " << report.nbLayers << ", \"profiled_layers\": " << report.layers.size() << ", \"fused_layers\": " << fused
+        << ", \"yolo_layers\": " << yolo << ", \"ms\": " << totalMs << "},\n  \"layers\": [";
+    for (size_t i = 0; i < report.layers.size(); ++i) {
+        out << (i ? ",\n" : "\n") << "    {\"index\": " << i << ", \"name\": " << jsonString(report.layers[i].first) << ", \"ms\": " << report.layers[i].second
+            << ", \"fused\": " << (isFusedLayer(report.layers[i].first) ? "true" : "false") << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void printEngineReport(std::ostream& out, const EngineReport& report) {
+    const double mb = 1 << 20;
+    out << std::fixed << std::setprecision(2);
+    for (auto& binding : report.bindings) {
+        out << "[Info] " << (binding.input ? "Input  " : "Output ") << binding.name << " " << dataTypeName(binding.type) << " " << costDims(binding.dims)
+            << ", " << binding.bytes / mb << " MB" << std::endl;
+    }
+    int yolo = 0;
+    for (auto& layer : report.layers) {
+        yolo += isYoloLayer(layer.first) ? 1 : 0;
+    }
+    out << "[Info] " << report.nbLayers << " layers, " << yolo << " YoloLayer_TRT, " << report.deviceMemoryBytes / mb << " MB device memory, "
+        << report.engineBytes / mb << " MB engine" << std::endl;
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+// Collects the layer times reported by an execution
+class LayerTimes : public IProfiler {
+    public:
+        void reportLayerTime(const char* layerName, float ms) override {
+            mLayers.emplace_back(layerName, ms);
+        }
+
+        std::vector<std::pair<std::string, float>> mLayers;
+};
+
+// Deserializes the engine file on the current device and runs it once on
+// zero inputs to list its layers, at the largest batch of an implicit batch
+// engine or the optimal shapes of the profile of an explicit batch engine
+static EngineReport inspectEngine(const std::string& file, ILogger& logger) {
+    std::ifstream input(file, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Unable to read engine " + file);
+    }
+    std::stringstream content;
+    content << input.rdbuf();
+    const std::string blob = content.str();
+
+    IRuntime* runtime = createInferRuntime(logger);
+    ICudaEngine* engine = runtime->deserializeCudaEngine(blob.data(), blob.size(), nullptr);
+    if (!engine) {
+        runtime->destroy();
+        throw std::runtime_error("Could not deserialize engine " + file + ", it needs the TensorRT version it was built with and liblayerplugin.so");
+    }
+
+    EngineReport report;
+    report.engine = file;
+    report.engineBytes = blob.size();
+    report.implicitBatch = engine->hasImplicitBatchDimension();
+    report.maxBatchSize = engine->getMaxBatchSize();
+    report.deviceMemoryBytes = engine->getDeviceMemorySize();
+    report.optimizationProfiles = engine->getNbOptimizationProfiles();
+    report.nbLayers = engine->getNbLayers();
+
+    IExecutionContext* context = engine->createExecutionContext();
+    std::vector<void*> buffers(engine->getNbBindings(), nullptr);
+    for (int i = 0; i < engine->getNbBindings(); ++i) {
+        BindingReport binding;
+        binding.index = i;
+        binding.name = engine->getBindingName(i);
+        binding.input = engine->bindingIsInput(i);
+        binding.type = engine->getBindingDataType(i);
+        binding.dims = engine->getBindingDimensions(i);
+        if (report.implicitBatch) {
+            binding.bytes = dimsVolume(binding.dims) * report.maxBatchSize * dataTypeSize(binding.type);
+        }
+        else if (binding.input) {
+            binding.min = engine->getProfileDimensions(i, 0, OptProfileSelector::kMIN);
+            binding.opt = engine->getProfileDimensions(i, 0, OptProfileSelector::kOPT);
+            binding.max = engine->getProfileDimensions(i, 0, OptProfileSelector::kMAX);
+            binding.bytes = dimsVolume(binding.max) * dataTypeSize(binding.type);
+        }
+        report.bindings.push_back(binding);
+    }
+
+    // Outputs of an explicit batch engine follow from the input shapes, the
+    // optimal ones are set last for the execution
+    if (!report.implicitBatch) {
+        for (OptProfileSelector selector : {OptProfileSelector::kMIN, OptProfileSelector::kMAX, OptProfileSelector::kOPT}) {
+            for (auto& binding : report.bindings) {
+                if (binding.input) {
+                    context->setBindingDimensions(binding.index, engine->getProfileDimensions(binding.index, 0, selector));
+                }
+            }
+            for (auto& binding : report.bindings) {
+                if (!binding.input) {
+                    Dims& dims = selector == OptProfileSelector::kMIN ? binding.min : selector == OptProfileSelector::kMAX ? binding.max : binding.opt;
+                    dims = context->getBindingDimensions(binding.index);
+                    binding.bytes = dimsVolume(binding.max) * dataTypeSize(binding.type);
+                }
+            }
+        }
+    }
+    for (auto& binding : report.bindings) {
+        uint64_t bytes = report.implicitBatch ? binding.bytes : dimsVolume(binding.opt) * dataTypeSize(binding.type);
+        if (cudaMalloc(&buffers[binding.index], bytes) != cudaSuccess) {
+            buffers[binding.index] = nullptr;
+        }
+        else {
+            cudaMemset(buffers[binding.index], 0, bytes);
+        }
+    }
+
+    // A warm up, then the profiled execution
+    LayerTimes times;
+    bool executed = std::find(buffers.begin(), buffers.end(), nullptr) == buffers.end();
+    for (int run = 0; executed && run < 2; ++run) {
+        context->setProfiler(run ? &times : nullptr);
+        executed = report.implicitBatch ? context->execute(report.maxBatchSize, buffers.data()) : context->executeV2(buffers.data());
+    }
+    if (!executed) {
+        std::cout << "[Warning] Could not execute " << file << ", the report has no layer list" << std::endl;
+    }
+    report.layers = times.mLayers;
+
+    for (void* buffer : buffers) {
+        if (buffer) {
+            cudaFree(buffer);
+        }
+    }
+    context->destroy();
+    engine->destroy();
+    runtime->destroy();
+    return report;
+}
+
+#endif
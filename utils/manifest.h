@@ -0,0 +1,253 @@
+#ifndef __TRT_MANIFEST_H_
+#define __TRT_MANIFEST_H_
+
+#include "NvInfer.h"
+#include "cuda_runtime_api.h"
+
+#include "enginebuild.h"
+#include "threadpool.h"
+#include "weights.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace nvinfer1;
+
+// Builds of many engines listed in a manifest file, one command line of
+// options per line. Every weight file is loaded once and shared by all builds
+// from it. The networks are defined in parallel on a thread pool, a few
+// builds ahead of the device, while the engines are built one at a time per
+// device, each device with its own builder.
+
+// Arguments of the build lines of a manifest with their line numbers. Lines
+// are split at blanks, double quotes keep blanks in an argument, # starts a
+// comment.
+static std::vector<std::pair<int, std::vector<std::string>>> readManifest(const std::string& file) {
+    std::ifstream input(file);
+    if (!input.is_open()) {
+        throw std::runtime_error("Unable to read manifest " + file);
+    }
+
+    std::vector<std::pair<int, std::vector<std::string>>> lines;
+    std::string line;
+    int number = 0;
+    while (std::getline(input, line)) {
+        number++;
+        std::vector<std::string> arguments;
+        std::string argument;
+        bool quoted = false;
+        bool started = false;
+        for (char c : line) {
+            if (c == '"') {
+                quoted = !quoted;
+                started = true;
+            }
+            else if (!quoted && c == '#') {
+                break;
+            }
+            else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+                if (started) {
+                    arguments.push_back(argument);
+                }
+                argument.clear();
+                started = false;
+            }
+            else {
+                argument += c;
+                started = true;
+            }
+        }
+        if (quoted) {
+            throw std::runtime_error("Unbalanced quote in line " + std::to_string(number) + " of manifest " + file);
+        }
+        if (started) {
+            arguments.push_back(argument);
+        }
+        if (!arguments.empty()) {
+            lines.emplace_back(number, arguments);
+        }
+    }
+    return lines;
+}
+
+// One engine of a manifest and, after buildManifest(), how its build went
+struct ManifestBuild {
+    std::string engine;     // output file
+    NetworkInfo info;
+    BuildOptions options;
+    int device = 0;
+    bool cached = false;    // copied from the engine cache, not built
+
+    double defineMs = 0.0;
+    double buildMs = 0.0;
+    size_t bytes = 0;
+    std::string error;      // empty if the engine was written
+};
+
+// Builds all engines not cached, a failed build is recorded in its entry and the others
+// go on. At most jobs networks per device are defined but not yet built,
+// which bounds the host memory; 0 for one per pool thread.
+static void buildManifest(std::vector<ManifestBuild>& builds, unsigned int maxBatchSize, ILogger& logger, unsigned int jobs = 0) {
+    using Clock = std::chrono::high_resolution_clock;
+
+    // Weight files shared by the builds, loaded up front, by file and the .cfg
+    // Darknet weights are read with
+    struct SharedWeights {
+        std::unique_ptr<WeightArena> arena;
+        std::unique_ptr<WeightMap> weightMap;
+        std::string error;  // the builds from the file fail with it
+    };
+    std::map<std::pair<std::string, std::string>, SharedWeights> weights;
+    for (auto& build : builds) {
+        if (build.cached) {
+            continue;
+        }
+        SharedWeights& shared = weights[std::make_pair(build.options.weights, build.options.cfg)];
+        if (shared.weightMap) {
+            continue;
+        }
+        std::cout << "[Info] Loading " << build.options.weights << std::endl;
+        shared.arena.reset(new WeightArena);
+        shared.weightMap.reset(new WeightMap(*shared.arena));
+        try {
+            shared.weightMap->load(build.options.weights, build.options.cfg);
+        }
+        catch(const std::runtime_error& exception) {
+            shared.error = exception.what();
+        }
+    }
+
+    ThreadPool pool(jobs);
+    const size_t ahead = pool.size();
+    std::map<int, std::vector<ManifestBuild*>> devices;
+    for (auto& build : builds) {
+        if (!build.cached) {
+            devices[build.device].push_back(&build);
+        }
+    }
+
+    // TensorRT builders are not thread safe, a network must not be defined
+    // while its builder builds another one. Every network thus has a builder
+    // of its own, created with the network on the pool thread that defines
+    // it and handed to the device thread for the build.
+    auto buildOnDevice = [&](int device, const std::vector<ManifestBuild*>& queue) {
+        cudaSetDevice(device);
+
+        std::vector<std::unique_ptr<DefinedNetwork>> defined(queue.size());
+        std::vector<IBuilder*> builders(queue.size(), nullptr);
+        std::vector<std::future<void>> definitions(queue.size());
+        size_t submitted = 0;
+        auto submit = [&]() {
+            size_t i = submitted++;
+            ManifestBuild& build = *queue[i];
+            defined[i].reset(new DefinedNetwork);
+            const SharedWeights& shared = weights[std::make_pair(build.options.weights, build.options.cfg)];
+            if (!shared.error.empty()) {
+                build.error = shared.error;
+                definitions[i] = pool.submit([]() {});
+                return;
+            }
+
+            WeightMap* sharedWeights = shared.weightMap.get();
+            definitions[i] = pool.submit([&build, &defined, &builders, &logger, i, device, sharedWeights, maxBatchSize]() {
+                auto start = Clock::now();
+                cudaSetDevice(device);
+                builders[i] = createInferBuilder(logger);
+                try {
+                    if (!builders[i]) {
+                        throw std::runtime_error("Could not create the TensorRT builder");
+                    }
+                    INetworkDefinition* network = builders[i]->createNetworkV2(networkCreationFlags(build.options));
+                    if (!network) {
+                        throw std::runtime_error("Could not create the network");
+                    }
+                    defineEngineNetwork(*defined[i], network, build.info, build.options, maxBatchSize, DataType::kFLOAT, sharedWeights);
+                }
+                catch(const std::exception& exception) {
+                    build.error = exception.what();
+                }
+                build.defineMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            });
+        };
+
+        for (size_t i = 0; i < queue.size(); ++i) {
+            while (submitted < queue.size() && submitted < i + ahead) {
+                submit();
+            }
+            definitions[i].get();
+            ManifestBuild& build = *queue[i];
+            if (build.error.empty()) {
+                std::cout << "[Info] Building " << build.engine << " on device " << device << std::endl;
+                auto start = Clock::now();
+                IBuilderConfig* config = builders[i]->createBuilderConfig();
+                try {
+                    ICudaEngine* engine = buildDefinedNetwork(*defined[i], builders[i], config);
+                    if (!engine) {
+                        throw std::runtime_error("Engine build failed");
+                    }
+                    build.bytes = saveEngine(engine, build.engine);
+                    engine->destroy();
+                }
+                catch(const std::runtime_error& exception) {
+                    build.error = exception.what();
+                }
+                config->destroy();
+                build.buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            }
+            defined[i].reset();
+            if (builders[i]) {
+                builders[i]->destroy();
+                builders[i] = nullptr;
+            }
+            std::cout << (build.error.empty() ? "[Info] Wrote " : "[Error] Failed ") << build.engine
+                      << (build.error.empty() ? "" : ": " + build.error) << std::endl;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (auto& device : devices) {
+        threads.emplace_back(buildOnDevice, device.first, std::cref(device.second));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// Table of the builds, returns the number of failed ones
+static int printManifestSummary(const std::vector<ManifestBuild>& builds, double wallMs) {
+    int failed = 0;
+    int cached = 0;
+    double defineMs = 0.0;
+    double buildMs = 0.0;
+    size_t bytes = 0;
+    std::cout << std::left << std::setw(40) << "Engine" << std::setw(8) << "Device" << std::right << std::setw(12) << "Define ms"
+              << std::setw(12) << "Build ms" << std::setw(12) << "Size MB" << "  Status" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (auto& build : builds) {
+        std::cout << std::left << std::setw(40) << build.engine << std::setw(8) << build.device << std::right << std::setw(12) << build.defineMs
+                  << std::setw(12) << build.buildMs << std::setw(12) << build.bytes / double(1 << 20) << "  "
+                  << (!build.error.empty() ? "failed: " + build.error : build.cached ? "cached" : "ok") << std::endl;
+        failed += build.error.empty() ? 0 : 1;
+        cached += build.cached ? 1 : 0;
+        defineMs += build.defineMs;
+        buildMs += build.buildMs;
+        bytes += build.bytes;
+    }
+    std::cout << "[Info] " << builds.size() - failed << " of " << builds.size() << " engines built (" << cached << " from the engine cache), " << bytes / double(1 << 20) << " MB, in "
+              << wallMs / 1000 << " s (" << defineMs / 1000 << " s defining, " << buildMs / 1000 << " s building)" << std::endl;
+    std::cout << std::defaultfloat << std::setprecision(6);
+    return failed;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __TRT_NETWORK_TRAITS_H_
+#define __TRT_NETWORK_TRAITS_H_
+
+#include "NvInfer.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace nvinfer1;
+
+// The layer helpers of the networks are templates on the network definition
+// they add layers to. Besides the methods of INetworkDefinition they call, they
+// need its tensor and layer types and a way to add a plugin layer, which are
+// given here. Specialized for INetworkDefinition below and for
+// RecordingNetwork in recordingnetwork.h.
+template <typename Network>
+struct NetworkTraits;
+
+template <>
+struct NetworkTraits<INetworkDefinition> {
+    using Tensor = ITensor;
+    using Layer = ILayer;
+
+    // Creates the plugin with the creator registered for type and version
+    static Layer* addPlugin(INetworkDefinition* network, const char* type, const char* version, std::vector<PluginField>& fields, Tensor* const* inputs, int nbInputs) {
+        auto creator = getPluginRegistry()->getPluginCreator(type, version);
+        if (!creator) {
+            throw std::runtime_error(std::string("Plugin ") + type + " version " + version + " is not registered");
+        }
+
+        PluginFieldCollection pluginData;
+        pluginData.nbFields = fields.size();
+        pluginData.fields = fields.data();
+        IPluginV2* plugin = creator->createPlugin(type, &pluginData);
+        return network->addPluginV2(inputs, nbInputs, *plugin);
+    }
+};
+
+template <typename Network>
+using TensorOf = typename NetworkTraits<Network>::Tensor;
+
+template <typename Network>
+using LayerOf = typename NetworkTraits<Network>::Layer;
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef __TRT_PRECISION_POLICY_H_
+#define __TRT_PRECISION_POLICY_H_
+
+#include "NvInfer.h"
+
+#include "buildoptions.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace nvinfer1;
+
+// Layers of a reduced precision build that stay in FP32, chosen by name
+// patterns. The networks pin their yolo head convolutions by default
+// (FP32_LAYERS), the layers whose small outputs decide the boxes and scores.
+
+// Name match with the wildcards * (any run of characters) and ? (one character)
+static inline bool matchLayerPattern(const std::string& pattern, const std::string& name) {
+    size_t p = 0;
+    size_t n = 0;
+    size_t star = std::string::npos;
+    size_t resume = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            p++;
+            n++;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = n;
+        }
+        else if (star != std::string::npos) {
+            p = star + 1;
+            n = ++resume;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
+
+// Patterns of the build, the network's unless overridden, "none" for no pinned layers
+static inline std::vector<std::string> resolveFp32Layers(const BuildOptions& options, const std::vector<std::string>& networkLayers) {
+    if (options.fp32Layers.empty()) {
+        return networkLayers;
+    }
+    std::vector<std::string> patterns;
+    for (auto& pattern : options.fp32Layers) {
+        if (pattern != "none") {
+            patterns.push_back(pattern);
+        }
+    }
+    return patterns;
+}
+
+// Sets the precision and output types of the layers matching the patterns to
+// FP32 and logs the assignment. Nothing is pinned in an FP32 build. Returns
+// the names of the pinned layers, the builder has to obey them with
+// BuilderFlag::kSTRICT_TYPES.
+template <typename Network>
+std::vector<std::string> pinLayerPrecision(Network *network, const std::vector<std::string>& patterns, Precision precision) {
+    std::vector<std::string> pinned;
+    if (precision == Precision::kFP32 || patterns.empty()) {
+        return pinned;
+    }
+
+    std::vector<bool> used(patterns.size(), false);
+    for (int i = 0; i < network->getNbLayers(); ++i) {
+        auto layer = network->getLayer(i);
+        std::string name = layer->getName();
+        bool match = false;
+        for (size_t j = 0; j < patterns.size(); ++j) {
+            if (matchLayerPattern(patterns[j], name)) {
+                used[j] = true;
+                match = true;
+            }
+        }
+        // Shape computations stay in INT32
+        if (!match || layer->getOutput(0)->getType() == DataType::kINT32) {
+            continue;
+        }
+
+        layer->setPrecision(DataType::kFLOAT);
+        for (int j = 0; j < layer->getNbOutputs(); ++j) {
+            // Counts like the number of detections of a filtering yolo layer stay INT32
+            if (layer->getOutput(j)->getType() != DataType::kINT32) {
+                layer->setOutputType(j, DataType::kFLOAT);
+            }
+        }
+        pinned.push_back(name);
+    }
+
+    for (size_t j = 0; j < patterns.size(); ++j) {
+        if (!used[j]) {
+            std::cout << "[Warning] No layer matches the FP32 layer pattern " << patterns[j] << std::endl;
+        }
+    }
+    std::cout << "[Info] " << pinned.size() << " of " << network->getNbLayers() << " layers pinned to FP32, the others "
+              << (precision == Precision::kINT8 ? "INT8" : "FP16") << std::endl;
+    for (auto& name : pinned) {
+        std::cout << "[Info]   " << name << ": FP32" << std::endl;
+    }
+    return pinned;
+}
+
+#endif
@@ -0,0 +1,552 @@
+#ifndef __TRT_RECORDING_NETWORK_H_
+#define __TRT_RECORDING_NETWORK_H_
+
+#include "NvInfer.h"
+
+#include "networktraits.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace nvinfer1;
+
+// Network definition that records the layers added to it instead of building
+// them. It has the methods of INetworkDefinition the layer helpers call, with
+// RecordedTensor and RecordedLayer in place of ITensor and ILayer, and infers
+// the output shapes like the builder, dynamic (-1) dimensions stay -1. Only
+// the TensorRT headers are needed, so the graph of a network can be captured
+// and checked on a machine without GPU or TensorRT libraries.
+
+// Floats per detection of YoloLayer_TRT, sizeof(Yolo::Detection) / sizeof(float)
+static const int RECORDED_YOLO_DETECTION_SIZE = 7;
+
+static inline const char* layerTypeName(LayerType type) {
+    switch (type) {
+        case LayerType::kCONVOLUTION: return "Convolution";
+        case LayerType::kACTIVATION: return "Activation";
+        case LayerType::kPOOLING: return "Pooling";
+        case LayerType::kSCALE: return "Scale";
+        case LayerType::kDECONVOLUTION: return "Deconvolution";
+        case LayerType::kCONCATENATION: return "Concatenation";
+        case LayerType::kELEMENTWISE: return "ElementWise";
+        case LayerType::kCONSTANT: return "Constant";
+        case LayerType::kPLUGIN_V2: return "PluginV2";
+        case LayerType::kSLICE: return "Slice";
+        case LayerType::kSHAPE: return "Shape";
+        case LayerType::kRESIZE: return "Resize";
+        default: return "Unknown";
+    }
+}
+
+struct RecordedLayer;
+
+struct RecordedTensor {
+    int index = 0;                      // in order of creation
+    std::string name;
+    Dims dims{};
+    DataType type = DataType::kFLOAT;
+    RecordedLayer* producer = nullptr;  // null for network inputs
+    bool output = false;
+
+    void setName(const char* tensorName) { name = tensorName; }
+    const char* getName() const { return name.c_str(); }
+    Dims getDimensions() const { return dims; }
+    void setType(DataType tensorType) { type = tensorType; }
+    DataType getType() const { return type; }
+    bool isNetworkInput() const { return !producer; }
+    bool isNetworkOutput() const { return output; }
+};
+
+struct RecordedLayer {
+    int index = 0;
+    LayerType type = LayerType::kIDENTITY;
+    std::string name;
+    std::vector<RecordedTensor*> inputs;
+    std::vector<RecordedTensor*> outputs;
+
+    // Parameters of the layer types they belong to
+    int outputMaps = 0;                 // convolution, deconvolution
+    Dims window{};                      // kernel or pooling window
+    Dims stride{};
+    Dims padding{};
+    int groups = 1;
+    std::vector<Weights> weights;       // kernel and bias, shift, scale and power, or the constant
+    ActivationType activation = ActivationType::kRELU;
+    float alpha = 0.0f;
+    float beta = 0.0f;
+    PoolingType pooling = PoolingType::kMAX;
+    ElementWiseOperation operation = ElementWiseOperation::kSUM;
+    ScaleMode scaleMode = ScaleMode::kUNIFORM;
+    int axis = 0;                       // concatenation axis, scale channel axis
+    ResizeMode resizeMode = ResizeMode::kNEAREST;
+    std::vector<float> scales;
+    Dims start{};                       // slice
+    Dims size{};
+    std::string pluginType;
+    std::string pluginVersion;
+    std::vector<std::pair<std::string, std::vector<double>>> pluginFields;
+
+    DataType precision = DataType::kFLOAT;
+    bool precisionSet = false;
+    std::vector<std::pair<int, DataType>> outputTypes;
+
+    LayerType getType() const { return type; }
+    void setName(const char* layerName) { name = layerName; }
+    const char* getName() const { return name.c_str(); }
+    int getNbInputs() const { return inputs.size(); }
+    RecordedTensor* getInput(int i) const { return inputs.at(i); }
+    int getNbOutputs() const { return outputs.size(); }
+    RecordedTensor* getOutput(int i) const { return outputs.at(i); }
+
+    void setPrecision(DataType dataType) { precision = dataType; precisionSet = true; }
+    DataType getPrecision() const { return precision; }
+    bool precisionIsSet() const { return precisionSet; }
+    void resetPrecision() { precisionSet = false; }
+    void setOutputType(int i, DataType dataType) { outputTypes.emplace_back(i, dataType); }
+
+    void setStrideNd(Dims dims) { stride = dims; infer(); }
+    void setPaddingNd(Dims dims) { padding = dims; infer(); }
+    void setNbGroups(int nbGroups) { groups = nbGroups; }
+    void setAlpha(float value) { alpha = value; }
+    void setBeta(float value) { beta = value; }
+    void setAxis(int value) { axis = value; infer(); }
+    void setResizeMode(ResizeMode mode) { resizeMode = mode; }
+    void setScales(const float* values, int nbScales) { scales.assign(values, values + nbScales); infer(); }
+
+    // Extra inputs like the runtime size of a slice, they do not change the recorded shape
+    void setInput(int i, RecordedTensor& tensor) {
+        if (static_cast<size_t>(i) >= inputs.size()) {
+            inputs.resize(i + 1, nullptr);
+        }
+        inputs[i] = &tensor;
+    }
+
+    bool hasPluginField(const std::string& fieldName) const {
+        for (auto& field : pluginFields) {
+            if (field.first == fieldName) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Value of a plugin field, throws if the plugin has no such field
+    double pluginField(const std::string& fieldName, size_t i = 0) const {
+        for (auto& field : pluginFields) {
+            if (field.first == fieldName && i < field.second.size()) {
+                return field.second[i];
+            }
+        }
+        throw std::runtime_error("Plugin " + pluginType + " has no field " + fieldName);
+    }
+
+    // Output shape from the inputs and parameters, spatial dimensions are the last two
+    void infer() {
+        Dims in = inputs.empty() || !inputs[0] ? Dims{} : inputs[0]->dims;
+        Dims& out = outputs[0]->dims;
+        int h = in.nbDims - 2;
+        int w = in.nbDims - 1;
+        switch (type) {
+            case LayerType::kCONVOLUTION:
+            case LayerType::kPOOLING:
+                out = in;
+                if (type == LayerType::kCONVOLUTION) {
+                    out.d[in.nbDims - 3] = outputMaps;
+                }
+                out.d[h] = convolvedSize(in.d[h], window.d[0], stride.d[0], padding.d[0]);
+                out.d[w] = convolvedSize(in.d[w], window.d[1], stride.d[1], padding.d[1]);
+                break;
+            case LayerType::kDECONVOLUTION:
+                out = in;
+                out.d[in.nbDims - 3] = outputMaps;
+                out.d[h] = in.d[h] < 0 ? -1 : (in.d[h] - 1) * stride.d[0] + window.d[0] - 2 * padding.d[0];
+                out.d[w] = in.d[w] < 0 ? -1 : (in.d[w] - 1) * stride.d[1] + window.d[1] - 2 * padding.d[1];
+                break;
+            case LayerType::kELEMENTWISE:
+                out = in;
+                for (int i = 0; i < in.nbDims; ++i) {
+                    int other = inputs[1]->dims.d[i];
+                    out.d[i] = in.d[i] == other || other == 1 ? in.d[i] : in.d[i] == 1 ? other : -1;
+                }
+                break;
+            case LayerType::kCONCATENATION:
+                out = in;
+                for (size_t i = 1; i < inputs.size(); ++i) {
+                    int extent = inputs[i]->dims.d[axis];
+                    out.d[axis] = out.d[axis] < 0 || extent < 0 ? -1 : out.d[axis] + extent;
+                }
+                break;
+            case LayerType::kRESIZE:
+                out = in;
+                for (int i = 0; i < in.nbDims && static_cast<size_t>(i) < scales.size(); ++i) {
+                    out.d[i] = in.d[i] < 0 ? -1 : static_cast<int>(in.d[i] * scales[i]);
+                }
+                break;
+            case LayerType::kSLICE:
+                out = size;
+                break;
+            case LayerType::kSHAPE:
+                out.nbDims = 1;
+                out.d[0] = in.nbDims;
+                break;
+            case LayerType::kCONSTANT:
+                break;
+            case LayerType::kPLUGIN_V2:
+                inferPlugin(in, out);
+                break;
+            default:
+                out = in;
+                break;
+        }
+    }
+
+    private:
+        static int convolvedSize(int size, int window, int stride, int padding) {
+            return size < 0 ? -1 : (size + 2 * padding - window) / stride + 1;
+        }
+
+        void inferPlugin(const Dims& in, Dims& out) const {
+            if (pluginType == "Mish_TRT") {
+                out = in;
+            }
+            else if (pluginType == "YoloLayer_TRT" && outputs.size() == 2) {
+                // Filter mode, the detections kept and their number
+                int size = static_cast<int>(pluginField("maxDetections")) * RECORDED_YOLO_DETECTION_SIZE;
+                out = in.nbDims == 4 ? static_cast<Dims>(Dims4{in.d[0], size, 1, 1}) : static_cast<Dims>(Dims3{size, 1, 1});
+                outputs[1]->dims = in.nbDims == 4 ? static_cast<Dims>(Dims4{in.d[0], 1, 1, 1}) : static_cast<Dims>(Dims3{1, 1, 1});
+                outputs[1]->type = DataType::kINT32;
+            }
+            else if (pluginType == "YoloLayer_TRT") {
+                // Detections of every cell and anchor in the channel dimension
+                int cells = in.d[in.nbDims - 2] < 0 || in.d[in.nbDims - 1] < 0 ? -1 : in.d[in.nbDims - 2] * in.d[in.nbDims - 1];
+                int size = cells < 0 ? -1 : cells * static_cast<int>(pluginField("numAnchors")) * RECORDED_YOLO_DETECTION_SIZE;
+                out = in.nbDims == 4 ? static_cast<Dims>(Dims4{in.d[0], size, 1, 1}) : static_cast<Dims>(Dims3{size, 1, 1});
+            }
+            else if (pluginType == "YoloNms_TRT") {
+                // {1}, {max_outputs, 4}, {max_outputs} and {max_outputs} per image
+                int maxOutputs = static_cast<int>(pluginField("maxOutputs"));
+                if (in.nbDims == 4) {
+                    out = Dims2{in.d[0], 1};
+                    outputs[1]->dims = Dims3{in.d[0], maxOutputs, 4};
+                    outputs[2]->dims = Dims2{in.d[0], maxOutputs};
+                }
+                else {
+                    out = Dims2{1, 0};
+                    out.nbDims = 1;
+                    outputs[1]->dims = Dims2{maxOutputs, 4};
+                    outputs[2]->dims = Dims2{maxOutputs, 0};
+                    outputs[2]->dims.nbDims = 1;
+                }
+                outputs[3]->dims = outputs[2]->dims;
+                outputs[0]->type = DataType::kINT32;
+            }
+            else {
+                throw std::runtime_error("No shape inference for plugin " + pluginType);
+            }
+        }
+};
+
+class RecordingNetwork {
+    public:
+        // flags as for IBuilder::createNetworkV2()
+        explicit RecordingNetwork(uint32_t flags = 0)
+            : mImplicitBatch(!(flags & (1U << static_cast<uint32_t>(NetworkDefinitionCreationFlag::kEXPLICIT_BATCH)))) {}
+
+        RecordingNetwork(const RecordingNetwork&) = delete;
+        RecordingNetwork& operator=(const RecordingNetwork&) = delete;
+
+        bool hasImplicitBatchDimension() const { return mImplicitBatch; }
+
+        RecordedTensor* addInput(const char* name, DataType type, Dims dims) {
+            RecordedTensor* tensor = addTensor(nullptr);
+            tensor->name = name;
+            tensor->type = type;
+            tensor->dims = dims;
+            mInputs.push_back(tensor);
+            return tensor;
+        }
+
+        void markOutput(RecordedTensor& tensor) {
+            tensor.output = true;
+            mOutputs.push_back(&tensor);
+        }
+
+        RecordedLayer* addConvolutionNd(RecordedTensor& input, int nbOutputMaps, Dims kernelSize, Weights kernelWeights, Weights biasWeights) {
+            RecordedLayer* layer = addLayer(LayerType::kCONVOLUTION, {&input});
+            layer->outputMaps = nbOutputMaps;
+            layer->window = kernelSize;
+            layer->stride = layer->padding = kernelSize;
+            std::fill(layer->stride.d, layer->stride.d + kernelSize.nbDims, 1);
+            std::fill(layer->padding.d, layer->padding.d + kernelSize.nbDims, 0);
+            layer->weights = {kernelWeights, biasWeights};
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addDeconvolutionNd(RecordedTensor& input, int nbOutputMaps, Dims kernelSize, Weights kernelWeights, Weights biasWeights) {
+            RecordedLayer* layer = addConvolutionNd(input, nbOutputMaps, kernelSize, kernelWeights, biasWeights);
+            layer->type = LayerType::kDECONVOLUTION;
+            layer->name = unnamed(*layer);
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addPoolingNd(RecordedTensor& input, PoolingType type, Dims windowSize) {
+            RecordedLayer* layer = addLayer(LayerType::kPOOLING, {&input});
+            layer->pooling = type;
+            layer->window = layer->stride = layer->padding = windowSize;
+            std::fill(layer->stride.d, layer->stride.d + windowSize.nbDims, 1);
+            std::fill(layer->padding.d, layer->padding.d + windowSize.nbDims, 0);
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addScaleNd(RecordedTensor& input, ScaleMode mode, Weights shift, Weights scale, Weights power, int channelAxis) {
+            RecordedLayer* layer = addLayer(LayerType::kSCALE, {&input});
+            layer->scaleMode = mode;
+            layer->weights = {shift, scale, power};
+            layer->axis = channelAxis;
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addActivation(RecordedTensor& input, ActivationType type) {
+            RecordedLayer* layer = addLayer(LayerType::kACTIVATION, {&input});
+            layer->activation = type;
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addElementWise(RecordedTensor& input1, RecordedTensor& input2, ElementWiseOperation op) {
+            RecordedLayer* layer = addLayer(LayerType::kELEMENTWISE, {&input1, &input2});
+            layer->operation = op;
+            layer->infer();
+            return layer;
+        }
+
+        // Concatenates along the channels like the builder's default axis
+        RecordedLayer* addConcatenation(RecordedTensor* const* inputs, int nbInputs) {
+            RecordedLayer* layer = addLayer(LayerType::kCONCATENATION, std::vector<RecordedTensor*>(inputs, inputs + nbInputs));
+            layer->axis = std::max(inputs[0]->dims.nbDims - 3, 0);
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addResize(RecordedTensor& input) {
+            RecordedLayer* layer = addLayer(LayerType::kRESIZE, {&input});
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addSlice(RecordedTensor& input, Dims start, Dims size, Dims stride) {
+            RecordedLayer* layer = addLayer(LayerType::kSLICE, {&input});
+            layer->start = start;
+            layer->size = size;
+            layer->stride = stride;
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addShape(RecordedTensor& input) {
+            RecordedLayer* layer = addLayer(LayerType::kSHAPE, {&input});
+            layer->outputs[0]->type = DataType::kINT32;
+            layer->infer();
+            return layer;
+        }
+
+        RecordedLayer* addConstant(Dims dimensions, Weights weights) {
+            RecordedLayer* layer = addLayer(LayerType::kCONSTANT, {});
+            layer->weights = {weights};
+            layer->outputs[0]->dims = dimensions;
+            layer->outputs[0]->type = weights.type;
+            return layer;
+        }
+
+        // Plugin layer with a copy of the plugin fields, see NetworkTraits
+        RecordedLayer* addPlugin(const char* type, const char* version, const std::vector<PluginField>& fields, RecordedTensor* const* inputs, int nbInputs) {
+            RecordedLayer* layer = addLayer(LayerType::kPLUGIN_V2, std::vector<RecordedTensor*>(inputs, inputs + nbInputs));
+            layer->pluginType = type;
+            layer->pluginVersion = version;
+            for (auto& field : fields) {
+                std::vector<double> values(field.length);
+                for (int i = 0; i < field.length; ++i) {
+                    if (field.type == PluginFieldType::kINT32) {
+                        values[i] = static_cast<const int32_t*>(field.data)[i];
+                    }
+                    else if (field.type == PluginFieldType::kFLOAT32) {
+                        values[i] = static_cast<const float*>(field.data)[i];
+                    }
+                    else {
+                        throw std::runtime_error(std::string("Unsupported type of plugin field ") + field.name);
+                    }
+                }
+                layer->pluginFields.emplace_back(field.name, values);
+            }
+            if (layer->pluginType == "YoloLayer_TRT" && layer->hasPluginField("maxDetections")) {
+                // A filtering yolo layer also outputs the number of detections
+                layer->outputs.push_back(addTensor(layer));
+                layer->outputs[1]->name = layer->name + "_output_1";
+            }
+            else if (layer->pluginType == "YoloNms_TRT") {
+                // num_detections, boxes, scores and classes
+                for (int i = 1; i < 4; ++i) {
+                    layer->outputs.push_back(addTensor(layer));
+                    layer->outputs[i]->name = layer->name + "_output_" + std::to_string(i);
+                }
+            }
+            layer->infer();
+            return layer;
+        }
+
+        int getNbLayers() const { return mLayers.size(); }
+        RecordedLayer* getLayer(int i) { return &mLayers.at(i); }
+        const RecordedLayer* getLayer(int i) const { return &mLayers.at(i); }
+        int getNbInputs() const { return mInputs.size(); }
+        RecordedTensor* getInput(int i) const { return mInputs.at(i); }
+        int getNbOutputs() const { return mOutputs.size(); }
+        RecordedTensor* getOutput(int i) const { return mOutputs.at(i); }
+
+        // One line per layer with its type, parameters, inputs and output
+        // shape but without names, two networks that build the same graph
+        // describe the same
+        std::string describe() const {
+            std::ostringstream out;
+            for (auto& layer : mLayers) {
+                out << layer.index << " " << layerTypeName(layer.type);
+                switch (layer.type) {
+                    case LayerType::kCONVOLUTION:
+                    case LayerType::kDECONVOLUTION:
+                        out << " maps=" << layer.outputMaps << " kernel=" << dims(layer.window) << " stride=" << dims(layer.stride)
+                            << " padding=" << dims(layer.padding) << " groups=" << layer.groups;
+                        break;
+                    case LayerType::kPOOLING:
+                        out << " type=" << static_cast<int>(layer.pooling) << " window=" << dims(layer.window) << " stride=" << dims(layer.stride)
+                            << " padding=" << dims(layer.padding);
+                        break;
+                    case LayerType::kSCALE:
+                        out << " mode=" << static_cast<int>(layer.scaleMode) << " axis=" << layer.axis;
+                        break;
+                    case LayerType::kACTIVATION:
+                        out << " type=" << static_cast<int>(layer.activation) << " alpha=" << layer.alpha << " beta=" << layer.beta;
+                        break;
+                    case LayerType::kELEMENTWISE:
+                        out << " op=" << static_cast<int>(layer.operation);
+                        break;
+                    case LayerType::kCONCATENATION:
+                        out << " axis=" << layer.axis;
+                        break;
+                    case LayerType::kRESIZE:
+                        out << " mode=" << static_cast<int>(layer.resizeMode) << " scales=";
+                        for (size_t i = 0; i < layer.scales.size(); ++i) {
+                            out << (i ? "," : "") << layer.scales[i];
+                        }
+                        break;
+                    case LayerType::kSLICE:
+                        out << " start=" << dims(layer.start) << " size=" << dims(layer.size) << " stride=" << dims(layer.stride);
+                        break;
+                    case LayerType::kPLUGIN_V2:
+                        out << " " << layer.pluginType << "/" << layer.pluginVersion;
+                        for (auto& field : layer.pluginFields) {
+                            out << " " << field.first << "=";
+                            for (size_t i = 0; i < field.second.size(); ++i) {
+                                out << (i ? "," : "") << field.second[i];
+                            }
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                if (!layer.weights.empty()) {
+                    out << " weights=";
+                    for (size_t i = 0; i < layer.weights.size(); ++i) {
+                        out << (i ? "," : "") << layer.weights[i].count;
+                    }
+                }
+                out << " in=";
+                for (size_t i = 0; i < layer.inputs.size(); ++i) {
+                    out << (i ? "," : "") << source(layer.inputs[i]);
+                }
+                out << " out=";
+                for (size_t i = 0; i < layer.outputs.size(); ++i) {
+                    out << (i ? "," : "") << dims(layer.outputs[i]->dims) << (layer.outputs[i]->output ? " output" : "");
+                }
+                out << "\n";
+            }
+            return out.str();
+        }
+
+    private:
+        RecordedTensor* addTensor(RecordedLayer* producer) {
+            mTensors.emplace_back();
+            RecordedTensor* tensor = &mTensors.back();
+            tensor->index = mTensors.size() - 1;
+            tensor->producer = producer;
+            return tensor;
+        }
+
+        // Layer with one output and the builder's default names
+        RecordedLayer* addLayer(LayerType type, std::vector<RecordedTensor*> inputs) {
+            mLayers.emplace_back();
+            RecordedLayer* layer = &mLayers.back();
+            layer->index = mLayers.size() - 1;
+            layer->type = type;
+            layer->inputs = std::move(inputs);
+            layer->outputs.push_back(addTensor(layer));
+            layer->name = unnamed(*layer);
+            return layer;
+        }
+
+        static std::string unnamed(RecordedLayer& layer) {
+            std::string name = "(Unnamed Layer* " + std::to_string(layer.index) + ") [" + layerTypeName(layer.type) + "]";
+            layer.outputs[0]->name = name + "_output";
+            return name;
+        }
+
+        static std::string dims(const Dims& d) {
+            std::string text;
+            for (int i = 0; i < d.nbDims; ++i) {
+                text += (i ? "x" : "") + std::to_string(d.d[i]);
+            }
+            return text;
+        }
+
+        // Producing layer and output of a tensor, or the name of a network input
+        static std::string source(const RecordedTensor* tensor) {
+            if (!tensor) {
+                return "-";
+            }
+            if (!tensor->producer) {
+                return tensor->name;
+            }
+            for (size_t i = 0; i < tensor->producer->outputs.size(); ++i) {
+                if (tensor->producer->outputs[i] == tensor) {
+                    return std::to_string(tensor->producer->index) + (i ? "." + std::to_string(i) : "");
+                }
+            }
+            return "?";
+        }
+
+        bool mImplicitBatch;
+        std::deque<RecordedTensor> mTensors;
+        std::deque<RecordedLayer> mLayers;
+        std::vector<RecordedTensor*> mInputs;
+        std::vector<RecordedTensor*> mOutputs;
+};
+
+template <>
+struct NetworkTraits<RecordingNetwork> {
+    using Tensor = RecordedTensor;
+    using Layer = RecordedLayer;
+
+    static Layer* addPlugin(RecordingNetwork* network, const char* type, const char* version, std::vector<PluginField>& fields, Tensor* const* inputs, int nbInputs) {
+        return network->addPlugin(type, version, fields, inputs, nbInputs);
+    }
+};
+
+#endif
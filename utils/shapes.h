@@ -0,0 +1,118 @@
+#ifndef __TRT_SHAPES_H_
+#define __TRT_SHAPES_H_
+
+#include "NvInfer.h"
+
+#include "arena.h"
+#include "buildoptions.h"
+#include "networktraits.h"
+
+#include <cassert>
+#include <iostream>
+
+using namespace nvinfer1;
+
+// The parts of a network that depend on the batch mode. Implicit batch
+// networks have CHW tensors of fixed size. With BuildOptions::explicitBatch
+// tensors are NCHW and batch, height and width are -1 where their ShapeRange
+// is dynamic, the builder resolves them within the optimization profile.
+// The helpers that add layers are templates on the network, see NetworkTraits.
+
+static inline ShapeRange resolveShapeRange(const ShapeRange& range, int fixed) {
+    if (!range.empty()) {
+        return range;
+    }
+    ShapeRange resolved;
+    resolved.min = resolved.opt = resolved.max = fixed;
+    return resolved;
+}
+
+static inline uint32_t networkCreationFlags(const BuildOptions& options) {
+    return options.explicitBatch ? 1U << static_cast<uint32_t>(NetworkDefinitionCreationFlag::kEXPLICIT_BATCH) : 0U;
+}
+
+// Index of the channel dimension of the tensors of the network
+template <typename Network>
+int channelAxis(Network *network) {
+    return network->hasImplicitBatchDimension() ? 0 : 1;
+}
+
+// RGB image input of the network, {3, H, W} or {N, 3, H, W}
+template <typename Network>
+TensorOf<Network>* addImageInput(Network *network, const BuildOptions& options, const char* name, DataType dt, unsigned int maxBatchSize, int inputH, int inputW) {
+    if (!options.explicitBatch) {
+        return network->addInput(name, dt, Dims3{3, inputH, inputW});
+    }
+
+    ShapeRange batch = resolveShapeRange(options.batch, maxBatchSize);
+    ShapeRange height = resolveShapeRange(options.height, inputH);
+    ShapeRange width = resolveShapeRange(options.width, inputW);
+    return network->addInput(name, dt, Dims4{batch.dynamic() ? -1 : batch.max, 3, height.dynamic() ? -1 : height.max, width.dynamic() ? -1 : width.max});
+}
+
+// Optimization profile of the image input, nothing to do for implicit batch
+static bool addImageProfile(IBuilder* builder, IBuilderConfig* config, const BuildOptions& options, const char* name, unsigned int maxBatchSize, int inputH, int inputW) {
+    if (!options.explicitBatch) {
+        return true;
+    }
+
+    ShapeRange batch = resolveShapeRange(options.batch, maxBatchSize);
+    ShapeRange height = resolveShapeRange(options.height, inputH);
+    ShapeRange width = resolveShapeRange(options.width, inputW);
+    IOptimizationProfile* profile = builder->createOptimizationProfile();
+    profile->setDimensions(name, OptProfileSelector::kMIN, Dims4{batch.min, 3, height.min, width.min});
+    profile->setDimensions(name, OptProfileSelector::kOPT, Dims4{batch.opt, 3, height.opt, width.opt});
+    profile->setDimensions(name, OptProfileSelector::kMAX, Dims4{batch.max, 3, height.max, width.max});
+    if (!profile->isValid()) {
+        return false;
+    }
+    config->addOptimizationProfile(profile);
+
+    std::cout << "[Info] Optimization profile batch " << batch.min << "-" << batch.opt << "-" << batch.max
+              << ", height " << height.min << "-" << height.opt << "-" << height.max
+              << ", width " << width.min << "-" << width.opt << "-" << width.max << std::endl;
+    return true;
+}
+
+// Channels [start, start + channels) of the input. Where batch or resolution
+// are dynamic the slice size is computed at runtime from the input shape as
+// shape * {1, 0, 1, 1} + {0, channels, 0, 0}, its constants are allocated in
+// the arena, which has to outlive the build.
+template <typename Network>
+LayerOf<Network>* addChannelSlice(Network *network, WeightArena& arena, TensorOf<Network>& input, int start, int channels) {
+    Dims dims = input.getDimensions();
+    if (dims.nbDims == 3) {
+        return network->addSlice(input, Dims3{start, 0, 0}, Dims3{channels, dims.d[1], dims.d[2]}, Dims3{1, 1, 1});
+    }
+
+    assert(dims.nbDims == 4);
+    auto slice = network->addSlice(input, Dims4{0, start, 0, 0}, Dims4{dims.d[0], channels, dims.d[2], dims.d[3]}, Dims4{1, 1, 1, 1});
+    assert(slice);
+    if (dims.d[0] >= 0 && dims.d[2] >= 0 && dims.d[3] >= 0) {
+        return slice;
+    }
+
+    int32_t* values = arena.allocate<int32_t>(8);
+    const int32_t constants[] = {1, 0, 1, 1, 0, channels, 0, 0};
+    std::copy(constants, constants + 8, values);
+    Dims vector{};
+    vector.nbDims = 1;
+    vector.d[0] = 4;
+    auto keep = network->addConstant(vector, Weights{DataType::kINT32, values, 4});
+    auto set = network->addConstant(vector, Weights{DataType::kINT32, values + 4, 4});
+    auto shape = network->addShape(input);
+    auto kept = network->addElementWise(*shape->getOutput(0), *keep->getOutput(0), ElementWiseOperation::kPROD);
+    auto size = network->addElementWise(*kept->getOutput(0), *set->getOutput(0), ElementWiseOperation::kSUM);
+    slice->setInput(2, *size->getOutput(0));
+    return slice;
+}
+
+// Nearest neighbor resize by 2 in height and width
+template <typename ResizeLayer, typename Tensor>
+void setUpsampleScales(ResizeLayer* resize, Tensor& input) {
+    const float scales[] = {1.0f, 1.0f, 2.0f, 2.0f};
+    int nbDims = input.getDimensions().nbDims;
+    resize->setScales(scales + 4 - nbDims, nbDims);
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef __TRT_THREADPOOL_H_
+#define __TRT_THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads for host side work during engine build
+class ThreadPool {
+    public:
+        explicit ThreadPool(unsigned int threads = 0) {
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            for (unsigned int i = 0; i < threads; ++i) {
+                mWorkers.emplace_back([this] { work(); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStopping = true;
+            }
+            mCondition.notify_all();
+            for (auto& worker : mWorkers) {
+                worker.join();
+            }
+        }
+
+        size_t size() const { return mWorkers.size(); }
+
+        std::future<void> submit(std::function<void()> job) {
+            auto task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+            std::future<void> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mJobs.emplace([task] { (*task)(); });
+            }
+            mCondition.notify_one();
+            return result;
+        }
+
+        // Calls fn(i) for every i in [0, count), indices are handed out
+        // dynamically so uneven work items balance across the workers.
+        // The calling thread takes part and the call returns when all are done.
+        // Must not be called from a job running on the same pool.
+        void parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+            std::atomic<size_t> next(0);
+            auto run = [&] {
+                for (size_t i = next++; i < count; i = next++) {
+                    fn(i);
+                }
+            };
+
+            std::vector<std::future<void>> helpers;
+            size_t nbHelpers = std::min(count, mWorkers.size());
+            for (size_t i = 1; i < nbHelpers; ++i) {
+                helpers.push_back(submit(run));
+            }
+            run();
+            for (auto& helper : helpers) {
+                helper.get();
+            }
+        }
+
+    private:
+        void work() {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mCondition.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+                    if (mJobs.empty()) {
+                        return;
+                    }
+                    job = std::move(mJobs.front());
+                    mJobs.pop();
+                }
+                job();
+            }
+        }
+
+        std::vector<std::thread> mWorkers;
+        std::queue<std::function<void()>> mJobs;
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        bool mStopping = false;
+};
+
+#endif
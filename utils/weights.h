@@ -1,15 +1,109 @@
 #ifndef __TRT_WEIGHTS_H_
 #define __TRT_WEIGHTS_H_
 
+#include "NvInfer.h"
+
+#include "arena.h"
+#include "checksum.h"
+#include "darknet.h"
+#include "half.h"
+#include "threadpool.h"
+
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include <fstream>
+#include <iostream>
 #include <cassert>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace nvinfer1;
 
+// Read-only memory mapping of a whole file
+class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+            close();
+        }
+
+        bool open(const std::string& file) {
+            close();
+
+            int fd = ::open(file.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+
+            void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED) {
+                return false;
+            }
+
+            mData = static_cast<const char*>(data);
+            mSize = st.st_size;
+            return true;
+        }
+
+        void close() {
+            if (mData) {
+                munmap(const_cast<char*>(mData), mSize);
+            }
+            mData = nullptr;
+            mSize = 0;
+        }
+
+        const char* data() const { return mData; }
+        size_t size() const { return mSize; }
+
+        bool contains(const void* ptr) const {
+            const char* p = static_cast<const char*>(ptr);
+            return mData && p >= mData && p < mData + mSize;
+        }
+
+        // Drops the pages that lie entirely within [begin, end) from the
+        // resident set. They are read again from the file if touched later.
+        void release(const char* begin, const char* end) const {
+            if (!mData) {
+                return;
+            }
+            size_t page = sysconf(_SC_PAGESIZE);
+            size_t first = alignUp(begin - mData, page);
+            size_t last = (end - mData) / page * page;
+            if (first < last) {
+                madvise(const_cast<char*>(mData) + first, last - first, MADV_DONTNEED);
+            }
+        }
+
+    private:
+        const char* mData = nullptr;
+        size_t mSize = 0;
+};
+
 // TensorRT weight files have a simple space delimited format:
 // [type] [size] <data x size in hex>
-static std::map<std::string, Weights> loadWeights(const std::string file) {
+static std::map<std::string, Weights> loadWeights(const std::string file, WeightArena& arena) {
     std::map<std::string, Weights> weightMap;
 
     // Open weights file
@@ -32,13 +126,13 @@ static std::map<std::string, Weights> loadWeights(const std::string file) {
         wt.type = DataType::kFLOAT;
 
         // Load blob
-        uint32_t* val = reinterpret_cast<uint32_t*>(malloc(sizeof(val) * size));
+        uint32_t* val = arena.allocate<uint32_t>(size);
         for (uint32_t x = 0, y = size; x < y; ++x)
         {
             input >> std::hex >> val[x];
         }
         wt.values = val;
-        
+
         wt.count = size;
         weightMap[name] = wt;
     }
@@ -46,4 +140,619 @@ static std::map<std::string, Weights> loadWeights(const std::string file) {
     return weightMap;
 }
 
-#endif
\ No newline at end of file
+// Decodes 8 hex digits (most significant first) without branches: every
+// digit is mapped to its nibble in parallel, then the nibbles are packed.
+// Accepts upper and lower case digits, the input is not validated, see
+// hexDigitErrors8().
+static inline uint32_t decodeHex8(const char* digits) {
+    uint64_t v;
+    memcpy(&v, digits, sizeof(v));
+    v = (v & 0x0F0F0F0F0F0F0F0FULL) + 9 * ((v >> 6) & 0x0101010101010101ULL);
+    v = ((v << 4) | (v >> 8)) & 0x00FF00FF00FF00FFULL;
+    return static_cast<uint32_t>(((v & 0xFF) << 24) | (((v >> 16) & 0xFF) << 16) | (((v >> 32) & 0xFF) << 8) | ((v >> 48) & 0xFF));
+}
+
+// Non-zero if any of 8 characters is not a hex digit. Every byte is range
+// checked in parallel: the high bit of a byte of x + (0x80 - lo) is set if it
+// is at least lo, the one of x + (0x7F - hi) if it is above hi.
+static inline uint64_t hexDigitErrors8(const char* digits) {
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t high = 0x8080808080808080ULL;
+    uint64_t v;
+    memcpy(&v, digits, sizeof(v));
+    uint64_t x = v & ~high;
+    auto between = [&](uint64_t lo, uint64_t hi) { return (x + ones * (0x80 - lo)) & ~(x + ones * (0x7F - hi)); };
+    return (v | ~(between('0', '9') | between('a', 'f') | between('A', 'F'))) & high;
+}
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+// Location of one blob inside a mapped text weight file, every blob is one line
+struct WtsLine {
+    std::string name;
+    uint32_t size;
+    const char* begin;  // first value
+    const char* end;    // end of the last value
+    bool fixedWidth;    // line has exactly the length of size 8 digit values
+};
+
+// Finds line boundaries and reads name and size of every blob, values are
+// decoded later with decodeWtsLine(). With release the pages already indexed
+// are dropped from the resident set as the index goes, see WeightMap.
+static std::vector<WtsLine> indexWeightsText(const MappedFile& text, bool release = false) {
+    const char* p = text.data();
+    const char* end = text.data() + text.size();
+    auto skipBlanks = [&] { while (p < end && isBlank(*p)) ++p; };
+    auto nextToken = [&] { skipBlanks(); const char* begin = p; while (p < end && !isBlank(*p)) ++p; return std::string(begin, p); };
+
+    // Read number of weight blobs
+    int32_t count = std::atoi(nextToken().c_str());
+    if (count <= 0) {
+        throw std::runtime_error("Invalid weight map file.");
+    }
+
+    std::vector<WtsLine> lines(count);
+    for (auto& line : lines)
+    {
+        line.name = nextToken();
+        line.size = std::strtoul(nextToken().c_str(), nullptr, 10);
+        if (line.name.empty()) {
+            throw std::runtime_error("Truncated weight map file, it ends after " + std::to_string(&line - lines.data()) + " of " + std::to_string(count) + " blobs.");
+        }
+
+        while (p < end && *p != '\n' && isBlank(*p)) ++p;
+        const char* eol = p < end ? static_cast<const char*>(memchr(p, '\n', end - p)) : nullptr;
+        line.begin = p;
+        line.end = eol ? eol : end;
+        while (line.end > line.begin && isBlank(line.end[-1])) --line.end;
+        line.fixedWidth = line.size > 0 && line.end - line.begin == 9 * static_cast<ptrdiff_t>(line.size) - 1;
+        p = line.end;
+        if (release) {
+            text.release(text.data(), p);
+        }
+    }
+
+    return lines;
+}
+
+// Checks that a line holds exactly size values of 1 to 8 hex digits
+static bool verifyWtsLine(const WtsLine& line) {
+    const char* q = line.begin;
+    for (uint32_t x = 0; x < line.size; ++x) {
+        while (q < line.end && isBlank(*q)) ++q;
+        if (q + 1 < line.end && q[0] == '0' && (q[1] == 'x' || q[1] == 'X')) q += 2;
+        const char* digits = q;
+        for (; q < line.end && !isBlank(*q); ++q) {
+            if (!isxdigit(static_cast<unsigned char>(*q))) {
+                return false;
+            }
+        }
+        if (q == digits || q - digits > 8) {
+            return false;
+        }
+    }
+    while (q < line.end && isBlank(*q)) ++q;
+    return q == line.end;
+}
+
+// Decodes values [first, last) of a fixed width line. Returns false if not
+// every value is 8 hex digits followed by one blank, the line then only
+// happens to have the right length or holds invalid values and has to go
+// through decodeIrregularWtsLine().
+static bool decodeFixedWidthWtsLine(const WtsLine& line, uint32_t* values, uint32_t first, uint32_t last) {
+    const char* digits = line.begin + 9 * static_cast<size_t>(first);
+    bool regular = true;
+    uint64_t errors = 0;
+    for (uint32_t x = first; x < last; ++x, digits += 9) {
+        values[x] = decodeHex8(digits);
+        errors |= hexDigitErrors8(digits);
+        regular &= x + 1 == line.size || isBlank(digits[8]);
+    }
+    return regular && !errors;
+}
+
+// Values of varying width, parse them one digit at a time. Returns false if
+// the line does not hold size values of 1 to 8 hex digits.
+static bool decodeIrregularWtsLine(const WtsLine& line, uint32_t* values) {
+    const char* q = line.begin;
+    for (uint32_t x = 0; x < line.size; ++x) {
+        while (q < line.end && isBlank(*q)) ++q;
+        if (q + 1 < line.end && q[0] == '0' && (q[1] == 'x' || q[1] == 'X')) q += 2;
+        uint32_t value = 0;
+        for (; q < line.end && !isBlank(*q); ++q) {
+            value = (value << 4) | ((*q & 0xF) + 9 * (*q >> 6));
+        }
+        values[x] = value;
+    }
+    return verifyWtsLine(line);
+}
+
+// Decodes a line of a mapped file and releases its pages chunk by chunk as
+// they are decoded, so that no more than a chunk of even the largest kernel
+// is resident as text next to its values. Throws if the line holds invalid
+// values.
+static void decodeWtsLine(const WtsLine& line, uint32_t* values, const MappedFile& text) {
+    const uint32_t chunkSize = 1 << 16;
+    bool regular = line.fixedWidth;
+    for (uint32_t first = 0; regular && first < line.size; first += chunkSize) {
+        uint32_t last = std::min(line.size, first + chunkSize);
+        regular = decodeFixedWidthWtsLine(line, values, first, last);
+        text.release(line.begin + 9 * static_cast<size_t>(first), line.begin + 9 * static_cast<size_t>(last));
+    }
+    bool valid = regular || decodeIrregularWtsLine(line, values);
+    text.release(line.begin, line.end);
+    if (!valid) {
+        throw std::runtime_error("Weight blob " + line.name + " does not hold " + std::to_string(line.size) + " hex values");
+    }
+}
+
+// Same text format as loadWeights(), decoded in parallel on the pool. Fixed
+// width lines are split into chunks so that the large convolution kernels
+// spread across all workers. The values are bit-identical to loadWeights().
+static std::map<std::string, Weights> loadWeightsParallel(const std::string file, ThreadPool& pool, WeightArena& arena) {
+    std::map<std::string, Weights> weightMap;
+
+    MappedFile text;
+    if (!text.open(file)) {
+        throw std::runtime_error("Unable to load weight file " + file);
+    }
+
+    struct Chunk {
+        size_t line;
+        uint32_t first, last;
+    };
+    const uint32_t chunkSize = 1 << 16;
+
+    std::vector<WtsLine> lines = indexWeightsText(text);
+    std::vector<uint32_t*> values(lines.size());
+    std::vector<Chunk> chunks;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        values[i] = arena.allocate<uint32_t>(lines[i].size);
+        weightMap[lines[i].name] = Weights{DataType::kFLOAT, values[i], lines[i].size};
+
+        for (uint32_t first = 0; lines[i].fixedWidth && first < lines[i].size; first += chunkSize) {
+            chunks.push_back(Chunk{i, first, std::min(lines[i].size, first + chunkSize)});
+        }
+    }
+
+    std::unique_ptr<std::atomic<bool>[]> irregular(new std::atomic<bool>[lines.size()]);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        irregular[i] = !lines[i].fixedWidth;
+    }
+
+    pool.parallelFor(chunks.size(), [&](size_t i) {
+        const Chunk& chunk = chunks[i];
+        if (!decodeFixedWidthWtsLine(lines[chunk.line], values[chunk.line], chunk.first, chunk.last)) {
+            irregular[chunk.line] = true;
+        }
+    });
+
+    std::vector<size_t> reparse;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (irregular[i]) {
+            reparse.push_back(i);
+        }
+    }
+    std::unique_ptr<bool[]> invalid(new bool[reparse.size()]());
+    pool.parallelFor(reparse.size(), [&](size_t i) {
+        invalid[i] = !decodeIrregularWtsLine(lines[reparse[i]], values[reparse[i]]);
+    });
+    for (size_t i = 0; i < reparse.size(); ++i) {
+        if (invalid[i]) {
+            throw std::runtime_error("Weight blob " + lines[reparse[i]].name + " in " + file + " does not hold " + std::to_string(lines[reparse[i]].size) + " hex values");
+        }
+    }
+
+    return weightMap;
+}
+
+static std::map<std::string, Weights> loadWeightsParallel(const std::string file, WeightArena& arena) {
+    ThreadPool pool;
+    return loadWeightsParallel(file, pool, arena);
+}
+
+// Binary weight files (.wtsb) are laid out so they can be memory mapped and
+// handed to TensorRT without any parsing or copying:
+// [header] [entry x count] [names] <payloads, each WTSB_ALIGNMENT aligned>
+// Entry and payload offsets are absolute file offsets, names are not terminated.
+// With WTSB_FLAG_CHECKSUMS set every entry holds the CRC32C of its payload.
+static const char WTSB_MAGIC[4] = {'W', 'T', 'S', 'B'};
+static const uint32_t WTSB_VERSION = 1;
+static const uint32_t WTSB_ALIGNMENT = 64;
+static const uint32_t WTSB_FLAG_CHECKSUMS = 1;
+
+struct WtsbHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t alignment;
+    uint64_t entriesOffset;
+    uint64_t namesOffset;
+    uint64_t fileSize;
+    uint32_t flags;
+    uint8_t reserved[20];
+};
+static_assert(sizeof(WtsbHeader) == 64, "WtsbHeader must be 64 bytes");
+
+struct WtsbEntry {
+    uint64_t offset;
+    uint64_t count;
+    uint32_t type;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t checksum;
+};
+static_assert(sizeof(WtsbEntry) == 32, "WtsbEntry must be 32 bytes");
+
+static inline size_t weightTypeSize(DataType type) {
+    return type == DataType::kHALF ? 2 : 4;
+}
+
+static bool hasExtension(const std::string& file, const std::string& extension) {
+    return file.size() >= extension.size() && file.compare(file.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// Checks the header and the entry table of a binary weight file, throws if
+// any offset points outside the file
+static const WtsbHeader& checkWeightsBinary(const MappedFile& mapping) {
+    auto check = [](bool condition, const std::string& message) {
+        if (!condition) {
+            throw std::runtime_error(message);
+        }
+    };
+
+    check(mapping.size() >= sizeof(WtsbHeader), "Invalid binary weight file.");
+    const WtsbHeader& header = *reinterpret_cast<const WtsbHeader*>(mapping.data());
+    check(memcmp(header.magic, WTSB_MAGIC, sizeof(WTSB_MAGIC)) == 0, "Invalid binary weight file.");
+    check(header.version == WTSB_VERSION, "Unsupported binary weight file version.");
+    check(header.fileSize == mapping.size(), "Truncated binary weight file, " + std::to_string(mapping.size()) + " of " + std::to_string(header.fileSize) + " bytes.");
+    check(header.alignment > 0 && header.namesOffset <= mapping.size(), "Invalid binary weight file.");
+    check(header.entriesOffset + header.count * sizeof(WtsbEntry) <= header.namesOffset, "Invalid binary weight file.");
+
+    const WtsbEntry* entries = reinterpret_cast<const WtsbEntry*>(mapping.data() + header.entriesOffset);
+    for (uint32_t i = 0; i < header.count; ++i) {
+        const WtsbEntry& entry = entries[i];
+        DataType type = static_cast<DataType>(entry.type);
+        std::string blob = "blob " + std::to_string(i);
+        check(type == DataType::kFLOAT || type == DataType::kHALF, "Invalid type of " + blob + " in binary weight file.");
+        check(header.namesOffset + entry.nameOffset + entry.nameLength <= mapping.size(), "Invalid name of " + blob + " in binary weight file.");
+        check(entry.offset % header.alignment == 0, "Misaligned " + blob + " in binary weight file.");
+        check(entry.offset + entry.count * weightTypeSize(type) <= mapping.size(), "Truncated " + blob + " in binary weight file.");
+    }
+    return header;
+}
+
+// Returns weights that point directly into the mapping, so the mapping has to
+// outlive every use of the returned map
+static std::map<std::string, Weights> loadWeightsBinary(const MappedFile& mapping) {
+    std::map<std::string, Weights> weightMap;
+
+    const WtsbHeader& header = checkWeightsBinary(mapping);
+    const WtsbEntry* entries = reinterpret_cast<const WtsbEntry*>(mapping.data() + header.entriesOffset);
+    const char* names = mapping.data() + header.namesOffset;
+
+    for (uint32_t i = 0; i < header.count; ++i) {
+        const WtsbEntry& entry = entries[i];
+        std::string name(names + entry.nameOffset, entry.nameLength);
+        weightMap[name] = Weights{static_cast<DataType>(entry.type), mapping.data() + entry.offset, static_cast<int64_t>(entry.count)};
+    }
+
+    return weightMap;
+}
+
+// Recomputes the payload checksums on the pool, returns the names of the
+// blobs that do not match. Files without checksums have nothing to compare.
+static std::vector<std::string> verifyWeightsBinary(const MappedFile& mapping, ThreadPool& pool) {
+    const WtsbHeader& header = checkWeightsBinary(mapping);
+    if (!(header.flags & WTSB_FLAG_CHECKSUMS)) {
+        return {};
+    }
+
+    const WtsbEntry* entries = reinterpret_cast<const WtsbEntry*>(mapping.data() + header.entriesOffset);
+    std::unique_ptr<bool[]> corrupt(new bool[header.count]());
+    pool.parallelFor(header.count, [&](size_t i) {
+        const WtsbEntry& entry = entries[i];
+        size_t bytes = entry.count * weightTypeSize(static_cast<DataType>(entry.type));
+        corrupt[i] = crc32c(mapping.data() + entry.offset, bytes) != entry.checksum;
+    });
+
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < header.count; ++i) {
+        if (corrupt[i]) {
+            names.emplace_back(mapping.data() + header.namesOffset + entries[i].nameOffset, entries[i].nameLength);
+        }
+    }
+    return names;
+}
+
+static bool writeWeightsBinary(const std::string& file, const std::map<std::string, Weights>& weightMap) {
+    std::ofstream output(file, std::ios::binary);
+    if (!output) {
+        return false;
+    }
+
+    WtsbHeader header{};
+    memcpy(header.magic, WTSB_MAGIC, sizeof(WTSB_MAGIC));
+    header.version = WTSB_VERSION;
+    header.count = weightMap.size();
+    header.alignment = WTSB_ALIGNMENT;
+    header.flags = WTSB_FLAG_CHECKSUMS;
+    header.entriesOffset = sizeof(WtsbHeader);
+    header.namesOffset = header.entriesOffset + header.count * sizeof(WtsbEntry);
+
+    // Lay out the name table and payloads before writing anything
+    std::vector<WtsbEntry> entries;
+    std::string names;
+    for (auto& wt : weightMap) {
+        WtsbEntry entry{};
+        entry.count = wt.second.count;
+        entry.type = static_cast<uint32_t>(wt.second.type);
+        entry.checksum = crc32c(wt.second.values, wt.second.count * weightTypeSize(wt.second.type));
+        entry.nameOffset = names.size();
+        entry.nameLength = wt.first.size();
+        names += wt.first;
+        entries.push_back(entry);
+    }
+
+    uint64_t offset = alignUp(header.namesOffset + names.size(), WTSB_ALIGNMENT);
+    for (auto& entry : entries) {
+        entry.offset = offset;
+        offset = alignUp(offset + entry.count * weightTypeSize(static_cast<DataType>(entry.type)), WTSB_ALIGNMENT);
+    }
+    header.fileSize = offset;
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(WtsbEntry));
+    output.write(names.data(), names.size());
+
+    const char padding[WTSB_ALIGNMENT] = {};
+    uint64_t position = header.namesOffset + names.size();
+    size_t i = 0;
+    for (auto& wt : weightMap) {
+        output.write(padding, entries[i].offset - position);
+        size_t bytes = entries[i].count * weightTypeSize(wt.second.type);
+        output.write(static_cast<const char*>(wt.second.values), bytes);
+        position = entries[i].offset + bytes;
+        ++i;
+    }
+    output.write(padding, header.fileSize - position);
+
+    return output.good();
+}
+
+// Loads any weight format. Binary (.wtsb) and Darknet (.weights, with the given
+// .cfg or else the one of the same name) files are mapped into the given
+// mapping, text files are decoded into the arena. Binary files are rejected if
+// a blob checksum fails.
+static std::map<std::string, Weights> loadWeights(const std::string file, MappedFile& mapping, WeightArena& arena, const std::string& cfg = "") {
+    if (hasExtension(file, ".wtsb") || hasExtension(file, ".weights")) {
+        if (!mapping.open(file)) {
+            throw std::runtime_error("Unable to load weight file " + file);
+        }
+        if (hasExtension(file, ".weights")) {
+            return indexDarknetWeights(parseDarknetCfg(darknetCfgFor(file, cfg)), mapping.data(), mapping.size());
+        }
+
+        ThreadPool pool;
+        std::vector<std::string> corrupt = verifyWeightsBinary(mapping, pool);
+        if (!corrupt.empty()) {
+            throw std::runtime_error(std::to_string(corrupt.size()) + " blobs in " + file + " fail their checksum, the first is " + corrupt.front());
+        }
+        return loadWeightsBinary(mapping);
+    }
+    return loadWeightsParallel(file, arena);
+}
+
+// Checks a weight file without keeping its values and returns a description
+// of every problem found, an empty list means the file is fine. Binary files
+// are checked against their blob checksums. Text files have none, there every
+// blob must hold as many hex values as its size says. Darknet files must match
+// the sizes given by cfg, or by the .cfg of the same name if it is empty.
+static std::vector<std::string> verifyWeights(const std::string& file, const std::string& cfg, ThreadPool& pool) {
+    std::vector<std::string> problems;
+    MappedFile mapping;
+    if (!mapping.open(file)) {
+        problems.push_back("Unable to load weight file " + file);
+        return problems;
+    }
+
+    try {
+        if (hasExtension(file, ".weights")) {
+            indexDarknetWeights(parseDarknetCfg(darknetCfgFor(file, cfg)), mapping.data(), mapping.size());
+        }
+        else if (hasExtension(file, ".wtsb")) {
+            if (!(checkWeightsBinary(mapping).flags & WTSB_FLAG_CHECKSUMS)) {
+                std::cout << "[Warning] " << file << " has no blob checksums, convert it again to add them" << std::endl;
+            }
+            for (auto& name : verifyWeightsBinary(mapping, pool)) {
+                problems.push_back("Checksum of blob " + name + " does not match");
+            }
+        }
+        else {
+            std::vector<WtsLine> lines = indexWeightsText(mapping);
+            std::unique_ptr<bool[]> invalid(new bool[lines.size()]());
+            pool.parallelFor(lines.size(), [&](size_t i) {
+                invalid[i] = !verifyWtsLine(lines[i]);
+            });
+            for (size_t i = 0; i < lines.size(); ++i) {
+                if (invalid[i]) {
+                    problems.push_back("Blob " + lines[i].name + " does not hold " + std::to_string(lines[i].size) + " hex values");
+                }
+            }
+        }
+    }
+    catch(const std::runtime_error& exception) {
+        problems.push_back(exception.what());
+    }
+    return problems;
+}
+
+// Weights of one engine build, materialized lazily. Opening a file only
+// indexes its blobs, a text blob is decoded into the arena the first time a
+// layer helper asks for it, binary and Darknet blobs are used straight from
+// the mapping. The text is about twice the size of the values, so its pages
+// are released as soon as they are indexed or decoded and the mapping is
+// closed once every blob is decoded; only the arena stays resident.
+// Asking for a blob that is not in the file throws, and the blobs that were
+// never asked for can be listed after the network is defined.
+// Parameters the layer helpers derive from the blobs live in the same arena,
+// so everything is released together with the arena.
+// Binary files may store blobs as kHALF. Those are handed to the builder as
+// they are when the engine is built in FP16 (setHalfWeights(true)), otherwise
+// they are widened to kFLOAT once, on first access.
+// Builds of several engines from one file share it through views, see the
+// second constructor.
+class WeightMap {
+    public:
+        explicit WeightMap(WeightArena& arena) : mArena(arena) {}
+
+        // View of the blobs of a loaded map for one of several builds from
+        // the same file, possibly running in parallel. Blobs are materialized
+        // once, in the shared map and its arena, which have to outlive the
+        // view. Half mode, used blobs and derived parameters (arena) are the
+        // view's own. A view is not loaded itself.
+        WeightMap(WeightArena& arena, WeightMap& shared) : mArena(arena), mShared(&shared) {
+            std::lock_guard<std::mutex> lock(shared.mMutex);
+            for (auto& entry : shared.mEntries) {
+                mEntries[entry.first] = Entry{entry.second.weights, nullptr, -1, true, false};
+            }
+        }
+
+        WeightMap(const WeightMap&) = delete;
+        WeightMap& operator=(const WeightMap&) = delete;
+
+        // Darknet weights are read with cfg, or the .cfg of the same name
+        void load(const std::string& file, const std::string& cfg = "") {
+            if (mShared) {
+                throw std::runtime_error("Weight map views are not loaded, load the shared map");
+            }
+            std::lock_guard<std::mutex> lock(mMutex);
+            mEntries.clear();
+            mLines.clear();
+
+            if (!hasExtension(file, ".wts")) {
+                for (auto& wt : loadWeights(file, mFile, mArena, cfg)) {
+                    mEntries[wt.first] = Entry{wt.second, nullptr, -1, true, false};
+                }
+                return;
+            }
+
+            if (!mFile.open(file)) {
+                throw std::runtime_error("Unable to load weight file " + file);
+            }
+            mLines = indexWeightsText(mFile, true);
+            mDecoded = 0;
+            for (size_t i = 0; i < mLines.size(); ++i) {
+                Weights wt{DataType::kFLOAT, nullptr, mLines[i].size};
+                mEntries[mLines[i].name] = Entry{wt, nullptr, static_cast<int>(i), false, false};
+            }
+        }
+
+        // Lets operator[] return kHALF blobs without widening them
+        void setHalfWeights(bool halfWeights) {
+            mHalfWeights = halfWeights;
+        }
+
+        // Blob for a builder layer, kHALF only if setHalfWeights(true)
+        Weights operator[](const std::string& name) {
+            return get(name, mHalfWeights ? DataType::kHALF : DataType::kFLOAT);
+        }
+
+        // Blob with type kFLOAT for host side math on the values
+        const float* floats(const std::string& name) {
+            return static_cast<const float*>(get(name, DataType::kFLOAT).values);
+        }
+
+        // Blob in its stored type if that is kFLOAT or the given type, kHALF
+        // blobs are widened if kFLOAT is asked for. Float blobs are never
+        // narrowed, the builder converts those itself.
+        Weights get(const std::string& name, DataType type) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            auto entry = mEntries.find(name);
+            if (entry == mEntries.end()) {
+                throw std::runtime_error("Weight blob " + name + " is missing in the weight file");
+            }
+
+            Entry& e = entry->second;
+            if (mShared) {
+                e.used = true;
+                lock.unlock();
+                return mShared->get(name, type);
+            }
+            if (!e.materialized) {
+                uint32_t* values = mArena.allocate<uint32_t>(e.weights.count);
+                decodeWtsLine(mLines[e.line], values, mFile);
+                e.weights.values = values;
+                e.materialized = true;
+                if (++mDecoded == mLines.size()) {
+                    mLines.clear();
+                    mFile.close();
+                }
+            }
+            e.used = true;
+
+            if (e.weights.type != DataType::kHALF || type == DataType::kHALF) {
+                return e.weights;
+            }
+            if (!e.widened) {
+                float* values = mArena.allocate<float>(e.weights.count);
+                halfToFloat(static_cast<const uint16_t*>(e.weights.values), values, e.weights.count);
+                e.widened = values;
+            }
+            return Weights{DataType::kFLOAT, e.widened, e.weights.count};
+        }
+
+        bool contains(const std::string& name) const {
+            return mEntries.count(name) > 0;
+        }
+
+        size_t size() const { return mEntries.size(); }
+
+        WeightArena& arena() { return mArena; }
+
+        // Blobs no layer asked for. Batch norm counters exported by PyTorch
+        // (num_batches_tracked) are never used and are left out.
+        std::vector<std::string> unused() const {
+            std::vector<std::string> names;
+            for (auto& entry : mEntries) {
+                if (!entry.second.used && !hasExtension(entry.first, ".num_batches_tracked")) {
+                    names.push_back(entry.first);
+                }
+            }
+            return names;
+        }
+
+        void reportUnused() const {
+            std::vector<std::string> names = unused();
+            if (names.empty()) {
+                return;
+            }
+            std::cout << "[Warning] " << names.size() << " weight blobs were not used:";
+            for (auto& name : names) {
+                std::cout << " " << name;
+            }
+            std::cout << std::endl;
+        }
+
+    private:
+        struct Entry {
+            Weights weights;
+            const float* widened;  // kFLOAT copy of a kHALF blob
+            int line;  // index into mLines for text files
+            bool materialized;
+            bool used;
+        };
+
+        WeightArena& mArena;
+        MappedFile mFile;
+        std::vector<WtsLine> mLines;
+        size_t mDecoded = 0;    // text blobs decoded, the mapping is closed once all are
+        std::map<std::string, Entry> mEntries;
+        std::mutex mMutex;
+        WeightMap* mShared = nullptr;
+        bool mHalfWeights = false;
+};
+
+#endif